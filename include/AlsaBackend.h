@@ -0,0 +1,94 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ALSABACKEND_MLB_H
+#define ALSABACKEND_MLB_H
+
+#include "AudioBackend.h"
+#include <alsa/asoundlib.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Loopback stream opening ALSA devices directly (hw: or plughw:).
+Both PCMs use the mmap interleaved access and are linked together so they start
+and stop at the same time. Each captured period is copied from the capture mmap
+area straight into the playback mmap area.
+*/
+class AlsaBackend : public AudioBackend
+{
+public:
+    AlsaBackend();
+    virtual ~AlsaBackend();
+
+    virtual bool init(const StreamConfig& config) override;
+    virtual void deinit() override;
+
+    virtual bool play() override;
+    virtual void stop() override;
+
+    virtual bool isPlayingContinue() const override;
+    virtual unsigned long xrunsCount() const override;
+    // The playback PCM is opened at the output rate.
+    virtual bool isResamplingSupported() const override;
+    // Any PCM name is accepted, the probe list the hints of ALSA.
+    virtual bool isDeviceSelectionSupported() const override;
+    virtual bool probeDevices(std::vector<DeviceInfo>* devices) override;
+    virtual std::string devicesHardware() const override;
+
+private:
+    // The period size is the one granted by the device on return.
+    bool setParams(snd_pcm_t* pcm, unsigned int rate, snd_pcm_uframes_t* periodSize, snd_pcm_uframes_t periodsCount, snd_pcm_uframes_t startThreshold);
+    // Fill the playback buffer with silence and start both PCMs.
+    bool start();
+    // Restart the PCMs after an xrun.
+    bool recover();
+    // Store the delay of the PCMs into the counters.
+    void updateLatency();
+
+    void streamLoop();
+    // Copy frames from the capture mmap area to the playback mmap area.
+    int copyPeriod();
+    // Same with a resampler: the period is processed into a buffer, resampled then copied to the playback.
+    int copyResampledPeriod();
+    // Copy frames into the playback mmap area, the frames not fitting are dropped.
+    int writePlayback(const char* data, snd_pcm_uframes_t frames);
+    int writeSilence(snd_pcm_uframes_t frames);
+
+    snd_pcm_t* m_capture;
+    snd_pcm_t* m_playback;
+    bool m_isLinked;
+
+    unsigned int m_sampleRate;
+    unsigned int m_channelsCount;
+    snd_pcm_format_t m_format;
+    snd_pcm_uframes_t m_periodSize;
+    // Period of the playback, the same as the capture without resampling.
+    snd_pcm_uframes_t m_outputPeriodSize;
+    size_t m_frameSize;
+    std::vector<char> m_processedData;
+    std::vector<char> m_resampledData;
+
+    std::thread m_tStream;
+    std::atomic<bool> m_isPlayingContinue;
+    std::atomic<unsigned long> m_xruns;
+};
+
+#endif // ALSABACKEND_MLB_H
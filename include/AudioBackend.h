@@ -0,0 +1,238 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef AUDIOBACKEND_MLB_H
+#define AUDIOBACKEND_MLB_H
+
+#include "DeviceCache.h"
+#include "DriftController.h"
+#include "TimingHistogram.h"
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Sample format exchanged between a backend and the processing path.
+enum class SampleFormat
+{
+    Int16,
+    Int24, // Packed in 3 bytes.
+    Int32,
+    Float32
+};
+
+size_t sampleFormatSize(SampleFormat format);
+// Convert a format name (s16, s24, s32 or f32, as used in the command line and the ini file) into a format.
+bool sampleFormatFromString(const std::string& name, SampleFormat* format);
+const char* sampleFormatName(SampleFormat format);
+
+// Quality of the resampler used when the playback rate differs from the capture rate.
+enum class ResamplerQuality
+{
+    Low,
+    Medium,
+    High
+};
+
+// Convert a quality name (low, medium or high, as used in the command line and the ini file) into a quality.
+bool resamplerQualityFromString(const std::string& name, ResamplerQuality* quality);
+const char* resamplerQualityName(ResamplerQuality quality);
+
+class Resampler;
+class LatencyCeiling;
+
+// Settings of the stream given to the backends.
+struct StreamConfig
+{
+    StreamConfig();
+
+    int sampleRate;
+    // Rate of the playback device, the same as the capture when 0.
+    int outputSampleRate;
+    ResamplerQuality resamplerQuality;
+    // Follow the drift between the clocks of the capture and of the playback with the resampler.
+    bool isDriftCompensation;
+    // Delay in seconds over which frames are dropped to catch up, disabled when 0.
+    double maxLatency;
+    int channelsCount;
+    // Format requested to the devices, the JACK, PipeWire and file APIs use their own.
+    SampleFormat sampleFormat;
+    unsigned long framesPerBuffer;
+
+    // PortAudio suggested latencies (Windows).
+    double inputLatency;
+    double outputLatency;
+
+    // Pulse Simple API ring buffer.
+    int ringBufferPeriods;
+
+    // Devices opened by the API, its default ones when empty.
+    std::string inputDevice;
+    std::string outputDevice;
+
+    // File backend.
+    std::string inputFile;
+    std::string outputFile;
+    bool isFileRealtime;
+    // Drift of the simulated playback clock in ppm, positive when it is faster than the capture.
+    double simulatedDrift;
+};
+
+/*
+Glitch and latency counters of a stream.
+They are updated by the audio thread and read by the main thread without lock.
+*/
+struct StreamCounters
+{
+    StreamCounters();
+    void reset();
+
+    // Frames sent to the processor.
+    std::atomic<unsigned long long> framesProcessed;
+    // Captured frames lost because they were not read in time.
+    std::atomic<unsigned long> inputOverflows;
+    // Silence played because the frames were not written in time.
+    std::atomic<unsigned long> outputUnderflows;
+    // Periods of silence used to prime the output.
+    std::atomic<unsigned long> primingOutputs;
+    // Latency of the devices in microseconds, -1 when not measured.
+    std::atomic<long> inputLatency;
+    std::atomic<long> outputLatency;
+};
+
+/*
+Processing of the captured frames before they are played.
+input and output may be the same buffer (in place processing).
+*/
+class AudioProcessor
+{
+public:
+    virtual ~AudioProcessor() {}
+    virtual void process(const void* input, void* output, unsigned long frames) = 0;
+};
+
+/*
+Interface of the audio APIs used to capture the microphone and play it on the speakers.
+A backend call its processor on each period with interleaved frames.
+*/
+class AudioBackend
+{
+    // Disabling the copy constructor
+    AudioBackend(const AudioBackend&) = delete;
+public:
+    AudioBackend();
+    virtual ~AudioBackend();
+
+    virtual bool init(const StreamConfig& config) = 0;
+    virtual void deinit() = 0;
+
+    virtual bool play() = 0;
+    virtual void stop() = 0;
+
+    virtual bool isPlayingContinue() const = 0;
+
+    // Format, sample rate and frames per buffer really used by the backend.
+    virtual SampleFormat sampleFormat() const;
+    virtual int sampleRate() const;
+    virtual unsigned long framesPerBuffer() const;
+    // Sample rate of the playback device, the frames are resampled after the processing when it differs.
+    virtual int outputSampleRate() const;
+    // Whether the playback can be opened at another rate than the capture.
+    virtual bool isResamplingSupported() const;
+    // Delay added by the resampler in seconds, 0 without resampling.
+    double resamplerLatency() const;
+    // Null when the drift is not compensated.
+    const DriftController* driftController() const;
+    // Whether the backend measure the queued delay and drop frames over the maximum latency.
+    virtual bool isLatencyCeilingSupported() const;
+    // Null when there is no maximum latency.
+    const LatencyCeiling* latencyCeiling() const;
+
+    // Whether the capture and the playback devices can be chosen.
+    virtual bool isDeviceSelectionSupported() const;
+    // Main thread: list the devices of the API and their capabilities, without init().
+    virtual bool probeDevices(std::vector<DeviceInfo>* devices);
+    // Changes when the devices are added or removed, empty when the probe must not be cached.
+    virtual std::string devicesHardware() const;
+
+    // Statistics, only available on some backends.
+    virtual unsigned long xrunsCount() const;
+    virtual size_t ringBufferPeriods() const;
+    virtual double ringBufferFill() const;
+    virtual unsigned long ringBufferOverruns() const;
+    virtual unsigned long ringBufferUnderruns() const;
+    // Change the buffering between the capture and the playback while playing, in periods.
+    // Return false when the backend cannot do it.
+    virtual bool setBufferPeriods(size_t periods);
+
+    const StreamCounters& counters() const;
+    // Time spent handling each period by the audio thread.
+    const TimingHistogram& timing() const;
+    // Fraction of the period spent in the audio callback, -1 when not available.
+    virtual double cpuLoad() const;
+    // Summary printed when the application exit.
+    virtual void printSummary(std::ostream& stream) const;
+
+    void setProcessor(AudioProcessor* processor);
+    const std::string& error() const;
+
+protected:
+    // Send a period to the processor.
+    void process(const void* input, void* output, unsigned long frames);
+
+    // Main thread: create the resampler when the output rate differs or the drift is compensated,
+    // for at most maxFrames frames per call. The drift is updated once per period of maxFrames.
+    bool initResampler(SampleFormat format, unsigned long maxFrames);
+    void deinitResampler();
+    // Audio thread: convert processed frames to the output rate, return the frames written into output.
+    unsigned long resample(const void* input, unsigned long frames, void* output);
+    // Frames of the output rate for maxFrames frames of the input rate.
+    unsigned long resampledFrames(unsigned long frames) const;
+    // Audio thread: give the level in seconds of the buffer between the capture and the playback
+    // to correct the ratio of the resampler.
+    void compensateDrift(double level);
+
+    // Main thread: create the latency ceiling when there is a maximum latency, for at most maxFrames frames per call.
+    bool initLatencyCeiling(SampleFormat format, unsigned long maxFrames);
+    void deinitLatencyCeiling();
+    // Audio thread: drop frames of the processed period when the delay queued before it is over the maximum,
+    // return the frames left.
+    unsigned long limitLatency(void* data, unsigned long frames, double latency);
+
+    // Timing of a period handled by the audio thread.
+    // The deadline is in seconds, the period length is used when it is not given.
+    typedef std::chrono::steady_clock::time_point PeriodTime;
+    static PeriodTime periodBegin();
+    void periodEnd(PeriodTime begin, unsigned long frames, double deadline = 0.0);
+
+    std::string m_strError;
+    StreamConfig m_config;
+    StreamCounters m_counters;
+    TimingHistogram m_timing;
+    // Null when the input and output rates are the same and the drift is not compensated.
+    Resampler* m_resampler;
+    DriftController m_driftController;
+    // Null when there is no maximum latency.
+    LatencyCeiling* m_latencyCeiling;
+
+private:
+    AudioProcessor* m_processor;
+};
+
+#endif // AUDIOBACKEND_MLB_H
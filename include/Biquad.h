@@ -0,0 +1,67 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef BIQUAD_MLB_H
+#define BIQUAD_MLB_H
+
+#include <string>
+#include <vector>
+
+// Shape of a band of the equalizer.
+enum class BiquadType
+{
+    HighPass,
+    LowShelf,
+    Peaking,
+    HighShelf,
+    LowPass
+};
+
+// Band of the equalizer as set by the user.
+struct BiquadBand
+{
+    BiquadBand();
+
+    BiquadType type;
+    // Cutoff or center frequency in Hz.
+    double frequency;
+    double q;
+    // Gain of the shelves and of the peaking bands in dB.
+    double gain;
+};
+
+// Convert "type:frequency[:q[:gain]]" (as used in the command line and the ini file) into a band.
+// The types are highpass, lowshelf, peaking, highshelf and lowpass.
+bool biquadBandFromString(const std::string& text, BiquadBand* band);
+// Convert a comma separated list of bands.
+bool biquadBandsFromString(const std::string& list, std::vector<BiquadBand>* bands);
+
+// Coefficients normalized by a0, for the transposed direct form II.
+struct BiquadCoefficients
+{
+    float b0;
+    float b1;
+    float b2;
+    float a1;
+    float a2;
+};
+
+// Coefficients of the band (Audio EQ Cookbook), false when the frequency is not below the Nyquist frequency.
+bool designBiquad(const BiquadBand& band, int sampleRate, BiquadCoefficients* coefficients);
+
+#endif // BIQUAD_MLB_H
@@ -0,0 +1,63 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef BUFFERCONTROLLER_MLB_H
+#define BUFFERCONTROLLER_MLB_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+/*
+Adaptive size of the buffering between the capture and the playback, in periods.
+The buffering grow by one period when underruns cluster together and shrink
+back by one period after a stable window without any underrun.
+It is updated by the main loop only, periods() may be read from any thread.
+*/
+class BufferController
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    BufferController(size_t minPeriods, size_t maxPeriods);
+
+    // Start from periods (clamped to the bounds).
+    void reset(size_t periods);
+
+    // Give the total of the underruns, return true when the number of periods changed.
+    bool update(unsigned long underruns);
+    bool update(unsigned long underruns, Clock::time_point now);
+
+    size_t periods() const;
+    size_t minPeriods() const;
+    size_t maxPeriods() const;
+
+private:
+    size_t m_minPeriods;
+    size_t m_maxPeriods;
+    std::atomic<size_t> m_periods;
+
+    unsigned long m_lastUnderruns;
+    // Underruns counted in the current cluster window.
+    unsigned long m_windowUnderruns;
+    Clock::time_point m_windowStart;
+    Clock::time_point m_lastUnderrun;
+    Clock::time_point m_lastChange;
+};
+
+#endif // BUFFERCONTROLLER_MLB_H
@@ -19,19 +19,86 @@
 #ifndef STREAMAPPLICATION_CMDParser
 #define STREAMAPPLICATION_CMDParser
 
+#include "AudioBackend.h"
+#include "MixBus.h"
+#include "ProcessingChain.h"
+#include "StreamApi.h"
 #include <string>
+#include <vector>
 #include <cxxopts.hpp>
 
+// Settings of a route played beside the others by the same process, defined by a [route.NAME] section.
+// The keys missing from the section are the global settings.
+struct RouteSettings
+{
+    RouteSettings();
+
+    std::string name;
+    std::string inputDevice;
+    std::string outputDevice;
+    // 0 to let the API choose.
+    int framesPerBuffer;
+    ProcessingSettings processing;
+};
+
 class CMDParser
 {
 public: 
     CMDParser(int& argc, char**& argv);
     ~CMDParser();
 
+    // Configuration file of the user, the one written by the calibration.
+    static std::string userConfigPath();
+
     bool isSampleRateSet() const;
     int sampleRate() const;
+    // Rate of the playback, 0 when it is the sample rate.
+    int outputSampleRate() const;
+    ResamplerQuality resamplerQuality() const;
+    bool isDriftCompensation() const;
+    // Maximum latency in milliseconds, 0 when disabled.
+    double maxLatency() const;
     bool isFramesPerBufferSet() const;
     int framesPerBuffer() const;
+    // Number of channels, 0 when not set.
+    int channelsCount() const;
+    bool isSampleFormatSet() const;
+    SampleFormat sampleFormat() const;
+    StreamApi api() const;
+    // Calibration of the frames per buffer.
+    bool isCalibrate() const;
+    int calibrateTime() const;
+    // Number of bursts of the latency measurement, 0 when disabled.
+    int measureLatencyBursts() const;
+    // Seconds between two statistics reports, 0 when only reported at exit.
+    int statsInterval() const;
+    // Chrome trace file written when not empty.
+    const std::string& traceFile() const;
+
+    // File API.
+    const std::string& inputFile() const;
+    const std::string& outputFile() const;
+    bool isFileRealtime() const;
+    // Drift of the simulated playback clock in ppm, 0 when disabled.
+    double simulatedDrift() const;
+
+    // Stages between the capture and the playback and their settings.
+    const ProcessingSettings& processing() const;
+    // Worker threads running the stages split by channel, 0 to run them on the audio thread.
+    int processingThreads() const;
+    // Benchmark of the processing chain instead of playing.
+    bool isBenchmark() const;
+    // Devices selected by their position in the list of the API, their id or a part of their description, the default ones when empty.
+    const std::string& inputDevice() const;
+    const std::string& outputDevice() const;
+    // List the devices of the API instead of playing.
+    bool isListDevices() const;
+    // Routes played together instead of a single stream, empty without routes.
+    const std::vector<RouteSettings>& routes() const;
+    // Capture sources mixed into the playback, empty without mix.
+    const std::vector<MixSourceSettings>& mixSources() const;
+    // Target level of the ring of each mix source in seconds.
+    double mixBufferTime() const;
 
 #ifdef WIN32
     bool isInputLatencySet() const;
@@ -39,14 +106,47 @@ public:
     bool isOutputLatencySet() const;
     double outputLatency() const;
 #elif __linux__
-    bool usePortAudio() const;
+    bool isRingBufferPeriodsSet() const;
+    int ringBufferPeriods() const;
+    // Bounds of the adaptive buffer in periods, 0 when disabled.
+    int adaptiveBufferMin() const;
+    int adaptiveBufferMax() const;
+    // Unix socket serving the metrics, disabled when empty.
+    const std::string& metricsSocket() const;
 #endif
 
 private:
     bool m_isSampleRateSet;
     int m_sampleRate;
+    int m_outputSampleRate;
+    ResamplerQuality m_resamplerQuality;
+    bool m_isDriftCompensation;
+    double m_maxLatency;
     bool m_isframesPerBufferSet;
     int m_framesPerBuffer;
+    int m_channelsCount;
+    bool m_isSampleFormatSet;
+    SampleFormat m_sampleFormat;
+    StreamApi m_api;
+    bool m_isCalibrate;
+    int m_calibrateTime;
+    bool m_isBenchmark;
+    std::string m_inputDevice;
+    std::string m_outputDevice;
+    bool m_isListDevices;
+    std::vector<RouteSettings> m_routes;
+    int m_measureLatencyBursts;
+    int m_statsInterval;
+    std::string m_traceFile;
+    std::string m_inputFile;
+    std::string m_outputFile;
+    bool m_isFileRealtime;
+    double m_simulatedDrift;
+    ProcessingSettings m_processing;
+    int m_processingThreads;
+    std::vector<MixSourceSettings> m_mixSources;
+    // Milliseconds.
+    double m_mixBuffer;
 
 #ifdef WIN32
     bool m_isInputLatencySet;
@@ -54,7 +154,11 @@ private:
     bool m_isOutputLatencySet;
     double m_outputLatency;
 #elif __linux__
-    bool m_usePortAudio;
+    bool m_isRingBufferPeriodsSet;
+    int m_ringBufferPeriods;
+    int m_adaptiveBufferMin;
+    int m_adaptiveBufferMax;
+    std::string m_metricsSocket;
 #endif
 };
 
@@ -0,0 +1,37 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CONFIGWRITER_MLB_H
+#define CONFIGWRITER_MLB_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+Update keys of a section of an ini file, keeping the other lines and the comments.
+The keys already set are replaced, the missing keys are added at the end of the section,
+the section is added at the end of the file if needed and the file is created if it does not exist.
+*/
+bool writeIniValues(
+    const std::string& path, 
+    const std::string& section, 
+    const std::vector<std::pair<std::string, std::string>>& values,
+    std::string& error);
+
+#endif // CONFIGWRITER_MLB_H
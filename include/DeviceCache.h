@@ -0,0 +1,65 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef DEVICECACHE_MLB_H
+#define DEVICECACHE_MLB_H
+
+#include "StreamApi.h"
+#include <string>
+#include <vector>
+
+// Capabilities of a capture or a playback device, as probed by a backend.
+struct DeviceInfo
+{
+    DeviceInfo();
+
+    // Name opening the device with its API.
+    std::string id;
+    std::string description;
+    bool isInput;
+    int channelsCount;
+    // Rate of the device when no other one is asked, 0 when unknown.
+    int defaultSampleRate;
+    // Lowest latency of the device in seconds, 0 when unknown.
+    double lowLatency;
+    // Rates supported by the device, empty when the API convert any rate.
+    std::vector<int> sampleRates;
+};
+
+// Rates tested when probing a device.
+const std::vector<int>& standardSampleRates();
+
+// Find a device of a direction by its position among them (as listed by --list-devices), its id or a part of its description.
+// Return null when no device match.
+const DeviceInfo* findDevice(const std::vector<DeviceInfo>& devices, const std::string& selector, bool isInput);
+
+// Whether the selector is a position in the list of devices.
+bool isDeviceIndex(const std::string& selector);
+
+/*
+The probe of the devices open each of them, it take a noticeable time on machines with many devices.
+The devices are cached on disk with a fingerprint of the hardware, a cache whose fingerprint changed is ignored.
+*/
+// Hash of the description of the hardware, stored in the cache.
+std::string deviceFingerprint(const std::string& hardware);
+// Path of the cache of an API.
+std::string deviceCachePath(StreamApi api);
+bool loadDeviceCache(const std::string& path, const std::string& fingerprint, std::vector<DeviceInfo>* devices);
+bool saveDeviceCache(const std::string& path, const std::string& fingerprint, const std::vector<DeviceInfo>& devices);
+
+#endif // DEVICECACHE_MLB_H
@@ -0,0 +1,67 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef DRIFTCONTROLLER_MLB_H
+#define DRIFTCONTROLLER_MLB_H
+
+#include <atomic>
+
+/*
+Compensation of the drift between the clocks of the capture and of the playback devices.
+The level of the buffer between them (in seconds) is low-pass filtered and a PI loop
+derive the correction of the resampling ratio holding it at the target level:
+a positive correction consume the captured frames faster.
+The target is the level reached after the settling time unless it is set.
+It is updated by the audio thread only, the getters may be read from any thread.
+*/
+class DriftController
+{
+public:
+    DriftController();
+
+    // Start again with the time between two updates in seconds (not thread safe).
+    void reset(double updatePeriod);
+    // Hold the buffer at this level in seconds instead of the settled one.
+    void setTargetLevel(double level);
+    // Take the target from the level again after the settling time (the buffering changed), the drift is kept.
+    void settle();
+
+    // Give the level of the buffer in seconds, return the correction of the ratio.
+    double update(double level);
+
+    double correction() const;
+    // Filtered level of the buffer in seconds.
+    double level() const;
+    // Negative while settling.
+    double targetLevel() const;
+
+private:
+    double m_updatePeriod;
+    double m_filterCoefficient;
+    double m_elapsedTime;
+    double m_settleTime;
+    double m_integral;
+    bool m_isTargetSet;
+    double m_target;
+
+    std::atomic<float> m_correction;
+    std::atomic<float> m_level;
+    std::atomic<float> m_targetLevel;
+};
+
+#endif // DRIFTCONTROLLER_MLB_H
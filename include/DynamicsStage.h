@@ -0,0 +1,95 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef DYNAMICSSTAGE_MLB_H
+#define DYNAMICSSTAGE_MLB_H
+
+#include "ProcessingChain.h"
+#include <atomic>
+#include <vector>
+
+/*
+Dynamics processor: downward expander (gate), compressor and lookahead limiter.
+The channels are linked, the gains are computed in dB from the loudest channel of each frame.
+The logarithms and exponentials are vectorized, the envelope followers are recursive
+but branch-free, the attack and release are chosen with min and max.
+The limiter delay the signal by the lookahead, so it is reported as the latency of the stage.
+*/
+class DynamicsStage : public ProcessingStage
+{
+public:
+    // Thresholds and ceiling in dBFS, lookahead in milliseconds.
+    DynamicsStage(double gateThreshold, double compressorThreshold, double compressorRatio, double limiterCeiling, double lookahead);
+
+    virtual const char* name() const override;
+    virtual bool init(int sampleRate, int channelsCount, unsigned long maxFrames) override;
+    virtual void process(float* const* planes, unsigned long frames) override;
+    virtual void reset() override;
+    virtual unsigned long latency() const override;
+    virtual std::string report() const override;
+
+private:
+    void computeLevels(float* const* planes, unsigned long frames);
+    void computeGains(unsigned long frames);
+
+    float m_gateThreshold;
+    float m_compressorThreshold;
+    float m_compressorSlope;
+    float m_limiterCeiling;
+    double m_lookaheadDuration;
+
+    int m_channelsCount;
+    unsigned long m_maxFrames;
+    unsigned long m_lookahead;
+
+    // Smoothing coefficients of the envelope followers.
+    float m_gateOpen;
+    float m_gateClose;
+    float m_compressorAttack;
+    float m_compressorRelease;
+    float m_limiterRelease;
+
+    // Level in dB of each frame, then gain of each frame.
+    std::vector<float> m_levels;
+    std::vector<float> m_gains;
+    // Delay lines of the lookahead, the last frames of the previous call followed by the current frames.
+    std::vector<float> m_delay;
+    std::vector<float> m_gainDelay;
+
+    // Gains of the gate and the compressor in dB.
+    float m_gateGain;
+    float m_compressorGain;
+
+    // Minimum of the limiter gains over the lookahead, computed by blocks (van Herk/Gil-Werman).
+    std::vector<float> m_holdBlock;
+    std::vector<float> m_holdSuffix;
+    unsigned long m_holdIndex;
+    float m_holdPrefix;
+    float m_limiterGain;
+    // Moving average of the limiter gains over the lookahead.
+    std::vector<float> m_average;
+    unsigned long m_averageIndex;
+    double m_averageSum;
+
+    // Gain reductions published for the statistics.
+    std::atomic<float> m_gateReduction;
+    std::atomic<float> m_compressorReduction;
+    std::atomic<float> m_limiterReduction;
+};
+
+#endif // DYNAMICSSTAGE_MLB_H
@@ -0,0 +1,71 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef EQUALIZERSTAGE_MLB_H
+#define EQUALIZERSTAGE_MLB_H
+
+#include "Biquad.h"
+#include "ProcessingChain.h"
+#include <vector>
+
+/*
+Parametric equalizer made of a cascade of biquads.
+The bands are processed four at once: each lane of a vector holds a band and
+the samples go through the lanes like a pipeline, band k filtering sample n - k.
+The pipeline is filled and emptied with scalar code at each call, so the stage add no latency.
+*/
+class EqualizerStage : public ProcessingStage
+{
+public:
+    explicit EqualizerStage(const std::vector<BiquadBand>& bands);
+
+    virtual const char* name() const override;
+    virtual bool init(int sampleRate, int channelsCount, unsigned long maxFrames) override;
+    virtual void process(float* const* planes, unsigned long frames) override;
+    virtual bool isChannelIndependent() const override;
+    virtual void processChannel(int channel, float* plane, unsigned long frames) override;
+    virtual void reset() override;
+    virtual size_t filtersCount() const override;
+
+private:
+    static const int LANES = 4;
+
+    // Coefficients of LANES consecutive bands, the missing bands let the samples pass.
+    struct BandGroup
+    {
+        float b0[LANES];
+        float b1[LANES];
+        float b2[LANES];
+        float a1[LANES];
+        float a2[LANES];
+        // Number of real bands in the group.
+        int count;
+    };
+
+    // One biquad of a group, on the state of its lane.
+    static float tick(const BandGroup& group, float* state, int lane, float input);
+    void processGroup(const BandGroup& group, float* state, float* samples, unsigned long frames) const;
+
+    std::vector<BiquadBand> m_bands;
+    std::vector<BandGroup> m_groups;
+    // s1 and s2 of each lane, for each channel and group.
+    std::vector<float> m_state;
+    int m_channelsCount;
+};
+
+#endif // EQUALIZERSTAGE_MLB_H
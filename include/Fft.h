@@ -0,0 +1,57 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FFT_MLB_H
+#define FFT_MLB_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+Fast Fourier transform of a real signal, computed with a complex transform of half the size.
+Everything is allocated in init(), the transform itself can be called from the audio thread.
+*/
+class RealFft
+{
+public:
+    RealFft();
+
+    // Main thread: the size must be a power of two, at least 4.
+    bool init(size_t size);
+    size_t size() const;
+
+    // Audio thread: squared magnitude of the bins 0 to size / 2 of size real samples.
+    void powerSpectrum(const float* input, float* power);
+
+private:
+    void transform();
+
+    size_t m_size;
+    // Complex buffer of size / 2 points, even samples in the real part and odd samples in the imaginary part.
+    std::vector<float> m_real;
+    std::vector<float> m_imaginary;
+    // Twiddle factors of the complex transform and of the split into the real spectrum.
+    std::vector<float> m_cos;
+    std::vector<float> m_sin;
+    std::vector<float> m_splitCos;
+    std::vector<float> m_splitSin;
+    std::vector<uint32_t> m_reversed;
+};
+
+#endif // FFT_MLB_H
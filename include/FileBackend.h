@@ -0,0 +1,87 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FILEBACKEND_MLB_H
+#define FILEBACKEND_MLB_H
+
+#include "AudioBackend.h"
+#include "WavFile.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/*
+Offline backend: a WAV file is used has the microphone and the processed
+frames are written into another WAV file has the speakers.
+It run as fast as possible unless it is asked to run in realtime, so the
+processing path can be measured and tested without any audio hardware.
+*/
+class FileBackend : public AudioBackend
+{
+public:
+    FileBackend();
+    virtual ~FileBackend();
+
+    virtual bool init(const StreamConfig& config) override;
+    virtual void deinit() override;
+
+    virtual bool play() override;
+    virtual void stop() override;
+
+    virtual bool isPlayingContinue() const override;
+
+    // The format and the sample rate are the ones of the input file.
+    virtual SampleFormat sampleFormat() const override;
+    virtual int sampleRate() const override;
+    // The output file is written at the output rate.
+    virtual bool isResamplingSupported() const override;
+    // Only the simulated playback device queue frames.
+    virtual bool isLatencyCeilingSupported() const override;
+
+    // Throughput and processing time per period.
+    virtual void printSummary(std::ostream& stream) const override;
+
+private:
+    void streamLoop();
+    // Queue the written frames into the simulated playback device and consume a period of its clock.
+    void simulatePlayback(unsigned long frames);
+
+    WavReader m_reader;
+    WavWriter m_writer;
+    bool m_isWriting;
+
+    std::vector<char> m_inputData;
+    std::vector<char> m_outputData;
+    std::vector<char> m_resampledData;
+
+    std::thread m_tStream;
+    std::atomic<bool> m_isPlayingContinue;
+
+    // Statistics, written by the stream thread before m_isPlayingContinue is cleared.
+    unsigned long m_periodsCount;
+    unsigned long long m_framesCount;
+    double m_elapsedTime;
+    double m_processingTime;
+    double m_maxProcessingTime;
+
+    // Frames queued in the simulated playback device, at the output rate.
+    double m_playbackLevel;
+    double m_playbackStartLevel;
+};
+
+#endif // FILEBACKEND_MLB_H
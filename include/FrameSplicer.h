@@ -0,0 +1,74 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FRAMESPLICER_MLB_H
+#define FRAMESPLICER_MLB_H
+
+#include "SampleConversion.h"
+#include <vector>
+
+/*
+Removal of frames from a period without a click.
+The frames are taken in the longest run of silent blocks (peak under -45 dBFS) when
+there is one, else at the quietest point of the period, with a raised cosine crossfade
+between the frames before and after the cut.
+The period is loaded, cut any number of times and stored back by the audio thread.
+*/
+class FrameSplicer
+{
+    // Disabling the copy constructor
+    FrameSplicer(const FrameSplicer&) = delete;
+public:
+    FrameSplicer();
+
+    // Main thread: interleaved frames in format, at most maxFrames per period.
+    bool init(SampleFormat format, int channelsCount, int sampleRate, unsigned long maxFrames);
+
+    // Audio thread: load a period of at most maxFrames and measure its blocks.
+    void load(const void* data, unsigned long frames);
+    // Audio thread: remove up to drop frames inside the longest silence of the period, return the frames removed.
+    unsigned long cutSilence(unsigned long drop);
+    // Audio thread: remove drop frames at the quietest point of the period, whatever its level.
+    // At most half of the period is removed, return the frames removed.
+    unsigned long cutQuietest(unsigned long drop);
+    // Audio thread: write the frames left into data, return their count.
+    unsigned long store(void* data);
+
+private:
+    // Peak of each block over all the channels.
+    void measureBlocks();
+    // Longest run of silent blocks, return its length in frames.
+    unsigned long findSilence(unsigned long* start) const;
+    // Start of the quietest span of length frames (the removed frames and the crossfade), at a block boundary.
+    unsigned long findQuietest(unsigned long length) const;
+    // Remove drop frames at position, the fade frames before the cut are crossfaded with the ones after it.
+    void splice(unsigned long position, unsigned long drop, unsigned long fade);
+
+    SampleConverter m_converter;
+    int m_channelsCount;
+    int m_sampleRate;
+    unsigned long m_maxFrames;
+    unsigned long m_blockFrames;
+    std::vector<float> m_buffer;
+    std::vector<float*> m_planes;
+    std::vector<float> m_blockPeaks;
+    // Frames of the loaded period left after the cuts.
+    unsigned long m_frames;
+};
+
+#endif // FRAMESPLICER_MLB_H
@@ -0,0 +1,42 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef GAINSTAGE_MLB_H
+#define GAINSTAGE_MLB_H
+
+#include "ProcessingChain.h"
+
+// Constant gain applied to all the channels.
+class GainStage : public ProcessingStage
+{
+public:
+    // Gain in dB.
+    explicit GainStage(double gain);
+
+    virtual const char* name() const override;
+    virtual bool init(int sampleRate, int channelsCount, unsigned long maxFrames) override;
+    virtual void process(float* const* planes, unsigned long frames) override;
+    virtual bool isChannelIndependent() const override;
+    virtual void processChannel(int channel, float* plane, unsigned long frames) override;
+
+private:
+    float m_gain;
+    int m_channelsCount;
+};
+
+#endif // GAINSTAGE_MLB_H
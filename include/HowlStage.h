@@ -0,0 +1,113 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef HOWLSTAGE_MLB_H
+#define HOWLSTAGE_MLB_H
+
+#include "Biquad.h"
+#include "Fft.h"
+#include "ProcessingChain.h"
+#include <atomic>
+#include <vector>
+
+/*
+Acoustic feedback suppressor.
+The captured signal is analysed every few milliseconds with a FFT, a narrowband peak that
+stand out of the spectrum and keep growing is a howl, a notch filter is placed on its frequency.
+The notch is deepened while the howl persist and released when it has not been seen for a while.
+*/
+class HowlStage : public ProcessingStage
+{
+public:
+    // Maximum notches count, maximum depth of a notch in dB and time before releasing a notch in seconds.
+    HowlStage(int notchesCount, double depth, double release);
+
+    virtual const char* name() const override;
+    virtual bool init(int sampleRate, int channelsCount, unsigned long maxFrames) override;
+    virtual void process(float* const* planes, unsigned long frames) override;
+    virtual void reset() override;
+    virtual std::string report() const override;
+
+    static const int MAX_NOTCHES = 16;
+
+private:
+    // Peak followed between the analyses.
+    struct Track
+    {
+        bool isUsed;
+        double frequency;
+        double level;
+        double startLevel;
+        double minLevel;
+        // Analyses since the peak was found and since it was last missing.
+        int hops;
+        int misses;
+    };
+
+    struct Notch
+    {
+        bool isUsed;
+        double frequency;
+        // Current and target attenuation in dB.
+        double depth;
+        double targetDepth;
+        // Analyses since the howl was last seen.
+        int idleHops;
+        BiquadCoefficients coefficients;
+    };
+
+    void analyse();
+    void updateTrack(Track& track);
+    void triggerNotch(double frequency);
+    void updateNotches();
+    void publish();
+
+    int m_notchesCount;
+    double m_maxDepth;
+    double m_release;
+
+    int m_sampleRate;
+    int m_channelsCount;
+    size_t m_hopSize;
+    size_t m_hopFill;
+    int m_releaseHops;
+    size_t m_firstBin;
+    size_t m_lastBin;
+
+    RealFft m_fft;
+    // Last frames of the captured signal, mixed to mono.
+    std::vector<float> m_history;
+    size_t m_historyPosition;
+    std::vector<float> m_window;
+    std::vector<float> m_frame;
+    std::vector<float> m_power;
+    std::vector<float> m_levels;
+    float m_powerScale;
+
+    std::vector<Track> m_tracks;
+    std::vector<Notch> m_notches;
+    // s1 and s2 of each notch for each channel.
+    std::vector<float> m_notchState;
+
+    // Published for the statistics.
+    std::atomic<unsigned long> m_howlsCount;
+    std::atomic<int> m_notchFrequencies[MAX_NOTCHES];
+    std::atomic<int> m_notchDepths[MAX_NOTCHES];
+};
+
+#endif // HOWLSTAGE_MLB_H
@@ -0,0 +1,81 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef JACKBACKEND_MLB_H
+#define JACKBACKEND_MLB_H
+
+#include "AudioBackend.h"
+#include "SampleConversion.h"
+#include <jack/jack.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+/*
+Loopback stream running as a JACK client.
+The captured samples are sent from the input ports to the output ports
+through the processor in the process callback, at the period size of the JACK server.
+*/
+class JackBackend : public AudioBackend
+{
+public:
+    JackBackend();
+    virtual ~JackBackend();
+
+    virtual bool init(const StreamConfig& config) override;
+    virtual void deinit() override;
+
+    virtual bool play() override;
+    virtual void stop() override;
+
+    virtual bool isPlayingContinue() const override;
+    virtual unsigned long xrunsCount() const override;
+    virtual double cpuLoad() const override;
+
+    // JACK ports are 32 bits float, the sample rate and period size are chosen by the JACK server.
+    virtual SampleFormat sampleFormat() const override;
+    virtual int sampleRate() const override;
+    virtual unsigned long framesPerBuffer() const override;
+
+private:
+    // Static callbacks used has interface to C callbacks
+    static int staticProcessCallback(jack_nframes_t nframes, void* userData);
+    static int staticXrunCallback(void* userData);
+    static void staticShutdownCallback(void* userData);
+
+    int processCallback(jack_nframes_t nframes);
+    // Connect the ports to the physical ports of the server.
+    void connectPhysicalPorts();
+    // Store the latency of the ports into the counters.
+    void updateLatency();
+
+    jack_client_t* m_client;
+    std::vector<jack_port_t*> m_inputPorts;
+    std::vector<jack_port_t*> m_outputPorts;
+    // Interleaved buffers used when there is more than one channel.
+    std::vector<float> m_inputData;
+    std::vector<float> m_outputData;
+    SampleConverter m_converter;
+    std::vector<float*> m_inputPlanes;
+    std::vector<float*> m_outputPlanes;
+
+    std::atomic<bool> m_isPlayingContinue;
+    std::atomic<unsigned long> m_xruns;
+};
+
+#endif // JACKBACKEND_MLB_H
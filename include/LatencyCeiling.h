@@ -0,0 +1,71 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef LATENCYCEILING_MLB_H
+#define LATENCYCEILING_MLB_H
+
+#include "AudioBackend.h"
+#include "FrameSplicer.h"
+#include <atomic>
+#include <cstdint>
+
+/*
+Hard ceiling of the delay queued between the capture and the speakers.
+When the delay goes over the ceiling, frames are removed from the periods until it is back
+under 80% of it (a catch-up). The removed frames are taken in the silent parts of the period
+(peak under -45 dBFS) during half a second, then at the quietest point of the period,
+up to half of it, with a raised cosine crossfade so the cut does not click (see FrameSplicer).
+It is used by the audio thread only, the counters may be read from any thread.
+*/
+class LatencyCeiling
+{
+    // Disabling the copy constructor
+    LatencyCeiling(const LatencyCeiling&) = delete;
+public:
+    LatencyCeiling();
+
+    // Main thread: interleaved frames in format, at most maxFrames per call, maxLatency in seconds.
+    bool init(SampleFormat format, int channelsCount, int sampleRate, double maxLatency, unsigned long maxFrames);
+
+    // Audio thread: latency is the delay in seconds queued before this period.
+    // Frames may be removed from data in place, return the frames left.
+    unsigned long process(void* data, unsigned long frames, double latency);
+
+    double maxLatency() const;
+    // Number of times the latency went over the ceiling.
+    unsigned long catchUpsCount() const;
+    // Frames removed, and the ones of them which were not in silence.
+    uint64_t droppedFrames() const;
+    uint64_t audibleDroppedFrames() const;
+
+private:
+    FrameSplicer m_splicer;
+    int m_sampleRate;
+    double m_maxLatency;
+    unsigned long m_maxFrames;
+
+    bool m_isCatchingUp;
+    // Time spent over the ceiling of the current catch-up.
+    double m_catchUpTime;
+
+    std::atomic<unsigned long> m_catchUpsCount;
+    std::atomic<uint64_t> m_droppedFrames;
+    std::atomic<uint64_t> m_audibleDroppedFrames;
+};
+
+#endif // LATENCYCEILING_MLB_H
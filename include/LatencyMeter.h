@@ -0,0 +1,96 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef LATENCYMETER_MLB_H
+#define LATENCYMETER_MLB_H
+
+#include "AudioBackend.h"
+#include <atomic>
+#include <ostream>
+#include <vector>
+
+/*
+Round-trip latency measurement.
+A maximum length sequence (MLS) burst is played on the output and searched in the
+captured input by cross-correlation. The audio thread only plays the burst and
+records the input, the correlation is done by the main thread in analyze().
+*/
+class LatencyMeter
+{
+    // Disabling the copy constructor
+    LatencyMeter(const LatencyMeter&) = delete;
+public:
+    explicit LatencyMeter(int burstsCount);
+    ~LatencyMeter();
+
+    // Allocate the buffers for the format of the backend (not thread safe).
+    bool init(SampleFormat format, int channelsCount, int sampleRate);
+
+    // Audio thread: play the bursts and record the input.
+    void process(const void* input, void* output, unsigned long frames);
+
+    // Main thread: search the last recorded burst and print its latency.
+    // Return true when a burst was analyzed.
+    bool analyze(std::ostream& stream);
+    bool isFinished() const;
+
+    // Min, median and max of the detected bursts.
+    void printReport(std::ostream& stream) const;
+    size_t detectedCount() const;
+
+private:
+    enum class State
+    {
+        Silence,
+        Recording,
+        Waiting
+    };
+
+    void generateSequence();
+    float inputSample(const void* input, unsigned long frame) const;
+    void writeSample(void* output, unsigned long frame, float value) const;
+    double framesToMs(long frames) const;
+
+    int m_burstsCount;
+    SampleFormat m_format;
+    int m_channelsCount;
+    size_t m_sampleSize;
+    size_t m_frameSize;
+    int m_sampleRate;
+
+    // Burst played on the output.
+    std::vector<float> m_sequence;
+    // Input recorded from the start of the burst.
+    std::vector<float> m_recording;
+    size_t m_maxLatency;
+    size_t m_silenceFrames;
+
+    // Audio thread state.
+    State m_state;
+    size_t m_position;
+
+    // Handoff between the audio thread and the main thread.
+    std::atomic<bool> m_isRecordingReady;
+    std::atomic<int> m_burstsDone;
+
+    // Results, main thread only.
+    std::vector<long> m_latencies;
+    int m_missedCount;
+};
+
+#endif // LATENCYMETER_MLB_H
@@ -19,14 +19,17 @@
 #ifndef LOOPBACKSTREAM_MLB_H
 #define LOOPBACKSTREAM_MLB_H
 
-#include <portaudio.h>
-#ifdef __linux__
-#include <pulse/simple.h>
-#include <thread>
-#endif
+#include "AudioBackend.h"
+#include "BufferController.h"
+#include "LatencyMeter.h"
+#include "ProcessingChain.h"
+#include "StreamApi.h"
+#include <atomic>
+#include <ostream>
 #include <string>
+#include <vector>
 
-class LoopbackStream
+class LoopbackStream : public AudioProcessor
 {
     // Disabling the copy constructor
     LoopbackStream(const LoopbackStream&) = delete;
@@ -45,70 +48,133 @@ public:
 
     bool isStreamReady() const; // Is the stream is ready to play.
     bool isPlayingContinue() const; // Is the stream is playing.
+    const std::string& error() const;
 
     void setSampleRate(int sampleRate);
+    // Rate of the playback, the frames are resampled after the processing when it differs from the sample rate.
+    void setOutputSampleRate(int sampleRate);
+    void setResamplerQuality(ResamplerQuality quality);
+    // Hold the buffering between the capture and the playback devices against the drift of their clocks.
+    void setDriftCompensation(bool value);
+    // Delay in seconds over which frames are dropped to catch up, 0 to disable.
+    void setMaxLatency(double maxLatency);
     void setFramesPerBuffer(int framesPerBuffer);
+    void setChannelsCount(int channelsCount);
+    // Format requested to the devices, the JACK, PipeWire and file APIs use their own.
+    void setSampleFormat(SampleFormat format);
+    void setApi(StreamApi api);
+
+    // File API.
+    void setInputFile(const std::string& path);
+    void setOutputFile(const std::string& path);
+    void setFileRealtime(bool value);
+    // Drift in ppm of the playback clock simulated by the file API.
+    void setSimulatedDrift(double ppm);
+
+    // Devices selected by their position in the list of the API, their id or a part of their description.
+    // The default devices are used when empty.
+    void setInputDevice(const std::string& device);
+    void setOutputDevice(const std::string& device);
+    // Probe the devices of the API and refresh the cache used by init().
+    bool listDevices(std::vector<DeviceInfo>* devices);
 
 #ifdef WIN32
     void setInputLatency(double inputLatency);
     void setOutputLatency(double outputLatency);
 #elif __linux__
-    void usePortAudio(bool value);
+    void setRingBufferPeriods(int periods);
 #endif
 
-private:
-    // Static callbacks used has interface to C callbacks
-    static int staticInputCallback(
-        const void *inputBuffer,
-        void *outputBuffer,
-        unsigned long framesPerBuffer,
-        const PaStreamCallbackTimeInfo* timeInfo,
-        PaStreamCallbackFlags statusFlags,
-        void *userData
-    );
-
-    // Callbacks
-    int inputCallback(
-        const void *inputBuffer,
-        void* outputBuffer
-    );
-
-#ifdef __linux__
-    void streamLoop();
-    void readingStream(int* index);
-#endif
+    // Ring buffer state of the Pulse Simple API path.
+    size_t ringBufferPeriods() const;
+    double ringBufferFill() const;
+    unsigned long ringBufferOverruns() const;
+    unsigned long ringBufferUnderruns() const;
+
+    // Number of xruns recovered by the ALSA API or reported by the JACK server.
+    unsigned long xrunsCount() const;
+
+    // Adapt the buffering between minPeriods and maxPeriods to the underruns (Pulse and Pulse Simple APIs).
+    void setAdaptiveBuffer(int minPeriods, int maxPeriods);
+    // Null when the adaptive buffer is disabled or not supported by the API.
+    const BufferController* bufferController() const;
+    // Called periodically by the main loop, return true when the buffering changed.
+    bool updateAdaptiveBuffer();
+
+    // Glitch and latency counters of the backend, null when there is no backend.
+    const StreamCounters* counters() const;
+    // Time spent by the audio thread on each period, null when there is no backend.
+    const TimingHistogram* timing() const;
+    // Cpu load of the audio callback, -1 when the backend does not report it.
+    double cpuLoad() const;
+
+    // Stages processing the frames between the capture and the playback, built by init().
+    void setProcessing(const ProcessingSettings& settings);
+    // Null when there is no stage.
+    const ProcessingChain* processingChain() const;
+    // Workers running the stages split by channel, null to run them on the audio thread.
+    // The executor may be shared by several streams.
+    void setProcessingExecutor(ProcessingExecutor* executor);
+
+    // Capture devices mixed into the playback after the stages, opened by init() with the API of the stream.
+    // bufferTime is the level in seconds each source is aligned on.
+    void setMixSources(const std::vector<MixSourceSettings>& sources, double bufferTime);
+    // Null without mix source.
+    const MixBus* mixBus() const;
+
+    // Play MLS bursts instead of the microphone to measure the round-trip latency.
+    void setLatencyMeasurement(int burstsCount);
+    LatencyMeter* latencyMeter() const;
+
+    // Rates of the capture and of the playback, set by init().
+    int sampleRate() const;
+    int outputSampleRate() const;
+    // Delay added by the resampler in seconds, 0 without resampling.
+    double resamplerLatency() const;
+    // Null when the drift is not compensated.
+    const DriftController* driftController() const;
+    // Null when there is no maximum latency or the API does not support it.
+    const LatencyCeiling* latencyCeiling() const;
+
+    // Summary of the backend printed when the application exit.
+    void printSummary(std::ostream& stream) const;
+
+    // Processing path between the capture and the playback, called by the backend.
+    virtual void process(const void* input, void* output, unsigned long frames) override;
 
 private:
+    AudioBackend* createBackend() const;
+    // Capture of a mix source with the API of the stream, null when the API cannot capture them.
+    MixCapture* createMixCapture() const;
+    // Open the mix sources at the format of the backend.
+    bool initMixBus();
+    // Devices of the backend, read from the cache when isCacheUsed and the hardware did not change.
+    bool loadDevices(AudioBackend* backend, bool isCacheUsed, std::vector<DeviceInfo>* devices);
+    // Replace the selected devices by their ids and check that they support the stream.
+    bool resolveDevices(AudioBackend* backend, StreamConfig* config);
+
     std::string m_strError;
 
     // Stream information
-    int m_channelsCount, m_sampleRate, m_sizePerSample;
-    unsigned long m_streamFramePerBuffer;
-#ifdef WIN32
-    double m_inputLatency;
-    double m_outputLatency;
-#endif
+    StreamConfig m_config;
+    StreamApi m_api;
+    size_t m_frameSize;
 
     // Stream.
     bool m_isStreamReady;
-    PaStream *m_stream;
-#ifdef __linux__
-    bool m_usePortAudio;
-    pa_simple* m_inputStream;
-    pa_simple* m_outputStream;
-    std::thread m_tStream;
-#endif
+    AudioBackend* m_backend;
+    LatencyMeter* m_latencyMeter;
+    BufferController* m_bufferController;
+    bool m_isAdaptiveBufferActive;
+    ProcessingSettings m_processingSettings;
+    ProcessingChain m_processingChain;
+    ProcessingExecutor* m_processingExecutor;
+    std::vector<MixSourceSettings> m_mixSources;
+    double m_mixBufferTime;
+    MixBus m_mixBus;
 
     // Playing variables.
-    bool m_isPlayingContinue;
-
-    // Buffer size
-    size_t m_inputBufferSize;
-
-    // Buffer data
-#ifdef __linux__
-    char* m_data;
-#endif
+    std::atomic<bool> m_isPlayingContinue;
 };
 
-#endif // LOOPBACKSTREAM_MLB_H
\ No newline at end of file
+#endif // LOOPBACKSTREAM_MLB_H
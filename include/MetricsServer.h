@@ -0,0 +1,76 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef METRICSSERVER_MLB_H
+#define METRICSSERVER_MLB_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class LoopbackStream;
+
+/*
+Metrics of the stream served on a Unix domain socket in the Prometheus text format.
+The values are read from the relaxed atomics published by the audio thread,
+the server run in its own thread so the audio thread never wait for a client.
+A client may send an HTTP request (curl --unix-socket) or nothing (socat).
+With several routes, the metrics of each stream are labelled with the name of its route.
+*/
+class MetricsServer
+{
+    // Disabling the copy constructor
+    MetricsServer(const MetricsServer&) = delete;
+public:
+    MetricsServer();
+    ~MetricsServer();
+
+    // Create the socket at path and start serving the metrics of the streams added.
+    bool start(const std::string& path);
+    // Stop serving and remove the socket file.
+    void stop();
+
+    // The metrics of the stream are labelled with the route, unless it is empty.
+    // A stream must be removed before it is initialized again or destroyed.
+    void addStream(const LoopbackStream* stream, const std::string& route = std::string());
+    void removeStream(const LoopbackStream* stream);
+
+    const std::string& error() const;
+
+private:
+    void serverLoop();
+    void serveClient(int client);
+    std::string metrics() const;
+
+    std::string m_path;
+    std::string m_strError;
+    // Route and stream, read by the server thread.
+    std::vector<std::pair<std::string, const LoopbackStream*>> m_streams;
+    mutable std::mutex m_streamsMutex;
+    int m_socket;
+    std::chrono::steady_clock::time_point m_start;
+
+    std::thread m_tServer;
+    std::atomic<bool> m_isRunning;
+};
+
+#endif // METRICSSERVER_MLB_H
@@ -0,0 +1,175 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MIXBUS_MLB_H
+#define MIXBUS_MLB_H
+
+#include "RingBuffer.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+// Settings of a capture source mixed into the playback, defined by a [mix.NAME] section.
+struct MixSourceSettings
+{
+    MixSourceSettings();
+
+    std::string name;
+    // Capture device, the default one of the API when empty.
+    std::string device;
+    // Gain in dB.
+    double gain;
+    // Position between the left (-1) and the right (1) channels.
+    double pan;
+    bool isMuted;
+};
+
+class MixSource;
+
+/*
+Capture of a mix source by an audio API, from its own thread (or the mainloop of the API).
+The device is opened in mono float at the rate of the stream, the frames are written into the source.
+*/
+class MixCapture
+{
+    // Disabling the copy constructor
+    MixCapture(const MixCapture&) = delete;
+public:
+    MixCapture() {}
+    virtual ~MixCapture() {}
+
+    // Main thread: open the device, framesPerBuffer is the period requested to the API.
+    virtual bool init(const std::string& device, int sampleRate, unsigned long framesPerBuffer, MixSource* source) = 0;
+    virtual void deinit() = 0;
+
+    virtual bool play() = 0;
+    virtual void stop() = 0;
+
+    virtual bool isPlayingContinue() const = 0;
+
+    const std::string& error() const { return m_strError; }
+
+protected:
+    std::string m_strError;
+};
+
+/*
+Source of the mix bus. The captured frames wait in a ring until the audio thread of the stream mix them.
+The sources do not arrive at the same time, so each ring is held around a target level:
+the source is mixed once the ring reach the target, it is primed again after an underrun and
+the oldest frames are dropped when the ring grows over twice the target (a realignment).
+A muted source is still read, so it is aligned when it is unmuted.
+*/
+class MixSource
+{
+    // Disabling the copy constructor
+    MixSource(const MixSource&) = delete;
+public:
+    explicit MixSource(const MixSourceSettings& settings);
+    ~MixSource();
+
+    // Main thread: mixed into channelsCount planes, at most maxFrames per call, the target level in seconds.
+    bool init(int channelsCount, int sampleRate, unsigned long maxFrames, double bufferTime);
+    // Not thread safe, the capture and the stream must be stopped.
+    void reset();
+
+    // Capture thread: mono frames, silence when frames is null.
+    void write(const float* frames, unsigned long count);
+
+    // Audio thread: add the frames of the source into the planes, with its gain and pan.
+    void mix(float* const* planes, unsigned long frames);
+
+    const MixSourceSettings& settings() const;
+    // Any thread.
+    void setMuted(bool isMuted);
+    void setGain(double gain);
+
+    // Frames waiting in the ring in seconds, and its target.
+    double level() const;
+    double targetLevel() const;
+    unsigned long underruns() const;
+    unsigned long realignments() const;
+    // Captured frames lost because the ring was full.
+    unsigned long overflows() const;
+
+private:
+    // Read and forget frames of the ring.
+    void skip(unsigned long frames);
+
+    MixSourceSettings m_settings;
+    RingBuffer m_ring;
+    std::vector<float> m_buffer;
+    // Gain of the source on each output channel, from the pan.
+    std::vector<float> m_panGains;
+    int m_sampleRate;
+    unsigned long m_maxFrames;
+    unsigned long m_targetFrames;
+    bool m_isPrimed;
+
+    std::atomic<float> m_gain;
+    std::atomic<bool> m_isMuted;
+    std::atomic<unsigned long> m_underruns;
+    std::atomic<unsigned long> m_realignments;
+    std::atomic<unsigned long> m_overflows;
+};
+
+/*
+Mixing bus summing capture sources into the playback of the stream.
+It runs in the processing chain, after the stages, on the planar float frames of the microphone:
+the sources are accumulated in float with vectorized kernels and the frames are converted to the
+format of the playback once, by the chain.
+*/
+class MixBus
+{
+    // Disabling the copy constructor
+    MixBus(const MixBus&) = delete;
+public:
+    MixBus();
+    ~MixBus();
+
+    // Main thread: the bus take the ownership of the source and of its capture.
+    void addSource(MixSource* source, MixCapture* capture);
+    void clear();
+    bool isEmpty() const;
+
+    // Main thread: open the captures at the rate of the stream.
+    bool init(int channelsCount, int sampleRate, unsigned long maxFrames, double bufferTime);
+    void deinit();
+    bool play();
+    void stop();
+
+    // Audio thread.
+    void mix(float* const* planes, unsigned long frames);
+
+    size_t sourcesCount() const;
+    const MixSource& source(size_t index) const;
+    // Whether the capture of the source is running.
+    bool isSourcePlaying(size_t index) const;
+
+    const std::string& error() const;
+
+private:
+    std::string m_strError;
+    std::vector<MixSource*> m_sources;
+    std::vector<MixCapture*> m_captures;
+};
+
+// Audio thread: output[i] += gain * input[i], vectorized.
+void accumulateFrames(float* output, const float* input, float gain, unsigned long frames);
+
+#endif // MIXBUS_MLB_H
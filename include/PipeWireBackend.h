@@ -0,0 +1,83 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef PIPEWIREBACKEND_MLB_H
+#define PIPEWIREBACKEND_MLB_H
+
+#include "AudioBackend.h"
+#include "SampleConversion.h"
+#include <pipewire/pipewire.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+/*
+Loopback stream running as a PipeWire filter node.
+The filter has one input and one output port per channel and sends
+the buffers of the input ports to the output ports through the processor
+in the realtime process callback, at the quantum of the PipeWire graph.
+*/
+class PipeWireBackend : public AudioBackend
+{
+public:
+    PipeWireBackend();
+    virtual ~PipeWireBackend();
+
+    virtual bool init(const StreamConfig& config) override;
+    virtual void deinit() override;
+
+    virtual bool play() override;
+    virtual void stop() override;
+
+    virtual bool isPlayingContinue() const override;
+
+    // PipeWire DSP ports are 32 bits float.
+    virtual SampleFormat sampleFormat() const override;
+
+private:
+    // Static callbacks used has interface to C callbacks
+    static void staticProcessCallback(void* userData, struct spa_io_position* position);
+    static void staticStateChangedCallback(void* userData, enum pw_filter_state oldState, enum pw_filter_state state, const char* error);
+
+    void processCallback(struct spa_io_position* position);
+    // Realtime thread: fill the buffers of the output ports with zeros.
+    void playSilence(uint32_t nframes);
+
+    bool m_isPipeWireInit;
+    struct pw_thread_loop* m_loop;
+    struct pw_filter* m_filter;
+    struct pw_filter_events m_filterEvents;
+    // Port data returned by pw_filter_add_port.
+    std::vector<void*> m_inputPorts;
+    std::vector<void*> m_outputPorts;
+    // Interleaved buffers used when there is more than one channel.
+    std::vector<float> m_inputData;
+    std::vector<float> m_outputData;
+    SampleConverter m_converter;
+    std::vector<float*> m_inputPlanes;
+    std::vector<float*> m_outputPlanes;
+    // Used in place of the buffers of the unlinked ports.
+    std::vector<float> m_silence;
+    std::vector<float> m_discard;
+
+    std::atomic<bool> m_isPlayingContinue;
+    // Rate of the graph when it differs from the sample rate, 0 else.
+    std::atomic<uint32_t> m_graphRate;
+};
+
+#endif // PIPEWIREBACKEND_MLB_H
@@ -0,0 +1,106 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef PORTAUDIOBACKEND_MLB_H
+#define PORTAUDIOBACKEND_MLB_H
+
+#include "AudioBackend.h"
+#include "MixBus.h"
+#include <portaudio.h>
+
+/*
+Loopback stream using a PortAudio duplex stream, on the default devices unless others are named.
+PortAudio must be initialized before init() and probeDevices() are called.
+*/
+class PortAudioBackend : public AudioBackend
+{
+public:
+    PortAudioBackend();
+    virtual ~PortAudioBackend();
+
+    virtual bool init(const StreamConfig& config) override;
+    virtual void deinit() override;
+
+    virtual bool play() override;
+    virtual void stop() override;
+
+    virtual bool isPlayingContinue() const override;
+
+    virtual double cpuLoad() const override;
+
+    // The devices are named by their host API and their name.
+    virtual bool isDeviceSelectionSupported() const override;
+    // The rates are tested by opening each device.
+    virtual bool probeDevices(std::vector<DeviceInfo>* devices) override;
+    virtual std::string devicesHardware() const override;
+
+private:
+    // Static callbacks used has interface to C callbacks
+    static int staticInputCallback(
+        const void *inputBuffer,
+        void *outputBuffer,
+        unsigned long framesPerBuffer,
+        const PaStreamCallbackTimeInfo* timeInfo,
+        PaStreamCallbackFlags statusFlags,
+        void *userData
+    );
+
+    // Callbacks
+    int inputCallback(
+        const void *inputBuffer,
+        void* outputBuffer,
+        unsigned long framesPerBuffer,
+        const PaStreamCallbackTimeInfo* timeInfo,
+        PaStreamCallbackFlags statusFlags
+    );
+
+    PaStream *m_stream;
+    bool m_isPlayingContinue;
+};
+
+// Capture of a mix source with a PortAudio input stream.
+class PortAudioCapture : public MixCapture
+{
+public:
+    PortAudioCapture();
+    virtual ~PortAudioCapture();
+
+    virtual bool init(const std::string& device, int sampleRate, unsigned long framesPerBuffer, MixSource* source) override;
+    virtual void deinit() override;
+
+    virtual bool play() override;
+    virtual void stop() override;
+
+    virtual bool isPlayingContinue() const override;
+
+private:
+    static int staticInputCallback(
+        const void *inputBuffer,
+        void *outputBuffer,
+        unsigned long framesPerBuffer,
+        const PaStreamCallbackTimeInfo* timeInfo,
+        PaStreamCallbackFlags statusFlags,
+        void *userData
+    );
+
+    PaStream *m_stream;
+    MixSource* m_source;
+    bool m_isPlayingContinue;
+};
+
+#endif // PORTAUDIOBACKEND_MLB_H
@@ -0,0 +1,195 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef PROCESSINGCHAIN_MLB_H
+#define PROCESSINGCHAIN_MLB_H
+
+#include "AudioBackend.h"
+#include "Biquad.h"
+#include "MixBus.h"
+#include "ProcessingExecutor.h"
+#include "SampleConversion.h"
+#include "TimingHistogram.h"
+#include <atomic>
+#include <string>
+#include <vector>
+
+/*
+A stage of the processing chain, working in place on one float buffer per channel.
+Everything must be allocated in init(), process() is called by the audio thread
+and must not allocate, lock nor do any I/O.
+*/
+class ProcessingStage
+{
+public:
+    virtual ~ProcessingStage() {}
+
+    // Name used in the chain setting and in the statistics.
+    virtual const char* name() const = 0;
+
+    // Main thread: prepare the stage for at most maxFrames frames per call.
+    virtual bool init(int sampleRate, int channelsCount, unsigned long maxFrames) = 0;
+    // Audio thread: process the planes in place.
+    virtual void process(float* const* planes, unsigned long frames) = 0;
+    // Whether the channels do not depend on each other, they can then be processed on different threads.
+    virtual bool isChannelIndependent() const { return false; }
+    // Any thread of the executor: process one channel in place, only called when the channels are independent.
+    // The channels of a period may be processed concurrently.
+    virtual void processChannel(int channel, float* plane, unsigned long frames) {}
+    // Clear the state of the stage (not thread safe).
+    virtual void reset() {}
+    // Number of filters of the stage, the benchmark report the cost of a filter.
+    virtual size_t filtersCount() const { return 1; }
+    // Frames by which the stage delay the signal.
+    virtual unsigned long latency() const { return 0; }
+    // Main thread: state of the stage for the statistics, empty when there is nothing to report.
+    virtual std::string report() const { return std::string(); }
+};
+
+// Settings of the stages, read from the command line and the ini file.
+struct ProcessingSettings
+{
+    ProcessingSettings();
+
+    // Names of the stages, in processing order.
+    std::vector<std::string> stages;
+
+    // Gain stage, in dB.
+    double gain;
+    // Bands of the equalizer stage, in processing order.
+    std::vector<BiquadBand> eqBands;
+    // Howl stage: maximum notches count, maximum depth of a notch in dB and time before releasing a notch in seconds.
+    int howlNotches;
+    double howlDepth;
+    double howlRelease;
+    // Dynamics stage: thresholds and ceiling in dBFS, lookahead of the limiter in milliseconds.
+    double gateThreshold;
+    double compressorThreshold;
+    double compressorRatio;
+    double limiterCeiling;
+    double lookahead;
+};
+
+// Convert a comma separated list of stages (as used in the command line and the ini file) into names.
+bool processingStagesFromString(const std::string& list, std::vector<std::string>* stages);
+// List of the stages, used in the help and error messages.
+std::string availableProcessingStages();
+// Create a stage from its name, null when the name is unknown.
+ProcessingStage* createProcessingStage(const std::string& name, const ProcessingSettings& settings);
+
+/*
+Chain of stages between the capture and the playback, shared by all the backends.
+The frames are converted to planar float, processed in place by each stage and converted back.
+The time spent by each stage is recorded in a histogram, with the period as deadline.
+With an executor, the stages are split in a graph of nodes, one per channel for the stages
+whose channels are independent and one for the others, and the nodes run on its workers.
+The time of each node is then recorded too.
+A mix bus adds its sources to the processed frames before they are converted back.
+*/
+class ProcessingChain : private ProcessingGraph
+{
+    // Disabling the copy constructor
+    ProcessingChain(const ProcessingChain&) = delete;
+public:
+    ProcessingChain();
+    ~ProcessingChain();
+
+    // Main thread: the chain take the ownership of the stage.
+    void addStage(ProcessingStage* stage);
+    // Main thread: workers running the stages, set before init(), null to run them on the audio thread.
+    void setExecutor(ProcessingExecutor* executor);
+    // Main thread: sources added after the stages, null without mixing.
+    void setMixBus(MixBus* mixBus);
+    void clear();
+    // Without stage nor mix bus.
+    bool isEmpty() const;
+
+    // Main thread: allocate the buffers and initialize the stages.
+    // Longer periods are processed in several parts of maxFrames.
+    bool init(SampleFormat format, int channelsCount, int sampleRate, unsigned long maxFrames);
+    // Clear the state of the stages and their timing (not thread safe).
+    void reset();
+
+    // Audio thread: input and output may be the same buffer.
+    void process(const void* input, void* output, unsigned long frames);
+
+    size_t stagesCount() const;
+    const char* stageName(size_t index) const;
+    const TimingHistogram& stageTiming(size_t index) const;
+    size_t stageFiltersCount(size_t index) const;
+    std::string stageReport(size_t index) const;
+    // Delay added by the stages in frames.
+    unsigned long latency() const;
+    int sampleRate() const;
+    // Length of a period in nanoseconds, the budget of the whole chain.
+    uint64_t periodDuration() const;
+
+    // Nodes of the graph run by the executor, 0 when the chain is run serially.
+    size_t nodesCount() const;
+    size_t nodeStage(size_t index) const;
+    // Channel of the node, -1 when the node process all the channels.
+    int nodeChannel(size_t index) const;
+    const TimingHistogram& nodeTiming(size_t index) const;
+    const ProcessingExecutor* executor() const;
+    // Periods run serially because the executor was busy with another stream.
+    unsigned long serialPeriods() const;
+    // Null without mix bus.
+    const MixBus* mixBus() const;
+    // Time spent mixing the sources on each period.
+    const TimingHistogram& mixTiming() const;
+
+    const std::string& error() const;
+
+private:
+    struct Node
+    {
+        size_t stage;
+        int channel;
+    };
+
+    // Split the stages into nodes, each depending on the nodes of the previous stage it reads.
+    void buildGraph(int channelsCount);
+    virtual void runNode(size_t index) override;
+
+    std::string m_strError;
+    std::vector<ProcessingStage*> m_stages;
+    std::vector<TimingHistogram*> m_timings;
+    // Time spent by each stage during the current call.
+    std::vector<uint64_t> m_durations;
+
+    SampleConverter m_converter;
+    std::vector<float> m_data;
+    std::vector<float*> m_planes;
+    size_t m_frameSize;
+    unsigned long m_maxFrames;
+
+    ProcessingExecutor* m_executor;
+    std::vector<Node> m_nodes;
+    std::vector<TimingHistogram*> m_nodeTimings;
+    std::vector<uint64_t> m_nodeDurations;
+    // Frames of the part being run by the executor.
+    unsigned long m_partFrames;
+    std::atomic<unsigned long> m_serialPeriods;
+
+    MixBus* m_mixBus;
+    TimingHistogram m_mixTiming;
+    int m_sampleRate;
+    uint64_t m_periodDuration;
+};
+
+#endif // PROCESSINGCHAIN_MLB_H
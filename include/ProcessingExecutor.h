@@ -0,0 +1,147 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef PROCESSINGEXECUTOR_MLB_H
+#define PROCESSINGEXECUTOR_MLB_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Dependency graph of the work of one period, run by the ProcessingExecutor.
+The nodes are added in a topological order (after the nodes they depend on),
+so running them by index is a valid serial execution.
+*/
+class ProcessingGraph
+{
+    // Disabling the copy constructor
+    ProcessingGraph(const ProcessingGraph&) = delete;
+public:
+    ProcessingGraph();
+    virtual ~ProcessingGraph();
+
+    // Main thread: add a node depending on already added nodes, return its index.
+    size_t addNode(const std::vector<size_t>& dependencies);
+    void clearNodes();
+    size_t nodesCount() const;
+
+    // Any thread of the executor: run a node, each node is run once per period.
+    // The writes of a node are visible to the nodes depending on it and to the caller of the run.
+    virtual void runNode(size_t index) = 0;
+
+private:
+    friend class ProcessingExecutor;
+
+    std::vector<std::vector<size_t>> m_successors;
+    std::vector<int> m_dependenciesCounts;
+    // Dependencies not done yet during a run.
+    std::unique_ptr<std::atomic<int>[]> m_pendings;
+    std::vector<size_t> m_roots;
+};
+
+/*
+Fixed pool of worker threads running the graphs of the audio threads.
+The workers are pinned to a core and in realtime priority when the system allows it.
+Each worker, and the calling audio thread, own a lock-free work-stealing deque (Chase-Lev):
+a node made ready is pushed on the deque of the thread which ran its last dependency
+and the idle threads steal from the others. The caller runs nodes too, then wait for the
+completion by spinning, and sleeping on a futex on Linux.
+The pool runs one graph at a time, run() return false when it is busy with another stream
+or the graph is too large, the caller then run the graph serially.
+*/
+class ProcessingExecutor
+{
+    // Disabling the copy constructor
+    ProcessingExecutor(const ProcessingExecutor&) = delete;
+public:
+    static const int MAX_THREADS = 64;
+    // Nodes of a graph, the capacity of the deques.
+    static const size_t MAX_NODES = 1024;
+
+    ProcessingExecutor();
+    ~ProcessingExecutor();
+
+    // Main thread: start the workers, at most one per core but one, the calling thread runs nodes too.
+    bool start(int threadsCount);
+    // Main thread: the audio threads must be stopped before.
+    void stop();
+    // Workers started, 0 when stopped.
+    int threadsCount() const;
+    // Whether all the workers got their realtime priority.
+    bool isRealtime() const;
+
+    // Audio thread: run the graph with the workers, false when it must be run serially.
+    bool run(ProcessingGraph& graph);
+
+    const std::string& error() const;
+
+private:
+    // Single owner, multiple thieves deque of node indices.
+    class Deque
+    {
+    public:
+        Deque();
+        // Owner.
+        void push(int32_t node);
+        int32_t pop();
+        // Any thread.
+        int32_t steal();
+
+    private:
+        std::atomic<int64_t> m_top;
+        std::atomic<int64_t> m_bottom;
+        std::unique_ptr<std::atomic<int32_t>[]> m_nodes;
+    };
+
+    static const int32_t NO_NODE = -1;
+    // Bits of the run state: active workers, open flag and run sequence.
+    static const uint64_t ACTIVE_MASK = 0xFFFF;
+    static const uint64_t OPEN_FLAG = 0x10000;
+    static const int SEQUENCE_SHIFT = 32;
+
+    void workerLoop(int slot);
+    // Worker: run its own nodes or stolen ones until the graph is done.
+    void work(int slot);
+    // Node from the own deque, or else stolen from the other threads.
+    int32_t findNode(int slot);
+    void runNode(int slot, int32_t node);
+
+    std::string m_strError;
+    std::vector<std::thread> m_threads;
+    // Deque 0 is the one of the calling thread.
+    std::vector<std::unique_ptr<Deque>> m_deques;
+    bool m_isRealtime;
+
+    std::atomic<bool> m_isRunning;
+    std::atomic<bool> m_isBusy;
+    ProcessingGraph* m_graph;
+    // The workers join a run only while it is open, the caller close it when they have left.
+    std::atomic<uint64_t> m_runState;
+    // Nodes not done yet, the caller sleep on it.
+    std::atomic<int32_t> m_remaining;
+    // Incremented to wake the sleeping workers.
+    std::atomic<int32_t> m_wakeSequence;
+    std::atomic<int32_t> m_sleepingWorkers;
+    std::atomic<bool> m_isCallerSleeping;
+};
+
+#endif // PROCESSINGEXECUTOR_MLB_H
@@ -0,0 +1,158 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef PULSEBACKEND_MLB_H
+#define PULSEBACKEND_MLB_H
+
+#include "AudioBackend.h"
+#include "MixBus.h"
+#include <pulse/pulseaudio.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// List the sources and the sinks of the PulseAudio server, used by the Pulse and the Pulse Simple APIs.
+bool probePulseDevices(std::vector<DeviceInfo>* devices, std::string* error);
+
+/*
+Threaded mainloop connected to the server, shared by the Pulse backends of the process:
+the routes use one connection and one mainloop thread.
+*/
+class PulseContext
+{
+    // Disabling the copy constructor
+    PulseContext(const PulseContext&) = delete;
+public:
+    // Main thread: connect on the first call, null on failure with the error set.
+    static PulseContext* acquire(std::string* error);
+    // Main thread: the last release disconnect from the server.
+    static void release(PulseContext* pulseContext);
+
+    pa_threaded_mainloop* mainloop() const;
+    pa_context* context() const;
+
+private:
+    PulseContext();
+    ~PulseContext();
+
+    bool connect(std::string* error);
+    bool isReady() const;
+    static void staticStateCallback(pa_context* context, void* userData);
+
+    pa_threaded_mainloop* m_mainloop;
+    pa_context* m_context;
+    int m_references;
+
+    static std::mutex s_mutex;
+    static PulseContext* s_instance;
+};
+
+/*
+Loopback stream using the asynchronous PulseAudio API.
+The captured fragments are peeked from the record stream and written
+directly into the memory of the playback stream from the mainloop thread.
+*/
+class PulseBackend : public AudioBackend
+{
+public:
+    PulseBackend();
+    virtual ~PulseBackend();
+
+    virtual bool init(const StreamConfig& config) override;
+    virtual void deinit() override;
+
+    virtual bool play() override;
+    virtual void stop() override;
+
+    virtual bool isPlayingContinue() const override;
+    // The playback stream is opened at the output rate.
+    virtual bool isResamplingSupported() const override;
+    // The devices are the sources and the sinks of the server.
+    virtual bool isDeviceSelectionSupported() const override;
+    virtual bool probeDevices(std::vector<DeviceInfo>* devices) override;
+
+    // The target length of the playback buffer.
+    virtual bool setBufferPeriods(size_t periods) override;
+
+private:
+    // Static callbacks used has interface to C callbacks
+    static void staticStreamStateCallback(pa_stream* stream, void* userData);
+    static void staticReadCallback(pa_stream* stream, size_t nbytes, void* userData);
+    static void staticOverflowCallback(pa_stream* stream, void* userData);
+    static void staticUnderflowCallback(pa_stream* stream, void* userData);
+
+    // Forward the captured fragments to the playback stream.
+    void readCallback();
+    // Process and write size bytes of data (or silence if data is null) into the playback stream.
+    bool writeToPlayback(const void* data, size_t size);
+    // Same with a resampler, the fragment is processed by periods and copied into the playback stream.
+    bool writeResampled(const void* data, size_t size);
+    // Store the latency of the streams into the counters.
+    void updateLatency();
+
+    bool connectStreams(const pa_sample_spec& inputSpec, size_t inputPeriodSize, const pa_sample_spec& outputSpec, size_t outputPeriodSize);
+    bool waitStreamReady(pa_stream* stream);
+    void corkStreams(bool cork);
+
+    // Shared connection, the mainloop and the context are the ones of it.
+    PulseContext* m_pulseContext;
+    pa_threaded_mainloop* m_mainloop;
+    pa_context* m_context;
+    pa_stream* m_inputStream;
+    pa_stream* m_outputStream;
+
+    size_t m_periodSize;
+    // Period of the playback stream in bytes, the same as m_periodSize without resampling.
+    size_t m_outputPeriodSize;
+    size_t m_frameSize;
+    // Processed period and its resampled frames.
+    std::vector<char> m_processedData;
+    std::vector<char> m_resampledData;
+    std::atomic<bool> m_isPlayingContinue;
+};
+
+/*
+Capture of a mix source with a record stream of the shared PulseAudio connection,
+read from the mainloop thread.
+*/
+class PulseCapture : public MixCapture
+{
+public:
+    PulseCapture();
+    virtual ~PulseCapture();
+
+    virtual bool init(const std::string& device, int sampleRate, unsigned long framesPerBuffer, MixSource* source) override;
+    virtual void deinit() override;
+
+    virtual bool play() override;
+    virtual void stop() override;
+
+    virtual bool isPlayingContinue() const override;
+
+private:
+    static void staticStreamStateCallback(pa_stream* stream, void* userData);
+    static void staticReadCallback(pa_stream* stream, size_t nbytes, void* userData);
+
+    PulseContext* m_pulseContext;
+    pa_stream* m_stream;
+    MixSource* m_source;
+    std::atomic<bool> m_isPlayingContinue;
+};
+
+#endif // PULSEBACKEND_MLB_H
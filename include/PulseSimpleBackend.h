@@ -0,0 +1,97 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef PULSESIMPLEBACKEND_MLB_H
+#define PULSESIMPLEBACKEND_MLB_H
+
+#include "AudioBackend.h"
+#include "FrameSplicer.h"
+#include "RingBuffer.h"
+#include <pulse/simple.h>
+#include <atomic>
+#include <thread>
+
+/*
+Loopback stream using the Pulse Simple API.
+A capture thread and a playback thread are connected by a ring buffer
+so a playback stall does not stall the capture.
+*/
+class PulseSimpleBackend : public AudioBackend
+{
+public:
+    PulseSimpleBackend();
+    virtual ~PulseSimpleBackend();
+
+    virtual bool init(const StreamConfig& config) override;
+    virtual void deinit() override;
+
+    virtual bool play() override;
+    virtual void stop() override;
+
+    virtual bool isPlayingContinue() const override;
+    // The playback thread resample the periods.
+    virtual bool isResamplingSupported() const override;
+    // The devices are the sources and the sinks of the server.
+    virtual bool isDeviceSelectionSupported() const override;
+    virtual bool probeDevices(std::vector<DeviceInfo>* devices) override;
+    // The ring and the playback stream latency are measured before each period.
+    virtual bool isLatencyCeilingSupported() const override;
+
+    // The periods kept in the ring buffer.
+    virtual bool setBufferPeriods(size_t periods) override;
+
+    virtual size_t ringBufferPeriods() const override;
+    virtual double ringBufferFill() const override;
+    virtual unsigned long ringBufferOverruns() const override;
+    virtual unsigned long ringBufferUnderruns() const override;
+
+private:
+    // Capture and playback threads.
+    void captureLoop();
+    void playbackLoop();
+    // Capture and playback threads: stop the stream, the error is given to m_strError by stop().
+    void fail(const char* error);
+
+    pa_simple* m_inputStream;
+    pa_simple* m_outputStream;
+    std::thread m_tCapture;
+    std::thread m_tPlayback;
+    std::atomic<bool> m_isPlayingContinue;
+    // First error of the threads, a string literal.
+    std::atomic<const char*> m_threadError;
+
+    // Buffer size
+    size_t m_inputBufferSize;
+
+    // Buffer data
+    char* m_data;
+    char* m_playbackData;
+    // Period at the output rate, only with a resampler.
+    char* m_resampledData;
+
+    // Capture to playback buffer.
+    RingBuffer m_ringBuffer;
+    std::atomic<unsigned long> m_ringOverruns;
+    std::atomic<unsigned long> m_ringUnderruns;
+    // Periods kept in the ring by the playback thread, 0 when not adaptive.
+    std::atomic<size_t> m_targetPeriods;
+    // Playback thread: cut of the periods given back when the target shrink.
+    FrameSplicer m_shrinkSplicer;
+};
+
+#endif // PULSESIMPLEBACKEND_MLB_H
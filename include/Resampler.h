@@ -0,0 +1,94 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef RESAMPLER_MLB_H
+#define RESAMPLER_MLB_H
+
+#include "AudioBackend.h"
+#include "SampleConversion.h"
+#include <string>
+#include <vector>
+
+/*
+Polyphase windowed-sinc resampler between two sample rates of rational ratio L / M.
+The lowpass filter is designed for L phases, the output frame j use the phase (j * M) mod L
+on the input frames ending at (j * M) / L, each phase being a dot product of a few dozen taps.
+The filter is computed in init(), the dot products use AVX2, SSE2 or NEON.
+A variable resampler has at least 256 phases and its ratio can be corrected by a few hundred ppm
+while it is running (clock drift), the taps are then interpolated between the two nearest phases.
+*/
+class Resampler
+{
+    // Disabling the copy constructor
+    Resampler(const Resampler&) = delete;
+public:
+    Resampler();
+
+    // Main thread: interleaved frames in format, at most maxInputFrames per call.
+    bool init(SampleFormat format, int channelsCount, int inputRate, int outputRate, ResamplerQuality quality, 
+        unsigned long maxInputFrames, bool isVariable = false);
+    // Clear the history (not thread safe).
+    void reset();
+
+    // Audio thread: resample the frames, return the count of frames written into output.
+    unsigned long process(const void* input, unsigned long frames, void* output);
+    // Audio thread, variable resampler only: the input is consumed (1 + correction) times faster,
+    // the correction is clamped to 1%.
+    void setRatioCorrection(double correction);
+
+    // Most frames returned by process().
+    unsigned long maxOutputFrames() const;
+    // Delay of the filter in seconds.
+    double latency() const;
+    // Taps of each phase.
+    size_t tapsCount() const;
+
+    const std::string& error() const;
+
+private:
+    std::string m_strError;
+    SampleConverter m_converter;
+    int m_channelsCount;
+    int m_inputRate;
+    unsigned long m_maxInputFrames;
+    unsigned long m_maxOutputFrames;
+
+    // Reduced ratio, the output rate is inputRate * L / M.
+    unsigned long m_upFactor;
+    unsigned long m_downFactor;
+    size_t m_tapsCount;
+    // Taps of each phase, in the order of the input frames, followed by the phase L
+    // (the phase 0 of the next frame) for the interpolation.
+    std::vector<float> m_coefficients;
+    bool m_isVariable;
+    // Phases of the variable resampler: taps interpolated for the current output frame and step between two output frames.
+    std::vector<float> m_interpolated;
+    double m_step;
+    double m_position;
+
+    // Each channel hold the last tapsCount - 1 frames followed by the frames of the call.
+    std::vector<float> m_history;
+    std::vector<float*> m_inputPlanes;
+    std::vector<float> m_output;
+    std::vector<float*> m_outputPlanes;
+    // Last input frame used by the next output frame and its phase.
+    unsigned long m_index;
+    unsigned long m_phase;
+};
+
+#endif // RESAMPLER_MLB_H
@@ -0,0 +1,74 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef RINGBUFFER_MLB_H
+#define RINGBUFFER_MLB_H
+
+#include <atomic>
+#include <cstddef>
+
+/*
+Lock-free single producer / single consumer ring buffer.
+The memory is allocated once in init() and the buffer is sized in periods.
+One thread may only write and one other thread may only read.
+*/
+class RingBuffer
+{
+    // Disabling the copy constructor
+    RingBuffer(const RingBuffer&) = delete;
+public:
+    RingBuffer();
+    ~RingBuffer();
+
+    // Allocate the buffer (not thread safe).
+    bool init(size_t periodSize, size_t periodsCount);
+    void deinit();
+    // Empty the buffer (not thread safe).
+    void reset();
+
+    // Producer side.
+    size_t write(const void* data, size_t size);
+    size_t availableWrite() const;
+
+    // Consumer side.
+    size_t read(void* data, size_t size);
+    size_t availableRead() const;
+
+    size_t capacity() const;
+    size_t periodSize() const;
+    size_t periodsCount() const;
+    // Number of periods currently stored in the buffer.
+    double fillLevel() const;
+
+private:
+    char* m_buffer;
+    size_t m_capacity;
+    size_t m_periodSize;
+    size_t m_periodsCount;
+
+    // Monotonic positions, each one is only written by its own thread.
+    // They are padded onto separate cache lines to avoid false sharing
+    // (padding instead of alignas, so the owner can be allocated with new).
+    char m_padding0[64];
+    std::atomic<size_t> m_writePos;
+    char m_padding1[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> m_readPos;
+    char m_padding2[64 - sizeof(std::atomic<size_t>)];
+};
+
+#endif // RINGBUFFER_MLB_H
@@ -0,0 +1,63 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SAMPLECONVERSION_MLB_H
+#define SAMPLECONVERSION_MLB_H
+
+#include "AudioBackend.h"
+
+// Scalar conversion of a single sample, the float range is [-1, 1] (float samples are not clipped).
+float sampleToFloat(SampleFormat format, const void* sample);
+void floatToSample(SampleFormat format, float value, void* sample);
+
+/*
+Conversion between the interleaved frames of a backend and one float buffer per channel.
+The kernels are specialized at compile time for each format and for 1, 2, 4, 6 and 8 channels,
+the other channels counts use a generic kernel. They use AVX2, SSE2 or NEON when the compiler
+targets it, with a scalar fallback.
+*/
+class SampleConverter
+{
+public:
+    SampleConverter();
+
+    // Select the kernels, return false when the format or the channels count is not supported.
+    bool init(SampleFormat format, int channelsCount);
+
+    // Interleaved frames to planar float.
+    void deinterleave(const void* input, float* const* planes, unsigned long frames) const;
+    // Planar float to interleaved frames, the integer samples are clipped to their range.
+    void interleave(const float* const* planes, void* output, unsigned long frames) const;
+
+    SampleFormat format() const;
+    int channelsCount() const;
+
+    // Instruction set used by the kernels.
+    static const char* instructionSet();
+
+    typedef void (*DeinterleaveKernel)(const void* input, float* const* planes, int channelsCount, unsigned long frames);
+    typedef void (*InterleaveKernel)(const float* const* planes, void* output, int channelsCount, unsigned long frames);
+
+private:
+    SampleFormat m_format;
+    int m_channelsCount;
+    DeinterleaveKernel m_deinterleave;
+    InterleaveKernel m_interleave;
+};
+
+#endif // SAMPLECONVERSION_MLB_H
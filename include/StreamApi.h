@@ -0,0 +1,42 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef STREAMAPI_MLB_H
+#define STREAMAPI_MLB_H
+
+#include <string>
+
+// Audio API used to capture the microphone and play it on the speakers.
+enum class StreamApi
+{
+    PortAudio,
+    PulseSimple,
+    Pulse,
+    Alsa,
+    Jack,
+    PipeWire,
+    File
+};
+
+// Convert an API name (as used in the command line and the ini file) into an API.
+bool streamApiFromString(const std::string& name, StreamApi* api);
+const char* streamApiName(StreamApi api);
+// List of the APIs compiled in, used in the help and error messages.
+std::string availableStreamApis();
+
+#endif // STREAMAPI_MLB_H
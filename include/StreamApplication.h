@@ -19,10 +19,17 @@
 #ifndef STREAMAPPLICATION_MLB_H
 #define STREAMAPPLICATION_MLB_H
 
+#include "CMDParser.h"
 #include "LoopbackStream.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
 
 #ifdef WIN32
 #include "windows.h"
+#elif __linux__
+#include "MetricsServer.h"
 #endif
 
 class StreamApplication
@@ -45,8 +52,44 @@ public:
     void stopApplication();
 
 private:
+    // Stream of a route of the multi-route mode, failing and restarting on its own.
+    struct Route
+    {
+        RouteSettings settings;
+        LoopbackStream* stream;
+        bool isPlaying;
+        // Time of the next start of a failed route.
+        std::chrono::steady_clock::time_point restartTime;
+        unsigned long lastXruns;
+        unsigned long lastCatchUps;
+    };
+
     void deinit();
 
+    // Set the settings of the user on the stream.
+    void configureStream(LoopbackStream* stream);
+    void startTracer();
+    // Print the xruns and the catch-ups as soon as they happen and follow the adaptive buffer.
+    void reportStreamEvents(LoopbackStream* stream, const std::string& prefix, unsigned long& lastXruns, unsigned long& lastCatchUps);
+
+    // Play the routes together until the application stops, a failed route restarts after a delay.
+    int runRoutes();
+    // Open and play the stream of the route, return false and schedule its restart if it fails.
+    bool startRoute(Route& route);
+
+    // Play a descending series of frames per buffer and sample rates,
+    // and write the smallest one playing without glitch into the user configuration.
+    int calibrate();
+    // Play a setting for the calibration time, return false if it cannot be played.
+    bool calibrationStep(int sampleRate, int framesPerBuffer, unsigned long& glitches);
+    // Xruns, overflows, underflows and deadline misses of the stream.
+    unsigned long glitchesCount() const;
+
+    // Run the processing chain on generated noise and print the cost of each stage.
+    int benchmark();
+    // Print the capture and the playback devices of the API and their capabilities.
+    int listDevices();
+
 #ifdef WIN32
     void createWindowsSignalsCatch();
     static BOOL WINAPI windowsSignalsHandler(DWORD signal);
@@ -56,16 +99,57 @@ private:
     static void sigActionHandler(int signal);
 #endif
 
+    // Print the glitches, the latency and the cpu load of the stream,
+    // the state of the ring buffer of the Pulse Simple API and the xruns of the ALSA and JACK APIs.
+    void printStats(const LoopbackStream* stream) const;
+
     LoopbackStream* m_stream;
-    bool m_isAppContinue;
+    std::atomic<bool> m_isAppContinue;
+    // Set by SIGUSR1 to print the statistics from the main loop.
+    std::atomic<bool> m_isStatsRequested;
     bool m_isAppReady;
     int m_sampleRate;
+    int m_outputSampleRate;
+    ResamplerQuality m_resamplerQuality;
+    bool m_isDriftCompensation;
+    // Maximum latency in milliseconds, 0 when disabled.
+    double m_maxLatency;
     int m_framesPerBuffer;
+    int m_channelsCount;
+    bool m_isSampleFormatSet;
+    SampleFormat m_sampleFormat;
+    StreamApi m_api;
+    int m_measureLatencyBursts;
+    bool m_isCalibrate;
+    bool m_isBenchmark;
+    bool m_isListDevices;
+    int m_calibrateTime;
+    int m_statsInterval;
+    mutable TimingHistogram::Snapshot m_timingSnapshot;
+    std::string m_traceFile;
+    std::string m_inputFile;
+    std::string m_outputFile;
+    bool m_isFileRealtime;
+    double m_simulatedDrift;
+    ProcessingSettings m_processing;
+    // Workers of the processing chains, shared by the routes.
+    int m_processingThreads;
+    ProcessingExecutor m_processingExecutor;
+    std::string m_inputDevice;
+    std::string m_outputDevice;
+    std::vector<Route> m_routes;
+    // Capture sources mixed into the playback of the stream, not of the routes.
+    std::vector<MixSourceSettings> m_mixSources;
+    double m_mixBufferTime;
 #ifdef WIN32
     double m_inputLatency;
     double m_outputLatency;
 #elif __linux__
-    bool m_usePortAudio;
+    int m_ringBufferPeriods;
+    int m_adaptiveBufferMin;
+    int m_adaptiveBufferMax;
+    std::string m_metricsSocket;
+    MetricsServer m_metricsServer;
 #endif
 };
 
@@ -0,0 +1,79 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef TIMINGHISTOGRAM_MLB_H
+#define TIMINGHISTOGRAM_MLB_H
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+/*
+Histogram of the time spent handling each period.
+The buckets are log-linear (16 buckets per power of two, about 6% of precision)
+and allocated with the object, recording a duration never allocate nor lock.
+Only one thread (the audio thread) may record, any thread may take a snapshot.
+*/
+class TimingHistogram
+{
+    // Disabling the copy constructor
+    TimingHistogram(const TimingHistogram&) = delete;
+public:
+    // Durations are stored in nanoseconds, up to about one minute.
+    static const int SUB_BUCKETS_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKETS_BITS;
+    static const int MAX_BITS = 40;
+    static const int BUCKETS_COUNT = (MAX_BITS - SUB_BUCKETS_BITS + 2) * SUB_BUCKETS;
+
+    // Copy of the histogram taken by a non real time thread.
+    struct Snapshot
+    {
+        Snapshot();
+
+        uint64_t buckets[BUCKETS_COUNT];
+        uint64_t count;
+        uint64_t deadlineMisses;
+        uint64_t max;
+
+        // Duration in nanoseconds below which a fraction (0 to 1) of the periods are.
+        uint64_t percentile(double fraction) const;
+        void print(std::ostream& stream) const;
+    };
+
+    TimingHistogram();
+    ~TimingHistogram();
+
+    // Audio thread: add the duration of a period and check it against its deadline.
+    void record(uint64_t duration, uint64_t deadline);
+
+    // Any thread.
+    void snapshot(Snapshot& snapshot) const;
+    // Not thread safe, must be called when the audio thread is stopped.
+    void reset();
+
+    static int bucketIndex(uint64_t value);
+    // Highest value stored in a bucket.
+    static uint64_t bucketValue(int index);
+
+private:
+    std::atomic<uint32_t> m_buckets[BUCKETS_COUNT];
+    std::atomic<uint64_t> m_deadlineMisses;
+    std::atomic<uint64_t> m_max;
+};
+
+#endif // TIMINGHISTOGRAM_MLB_H
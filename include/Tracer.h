@@ -0,0 +1,141 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef TRACER_MLB_H
+#define TRACER_MLB_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+
+/*
+Opt-in event tracing into the Chrome trace format (chrome://tracing, Perfetto).
+Each thread writing events get its own preallocated ring buffer, given back when the
+thread exit, writing an event never allocate nor lock. A background thread flush the rings to the JSON file.
+When the tracer is not started, the trace functions only check a pointer.
+The event names must be string literals, only their pointer is stored.
+*/
+class Tracer
+{
+    // Disabling the copy constructor
+    Tracer(const Tracer&) = delete;
+public:
+    // Start tracing into the file at path (not thread safe).
+    static bool start(const std::string& path);
+    // Flush the remaining events and close the file.
+    // The audio threads must be stopped before.
+    static void stop();
+    static bool isEnabled();
+
+    // Name of the calling thread in the trace, kept for the traces started later.
+    static void nameThread(const char* name);
+
+    // Events of the calling thread.
+    static void begin(const char* name);
+    static void end(const char* name);
+    static void counter(const char* name, double value);
+    static void instant(const char* name);
+
+private:
+    // Number of threads tracing at the same time and of events per thread.
+    static const int MAX_THREADS = 16;
+    static const size_t BUFFER_EVENTS = 1 << 14;
+
+    struct Event
+    {
+        uint64_t timestamp;
+        const char* name;
+        char phase;
+        double value;
+    };
+
+    // A buffer is taken by a thread, released when the thread exit and freed by the flush thread once emptied.
+    enum BufferState
+    {
+        FREE_BUFFER,
+        TAKEN_BUFFER,
+        USED_BUFFER,
+        RELEASED_BUFFER
+    };
+
+    // Single producer / single consumer ring of events.
+    struct ThreadBuffer
+    {
+        ThreadBuffer();
+
+        Event* events;
+        std::atomic<const char*> name;
+        std::atomic<int> state;
+        // Thread id in the trace, not reused by the next thread taking the buffer.
+        int tid;
+        bool isNameWritten;
+        std::atomic<size_t> writePos;
+        std::atomic<size_t> readPos;
+        std::atomic<unsigned long> droppedEvents;
+    };
+
+    // Buffer of the calling thread, released by its destructor at the exit of the thread.
+    struct ThreadSlot
+    {
+        ThreadSlot();
+        ~ThreadSlot();
+
+        unsigned int generation;
+        ThreadBuffer* buffer;
+        // Given to each buffer taken by the thread.
+        const char* name;
+    };
+
+    explicit Tracer(unsigned int generation);
+    ~Tracer();
+
+    // The tracer while the calling thread write into it, nullptr when it is not started.
+    // stop() wait for the threads to release it before deleting it.
+    static Tracer* acquireInstance();
+    static void releaseInstance();
+    static ThreadSlot& threadSlot();
+    static ThreadBuffer* threadBuffer(Tracer* tracer);
+    static void record(char phase, const char* name, double value);
+
+    void flushLoop();
+    void flush();
+    void writeEvent(int tid, const Event& event);
+
+    static std::atomic<Tracer*> s_instance;
+    // Incremented on each start, so the threads know their cached buffer is outdated.
+    static std::atomic<unsigned int> s_generation;
+    // Threads between acquireInstance() and releaseInstance().
+    static std::atomic<int> s_writers;
+
+    unsigned int m_generation;
+    std::ofstream m_file;
+    bool m_isFirstEvent;
+    std::chrono::steady_clock::time_point m_start;
+    ThreadBuffer m_buffers[MAX_THREADS];
+    std::atomic<int> m_nextTid;
+    // Threads not traced because all the buffers were taken.
+    std::atomic<unsigned long> m_missedThreads;
+
+    std::thread m_tFlush;
+    std::atomic<bool> m_isFlushing;
+};
+
+#endif // TRACER_MLB_H
@@ -0,0 +1,87 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef WAVFILE_MLB_H
+#define WAVFILE_MLB_H
+
+#include "AudioBackend.h"
+#include <cstdio>
+#include <string>
+
+// Read the frames of a PCM 16, 24 or 32 bits or float 32 bits WAV file.
+class WavReader
+{
+    // Disabling the copy constructor
+    WavReader(const WavReader&) = delete;
+public:
+    WavReader();
+    ~WavReader();
+
+    bool open(const std::string& path);
+    void close();
+
+    // Read up to frames frames, return the number of frames read.
+    size_t read(void* data, size_t frames);
+
+    int channelsCount() const;
+    int sampleRate() const;
+    SampleFormat sampleFormat() const;
+    size_t framesCount() const;
+    const std::string& error() const;
+
+private:
+    std::string m_strError;
+    FILE* m_file;
+    int m_channelsCount;
+    int m_sampleRate;
+    SampleFormat m_sampleFormat;
+    size_t m_frameSize;
+    size_t m_framesCount;
+    size_t m_framesRead;
+};
+
+// Write frames into a PCM or float WAV file, in the extensible format for more than 16 bits integers or two channels.
+class WavWriter
+{
+    // Disabling the copy constructor
+    WavWriter(const WavWriter&) = delete;
+public:
+    WavWriter();
+    ~WavWriter();
+
+    bool open(const std::string& path, int channelsCount, int sampleRate, SampleFormat format);
+    // Update the header sizes and close the file.
+    void close();
+
+    bool write(const void* data, size_t frames);
+
+    const std::string& error() const;
+
+private:
+    bool writeHeader();
+
+    std::string m_strError;
+    FILE* m_file;
+    int m_channelsCount;
+    int m_sampleRate;
+    SampleFormat m_sampleFormat;
+    size_t m_frameSize;
+    size_t m_framesWritten;
+};
+
+#endif // WAVFILE_MLB_H
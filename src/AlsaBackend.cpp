@@ -0,0 +1,597 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "AlsaBackend.h"
+#include "Resampler.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+// Number of periods of the playback buffer and number of periods of silence written before starting.
+#define ALSA_PLAYBACK_PERIODS 3
+#define ALSA_PLAYBACK_PREFILL 2
+// Number of periods of the capture buffer.
+#define ALSA_CAPTURE_PERIODS 4
+// Device opened when none is selected.
+#define ALSA_DEFAULT_DEVICE "plughw:0,0"
+
+static snd_pcm_format_t alsaSampleFormat(SampleFormat format)
+{
+    switch (format)
+    {
+    case SampleFormat::Int24:
+        return SND_PCM_FORMAT_S24_3LE;
+    case SampleFormat::Int32:
+        return SND_PCM_FORMAT_S32_LE;
+    case SampleFormat::Float32:
+        return SND_PCM_FORMAT_FLOAT_LE;
+    default:
+        return SND_PCM_FORMAT_S16_LE;
+    }
+}
+
+// Fill the capabilities of a device, a device busy or unplugged is left without them.
+static void probeAlsaDevice(DeviceInfo* device)
+{
+    snd_pcm_t* pcm = nullptr;
+    if (snd_pcm_open(&pcm, device->id.c_str(), device->isInput ? SND_PCM_STREAM_CAPTURE : SND_PCM_STREAM_PLAYBACK, SND_PCM_NONBLOCK) < 0)
+        return;
+
+    snd_pcm_hw_params_t* hwParams = nullptr;
+    snd_pcm_hw_params_malloc(&hwParams);
+    if (snd_pcm_hw_params_any(pcm, hwParams) >= 0)
+    {
+        unsigned int channels = 0;
+        if (snd_pcm_hw_params_get_channels_max(hwParams, &channels) >= 0)
+            device->channelsCount = static_cast<int>(channels);
+        for (int rate : standardSampleRates())
+        {
+            if (snd_pcm_hw_params_test_rate(pcm, hwParams, rate, 0) == 0)
+                device->sampleRates.push_back(rate);
+        }
+        unsigned int bufferTime = 0;
+        int dir = 0;
+        if (snd_pcm_hw_params_get_buffer_time_min(hwParams, &bufferTime, &dir) >= 0)
+            device->lowLatency = bufferTime / 1000000.0;
+    }
+    snd_pcm_hw_params_free(hwParams);
+    snd_pcm_close(pcm);
+}
+
+AlsaBackend::AlsaBackend() :
+    m_capture(nullptr),
+    m_playback(nullptr),
+    m_isLinked(false),
+    m_sampleRate(48000),
+    m_channelsCount(1),
+    m_format(SND_PCM_FORMAT_S16_LE),
+    m_periodSize(256),
+    m_outputPeriodSize(256),
+    m_frameSize(2),
+    m_isPlayingContinue(false),
+    m_xruns(0)
+{}
+
+AlsaBackend::~AlsaBackend()
+{
+    deinit();
+}
+
+bool AlsaBackend::init(const StreamConfig& config)
+{
+    deinit();
+    m_config = config;
+
+    const std::string captureDevice = m_config.inputDevice.empty() ? ALSA_DEFAULT_DEVICE : m_config.inputDevice;
+    const std::string playbackDevice = m_config.outputDevice.empty() ? ALSA_DEFAULT_DEVICE : m_config.outputDevice;
+    m_sampleRate = m_config.sampleRate;
+    m_channelsCount = m_config.channelsCount;
+    m_format = alsaSampleFormat(m_config.sampleFormat);
+    m_periodSize = m_config.framesPerBuffer;
+    m_frameSize = m_channelsCount * sampleFormatSize(m_config.sampleFormat);
+    m_xruns = 0;
+
+    // With another output rate, the playback period last about as long as the capture one.
+    if (!initResampler(m_config.sampleFormat, m_periodSize))
+        return false;
+    m_outputPeriodSize = resampledFrames(m_periodSize);
+    if (m_resampler)
+    {
+        m_processedData.assign(m_periodSize * m_frameSize, 0);
+        m_resampledData.assign(m_resampler->maxOutputFrames() * m_frameSize, 0);
+    }
+
+    // Opening the input device. (the microphone.)
+    int err = snd_pcm_open(&m_capture, captureDevice.c_str(), SND_PCM_STREAM_CAPTURE, 0);
+    if (err < 0)
+    {
+        m_capture = nullptr;
+        m_strError = "Failed to open the ALSA capture device " + captureDevice + ": " + snd_strerror(err);
+        return false;
+    }
+
+    // Opening the output device. (the speakers.)
+    err = snd_pcm_open(&m_playback, playbackDevice.c_str(), SND_PCM_STREAM_PLAYBACK, 0);
+    if (err < 0)
+    {
+        m_playback = nullptr;
+        m_strError = "Failed to open the ALSA playback device " + playbackDevice + ": " + snd_strerror(err);
+        deinit();
+        return false;
+    }
+
+    // The playback is started by the link with the capture, it must not start by itself.
+    if (!setParams(m_capture, m_sampleRate, &m_periodSize, ALSA_CAPTURE_PERIODS, 1) ||
+        !setParams(m_playback, outputSampleRate(), &m_outputPeriodSize, ALSA_PLAYBACK_PERIODS, m_outputPeriodSize * ALSA_PLAYBACK_PERIODS))
+    {
+        deinit();
+        return false;
+    }
+
+    // Linking the PCMs, if the devices cannot be linked (not the same card), they are started one after the other.
+    m_isLinked = snd_pcm_link(m_capture, m_playback) == 0;
+
+    return true;
+}
+
+bool AlsaBackend::setParams(snd_pcm_t* pcm, unsigned int rate, snd_pcm_uframes_t* periodSize, snd_pcm_uframes_t periodsCount, snd_pcm_uframes_t startThreshold)
+{
+    snd_pcm_hw_params_t* hwParams = nullptr;
+    snd_pcm_hw_params_malloc(&hwParams);
+
+    int err = snd_pcm_hw_params_any(pcm, hwParams);
+    if (err >= 0)
+        err = snd_pcm_hw_params_set_access(pcm, hwParams, SND_PCM_ACCESS_MMAP_INTERLEAVED);
+    if (err >= 0)
+        err = snd_pcm_hw_params_set_format(pcm, hwParams, m_format);
+    if (err >= 0)
+        err = snd_pcm_hw_params_set_channels(pcm, hwParams, m_channelsCount);
+    if (err >= 0)
+        err = snd_pcm_hw_params_set_rate(pcm, hwParams, rate, 0);
+
+    snd_pcm_uframes_t requestedSize = *periodSize;
+    snd_pcm_uframes_t bufferSize = requestedSize * periodsCount;
+    int dir = 0;
+    if (err >= 0)
+        err = snd_pcm_hw_params_set_period_size_near(pcm, hwParams, periodSize, &dir);
+    if (err >= 0)
+        err = snd_pcm_hw_params_set_buffer_size_near(pcm, hwParams, &bufferSize);
+    if (err >= 0)
+        err = snd_pcm_hw_params(pcm, hwParams);
+    snd_pcm_hw_params_free(hwParams);
+
+    if (err < 0)
+    {
+        m_strError = std::string("Failed to configure the ALSA device: ") + snd_strerror(err);
+        return false;
+    }
+    // The resampled playback accept the nearest period, the capture period must be exact.
+    if (*periodSize != requestedSize && (pcm == m_capture || !m_resampler))
+    {
+        m_strError = "The ALSA device does not support the requested frames per buffer.";
+        return false;
+    }
+
+    // Wake up on each period.
+    snd_pcm_sw_params_t* swParams = nullptr;
+    snd_pcm_sw_params_malloc(&swParams);
+    err = snd_pcm_sw_params_current(pcm, swParams);
+    if (err >= 0)
+        err = snd_pcm_sw_params_set_avail_min(pcm, swParams, *periodSize);
+    if (err >= 0)
+        err = snd_pcm_sw_params_set_start_threshold(pcm, swParams, startThreshold);
+    if (err >= 0)
+        err = snd_pcm_sw_params(pcm, swParams);
+    snd_pcm_sw_params_free(swParams);
+
+    if (err < 0)
+    {
+        m_strError = std::string("Failed to configure the ALSA device: ") + snd_strerror(err);
+        return false;
+    }
+    return true;
+}
+
+void AlsaBackend::deinit()
+{
+    stop();
+
+    if (m_capture && m_isLinked)
+        snd_pcm_unlink(m_capture);
+    m_isLinked = false;
+
+    if (m_capture)
+    {
+        snd_pcm_close(m_capture);
+        m_capture = nullptr;
+    }
+    if (m_playback)
+    {
+        snd_pcm_close(m_playback);
+        m_playback = nullptr;
+    }
+    m_processedData.clear();
+    m_resampledData.clear();
+    deinitResampler();
+}
+
+bool AlsaBackend::play()
+{
+    if (!m_capture || !m_playback)
+    {
+        m_strError = "The stream is not ready.";
+        return false;
+    }
+
+    if (!start())
+        return false;
+
+    m_isPlayingContinue = true;
+    m_tStream = std::thread(&AlsaBackend::streamLoop, this);
+    return true;
+}
+
+void AlsaBackend::stop()
+{
+    m_isPlayingContinue = false;
+    if (m_tStream.joinable())
+        m_tStream.join();
+
+    if (m_capture)
+        snd_pcm_drop(m_capture);
+    if (m_playback)
+        snd_pcm_drop(m_playback);
+}
+
+bool AlsaBackend::start()
+{
+    int err = snd_pcm_prepare(m_capture);
+    if (err >= 0)
+        err = snd_pcm_prepare(m_playback);
+    if (err >= 0)
+        err = writeSilence(m_outputPeriodSize * ALSA_PLAYBACK_PREFILL);
+    if (err >= 0)
+        m_counters.primingOutputs.fetch_add(ALSA_PLAYBACK_PREFILL, std::memory_order_relaxed);
+
+    // Starting the capture also start the playback when the PCMs are linked.
+    if (err >= 0)
+        err = snd_pcm_start(m_capture);
+    if (err >= 0 && !m_isLinked)
+        err = snd_pcm_start(m_playback);
+
+    if (err < 0)
+    {
+        m_strError = std::string("Failed to start the ALSA devices: ") + snd_strerror(err);
+        return false;
+    }
+    return true;
+}
+
+bool AlsaBackend::recover()
+{
+    m_xruns.fetch_add(1, std::memory_order_relaxed);
+    Tracer::instant("xrun");
+    if (snd_pcm_state(m_capture) == SND_PCM_STATE_XRUN)
+        m_counters.inputOverflows.fetch_add(1, std::memory_order_relaxed);
+    if (snd_pcm_state(m_playback) == SND_PCM_STATE_XRUN)
+        m_counters.outputUnderflows.fetch_add(1, std::memory_order_relaxed);
+
+    snd_pcm_drop(m_capture);
+    snd_pcm_drop(m_playback);
+    // The playback is filled again, the drift compensation hold the new level.
+    m_driftController.settle();
+    return start();
+}
+
+void AlsaBackend::streamLoop()
+{
+    Tracer::nameThread("alsa");
+
+    while (m_isPlayingContinue)
+    {
+        snd_pcm_sframes_t available = snd_pcm_avail_update(m_capture);
+        if (available < 0)
+        {
+            if (!recover())
+            {
+                m_isPlayingContinue = false;
+                break;
+            }
+            continue;
+        }
+
+        // Waiting for a full period from the microphone.
+        if (static_cast<snd_pcm_uframes_t>(available) < m_periodSize)
+        {
+            Tracer::begin("snd_pcm_wait");
+            int err = snd_pcm_wait(m_capture, 1000);
+            Tracer::end("snd_pcm_wait");
+            if (err < 0 && !recover())
+            {
+                m_isPlayingContinue = false;
+                break;
+            }
+            continue;
+        }
+
+        PeriodTime begin = periodBegin();
+        int err = copyPeriod();
+        periodEnd(begin, m_periodSize);
+        if (err < 0 && !recover())
+        {
+            m_isPlayingContinue = false;
+            break;
+        }
+        if (err >= 0)
+            updateLatency();
+    }
+}
+
+void AlsaBackend::updateLatency()
+{
+    // Frames waiting in the capture buffer and frames queued before the DAC.
+    snd_pcm_sframes_t delay = 0;
+    if (snd_pcm_delay(m_capture, &delay) == 0)
+        m_counters.inputLatency.store(static_cast<long>(delay * 1000000LL / m_config.sampleRate), std::memory_order_relaxed);
+    if (snd_pcm_delay(m_playback, &delay) == 0)
+        m_counters.outputLatency.store(static_cast<long>(delay * 1000000LL / outputSampleRate()), std::memory_order_relaxed);
+}
+
+int AlsaBackend::copyPeriod()
+{
+    if (m_resampler)
+        return copyResampledPeriod();
+
+    snd_pcm_sframes_t playbackAvailable = snd_pcm_avail_update(m_playback);
+    if (playbackAvailable < 0)
+        return static_cast<int>(playbackAvailable);
+
+    snd_pcm_uframes_t remaining = m_periodSize;
+    bool isDropped = false;
+    while (remaining > 0)
+    {
+        const snd_pcm_channel_area_t* captureAreas = nullptr;
+        snd_pcm_uframes_t captureOffset = 0;
+        snd_pcm_uframes_t captureFrames = remaining;
+        int err = snd_pcm_mmap_begin(m_capture, &captureAreas, &captureOffset, &captureFrames);
+        if (err < 0)
+            return err;
+
+        const snd_pcm_channel_area_t* playbackAreas = nullptr;
+        snd_pcm_uframes_t playbackOffset = 0;
+        snd_pcm_uframes_t playbackFrames = captureFrames;
+        if (playbackAvailable > 0)
+        {
+            err = snd_pcm_mmap_begin(m_playback, &playbackAreas, &playbackOffset, &playbackFrames);
+            if (err < 0)
+                return err;
+        }
+        else
+        {
+            // The playback buffer is full, the captured frames are dropped.
+            playbackFrames = 0;
+            isDropped = true;
+        }
+
+        snd_pcm_uframes_t frames = captureFrames;
+        if (playbackFrames > 0)
+        {
+            if (playbackFrames < frames)
+                frames = playbackFrames;
+
+            // Interleaved areas: all the channels share the same address of the first channel.
+            const char* src = static_cast<const char*>(captureAreas[0].addr) + 
+                (captureAreas[0].first + captureOffset * captureAreas[0].step) / 8;
+            char* dst = static_cast<char*>(playbackAreas[0].addr) + 
+                (playbackAreas[0].first + playbackOffset * playbackAreas[0].step) / 8;
+            process(src, dst, frames);
+
+            snd_pcm_sframes_t committed = snd_pcm_mmap_commit(m_playback, playbackOffset, frames);
+            if (committed < 0)
+                return static_cast<int>(committed);
+            playbackAvailable -= frames;
+        }
+
+        snd_pcm_sframes_t committed = snd_pcm_mmap_commit(m_capture, captureOffset, frames);
+        if (committed < 0)
+            return static_cast<int>(committed);
+        remaining -= frames;
+    }
+
+    // Counted once per period, like a capture overrun.
+    if (isDropped)
+    {
+        m_counters.inputOverflows.fetch_add(1, std::memory_order_relaxed);
+        Tracer::instant("playback full");
+    }
+    return 0;
+}
+
+int AlsaBackend::copyResampledPeriod()
+{
+    snd_pcm_uframes_t remaining = m_periodSize;
+    while (remaining > 0)
+    {
+        const snd_pcm_channel_area_t* captureAreas = nullptr;
+        snd_pcm_uframes_t captureOffset = 0;
+        snd_pcm_uframes_t captureFrames = remaining;
+        int err = snd_pcm_mmap_begin(m_capture, &captureAreas, &captureOffset, &captureFrames);
+        if (err < 0)
+            return err;
+
+        const char* src = static_cast<const char*>(captureAreas[0].addr) + 
+            (captureAreas[0].first + captureOffset * captureAreas[0].step) / 8;
+        process(src, m_processedData.data(), captureFrames);
+
+        snd_pcm_sframes_t committed = snd_pcm_mmap_commit(m_capture, captureOffset, captureFrames);
+        if (committed < 0)
+            return static_cast<int>(committed);
+        remaining -= captureFrames;
+
+        unsigned long frames = resample(m_processedData.data(), captureFrames, m_resampledData.data());
+        err = writePlayback(m_resampledData.data(), frames);
+        if (err < 0)
+            return err;
+    }
+
+    // Without link, the two devices drift and the frames queued for the playback follow it.
+    snd_pcm_sframes_t delay = 0;
+    if (snd_pcm_delay(m_playback, &delay) == 0)
+        compensateDrift(static_cast<double>(delay) / outputSampleRate());
+    return 0;
+}
+
+int AlsaBackend::writePlayback(const char* data, snd_pcm_uframes_t frames)
+{
+    snd_pcm_sframes_t available = snd_pcm_avail_update(m_playback);
+    if (available < 0)
+        return static_cast<int>(available);
+    // The playback buffer is full, the last frames are dropped.
+    if (frames > static_cast<snd_pcm_uframes_t>(available))
+    {
+        frames = static_cast<snd_pcm_uframes_t>(available);
+        m_counters.inputOverflows.fetch_add(1, std::memory_order_relaxed);
+        Tracer::instant("playback full");
+    }
+
+    while (frames > 0)
+    {
+        const snd_pcm_channel_area_t* areas = nullptr;
+        snd_pcm_uframes_t offset = 0;
+        snd_pcm_uframes_t count = frames;
+        int err = snd_pcm_mmap_begin(m_playback, &areas, &offset, &count);
+        if (err < 0)
+            return err;
+        if (count == 0)
+            break;
+
+        char* dst = static_cast<char*>(areas[0].addr) + (areas[0].first + offset * areas[0].step) / 8;
+        memcpy(dst, data, count * m_frameSize);
+        snd_pcm_sframes_t committed = snd_pcm_mmap_commit(m_playback, offset, count);
+        if (committed < 0)
+            return static_cast<int>(committed);
+        data += count * m_frameSize;
+        frames -= count;
+    }
+    return 0;
+}
+
+int AlsaBackend::writeSilence(snd_pcm_uframes_t frames)
+{
+    while (frames > 0)
+    {
+        const snd_pcm_channel_area_t* areas = nullptr;
+        snd_pcm_uframes_t offset = 0;
+        snd_pcm_uframes_t count = frames;
+        int err = snd_pcm_mmap_begin(m_playback, &areas, &offset, &count);
+        if (err < 0)
+            return err;
+        if (count == 0)
+            return -EPIPE;
+
+        snd_pcm_areas_silence(areas, offset, m_channelsCount, count, m_format);
+        snd_pcm_sframes_t committed = snd_pcm_mmap_commit(m_playback, offset, count);
+        if (committed < 0)
+            return static_cast<int>(committed);
+        frames -= count;
+    }
+    return 0;
+}
+
+bool AlsaBackend::isPlayingContinue() const
+{
+    return m_isPlayingContinue;
+}
+
+bool AlsaBackend::isResamplingSupported() const
+{
+    return true;
+}
+
+bool AlsaBackend::isDeviceSelectionSupported() const
+{
+    return true;
+}
+
+bool AlsaBackend::probeDevices(std::vector<DeviceInfo>* devices)
+{
+    void** hints = nullptr;
+    int err = snd_device_name_hint(-1, "pcm", &hints);
+    if (err < 0)
+    {
+        m_strError = std::string("Failed to list the ALSA devices: ") + snd_strerror(err);
+        return false;
+    }
+
+    devices->clear();
+    for (void** hint = hints; *hint; hint++)
+    {
+        char* name = snd_device_name_get_hint(*hint, "NAME");
+        char* description = snd_device_name_get_hint(*hint, "DESC");
+        // Null for the devices doing both the capture and the playback.
+        char* ioid = snd_device_name_get_hint(*hint, "IOID");
+        if (name && strcmp(name, "null") != 0)
+        {
+            for (int direction = 0; direction < 2; direction++)
+            {
+                bool isInput = direction == 0;
+                if (ioid && strcmp(ioid, isInput ? "Input" : "Output") != 0)
+                    continue;
+
+                DeviceInfo device;
+                device.id = name;
+                device.description = description ? description : name;
+                std::replace(device.description.begin(), device.description.end(), '\n', ' ');
+                device.isInput = isInput;
+                probeAlsaDevice(&device);
+                devices->push_back(device);
+            }
+        }
+        free(name);
+        free(description);
+        free(ioid);
+    }
+    snd_device_name_free_hint(hints);
+    return true;
+}
+
+std::string AlsaBackend::devicesHardware() const
+{
+    // The cards and their PCMs as known by the kernel, and the PCMs defined by the configuration of ALSA.
+    std::vector<std::string> paths = { "/proc/asound/cards", "/proc/asound/pcm", "/etc/asound.conf" };
+    const char* homeDir = getenv("HOME");
+    if (homeDir)
+        paths.push_back(std::string(homeDir) + "/.asoundrc");
+
+    std::ostringstream hardware;
+    for (const std::string& path : paths)
+    {
+        std::ifstream file(path);
+        if (file)
+            hardware << file.rdbuf();
+    }
+    return hardware.str();
+}
+
+unsigned long AlsaBackend::xrunsCount() const
+{
+    return m_xruns.load(std::memory_order_relaxed);
+}
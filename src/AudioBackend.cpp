@@ -0,0 +1,369 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "AudioBackend.h"
+#include "LatencyCeiling.h"
+#include "Resampler.h"
+#include "Tracer.h"
+
+size_t sampleFormatSize(SampleFormat format)
+{
+    switch (format)
+    {
+    case SampleFormat::Int16:
+        return 2;
+    case SampleFormat::Int24:
+        return 3;
+    case SampleFormat::Int32:
+    case SampleFormat::Float32:
+        return 4;
+    }
+    return 0;
+}
+
+bool sampleFormatFromString(const std::string& name, SampleFormat* format)
+{
+    if (!format)
+        return false;
+
+    if (name == "s16")
+        *format = SampleFormat::Int16;
+    else if (name == "s24")
+        *format = SampleFormat::Int24;
+    else if (name == "s32")
+        *format = SampleFormat::Int32;
+    else if (name == "f32")
+        *format = SampleFormat::Float32;
+    else
+        return false;
+    return true;
+}
+
+const char* sampleFormatName(SampleFormat format)
+{
+    switch (format)
+    {
+    case SampleFormat::Int16:
+        return "s16";
+    case SampleFormat::Int24:
+        return "s24";
+    case SampleFormat::Int32:
+        return "s32";
+    case SampleFormat::Float32:
+        return "f32";
+    }
+    return "unknown";
+}
+
+bool resamplerQualityFromString(const std::string& name, ResamplerQuality* quality)
+{
+    if (!quality)
+        return false;
+
+    if (name == "low")
+        *quality = ResamplerQuality::Low;
+    else if (name == "medium")
+        *quality = ResamplerQuality::Medium;
+    else if (name == "high")
+        *quality = ResamplerQuality::High;
+    else
+        return false;
+    return true;
+}
+
+const char* resamplerQualityName(ResamplerQuality quality)
+{
+    switch (quality)
+    {
+    case ResamplerQuality::Low:
+        return "low";
+    case ResamplerQuality::Medium:
+        return "medium";
+    case ResamplerQuality::High:
+        return "high";
+    }
+    return "unknown";
+}
+
+StreamConfig::StreamConfig() :
+    sampleRate(48000),
+    outputSampleRate(0),
+    resamplerQuality(ResamplerQuality::Medium),
+    isDriftCompensation(false),
+    maxLatency(0.0),
+    channelsCount(1),
+    sampleFormat(SampleFormat::Int16),
+    framesPerBuffer(256),
+    inputLatency(0.02),
+    outputLatency(0.02),
+    ringBufferPeriods(4),
+    isFileRealtime(false),
+    simulatedDrift(0.0)
+{}
+
+StreamCounters::StreamCounters() :
+    framesProcessed(0),
+    inputOverflows(0),
+    outputUnderflows(0),
+    primingOutputs(0),
+    inputLatency(-1),
+    outputLatency(-1)
+{}
+
+void StreamCounters::reset()
+{
+    framesProcessed = 0;
+    inputOverflows = 0;
+    outputUnderflows = 0;
+    primingOutputs = 0;
+    inputLatency = -1;
+    outputLatency = -1;
+}
+
+AudioBackend::AudioBackend() :
+    m_resampler(nullptr),
+    m_latencyCeiling(nullptr),
+    m_processor(nullptr)
+{}
+
+AudioBackend::~AudioBackend()
+{
+    deinitResampler();
+    deinitLatencyCeiling();
+}
+
+SampleFormat AudioBackend::sampleFormat() const
+{
+    return m_config.sampleFormat;
+}
+
+int AudioBackend::sampleRate() const
+{
+    return m_config.sampleRate;
+}
+
+unsigned long AudioBackend::framesPerBuffer() const
+{
+    return m_config.framesPerBuffer;
+}
+
+int AudioBackend::outputSampleRate() const
+{
+    return m_config.outputSampleRate > 0 ? m_config.outputSampleRate : sampleRate();
+}
+
+bool AudioBackend::isResamplingSupported() const
+{
+    return false;
+}
+
+double AudioBackend::resamplerLatency() const
+{
+    return m_resampler ? m_resampler->latency() : 0.0;
+}
+
+const DriftController* AudioBackend::driftController() const
+{
+    return m_resampler && m_config.isDriftCompensation ? &m_driftController : nullptr;
+}
+
+bool AudioBackend::isLatencyCeilingSupported() const
+{
+    return false;
+}
+
+const LatencyCeiling* AudioBackend::latencyCeiling() const
+{
+    return m_latencyCeiling;
+}
+
+bool AudioBackend::isDeviceSelectionSupported() const
+{
+    return false;
+}
+
+bool AudioBackend::probeDevices(std::vector<DeviceInfo>* devices)
+{
+    m_strError = "The API does not list its devices.";
+    return false;
+}
+
+std::string AudioBackend::devicesHardware() const
+{
+    return std::string();
+}
+
+unsigned long AudioBackend::xrunsCount() const
+{
+    return 0;
+}
+
+size_t AudioBackend::ringBufferPeriods() const
+{
+    return 0;
+}
+
+double AudioBackend::ringBufferFill() const
+{
+    return 0.0;
+}
+
+unsigned long AudioBackend::ringBufferOverruns() const
+{
+    return 0;
+}
+
+unsigned long AudioBackend::ringBufferUnderruns() const
+{
+    return 0;
+}
+
+bool AudioBackend::setBufferPeriods(size_t periods)
+{
+    return false;
+}
+
+const StreamCounters& AudioBackend::counters() const
+{
+    return m_counters;
+}
+
+const TimingHistogram& AudioBackend::timing() const
+{
+    return m_timing;
+}
+
+double AudioBackend::cpuLoad() const
+{
+    return -1.0;
+}
+
+void AudioBackend::printSummary(std::ostream& stream) const
+{}
+
+void AudioBackend::setProcessor(AudioProcessor* processor)
+{
+    m_processor = processor;
+}
+
+const std::string& AudioBackend::error() const
+{
+    return m_strError;
+}
+
+void AudioBackend::process(const void* input, void* output, unsigned long frames)
+{
+    if (m_processor)
+        m_processor->process(input, output, frames);
+
+    // Only the audio thread write the counter, no locked instruction is needed.
+    m_counters.framesProcessed.store(
+        m_counters.framesProcessed.load(std::memory_order_relaxed) + frames, std::memory_order_relaxed);
+}
+
+bool AudioBackend::initResampler(SampleFormat format, unsigned long maxFrames)
+{
+    deinitResampler();
+    if (outputSampleRate() == sampleRate() && !m_config.isDriftCompensation)
+        return true;
+
+    // The drift need a ratio adjustable by a few ppm.
+    m_resampler = new Resampler();
+    if (!m_resampler->init(format, m_config.channelsCount, sampleRate(), outputSampleRate(), m_config.resamplerQuality, 
+        maxFrames, m_config.isDriftCompensation))
+    {
+        m_strError = m_resampler->error();
+        deinitResampler();
+        return false;
+    }
+    m_driftController.reset(static_cast<double>(maxFrames) / sampleRate());
+    return true;
+}
+
+void AudioBackend::deinitResampler()
+{
+    delete m_resampler;
+    m_resampler = nullptr;
+}
+
+unsigned long AudioBackend::resample(const void* input, unsigned long frames, void* output)
+{
+    Tracer::begin("resample");
+    unsigned long count = m_resampler->process(input, frames, output);
+    Tracer::end("resample");
+    return count;
+}
+
+unsigned long AudioBackend::resampledFrames(unsigned long frames) const
+{
+    return static_cast<unsigned long>(static_cast<double>(frames) * outputSampleRate() / sampleRate() + 0.5);
+}
+
+void AudioBackend::compensateDrift(double level)
+{
+    if (!m_resampler || !m_config.isDriftCompensation)
+        return;
+    m_resampler->setRatioCorrection(m_driftController.update(level));
+    Tracer::counter("drift correction", m_driftController.correction() * 1e6);
+}
+
+bool AudioBackend::initLatencyCeiling(SampleFormat format, unsigned long maxFrames)
+{
+    deinitLatencyCeiling();
+    if (m_config.maxLatency <= 0.0)
+        return true;
+
+    m_latencyCeiling = new LatencyCeiling();
+    if (!m_latencyCeiling->init(format, m_config.channelsCount, sampleRate(), m_config.maxLatency, maxFrames))
+    {
+        m_strError = "Unsupported stream format for the maximum latency.";
+        deinitLatencyCeiling();
+        return false;
+    }
+    return true;
+}
+
+void AudioBackend::deinitLatencyCeiling()
+{
+    delete m_latencyCeiling;
+    m_latencyCeiling = nullptr;
+}
+
+unsigned long AudioBackend::limitLatency(void* data, unsigned long frames, double latency)
+{
+    if (!m_latencyCeiling)
+        return frames;
+    return m_latencyCeiling->process(data, frames, latency);
+}
+
+AudioBackend::PeriodTime AudioBackend::periodBegin()
+{
+    Tracer::begin("period");
+    return std::chrono::steady_clock::now();
+}
+
+void AudioBackend::periodEnd(PeriodTime begin, unsigned long frames, double deadline)
+{
+    uint64_t duration = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count());
+
+    if (deadline <= 0.0)
+        deadline = static_cast<double>(frames) / sampleRate();
+    m_timing.record(duration, static_cast<uint64_t>(deadline * 1e9));
+    Tracer::end("period");
+}
@@ -0,0 +1,180 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "Biquad.h"
+#include <cmath>
+
+BiquadBand::BiquadBand() :
+    type(BiquadType::Peaking),
+    frequency(1000.0),
+    q(0.707),
+    gain(0.0)
+{}
+
+bool biquadBandFromString(const std::string& text, BiquadBand* band)
+{
+    if (!band)
+        return false;
+
+    // Splitting the fields separated by colons.
+    std::vector<std::string> fields;
+    size_t begin = 0;
+    while (true)
+    {
+        size_t end = text.find(':', begin);
+        fields.push_back(text.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+        if (end == std::string::npos)
+            break;
+        begin = end + 1;
+    }
+    if (fields.size() < 2 || fields.size() > 4)
+        return false;
+
+    BiquadBand result;
+    const std::string& type = fields[0];
+    if (type == "highpass")
+        result.type = BiquadType::HighPass;
+    else if (type == "lowshelf")
+        result.type = BiquadType::LowShelf;
+    else if (type == "peaking")
+        result.type = BiquadType::Peaking;
+    else if (type == "highshelf")
+        result.type = BiquadType::HighShelf;
+    else if (type == "lowpass")
+        result.type = BiquadType::LowPass;
+    else
+        return false;
+
+    try
+    {
+        result.frequency = std::stod(fields[1]);
+        if (fields.size() > 2)
+            result.q = std::stod(fields[2]);
+        if (fields.size() > 3)
+            result.gain = std::stod(fields[3]);
+    }
+    catch (...)
+    {
+        return false;
+    }
+    if (result.frequency <= 0.0 || result.q <= 0.0)
+        return false;
+
+    *band = result;
+    return true;
+}
+
+bool biquadBandsFromString(const std::string& list, std::vector<BiquadBand>* bands)
+{
+    if (!bands)
+        return false;
+
+    std::vector<BiquadBand> result;
+    size_t begin = 0;
+    while (begin <= list.size())
+    {
+        size_t end = list.find(',', begin);
+        if (end == std::string::npos)
+            end = list.size();
+
+        // Trimming the spaces around the band.
+        size_t first = list.find_first_not_of(" \t", begin);
+        size_t last = list.find_last_not_of(" \t", end - 1);
+        if (first != std::string::npos && first < end && last >= first)
+        {
+            BiquadBand band;
+            if (!biquadBandFromString(list.substr(first, last - first + 1), &band))
+                return false;
+            result.push_back(band);
+        }
+        else if (end < list.size())
+        {
+            // Empty band between two commas.
+            return false;
+        }
+        begin = end + 1;
+    }
+
+    *bands = result;
+    return true;
+}
+
+bool designBiquad(const BiquadBand& band, int sampleRate, BiquadCoefficients* coefficients)
+{
+    if (!coefficients || sampleRate <= 0 || band.frequency >= sampleRate / 2.0)
+        return false;
+
+    const double pi = 3.14159265358979323846;
+    double a = std::pow(10.0, band.gain / 40.0);
+    double w0 = 2.0 * pi * band.frequency / sampleRate;
+    double cosW0 = std::cos(w0);
+    double alpha = std::sin(w0) / (2.0 * band.q);
+    double shelf = 2.0 * std::sqrt(a) * alpha;
+
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0, a0 = 1.0, a1 = 0.0, a2 = 0.0;
+    switch (band.type)
+    {
+    case BiquadType::HighPass:
+        b0 = (1.0 + cosW0) / 2.0;
+        b1 = -(1.0 + cosW0);
+        b2 = (1.0 + cosW0) / 2.0;
+        a0 = 1.0 + alpha;
+        a1 = -2.0 * cosW0;
+        a2 = 1.0 - alpha;
+        break;
+    case BiquadType::LowShelf:
+        b0 = a * ((a + 1.0) - (a - 1.0) * cosW0 + shelf);
+        b1 = 2.0 * a * ((a - 1.0) - (a + 1.0) * cosW0);
+        b2 = a * ((a + 1.0) - (a - 1.0) * cosW0 - shelf);
+        a0 = (a + 1.0) + (a - 1.0) * cosW0 + shelf;
+        a1 = -2.0 * ((a - 1.0) + (a + 1.0) * cosW0);
+        a2 = (a + 1.0) + (a - 1.0) * cosW0 - shelf;
+        break;
+    case BiquadType::Peaking:
+        b0 = 1.0 + alpha * a;
+        b1 = -2.0 * cosW0;
+        b2 = 1.0 - alpha * a;
+        a0 = 1.0 + alpha / a;
+        a1 = -2.0 * cosW0;
+        a2 = 1.0 - alpha / a;
+        break;
+    case BiquadType::HighShelf:
+        b0 = a * ((a + 1.0) + (a - 1.0) * cosW0 + shelf);
+        b1 = -2.0 * a * ((a - 1.0) + (a + 1.0) * cosW0);
+        b2 = a * ((a + 1.0) + (a - 1.0) * cosW0 - shelf);
+        a0 = (a + 1.0) - (a - 1.0) * cosW0 + shelf;
+        a1 = 2.0 * ((a - 1.0) - (a + 1.0) * cosW0);
+        a2 = (a + 1.0) - (a - 1.0) * cosW0 - shelf;
+        break;
+    case BiquadType::LowPass:
+        b0 = (1.0 - cosW0) / 2.0;
+        b1 = 1.0 - cosW0;
+        b2 = (1.0 - cosW0) / 2.0;
+        a0 = 1.0 + alpha;
+        a1 = -2.0 * cosW0;
+        a2 = 1.0 - alpha;
+        break;
+    }
+
+    coefficients->b0 = static_cast<float>(b0 / a0);
+    coefficients->b1 = static_cast<float>(b1 / a0);
+    coefficients->b2 = static_cast<float>(b2 / a0);
+    coefficients->a1 = static_cast<float>(a1 / a0);
+    coefficients->a2 = static_cast<float>(a2 / a0);
+    return true;
+}
@@ -0,0 +1,114 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "BufferController.h"
+
+namespace
+{
+    // Grow when this many underruns happen inside the cluster window.
+    const unsigned long GROW_UNDERRUNS = 2;
+    const std::chrono::seconds CLUSTER_WINDOW(5);
+    // Shrink after this long without underrun and without change.
+    const std::chrono::seconds STABLE_WINDOW(30);
+}
+
+BufferController::BufferController(size_t minPeriods, size_t maxPeriods) :
+    m_minPeriods(minPeriods > 0 ? minPeriods : 1),
+    m_maxPeriods(maxPeriods > m_minPeriods ? maxPeriods : m_minPeriods),
+    m_periods(m_minPeriods),
+    m_lastUnderruns(0),
+    m_windowUnderruns(0)
+{
+    reset(m_minPeriods);
+}
+
+void BufferController::reset(size_t periods)
+{
+    if (periods < m_minPeriods)
+        periods = m_minPeriods;
+    if (periods > m_maxPeriods)
+        periods = m_maxPeriods;
+    m_periods = periods;
+
+    Clock::time_point now = Clock::now();
+    m_lastUnderruns = 0;
+    m_windowUnderruns = 0;
+    m_windowStart = now;
+    m_lastUnderrun = now;
+    m_lastChange = now;
+}
+
+bool BufferController::update(unsigned long underruns)
+{
+    return update(underruns, Clock::now());
+}
+
+bool BufferController::update(unsigned long underruns, Clock::time_point now)
+{
+    unsigned long newUnderruns = underruns >= m_lastUnderruns ? underruns - m_lastUnderruns : 0;
+    m_lastUnderruns = underruns;
+
+    if (now - m_windowStart > CLUSTER_WINDOW)
+    {
+        m_windowStart = now;
+        m_windowUnderruns = 0;
+    }
+
+    if (newUnderruns > 0)
+    {
+        m_lastUnderrun = now;
+        m_windowUnderruns += newUnderruns;
+
+        // A single underrun may be an accident, a cluster mean the machine is too loaded.
+        if (m_windowUnderruns >= GROW_UNDERRUNS && m_periods < m_maxPeriods)
+        {
+            m_periods = m_periods + 1;
+            m_windowUnderruns = 0;
+            m_windowStart = now;
+            m_lastChange = now;
+            return true;
+        }
+        return false;
+    }
+
+    // Slowly give the latency back when the stream is stable.
+    if (m_periods > m_minPeriods &&
+        now - m_lastUnderrun >= STABLE_WINDOW &&
+        now - m_lastChange >= STABLE_WINDOW)
+    {
+        m_periods = m_periods - 1;
+        m_lastChange = now;
+        return true;
+    }
+    return false;
+}
+
+size_t BufferController::periods() const
+{
+    return m_periods;
+}
+
+size_t BufferController::minPeriods() const
+{
+    return m_minPeriods;
+}
+
+size_t BufferController::maxPeriods() const
+{
+    return m_maxPeriods;
+}
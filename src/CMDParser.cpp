@@ -17,25 +17,265 @@
 */
 
 #include "CMDParser.h"
+#include "HowlStage.h"
 #include <ini_parser.h>
+#include <sstream>
 
 #ifdef __linux__
 #include <pwd.h>
 #include <unistd.h>
 #endif
 
+// Conversion of an ini value, false when it is not a number.
+static bool stringToNumber(const std::string& string, double* number)
+{
+    try
+    {
+        *number = std::stod(string);
+    }
+    catch (...)
+    {
+        return false;
+    }
+    return true;
+}
+
+static bool stringToNumber(const std::string& string, int* number)
+{
+    try
+    {
+        *number = std::stoi(string);
+    }
+    catch (...)
+    {
+        return false;
+    }
+    return true;
+}
+
+// Lowest and highest gain in dB of the gain stage, the routes and the mix sources.
+static const double MIN_GAIN = -60.0;
+static const double MAX_GAIN = 40.0;
+
+// Number set in the ini file, the program exit when it is not between min and max (NaN included). False when the key is missing.
+template<typename T>
+static bool parseIniNumber(ini_parser& ini, const std::string& section, const char* key, T min, T max, const std::string& description, T* value)
+{
+    bool isValid = false;
+    if (!ini.isParsed())
+        return false;
+    std::string sNumber = ini.getValue(section, key, &isValid);
+    if (!isValid)
+        return false;
+
+    T number = min;
+    if (!stringToNumber(sNumber, &number) || !(number >= min && number <= max))
+    {
+        std::cout << "Ini error: the " << description << " must be between " << min << " and " << max << "." << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    *value = number;
+    return true;
+}
+
+// Number set on the command line or else in the ini file, the program exit when it is not between min and max.
+template<typename T>
+static void parseNumber(const cxxopts::ParseResult& result, ini_parser& ini, const char* option, const char* section, const char* key, 
+    T min, T max, const char* description, T* value)
+{
+    if (result.count(option))
+    {
+        T number = result[option].as<T>();
+        if (!(number >= min && number <= max))
+        {
+            std::cout << "The " << description << " must be between " << min << " and " << max << "." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        *value = number;
+        return;
+    }
+
+    parseIniNumber(ini, section, key, min, max, description, value);
+}
+
+// Comma separated list of the names of ini sections, the program exit when a name is invalid or listed twice.
+static std::vector<std::string> parseNames(const std::string& list, const char* kind)
+{
+    std::vector<std::string> names;
+    std::istringstream stream(list);
+    std::string name;
+    while (std::getline(stream, name, ','))
+    {
+        size_t begin = name.find_first_not_of(" \t");
+        size_t end = name.find_last_not_of(" \t");
+        name = begin == std::string::npos ? std::string() : name.substr(begin, end - begin + 1);
+        if (name.empty() || name.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_") != std::string::npos)
+        {
+            std::cout << "Invalid " << kind << " name \"" << name << "\", the names are made of letters, digits, - and _." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        for (const std::string& other : names)
+        {
+            if (other == name)
+            {
+                std::cout << "The " << kind << " " << name << " is listed twice." << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+        }
+        names.push_back(name);
+    }
+    return names;
+}
+
+// Settings of the [route.NAME] section of a route, the program exit when one is invalid.
+static void parseRoute(ini_parser& ini, RouteSettings* route)
+{
+    const std::string section = "route." + route->name;
+    bool isValid = false;
+    bool isSectionFound = false;
+
+    std::string sInputDevice = ini.getValue(section, "input", &isValid);
+    if (isValid)
+    {
+        route->inputDevice = sInputDevice;
+        isSectionFound = true;
+    }
+    std::string sOutputDevice = ini.getValue(section, "output", &isValid);
+    if (isValid)
+    {
+        route->outputDevice = sOutputDevice;
+        isSectionFound = true;
+    }
+
+    std::string sFramesPerBuffer = ini.getValue(section, "frames-per-buffer", &isValid);
+    if (isValid)
+    {
+        int framesPerBuffer = 0;
+        try
+        {
+            framesPerBuffer = std::stoi(sFramesPerBuffer);
+        }
+        catch (...)
+        {}
+        if (framesPerBuffer <= 0)
+        {
+            std::cout << "Ini error: frames per buffer of the route " << route->name << " must be an integer higher than 0." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        route->framesPerBuffer = framesPerBuffer;
+        isSectionFound = true;
+    }
+
+    std::string sChain = ini.getValue(section, "processing-chain", &isValid);
+    if (isValid)
+    {
+        route->processing.stages.clear();
+        if (!processingStagesFromString(sChain, &route->processing.stages))
+        {
+            std::cout << "Ini error: unknown processing stage in the route " << route->name << ". Possible values are " 
+                << availableProcessingStages() << "." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        isSectionFound = true;
+    }
+
+    if (parseIniNumber(ini, section, "gain", MIN_GAIN, MAX_GAIN, "gain of the route " + route->name, &route->processing.gain))
+        isSectionFound = true;
+
+    std::string sBands = ini.getValue(section, "eq", &isValid);
+    if (isValid)
+    {
+        route->processing.eqBands.clear();
+        if (!biquadBandsFromString(sBands, &route->processing.eqBands))
+        {
+            std::cout << "Ini error: invalid eq band in the route " << route->name << ", the bands are type:frequency[:q[:gain]]." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        isSectionFound = true;
+    }
+
+    // A misspelled name would play the default devices.
+    if (!isSectionFound)
+    {
+        std::cout << "Ini error: the route " << route->name << " has no [" << section << "] section." << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+// Settings of the [mix.NAME] section of a mix source, the program exit when one is invalid.
+static void parseMixSource(ini_parser& ini, MixSourceSettings* source)
+{
+    const std::string section = "mix." + source->name;
+    bool isValid = false;
+    bool isSectionFound = false;
+
+    std::string sDevice = ini.getValue(section, "device", &isValid);
+    if (isValid)
+    {
+        source->device = sDevice;
+        isSectionFound = true;
+    }
+
+    if (parseIniNumber(ini, section, "gain", MIN_GAIN, MAX_GAIN, "gain of the mix source " + source->name, &source->gain))
+        isSectionFound = true;
+    if (parseIniNumber(ini, section, "pan", -1.0, 1.0, "pan of the mix source " + source->name, &source->pan))
+        isSectionFound = true;
+
+    std::string sMute = ini.getValue(section, "mute", &isValid);
+    if (isValid)
+    {
+        source->isMuted = sMute == "yes" || sMute == "on" || sMute == "true" || sMute == "1";
+        isSectionFound = true;
+    }
+
+    if (!isSectionFound)
+    {
+        std::cout << "Ini error: the mix source " << source->name << " has no [" << section << "] section." << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+}
+
+RouteSettings::RouteSettings() :
+    framesPerBuffer(0)
+{}
+
 CMDParser::CMDParser(int& argc, char**& argv) :
     m_isSampleRateSet(false),
     m_sampleRate(0),
+    m_outputSampleRate(0),
+    m_resamplerQuality(ResamplerQuality::Medium),
+    m_isDriftCompensation(false),
+    m_maxLatency(0.0),
     m_isframesPerBufferSet(false),
     m_framesPerBuffer(0),
+    m_channelsCount(0),
+    m_isSampleFormatSet(false),
+    m_sampleFormat(SampleFormat::Int16),
+#ifdef WIN32
+    m_api(StreamApi::PortAudio),
+#elif __linux__
+    m_api(StreamApi::PulseSimple),
+#endif
+    m_isCalibrate(false),
+    m_calibrateTime(5),
+    m_isBenchmark(false),
+    m_isListDevices(false),
+    m_measureLatencyBursts(0),
+    m_statsInterval(0),
+    m_isFileRealtime(false),
+    m_simulatedDrift(0.0),
+    m_processingThreads(0),
+    m_mixBuffer(10.0),
 #ifdef WIN32
     m_isInputLatencySet(false),
     m_inputLatency(-1.0),
     m_isOutputLatencySet(false),
     m_outputLatency(-1.0)
 #elif __linux__
-    m_usePortAudio(false)
+    m_isRingBufferPeriodsSet(false),
+    m_ringBufferPeriods(0),
+    m_adaptiveBufferMin(0),
+    m_adaptiveBufferMax(0)
 #endif
 {
     // Parsing command line arguments.
@@ -48,14 +288,111 @@ CMDParser::CMDParser(int& argc, char**& argv) :
     options.add_options()
         ("r,sample-rate", "Sample rate (default: 48000)\nDo not go above devices maximum supported values.", cxxopts::value<int>())
         ("s,short", "Short version for sample rate: 44 (44100), 48 (48000), 96 (96000). Overridden by sample-rate.", cxxopts::value<int>())
+        ("output-sample-rate", 
+            "Sample rate of the speakers when it differs from the microphone, the stream is resampled after the processing "
+            "(Pulse, Pulse Simple, ALSA and file APIs).",
+            cxxopts::value<int>())
+        ("resampler-quality", 
+            "Quality of the resampler: low, medium or high (default: medium). A higher quality add latency and cpu load.",
+            cxxopts::value<std::string>())
+        ("drift-compensation", 
+            "Hold the buffering between the microphone and the speakers when they are different devices whose clocks drift, "
+            "by adjusting the ratio of the resampler (Pulse, Pulse Simple, ALSA and file APIs).",
+            cxxopts::value<bool>()->default_value("false"))
+        ("max-latency", 
+            "Maximum latency in milliseconds queued between the microphone and the speakers, over it frames are dropped to catch up, "
+            "preferably in silence (Pulse Simple API, and file API with a simulated drift).",
+            cxxopts::value<double>())
         ("f,frames-per-buffer", 
             "Number of frames per buffer (default: 256). A lower value will get a better latency but more cpu overhead and glitches.",
             cxxopts::value<int>())
+        ("c,channels", "Number of channels of the stream (default: 1).", cxxopts::value<int>())
+        ("sample-format", 
+            "Sample format of the devices: s16, s24, s32 or f32 (default: s16). Use the native format of the devices to avoid a conversion by the sound server.",
+            cxxopts::value<std::string>())
+        ("a,api", "Audio API: " + availableStreamApis() + ".", cxxopts::value<std::string>())
+        ("stats-interval", 
+            "Print the glitches, the device latency and the cpu load every N seconds (default: 0, only at exit).", 
+            cxxopts::value<int>())
+        ("trace-file", 
+            "Write a trace of the audio threads into a Chrome trace JSON file (chrome://tracing or ui.perfetto.dev).", 
+            cxxopts::value<std::string>())
+        ("calibrate", 
+            "Find the smallest frames per buffer (and sample rate) playing without glitch and write it to the [stream] section of the user configuration file.",
+            cxxopts::value<bool>()->default_value("false"))
+        ("calibrate-time", "Seconds each setting is played during the calibration (default: 5).", cxxopts::value<int>())
+        ("measure-latency", 
+            "Measure the round-trip latency by playing N noise bursts and searching them in the microphone (default: 10 bursts). "
+            "The output must reach the input, either acoustically or with a loopback device.",
+            cxxopts::value<int>()->implicit_value("10"))
+        ("input-file", "WAV file used as the microphone by the file API.", cxxopts::value<std::string>())
+        ("output-file", "WAV file receiving the processed frames with the file API.", cxxopts::value<std::string>())
+        ("realtime", "Run the file API at the speed of a real device instead of as fast as possible.", cxxopts::value<bool>()->default_value("false"))
+        ("simulate-drift", 
+            "Simulate a playback device with the file API whose clock drift by N ppm from the capture, positive when faster.",
+            cxxopts::value<double>())
+        ("processing-chain", 
+            "Comma separated list of the stages processing the microphone before the speakers, in order: " + availableProcessingStages() + ".",
+            cxxopts::value<std::string>())
+        ("processing-threads", 
+            "Number of worker threads running the stages in parallel, one channel per thread for the gain and eq stages, "
+            "from 0 to 64 (default: 0, the audio thread runs the whole chain).",
+            cxxopts::value<int>())
+        ("gain", "Gain of the gain stage in dB, from -60 to 40 (default: 0).", cxxopts::value<double>())
+        ("eq", 
+            "Comma separated list of the bands of the eq stage, each band is type:frequency[:q[:gain]] "
+            "with the types highpass, lowshelf, peaking, highshelf and lowpass (example: highpass:80,peaking:4000:1.5:4).",
+            cxxopts::value<std::string>())
+        ("howl-notches", "Maximum number of notches placed by the howl stage, from 1 to 16 (default: 6).", cxxopts::value<int>())
+        ("howl-depth", "Maximum attenuation of a notch of the howl stage in dB, from 1 to 60 (default: 18).", cxxopts::value<double>())
+        ("howl-release", "Seconds without howl before a notch of the howl stage is released, from 0 to 3600 (default: 10).", 
+            cxxopts::value<double>())
+        ("gate-threshold", "Level in dBFS under which the dynamics stage attenuate the microphone (default: -60).", cxxopts::value<double>())
+        ("compressor-threshold", "Level in dBFS above which the dynamics stage compress the microphone (default: -18).", cxxopts::value<double>())
+        ("compressor-ratio", "Ratio of the compressor of the dynamics stage, 1 to disable it (default: 3).", cxxopts::value<double>())
+        ("limiter-ceiling", "Maximum level in dBFS of the output of the dynamics stage (default: -1).", cxxopts::value<double>())
+        ("lookahead", 
+            "Lookahead of the limiter of the dynamics stage in milliseconds, the stream is delayed by this time (default: 2).", 
+            cxxopts::value<double>())
+        ("benchmark", 
+            "Measure the cost of the processing chain on generated noise, per frame and per filter, without opening any device.",
+            cxxopts::value<bool>()->default_value("false"))
+        ("input-device", 
+            "Capture device, by its number in --list-devices, its name or a part of its description (default: the default device of the API). "
+            "With the alsa API, any PCM name (default: plughw:0,0).",
+            cxxopts::value<std::string>())
+        ("output-device", "Playback device, selected like the input device.", cxxopts::value<std::string>())
+        ("routes", 
+            "Comma separated list of the routes to play together, each defined by a [route.NAME] section of the ini file "
+            "(default: the names of the [routes] section).",
+            cxxopts::value<std::string>())
+        ("mix-sources", 
+            "Comma separated list of the capture sources mixed into the playback, each defined by a [mix.NAME] section of the ini file "
+            "(default: the sources of the [mix] section). Only with the portaudio, pulse and pulse-simple APIs.",
+            cxxopts::value<std::string>())
+        ("mix-buffer", 
+            "Buffering of each mix source in milliseconds absorbing the jitter between the devices, from 1 to 1000 (default: 10).",
+            cxxopts::value<double>())
+        ("list-devices", 
+            "List the devices of the API with their channels, rates and lowest latency, and refresh the cache of the devices.",
+            cxxopts::value<bool>()->default_value("false"))
 #ifdef WIN32
         ("i,input_latency", "Latency in seconds at which Windows will try to operate to get audio from the microphone (default: 0.02).", cxxopts::value<double>())
         ("o,output_latency", "Latency in seconds at which Windows will try to operate to send audio to the dac (default: 0.02).", cxxopts::value<double>())
 #elif __linux__
-        ("p,portaudio", "Use PortAudio API instead of the Pulse Simple API.", cxxopts::value<bool>()->default_value("false"))
+        ("p,portaudio", "Use PortAudio API instead of the Pulse Simple API. Same as --api portaudio.", cxxopts::value<bool>()->default_value("false"))
+#ifdef HAVE_PIPEWIRE
+        ("w,pipewire", "Use a native PipeWire filter instead of the Pulse Simple API. Same as --api pipewire.", cxxopts::value<bool>()->default_value("false"))
+#endif
+        ("adaptive-buffer", 
+            "Grow the buffering of the Pulse and Pulse Simple APIs when underruns cluster and shrink it back when stable.", 
+            cxxopts::value<bool>()->default_value("false"))
+        ("min-buffer", "Minimum buffering of the adaptive buffer in periods (default: 2).", cxxopts::value<int>())
+        ("max-buffer", "Maximum buffering of the adaptive buffer in periods (default: 8).", cxxopts::value<int>())
+        ("metrics-socket", "Serve the metrics of the stream in the Prometheus text format on this Unix socket.", cxxopts::value<std::string>())
+        ("b,ring-buffer", 
+            "Number of periods of the buffer between the capture and the playback threads of the Pulse Simple API (default: 4).",
+            cxxopts::value<int>())
 #endif
         ("v,version", "Show the version of the program.")
         ("h,help", "Print usage information.");
@@ -63,18 +400,12 @@ CMDParser::CMDParser(int& argc, char**& argv) :
     // ini_parser object used to read ini file.
     ini_parser ini;
     bool isValid = false;
-    std::string fIniPath;
+    std::string fIniPath = userConfigPath();
 #ifdef WIN32
-    fIniPath = "./MicrophoneLoopback.conf";
     ini.setIniFile(fIniPath, true);
 	if (ini.isParsed())
 		std::cout << fIniPath << std::endl;
 #elif __linux__
-    const char* homeDir = getenv("HOME");
-    if (homeDir == nullptr)
-        homeDir = getpwuid(getuid())->pw_dir;
-    fIniPath = homeDir;
-    fIniPath += "/.config/MicrophoneLoopback/MicrophoneLoopback.conf";
     ini.setIniFile(fIniPath, true);
     if (!ini.isParsed())
     {
@@ -160,6 +491,76 @@ CMDParser::CMDParser(int& argc, char**& argv) :
         }
     }
 
+    // Output sample rate.
+    if (result.count("output-sample-rate"))
+    {
+        m_outputSampleRate = result["output-sample-rate"].as<int>();
+        if (m_outputSampleRate < 16000)
+        {
+            std::cout << "Output sample rate cannot be below 16000." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    else if (ini.isParsed())
+    {
+        std::string sOutputSampleRate = ini.getValue("stream", "output-sample-rate", &isValid);
+        if (isValid)
+        {
+            try
+            {
+                int outputSampleRate = std::stoi(sOutputSampleRate);
+                if (outputSampleRate < 16000)
+                {
+                    std::cout << "Ini error: output sample rate cannot be below 16000." << std::endl;
+                    std::exit(EXIT_FAILURE);
+                }
+                m_outputSampleRate = outputSampleRate;
+            }
+            catch (...)
+            {
+                std::cout << "Ini error: output sample rate must be a integer." << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    // Resampler quality.
+    if (result.count("resampler-quality"))
+    {
+        if (!resamplerQualityFromString(result["resampler-quality"].as<std::string>(), &m_resamplerQuality))
+        {
+            std::cout << "Unknown resampler quality. Possible values are low, medium and high." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    else if (ini.isParsed())
+    {
+        std::string sResamplerQuality = ini.getValue("stream", "resampler-quality", &isValid);
+        if (isValid && !resamplerQualityFromString(sResamplerQuality, &m_resamplerQuality))
+        {
+            std::cout << "Ini error: unknown resampler quality. Possible values are low, medium and high." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // Drift compensation.
+    m_isDriftCompensation = result["drift-compensation"].as<bool>();
+    if (!m_isDriftCompensation && ini.isParsed())
+    {
+        std::string sDriftCompensation = ini.getValue("stream", "drift-compensation", &isValid);
+        if (isValid)
+        {
+            if (sDriftCompensation == "yes" ||
+                sDriftCompensation == "on" ||
+                sDriftCompensation == "true" ||
+                sDriftCompensation == "1")
+                m_isDriftCompensation = true;
+        }
+    }
+
+    // Maximum latency.
+    parseNumber(result, ini, "max-latency", "stream", "max-latency", 0.0, 10000.0, "maximum latency", &m_maxLatency);
+
     // Frames per buffer.
     if (result.count("frames-per-buffer"))
     {
@@ -195,6 +596,395 @@ CMDParser::CMDParser(int& argc, char**& argv) :
         }
     }
 
+    // Channels.
+    if (result.count("channels"))
+    {
+        m_channelsCount = result["channels"].as<int>();
+        if (m_channelsCount <= 0)
+        {
+            std::cout << "Channels must be higher than 0." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    else if (ini.isParsed())
+    {
+        std::string sChannels = ini.getValue("stream", "channels", &isValid);
+        if (isValid)
+        {
+            try
+            {
+                int channelsCount = std::stoi(sChannels);
+                if (channelsCount <= 0)
+                {
+                    std::cout << "Ini error: channels must be higher than 0." << std::endl;
+                    std::exit(EXIT_FAILURE);
+                }
+                m_channelsCount = channelsCount;
+            }
+            catch (...)
+            {
+                std::cout << "Ini error: channels must be an integer." << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    // Sample format.
+    if (result.count("sample-format"))
+    {
+        if (!sampleFormatFromString(result["sample-format"].as<std::string>(), &m_sampleFormat))
+        {
+            std::cout << "Unknown sample format. Possible values are s16, s24, s32 and f32." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        m_isSampleFormatSet = true;
+    }
+    else if (ini.isParsed())
+    {
+        std::string sSampleFormat = ini.getValue("stream", "sample-format", &isValid);
+        if (isValid)
+        {
+            if (!sampleFormatFromString(sSampleFormat, &m_sampleFormat))
+            {
+                std::cout << "Ini error: unknown sample format. Possible values are s16, s24, s32 and f32." << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+            m_isSampleFormatSet = true;
+        }
+    }
+
+    // Audio API
+    if (result.count("api"))
+    {
+        if (!streamApiFromString(result["api"].as<std::string>(), &m_api))
+        {
+            std::cout << "Unknown API. Possible values are " << availableStreamApis() << "." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+#ifdef __linux__
+    else if (result["portaudio"].as<bool>())
+    {
+        m_api = StreamApi::PortAudio;
+    }
+#ifdef HAVE_PIPEWIRE
+    else if (result["pipewire"].as<bool>())
+    {
+        m_api = StreamApi::PipeWire;
+    }
+#endif
+#endif
+    else if (ini.isParsed())
+    {
+        std::string sApi = ini.getValue("api", "api", &isValid);
+        if (isValid)
+        {
+            if (!streamApiFromString(sApi, &m_api))
+            {
+                std::cout << "Ini error: unknown API. Possible values are " << availableStreamApis() << "." << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+        }
+#ifdef __linux__
+        else
+        {
+            // Use PortAudio
+            std::string sUsePortAudio = ini.getValue("api", "use-portaudio", &isValid);
+            if (isValid)
+            {
+                if (sUsePortAudio == "yes" ||
+                    sUsePortAudio == "on" ||
+                    sUsePortAudio == "true" ||
+                    sUsePortAudio == "1")
+                    m_api = StreamApi::PortAudio;
+            }
+
+#ifdef HAVE_PIPEWIRE
+            // Use PipeWire
+            std::string sUsePipeWire = ini.getValue("api", "use-pipewire", &isValid);
+            if (isValid)
+            {
+                if (sUsePipeWire == "yes" ||
+                    sUsePipeWire == "on" ||
+                    sUsePipeWire == "true" ||
+                    sUsePipeWire == "1")
+                    m_api = StreamApi::PipeWire;
+            }
+#endif
+        }
+#endif
+    }
+
+    // Statistics interval.
+    if (result.count("stats-interval"))
+    {
+        m_statsInterval = result["stats-interval"].as<int>();
+        if (m_statsInterval < 0)
+        {
+            std::cout << "Statistics interval cannot be negative." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    else if (ini.isParsed())
+    {
+        std::string sStatsInterval = ini.getValue("stats", "interval", &isValid);
+        if (isValid)
+        {
+            try
+            {
+                m_statsInterval = std::stoi(sStatsInterval);
+                if (m_statsInterval < 0)
+                {
+                    std::cout << "Ini error: statistics interval cannot be negative." << std::endl;
+                    std::exit(EXIT_FAILURE);
+                }
+            }
+            catch (...)
+            {
+                std::cout << "Ini error: statistics interval must be an integer." << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    // Trace file
+    if (result.count("trace-file"))
+        m_traceFile = result["trace-file"].as<std::string>();
+    else if (ini.isParsed())
+    {
+        std::string sTraceFile = ini.getValue("trace", "file", &isValid);
+        if (isValid)
+            m_traceFile = sTraceFile;
+    }
+
+    // Calibration
+    m_isCalibrate = result["calibrate"].as<bool>();
+    if (result.count("calibrate-time"))
+    {
+        m_calibrateTime = result["calibrate-time"].as<int>();
+        if (m_calibrateTime <= 0)
+        {
+            std::cout << "The calibration time must be at least one second." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // Latency measurement
+    if (result.count("measure-latency"))
+    {
+        m_measureLatencyBursts = result["measure-latency"].as<int>();
+        if (m_measureLatencyBursts <= 0)
+        {
+            std::cout << "The latency measurement need at least one burst." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // Files of the file API
+    if (result.count("input-file"))
+        m_inputFile = result["input-file"].as<std::string>();
+    else if (ini.isParsed())
+    {
+        std::string sInputFile = ini.getValue("file", "input", &isValid);
+        if (isValid)
+            m_inputFile = sInputFile;
+    }
+
+    if (result.count("output-file"))
+        m_outputFile = result["output-file"].as<std::string>();
+    else if (ini.isParsed())
+    {
+        std::string sOutputFile = ini.getValue("file", "output", &isValid);
+        if (isValid)
+            m_outputFile = sOutputFile;
+    }
+
+    m_isFileRealtime = result["realtime"].as<bool>();
+    if (!m_isFileRealtime && ini.isParsed())
+    {
+        std::string sRealtime = ini.getValue("file", "realtime", &isValid);
+        if (isValid)
+        {
+            if (sRealtime == "yes" ||
+                sRealtime == "on" ||
+                sRealtime == "true" ||
+                sRealtime == "1")
+                m_isFileRealtime = true;
+        }
+    }
+    parseNumber(result, ini, "simulate-drift", "file", "drift", -1000.0, 1000.0, "simulated drift", &m_simulatedDrift);
+
+    // Processing chain
+    if (result.count("processing-chain"))
+    {
+        if (!processingStagesFromString(result["processing-chain"].as<std::string>(), &m_processing.stages))
+        {
+            std::cout << "Unknown processing stage. Possible values are " << availableProcessingStages() << "." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    else if (ini.isParsed())
+    {
+        std::string sChain = ini.getValue("processing", "chain", &isValid);
+        if (isValid && !processingStagesFromString(sChain, &m_processing.stages))
+        {
+            std::cout << "Ini error: unknown processing stage. Possible values are " << availableProcessingStages() << "." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // Workers of the processing chain.
+    if (result.count("processing-threads"))
+    {
+        m_processingThreads = result["processing-threads"].as<int>();
+        if (m_processingThreads < 0 || m_processingThreads > ProcessingExecutor::MAX_THREADS)
+        {
+            std::cout << "The processing threads count must be between 0 and " << ProcessingExecutor::MAX_THREADS << "." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    else if (ini.isParsed())
+    {
+        std::string sThreads = ini.getValue("processing", "threads", &isValid);
+        if (isValid)
+        {
+            try
+            {
+                m_processingThreads = std::stoi(sThreads);
+            }
+            catch (...)
+            {
+                m_processingThreads = -1;
+            }
+            if (m_processingThreads < 0 || m_processingThreads > ProcessingExecutor::MAX_THREADS)
+            {
+                std::cout << "Ini error: the processing threads count must be between 0 and " << ProcessingExecutor::MAX_THREADS << "." << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    // Gain stage
+    parseNumber(result, ini, "gain", "processing", "gain", MIN_GAIN, MAX_GAIN, "gain", &m_processing.gain);
+
+    // Equalizer stage
+    if (result.count("eq"))
+    {
+        if (!biquadBandsFromString(result["eq"].as<std::string>(), &m_processing.eqBands))
+        {
+            std::cout << "Invalid eq band, the bands are type:frequency[:q[:gain]]." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    else if (ini.isParsed())
+    {
+        std::string sBands = ini.getValue("eq", "bands", &isValid);
+        if (isValid && !biquadBandsFromString(sBands, &m_processing.eqBands))
+        {
+            std::cout << "Ini error: invalid eq band, the bands are type:frequency[:q[:gain]]." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    // Howl stage
+    parseNumber(result, ini, "howl-notches", "howl", "notches", 1, HowlStage::MAX_NOTCHES, "howl notches count", 
+        &m_processing.howlNotches);
+    parseNumber(result, ini, "howl-depth", "howl", "depth", 1.0, 60.0, "howl depth", &m_processing.howlDepth);
+    parseNumber(result, ini, "howl-release", "howl", "release", 0.0, 3600.0, "howl release", &m_processing.howlRelease);
+
+    // Dynamics stage
+    parseNumber(result, ini, "gate-threshold", "dynamics", "gate-threshold", -120.0, 0.0, "gate threshold", &m_processing.gateThreshold);
+    parseNumber(result, ini, "compressor-threshold", "dynamics", "compressor-threshold", -60.0, 0.0, 
+        "compressor threshold", &m_processing.compressorThreshold);
+    parseNumber(result, ini, "compressor-ratio", "dynamics", "compressor-ratio", 1.0, 50.0, "compressor ratio", &m_processing.compressorRatio);
+    parseNumber(result, ini, "limiter-ceiling", "dynamics", "limiter-ceiling", -20.0, 0.0, "limiter ceiling", &m_processing.limiterCeiling);
+    parseNumber(result, ini, "lookahead", "dynamics", "lookahead", 0.0, 20.0, "lookahead", &m_processing.lookahead);
+
+    // Benchmark
+    m_isBenchmark = result["benchmark"].as<bool>();
+
+    // Devices
+    if (result.count("input-device"))
+        m_inputDevice = result["input-device"].as<std::string>();
+    else if (ini.isParsed())
+    {
+        std::string sInputDevice = ini.getValue("devices", "input", &isValid);
+        if (isValid)
+            m_inputDevice = sInputDevice;
+    }
+
+    if (result.count("output-device"))
+        m_outputDevice = result["output-device"].as<std::string>();
+    else if (ini.isParsed())
+    {
+        std::string sOutputDevice = ini.getValue("devices", "output", &isValid);
+        if (isValid)
+            m_outputDevice = sOutputDevice;
+    }
+    m_isListDevices = result["list-devices"].as<bool>();
+
+    // Routes, they start from the global settings.
+    std::string sRoutes;
+    if (result.count("routes"))
+        sRoutes = result["routes"].as<std::string>();
+    else if (ini.isParsed())
+    {
+        std::string sNames = ini.getValue("routes", "names", &isValid);
+        if (isValid)
+            sRoutes = sNames;
+    }
+    for (const std::string& routeName : parseNames(sRoutes, "route"))
+    {
+        if (!ini.isParsed())
+        {
+            std::cout << "The routes are defined in the ini file, " << userConfigPath() << " was not found." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+
+        RouteSettings route;
+        route.name = routeName;
+        route.inputDevice = m_inputDevice;
+        route.outputDevice = m_outputDevice;
+        route.framesPerBuffer = m_isframesPerBufferSet ? m_framesPerBuffer : 0;
+        route.processing = m_processing;
+        parseRoute(ini, &route);
+        m_routes.push_back(route);
+    }
+
+    // Mix sources, the streams of the routes do not take them.
+    std::string sMixSources;
+    bool isMixSourcesFromIni = false;
+    if (result.count("mix-sources"))
+        sMixSources = result["mix-sources"].as<std::string>();
+    else if (ini.isParsed())
+    {
+        std::string sNames = ini.getValue("mix", "sources", &isValid);
+        if (isValid)
+        {
+            sMixSources = sNames;
+            isMixSourcesFromIni = true;
+        }
+    }
+    if (!m_routes.empty() && sMixSources.find_first_not_of(" \t,") != std::string::npos)
+    {
+        std::cout << (isMixSourcesFromIni ? "Ini error: the" : "The") << " mix sources cannot be played with the routes." << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    for (const std::string& sourceName : parseNames(sMixSources, "mix source"))
+    {
+        if (!ini.isParsed())
+        {
+            std::cout << "The mix sources are defined in the ini file, " << userConfigPath() << " was not found." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+
+        MixSourceSettings source;
+        source.name = sourceName;
+        parseMixSource(ini, &source);
+        m_mixSources.push_back(source);
+    }
+    parseNumber(result, ini, "mix-buffer", "mix", "buffer", 1.0, 1000.0, "mix buffer", &m_mixBuffer);
+
 #ifdef WIN32
     // Input latency
     if (result.count("input_latency"))
@@ -266,18 +1056,95 @@ CMDParser::CMDParser(int& argc, char**& argv) :
         }
     }
 #elif __linux__
-    // Use PortAudio
-    m_usePortAudio = result["portaudio"].as<bool>();
-    if (!m_usePortAudio && ini.isParsed())
+    // Adaptive buffer
+    bool isAdaptiveBuffer = result["adaptive-buffer"].as<bool>();
+    int adaptiveBufferMin = 2;
+    int adaptiveBufferMax = 8;
+    if (ini.isParsed())
     {
-        std::string sUsePortAudio = ini.getValue("api", "use-portaudio", &isValid);
+        std::string sAdaptiveBuffer = ini.getValue("adaptive-buffer", "enabled", &isValid);
+        if (isValid && !isAdaptiveBuffer)
+        {
+            if (sAdaptiveBuffer == "yes" ||
+                sAdaptiveBuffer == "on" ||
+                sAdaptiveBuffer == "true" ||
+                sAdaptiveBuffer == "1")
+                isAdaptiveBuffer = true;
+        }
+
+        try
+        {
+            std::string sMin = ini.getValue("adaptive-buffer", "min", &isValid);
+            if (isValid)
+                adaptiveBufferMin = std::stoi(sMin);
+            std::string sMax = ini.getValue("adaptive-buffer", "max", &isValid);
+            if (isValid)
+                adaptiveBufferMax = std::stoi(sMax);
+        }
+        catch (...)
+        {
+            std::cout << "Ini error: adaptive buffer bounds must be integers." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    if (result.count("min-buffer"))
+        adaptiveBufferMin = result["min-buffer"].as<int>();
+    if (result.count("max-buffer"))
+        adaptiveBufferMax = result["max-buffer"].as<int>();
+
+    if (isAdaptiveBuffer)
+    {
+        if (adaptiveBufferMin < 1 || adaptiveBufferMax < adaptiveBufferMin)
+        {
+            std::cout << "The adaptive buffer need 1 <= min-buffer <= max-buffer." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        m_adaptiveBufferMin = adaptiveBufferMin;
+        m_adaptiveBufferMax = adaptiveBufferMax;
+    }
+
+    // Metrics socket
+    if (result.count("metrics-socket"))
+        m_metricsSocket = result["metrics-socket"].as<std::string>();
+    else if (ini.isParsed())
+    {
+        std::string sMetricsSocket = ini.getValue("metrics", "socket", &isValid);
         if (isValid)
+            m_metricsSocket = sMetricsSocket;
+    }
+
+    // Ring buffer periods.
+    if (result.count("ring-buffer"))
+    {
+        m_ringBufferPeriods = result["ring-buffer"].as<int>();
+        if (m_ringBufferPeriods < 2)
         {
-            if (sUsePortAudio == "yes" ||
-                sUsePortAudio == "on" ||
-                sUsePortAudio == "true" ||
-                sUsePortAudio == "1")
-                m_usePortAudio = true;
+            std::cout << "Ring buffer must be at least 2 periods." << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        m_isRingBufferPeriodsSet = true;
+    }
+    else if (ini.isParsed())
+    {
+        std::string sRingBuffer = ini.getValue("stream", "ring-buffer", &isValid);
+        if (isValid)
+        {
+            try
+            {
+                int ringBufferPeriods = std::stoi(sRingBuffer);
+                if (ringBufferPeriods < 2)
+                {
+                    std::cout << "Ini error: ring buffer must be at least 2 periods." << std::endl;
+                    std::exit(EXIT_FAILURE);
+                }
+                m_ringBufferPeriods = ringBufferPeriods;
+                m_isRingBufferPeriodsSet = true;
+            }
+            catch (...)
+            {
+                std::cout << "Ini error: ring buffer must be an integer." << std::endl;
+                std::exit(EXIT_FAILURE);
+            }
         }
     }
 #endif
@@ -286,6 +1153,18 @@ CMDParser::CMDParser(int& argc, char**& argv) :
 CMDParser::~CMDParser()
 {}
 
+std::string CMDParser::userConfigPath()
+{
+#ifdef WIN32
+    return "./MicrophoneLoopback.conf";
+#elif __linux__
+    const char* homeDir = getenv("HOME");
+    if (homeDir == nullptr)
+        homeDir = getpwuid(getuid())->pw_dir;
+    return std::string(homeDir) + "/.config/MicrophoneLoopback/MicrophoneLoopback.conf";
+#endif
+}
+
 bool CMDParser::isSampleRateSet() const
 {
     return m_isSampleRateSet;
@@ -296,6 +1175,26 @@ int CMDParser::sampleRate() const
     return m_sampleRate;
 }
 
+int CMDParser::outputSampleRate() const
+{
+    return m_outputSampleRate;
+}
+
+ResamplerQuality CMDParser::resamplerQuality() const
+{
+    return m_resamplerQuality;
+}
+
+bool CMDParser::isDriftCompensation() const
+{
+    return m_isDriftCompensation;
+}
+
+double CMDParser::maxLatency() const
+{
+    return m_maxLatency;
+}
+
 bool CMDParser::isFramesPerBufferSet() const
 {
     return m_isframesPerBufferSet;
@@ -306,6 +1205,116 @@ int CMDParser::framesPerBuffer() const
     return m_framesPerBuffer;
 }
 
+int CMDParser::channelsCount() const
+{
+    return m_channelsCount;
+}
+
+bool CMDParser::isSampleFormatSet() const
+{
+    return m_isSampleFormatSet;
+}
+
+SampleFormat CMDParser::sampleFormat() const
+{
+    return m_sampleFormat;
+}
+
+StreamApi CMDParser::api() const
+{
+    return m_api;
+}
+
+int CMDParser::statsInterval() const
+{
+    return m_statsInterval;
+}
+
+const std::string& CMDParser::traceFile() const
+{
+    return m_traceFile;
+}
+
+bool CMDParser::isCalibrate() const
+{
+    return m_isCalibrate;
+}
+
+int CMDParser::calibrateTime() const
+{
+    return m_calibrateTime;
+}
+
+int CMDParser::measureLatencyBursts() const
+{
+    return m_measureLatencyBursts;
+}
+
+const std::string& CMDParser::inputFile() const
+{
+    return m_inputFile;
+}
+
+const std::string& CMDParser::outputFile() const
+{
+    return m_outputFile;
+}
+
+bool CMDParser::isFileRealtime() const
+{
+    return m_isFileRealtime;
+}
+
+double CMDParser::simulatedDrift() const
+{
+    return m_simulatedDrift;
+}
+
+const ProcessingSettings& CMDParser::processing() const
+{
+    return m_processing;
+}
+
+int CMDParser::processingThreads() const
+{
+    return m_processingThreads;
+}
+
+bool CMDParser::isBenchmark() const
+{
+    return m_isBenchmark;
+}
+
+const std::string& CMDParser::inputDevice() const
+{
+    return m_inputDevice;
+}
+
+const std::string& CMDParser::outputDevice() const
+{
+    return m_outputDevice;
+}
+
+bool CMDParser::isListDevices() const
+{
+    return m_isListDevices;
+}
+
+const std::vector<RouteSettings>& CMDParser::routes() const
+{
+    return m_routes;
+}
+
+const std::vector<MixSourceSettings>& CMDParser::mixSources() const
+{
+    return m_mixSources;
+}
+
+double CMDParser::mixBufferTime() const
+{
+    return m_mixBuffer / 1000.0;
+}
+
 #ifdef WIN32
 bool CMDParser::isInputLatencySet() const
 {
@@ -328,8 +1337,28 @@ double CMDParser::outputLatency() const
 }
 
 #elif __linux__
-bool CMDParser::usePortAudio() const
+bool CMDParser::isRingBufferPeriodsSet() const
+{
+    return m_isRingBufferPeriodsSet;
+}
+
+int CMDParser::ringBufferPeriods() const
+{
+    return m_ringBufferPeriods;
+}
+
+int CMDParser::adaptiveBufferMin() const
+{
+    return m_adaptiveBufferMin;
+}
+
+int CMDParser::adaptiveBufferMax() const
+{
+    return m_adaptiveBufferMax;
+}
+
+const std::string& CMDParser::metricsSocket() const
 {
-    return m_usePortAudio;
+    return m_metricsSocket;
 }
 #endif
@@ -0,0 +1,141 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ConfigWriter.h"
+#include <fstream>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+    std::string trim(const std::string& str)
+    {
+        size_t begin = str.find_first_not_of(" \t\r");
+        if (begin == std::string::npos)
+            return std::string();
+        size_t end = str.find_last_not_of(" \t\r");
+        return str.substr(begin, end - begin + 1);
+    }
+
+    // Name of the key of a "key=value" line, empty for the other lines.
+    std::string keyOfLine(const std::string& line)
+    {
+        std::string trimmed = trim(line);
+        if (trimmed.empty() || trimmed[0] == '#' || trimmed[0] == ';' || trimmed[0] == '[')
+            return std::string();
+        size_t equal = trimmed.find('=');
+        if (equal == std::string::npos)
+            return std::string();
+        return trim(trimmed.substr(0, equal));
+    }
+
+#ifdef __linux__
+    // Create the parent directories of path.
+    void createParentDirectories(const std::string& path)
+    {
+        for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1))
+            mkdir(path.substr(0, pos).c_str(), 0755);
+    }
+#endif
+}
+
+bool writeIniValues(
+    const std::string& path, 
+    const std::string& section, 
+    const std::vector<std::pair<std::string, std::string>>& values,
+    std::string& error)
+{
+    // Reading the existing file, if any.
+    std::vector<std::string> lines;
+    {
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line))
+            lines.push_back(line);
+    }
+
+    std::vector<bool> isWritten(values.size(), false);
+    const std::string header = "[" + section + "]";
+    bool isInSection = false;
+    bool isSectionFound = false;
+    // Line after the last value of the section, where the missing keys are inserted.
+    size_t insertPos = lines.size();
+
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+        std::string trimmed = trim(lines[i]);
+        if (!trimmed.empty() && trimmed[0] == '[')
+        {
+            if (isInSection)
+                break;
+            isInSection = trimmed == header;
+            if (isInSection)
+            {
+                isSectionFound = true;
+                insertPos = i + 1;
+            }
+            continue;
+        }
+        if (!isInSection)
+            continue;
+
+        if (!trimmed.empty())
+            insertPos = i + 1;
+
+        std::string key = keyOfLine(lines[i]);
+        for (size_t v = 0; v < values.size(); v++)
+        {
+            if (key == values[v].first)
+            {
+                lines[i] = values[v].first + "=" + values[v].second;
+                isWritten[v] = true;
+            }
+        }
+    }
+
+    // Adding the keys not found in the file.
+    std::vector<std::string> newLines;
+    if (!isSectionFound)
+    {
+        if (!lines.empty() && !trim(lines.back()).empty())
+            newLines.push_back(std::string());
+        newLines.push_back(header);
+        insertPos = lines.size();
+    }
+    for (size_t v = 0; v < values.size(); v++)
+    {
+        if (!isWritten[v])
+            newLines.push_back(values[v].first + "=" + values[v].second);
+    }
+    lines.insert(lines.begin() + insertPos, newLines.begin(), newLines.end());
+
+#ifdef __linux__
+    createParentDirectories(path);
+#endif
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file.is_open())
+    {
+        error = "Failed to write the configuration file " + path + ".";
+        return false;
+    }
+    for (const std::string& line : lines)
+        file << line << "\n";
+    return true;
+}
@@ -0,0 +1,230 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "DeviceCache.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pwd.h>
+#endif
+
+namespace
+{
+    const char* CACHE_HEADER = "MicrophoneLoopback devices 1";
+
+    // The fields of the cache are separated by tabs, one device per line.
+    std::string sanitize(const std::string& str)
+    {
+        std::string result = str;
+        for (char& c : result)
+        {
+            if (c == '\t' || c == '\n' || c == '\r')
+                c = ' ';
+        }
+        return result;
+    }
+
+    std::string lowerCase(const std::string& str)
+    {
+        std::string result = str;
+        for (char& c : result)
+        {
+            if (c >= 'A' && c <= 'Z')
+                c = c - 'A' + 'a';
+        }
+        return result;
+    }
+
+    bool parseDevice(const std::string& line, DeviceInfo* device)
+    {
+        std::vector<std::string> fields;
+        std::istringstream stream(line);
+        std::string field;
+        while (std::getline(stream, field, '\t'))
+            fields.push_back(field);
+        if (fields.size() != 7 || (fields[0] != "in" && fields[0] != "out"))
+            return false;
+
+        try
+        {
+            device->isInput = fields[0] == "in";
+            device->id = fields[1];
+            device->channelsCount = std::stoi(fields[2]);
+            device->defaultSampleRate = std::stoi(fields[3]);
+            device->lowLatency = std::stod(fields[4]);
+            device->sampleRates.clear();
+            std::istringstream rates(fields[5]);
+            std::string rate;
+            while (std::getline(rates, rate, ','))
+            {
+                if (!rate.empty())
+                    device->sampleRates.push_back(std::stoi(rate));
+            }
+            device->description = fields[6];
+        }
+        catch (...)
+        {
+            return false;
+        }
+        return true;
+    }
+
+#ifdef __linux__
+    void createParentDirectories(const std::string& path)
+    {
+        for (size_t pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1))
+            mkdir(path.substr(0, pos).c_str(), 0755);
+    }
+#endif
+}
+
+DeviceInfo::DeviceInfo() :
+    isInput(true),
+    channelsCount(0),
+    defaultSampleRate(0),
+    lowLatency(0.0)
+{}
+
+const std::vector<int>& standardSampleRates()
+{
+    static const std::vector<int> rates = { 8000, 11025, 16000, 22050, 32000, 44100, 48000, 88200, 96000, 176400, 192000 };
+    return rates;
+}
+
+bool isDeviceIndex(const std::string& selector)
+{
+    return !selector.empty() && selector.size() < 6 && selector.find_first_not_of("0123456789") == std::string::npos;
+}
+
+const DeviceInfo* findDevice(const std::vector<DeviceInfo>& devices, const std::string& selector, bool isInput)
+{
+    if (isDeviceIndex(selector))
+    {
+        int index = std::atoi(selector.c_str());
+        for (const DeviceInfo& device : devices)
+        {
+            if (device.isInput == isInput && index-- == 0)
+                return &device;
+        }
+        return nullptr;
+    }
+
+    // The id match exactly, the description only a part of it.
+    for (const DeviceInfo& device : devices)
+    {
+        if (device.isInput == isInput && device.id == selector)
+            return &device;
+    }
+    std::string lowerSelector = lowerCase(selector);
+    for (const DeviceInfo& device : devices)
+    {
+        if (device.isInput == isInput && lowerCase(device.description).find(lowerSelector) != std::string::npos)
+            return &device;
+    }
+    return nullptr;
+}
+
+std::string deviceFingerprint(const std::string& hardware)
+{
+    // FNV-1a, stable across runs and builds.
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : hardware)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    char result[17];
+    snprintf(result, sizeof(result), "%016llx", static_cast<unsigned long long>(hash));
+    return result;
+}
+
+std::string deviceCachePath(StreamApi api)
+{
+#ifdef WIN32
+    return std::string("./MicrophoneLoopback.") + streamApiName(api) + ".devices";
+#elif __linux__
+    const char* cacheDir = getenv("XDG_CACHE_HOME");
+    if (cacheDir && cacheDir[0] == '/')
+        return std::string(cacheDir) + "/MicrophoneLoopback/" + streamApiName(api) + ".devices";
+    const char* homeDir = getenv("HOME");
+    if (homeDir == nullptr)
+        homeDir = getpwuid(getuid())->pw_dir;
+    return std::string(homeDir) + "/.cache/MicrophoneLoopback/" + streamApiName(api) + ".devices";
+#endif
+}
+
+bool loadDeviceCache(const std::string& path, const std::string& fingerprint, std::vector<DeviceInfo>* devices)
+{
+    std::ifstream file(path);
+    std::string line;
+    if (!std::getline(file, line) || line != CACHE_HEADER)
+        return false;
+    if (!std::getline(file, line) || line != "fingerprint\t" + fingerprint)
+        return false;
+
+    std::vector<DeviceInfo> cachedDevices;
+    while (std::getline(file, line))
+    {
+        DeviceInfo device;
+        if (!parseDevice(line, &device))
+            return false;
+        cachedDevices.push_back(device);
+    }
+    if (cachedDevices.empty())
+        return false;
+
+    devices->swap(cachedDevices);
+    return true;
+}
+
+bool saveDeviceCache(const std::string& path, const std::string& fingerprint, const std::vector<DeviceInfo>& devices)
+{
+#ifdef __linux__
+    createParentDirectories(path);
+#endif
+
+    // Written aside and renamed, another instance may read it at the same time.
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::trunc);
+        if (!file)
+            return false;
+        file << CACHE_HEADER << "\n";
+        file << "fingerprint\t" << fingerprint << "\n";
+        for (const DeviceInfo& device : devices)
+        {
+            file << (device.isInput ? "in" : "out") << "\t" << sanitize(device.id) << "\t" << device.channelsCount << "\t" 
+                << device.defaultSampleRate << "\t" << device.lowLatency << "\t";
+            for (size_t i = 0; i < device.sampleRates.size(); i++)
+                file << (i > 0 ? "," : "") << device.sampleRates[i];
+            file << "\t" << sanitize(device.description.empty() ? device.id : device.description) << "\n";
+        }
+        if (!file)
+            return false;
+    }
+#ifdef WIN32
+    std::remove(path.c_str());
+#endif
+    return std::rename(tmpPath.c_str(), path.c_str()) == 0;
+}
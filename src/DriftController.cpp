@@ -0,0 +1,118 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "DriftController.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Time constant of the low-pass filter of the level, the level jump by a period at each write.
+    const double LEVEL_TIME_CONSTANT = 1.0;
+    // Time before the target is taken from the level.
+    const double SETTLE_TIME = 2.0;
+    // Critically damped loop of about 20 seconds, slow enough to keep the pitch change inaudible.
+    const double NATURAL_FREQUENCY = 0.05;
+    const double PROPORTIONAL_GAIN = 2.0 * NATURAL_FREQUENCY;
+    const double INTEGRAL_GAIN = NATURAL_FREQUENCY * NATURAL_FREQUENCY;
+    // Largest correction, the crystals of the devices are usually within 100 ppm.
+    const double MAX_CORRECTION = 0.001;
+}
+
+DriftController::DriftController() :
+    m_updatePeriod(0.0),
+    m_filterCoefficient(0.0),
+    m_elapsedTime(0.0),
+    m_settleTime(0.0),
+    m_integral(0.0),
+    m_isTargetSet(false),
+    m_target(0.0),
+    m_correction(0.0f),
+    m_level(0.0f),
+    m_targetLevel(-1.0f)
+{}
+
+void DriftController::reset(double updatePeriod)
+{
+    m_updatePeriod = updatePeriod > 0.0 ? updatePeriod : 0.0;
+    m_filterCoefficient = 1.0 - std::exp(-m_updatePeriod / LEVEL_TIME_CONSTANT);
+    m_elapsedTime = 0.0;
+    m_settleTime = 0.0;
+    m_integral = 0.0;
+    m_isTargetSet = false;
+    m_target = 0.0;
+    m_correction = 0.0f;
+    m_level = 0.0f;
+    m_targetLevel = -1.0f;
+}
+
+void DriftController::setTargetLevel(double level)
+{
+    m_target = level;
+    m_isTargetSet = true;
+    m_targetLevel = static_cast<float>(level);
+}
+
+void DriftController::settle()
+{
+    m_settleTime = 0.0;
+    m_isTargetSet = false;
+    m_targetLevel = -1.0f;
+}
+
+double DriftController::update(double level)
+{
+    // The filter start from the first level instead of 0.
+    double filtered = m_elapsedTime > 0.0 ? m_level + m_filterCoefficient * (level - m_level) : level;
+    m_level = static_cast<float>(filtered);
+    m_elapsedTime += m_updatePeriod;
+
+    // While settling, the correction is kept.
+    if (!m_isTargetSet)
+    {
+        m_settleTime += m_updatePeriod;
+        if (m_settleTime < SETTLE_TIME)
+            return m_correction;
+        setTargetLevel(filtered);
+    }
+
+    // The integral hold the drift, it is bounded so it does not wind up while the correction is clamped.
+    double error = filtered - m_target;
+    m_integral += error * m_updatePeriod;
+    m_integral = std::max(-MAX_CORRECTION / INTEGRAL_GAIN, std::min(MAX_CORRECTION / INTEGRAL_GAIN, m_integral));
+
+    double correction = PROPORTIONAL_GAIN * error + INTEGRAL_GAIN * m_integral;
+    correction = std::max(-MAX_CORRECTION, std::min(MAX_CORRECTION, correction));
+    m_correction = static_cast<float>(correction);
+    return correction;
+}
+
+double DriftController::correction() const
+{
+    return m_correction;
+}
+
+double DriftController::level() const
+{
+    return m_level;
+}
+
+double DriftController::targetLevel() const
+{
+    return m_targetLevel;
+}
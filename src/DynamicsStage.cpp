@@ -0,0 +1,350 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "DynamicsStage.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+// Below the threshold, the gate attenuate 3 dB for each dB, up to the range.
+#define DYNAMICS_GATE_SLOPE 3.0f
+#define DYNAMICS_GATE_RANGE 40.0f
+// Time constants in seconds.
+#define DYNAMICS_GATE_OPEN 0.001
+#define DYNAMICS_GATE_CLOSE 0.1
+#define DYNAMICS_COMPRESSOR_ATTACK 0.005
+#define DYNAMICS_COMPRESSOR_RELEASE 0.15
+#define DYNAMICS_LIMITER_RELEASE 0.05
+// Levels below are silence, about -200 dBFS.
+#define DYNAMICS_MIN_LEVEL 1e-10f
+// 20 * log10(2), dB per octave of amplitude.
+#define DYNAMICS_DB_PER_LOG2 6.02059991f
+
+/*
+Approximations of log2 and exp2 from the exponent of the float and a polynomial on the mantissa,
+the error is about 0.001 dB. The scalar and vectorized versions do the same operations.
+*/
+static float fastLog2(float x)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    float exponent = static_cast<float>(static_cast<int32_t>(bits >> 23) - 127);
+    bits = (bits & 0x007FFFFF) | 0x3F800000;
+    float m;
+    std::memcpy(&m, &bits, sizeof(m));
+    float p = -0.0784406762f;
+    p = p * m + 0.626032182f;
+    p = p * m - 2.07833517f;
+    p = p * m + 4.02921139f;
+    p = p * m - 2.49835315f;
+    return exponent + p;
+}
+
+// Only for x between -126 and 0.
+static float fastExp2(float x)
+{
+    float t = x + 127.0f;
+    int32_t i = static_cast<int32_t>(t);
+    float f = t - static_cast<float>(i);
+    float p = 0.0136703095f;
+    p = p * f + 0.0517449978f;
+    p = p * f + 0.241604357f;
+    p = p * f + 0.692972922f;
+    p = p * f + 1.00000349f;
+    uint32_t bits = static_cast<uint32_t>(i) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return scale * p;
+}
+
+static float smoothingCoefficient(double duration, int sampleRate)
+{
+    return static_cast<float>(std::exp(-1.0 / (duration * sampleRate)));
+}
+
+DynamicsStage::DynamicsStage(double gateThreshold, double compressorThreshold, double compressorRatio, double limiterCeiling, double lookahead) :
+    m_gateThreshold(static_cast<float>(gateThreshold)),
+    m_compressorThreshold(static_cast<float>(compressorThreshold)),
+    m_compressorSlope(static_cast<float>(1.0 - 1.0 / compressorRatio)),
+    m_limiterCeiling(static_cast<float>(limiterCeiling)),
+    m_lookaheadDuration(lookahead),
+    m_channelsCount(0),
+    m_maxFrames(0),
+    m_lookahead(0),
+    m_gateOpen(0.0f),
+    m_gateClose(0.0f),
+    m_compressorAttack(0.0f),
+    m_compressorRelease(0.0f),
+    m_limiterRelease(0.0f),
+    m_gateGain(0.0f),
+    m_compressorGain(0.0f),
+    m_holdIndex(0),
+    m_holdPrefix(0.0f),
+    m_limiterGain(0.0f),
+    m_averageIndex(0),
+    m_averageSum(0.0),
+    m_gateReduction(0.0f),
+    m_compressorReduction(0.0f),
+    m_limiterReduction(0.0f)
+{}
+
+const char* DynamicsStage::name() const
+{
+    return "dynamics";
+}
+
+bool DynamicsStage::init(int sampleRate, int channelsCount, unsigned long maxFrames)
+{
+    m_channelsCount = channelsCount;
+    m_maxFrames = maxFrames;
+    m_lookahead = static_cast<unsigned long>(m_lookaheadDuration * sampleRate / 1000.0 + 0.5);
+
+    m_gateOpen = smoothingCoefficient(DYNAMICS_GATE_OPEN, sampleRate);
+    m_gateClose = smoothingCoefficient(DYNAMICS_GATE_CLOSE, sampleRate);
+    m_compressorAttack = smoothingCoefficient(DYNAMICS_COMPRESSOR_ATTACK, sampleRate);
+    m_compressorRelease = smoothingCoefficient(DYNAMICS_COMPRESSOR_RELEASE, sampleRate);
+    m_limiterRelease = smoothingCoefficient(DYNAMICS_LIMITER_RELEASE, sampleRate);
+
+    m_levels.assign(maxFrames, 0.0f);
+    m_gains.assign(maxFrames, 0.0f);
+    m_delay.assign(static_cast<size_t>(channelsCount) * (m_lookahead + maxFrames), 0.0f);
+    m_gainDelay.assign(m_lookahead + maxFrames, 0.0f);
+    // The window of the minimum include the current frame and the lookahead.
+    m_holdBlock.assign(m_lookahead + 1, 0.0f);
+    m_holdSuffix.assign(m_lookahead + 2, 0.0f);
+    m_average.assign(std::max(m_lookahead, 1UL), 0.0f);
+
+    reset();
+    return true;
+}
+
+void DynamicsStage::reset()
+{
+    std::fill(m_delay.begin(), m_delay.end(), 0.0f);
+    std::fill(m_gainDelay.begin(), m_gainDelay.end(), 0.0f);
+    std::fill(m_holdBlock.begin(), m_holdBlock.end(), 0.0f);
+    std::fill(m_holdSuffix.begin(), m_holdSuffix.end(), 0.0f);
+    std::fill(m_average.begin(), m_average.end(), 0.0f);
+    m_holdIndex = 0;
+    m_holdPrefix = 0.0f;
+    m_limiterGain = 0.0f;
+    m_averageIndex = 0;
+    m_averageSum = 0.0;
+    m_gateGain = 0.0f;
+    m_compressorGain = 0.0f;
+    m_gateReduction.store(0.0f, std::memory_order_relaxed);
+    m_compressorReduction.store(0.0f, std::memory_order_relaxed);
+    m_limiterReduction.store(0.0f, std::memory_order_relaxed);
+}
+
+unsigned long DynamicsStage::latency() const
+{
+    return m_lookahead;
+}
+
+void DynamicsStage::process(float* const* planes, unsigned long frames)
+{
+    computeLevels(planes, frames);
+    computeGains(frames);
+
+    // The frames are delayed by the lookahead, their gains were delayed the same way.
+    size_t delaySize = m_lookahead + m_maxFrames;
+    for (int c = 0; c < m_channelsCount; c++)
+    {
+        float* delay = m_delay.data() + c * delaySize;
+        float* samples = planes[c];
+        std::memcpy(delay + m_lookahead, samples, frames * sizeof(float));
+        for (unsigned long t = 0; t < frames; t++)
+            samples[t] = delay[t] * m_gains[t];
+        std::memmove(delay, delay + frames, m_lookahead * sizeof(float));
+    }
+}
+
+void DynamicsStage::computeLevels(float* const* planes, unsigned long frames)
+{
+    // Peak of the channels, in dB.
+    unsigned long t = 0;
+#if defined(MLB_SSE2)
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128i mantissaMask = _mm_set1_epi32(0x007FFFFF);
+    const __m128i one = _mm_set1_epi32(0x3F800000);
+    const __m128i bias = _mm_set1_epi32(127);
+    for (; t + 4 <= frames; t += 4)
+    {
+        __m128 peak = _mm_set1_ps(DYNAMICS_MIN_LEVEL);
+        for (int c = 0; c < m_channelsCount; c++)
+            peak = _mm_max_ps(peak, _mm_and_ps(_mm_loadu_ps(planes[c] + t), signMask));
+
+        __m128i bits = _mm_castps_si128(peak);
+        __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), bias));
+        __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, mantissaMask), one));
+        __m128 p = _mm_set1_ps(-0.0784406762f);
+        p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(0.626032182f));
+        p = _mm_sub_ps(_mm_mul_ps(p, m), _mm_set1_ps(2.07833517f));
+        p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(4.02921139f));
+        p = _mm_sub_ps(_mm_mul_ps(p, m), _mm_set1_ps(2.49835315f));
+        _mm_storeu_ps(m_levels.data() + t, _mm_mul_ps(_mm_add_ps(exponent, p), _mm_set1_ps(DYNAMICS_DB_PER_LOG2)));
+    }
+#elif defined(MLB_NEON)
+    const uint32x4_t mantissaMask = vdupq_n_u32(0x007FFFFF);
+    const uint32x4_t one = vdupq_n_u32(0x3F800000);
+    const int32x4_t bias = vdupq_n_s32(127);
+    for (; t + 4 <= frames; t += 4)
+    {
+        float32x4_t peak = vdupq_n_f32(DYNAMICS_MIN_LEVEL);
+        for (int c = 0; c < m_channelsCount; c++)
+            peak = vmaxq_f32(peak, vabsq_f32(vld1q_f32(planes[c] + t)));
+
+        uint32x4_t bits = vreinterpretq_u32_f32(peak);
+        float32x4_t exponent = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), bias));
+        float32x4_t m = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, mantissaMask), one));
+        float32x4_t p = vdupq_n_f32(-0.0784406762f);
+        p = vaddq_f32(vmulq_f32(p, m), vdupq_n_f32(0.626032182f));
+        p = vsubq_f32(vmulq_f32(p, m), vdupq_n_f32(2.07833517f));
+        p = vaddq_f32(vmulq_f32(p, m), vdupq_n_f32(4.02921139f));
+        p = vsubq_f32(vmulq_f32(p, m), vdupq_n_f32(2.49835315f));
+        vst1q_f32(m_levels.data() + t, vmulq_f32(vaddq_f32(exponent, p), vdupq_n_f32(DYNAMICS_DB_PER_LOG2)));
+    }
+#endif
+    for (; t < frames; t++)
+    {
+        float peak = DYNAMICS_MIN_LEVEL;
+        for (int c = 0; c < m_channelsCount; c++)
+            peak = std::max(peak, std::fabs(planes[c][t]));
+        m_levels[t] = fastLog2(peak) * DYNAMICS_DB_PER_LOG2;
+    }
+}
+
+void DynamicsStage::computeGains(unsigned long frames)
+{
+    // Followers of the gate and the compressor, in dB.
+    // With y the gain and x the target, y' = x + k * (y - x) where k is the attack coefficient when the gain
+    // goes down and the release coefficient when it goes up. The fastest direction give the lowest gain
+    // going down and the highest gain going up, so the right coefficient is picked with min or max.
+    float gateGain = m_gateGain;
+    float compressorGain = m_compressorGain;
+    float limiterReduction = 0.0f;
+    float* gainDelay = m_gainDelay.data() + m_lookahead;
+    float* holdBlock = m_holdBlock.data();
+    float* holdSuffix = m_holdSuffix.data();
+    unsigned long window = m_lookahead + 1;
+    float averageScale = 1.0f / m_average.size();
+
+    for (unsigned long t = 0; t < frames; t++)
+    {
+        float level = m_levels[t];
+
+        float gateTarget = std::max(std::min((level - m_gateThreshold) * DYNAMICS_GATE_SLOPE, 0.0f), -DYNAMICS_GATE_RANGE);
+        gateGain = std::max(gateTarget + m_gateOpen * (gateGain - gateTarget), gateTarget + m_gateClose * (gateGain - gateTarget));
+
+        float compressorTarget = std::min((m_compressorThreshold - level) * m_compressorSlope, 0.0f);
+        compressorGain = std::min(compressorTarget + m_compressorAttack * (compressorGain - compressorTarget), 
+            compressorTarget + m_compressorRelease * (compressorGain - compressorTarget));
+
+        float expanderGain = gateGain + compressorGain;
+        gainDelay[t] = expanderGain;
+
+        // Gain needed by the limiter for this frame after the gate and the compressor.
+        float limiterTarget = std::min(m_limiterCeiling - (level + expanderGain), 0.0f);
+
+        // Minimum over the lookahead: the prefix of the current block and the suffix of the previous block.
+        holdBlock[m_holdIndex] = limiterTarget;
+        m_holdPrefix = std::min(m_holdPrefix, limiterTarget);
+        float hold = std::min(m_holdPrefix, holdSuffix[m_holdIndex + 1]);
+        if (++m_holdIndex == window)
+        {
+            for (unsigned long i = window; i-- > 0;)
+                holdSuffix[i] = std::min(holdSuffix[i + 1], holdBlock[i]);
+            m_holdIndex = 0;
+            m_holdPrefix = 0.0f;
+        }
+
+        // Instant attack and smooth release, then averaged over the lookahead: the gain reach the minimum
+        // when the loudest frame of the window leave the delay line, without going under it earlier.
+        m_limiterGain = std::min(hold, hold + m_limiterRelease * (m_limiterGain - hold));
+        m_averageSum += m_limiterGain - m_average[m_averageIndex];
+        m_average[m_averageIndex] = m_limiterGain;
+        if (++m_averageIndex == m_average.size())
+            m_averageIndex = 0;
+        float limiterGain = static_cast<float>(m_averageSum) * averageScale;
+        limiterReduction = std::min(limiterReduction, limiterGain);
+
+        m_gains[t] = limiterGain;
+    }
+    m_gateGain = gateGain;
+    m_compressorGain = compressorGain;
+
+    // Gain of the delayed frames, then back to linear.
+    gainDelay = m_gainDelay.data();
+    unsigned long t = 0;
+#if defined(MLB_SSE2)
+    const __m128 scale = _mm_set1_ps(1.0f / DYNAMICS_DB_PER_LOG2);
+    for (; t + 4 <= frames; t += 4)
+    {
+        __m128 x = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(gainDelay + t), _mm_loadu_ps(m_gains.data() + t)), scale);
+        x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-126.0f)), _mm_setzero_ps());
+        __m128 u = _mm_add_ps(x, _mm_set1_ps(127.0f));
+        __m128i i = _mm_cvttps_epi32(u);
+        __m128 f = _mm_sub_ps(u, _mm_cvtepi32_ps(i));
+        __m128 p = _mm_set1_ps(0.0136703095f);
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.0517449978f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.241604357f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.692972922f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.00000349f));
+        _mm_storeu_ps(m_gains.data() + t, _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(i, 23)), p));
+    }
+#elif defined(MLB_NEON)
+    const float32x4_t scale = vdupq_n_f32(1.0f / DYNAMICS_DB_PER_LOG2);
+    for (; t + 4 <= frames; t += 4)
+    {
+        float32x4_t x = vmulq_f32(vaddq_f32(vld1q_f32(gainDelay + t), vld1q_f32(m_gains.data() + t)), scale);
+        x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-126.0f)), vdupq_n_f32(0.0f));
+        float32x4_t u = vaddq_f32(x, vdupq_n_f32(127.0f));
+        int32x4_t i = vcvtq_s32_f32(u);
+        float32x4_t f = vsubq_f32(u, vcvtq_f32_s32(i));
+        float32x4_t p = vdupq_n_f32(0.0136703095f);
+        p = vaddq_f32(vmulq_f32(p, f), vdupq_n_f32(0.0517449978f));
+        p = vaddq_f32(vmulq_f32(p, f), vdupq_n_f32(0.241604357f));
+        p = vaddq_f32(vmulq_f32(p, f), vdupq_n_f32(0.692972922f));
+        p = vaddq_f32(vmulq_f32(p, f), vdupq_n_f32(1.00000349f));
+        vst1q_f32(m_gains.data() + t, vmulq_f32(vreinterpretq_f32_s32(vshlq_n_s32(i, 23)), p));
+    }
+#endif
+    for (; t < frames; t++)
+    {
+        float x = (gainDelay[t] + m_gains[t]) * (1.0f / DYNAMICS_DB_PER_LOG2);
+        m_gains[t] = fastExp2(std::min(std::max(x, -126.0f), 0.0f));
+    }
+    std::memmove(m_gainDelay.data(), m_gainDelay.data() + frames, m_lookahead * sizeof(float));
+
+    m_gateReduction.store(0.0f - m_gateGain, std::memory_order_relaxed);
+    m_compressorReduction.store(0.0f - m_compressorGain, std::memory_order_relaxed);
+    m_limiterReduction.store(0.0f - limiterReduction, std::memory_order_relaxed);
+}
+
+std::string DynamicsStage::report() const
+{
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(1) << "gain reduction: gate " << m_gateReduction.load(std::memory_order_relaxed)
+        << " dB, compressor " << m_compressorReduction.load(std::memory_order_relaxed)
+        << " dB, limiter " << m_limiterReduction.load(std::memory_order_relaxed) << " dB";
+    return stream.str();
+}
@@ -0,0 +1,186 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "EqualizerStage.h"
+#include "Simd.h"
+#include <algorithm>
+
+// s1 and s2 of each lane.
+#define EQUALIZER_STATE_SIZE (2 * LANES)
+
+EqualizerStage::EqualizerStage(const std::vector<BiquadBand>& bands) :
+    m_bands(bands),
+    m_channelsCount(0)
+{}
+
+const char* EqualizerStage::name() const
+{
+    return "eq";
+}
+
+bool EqualizerStage::init(int sampleRate, int channelsCount, unsigned long maxFrames)
+{
+    m_channelsCount = channelsCount;
+
+    // The bands are grouped by LANES, the last group is completed with pass-through biquads.
+    size_t groupsCount = (m_bands.size() + LANES - 1) / LANES;
+    m_groups.assign(groupsCount, BandGroup());
+    for (size_t i = 0; i < groupsCount * LANES; i++)
+    {
+        BiquadCoefficients coefficients = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+        if (i < m_bands.size() && !designBiquad(m_bands[i], sampleRate, &coefficients))
+            return false;
+
+        BandGroup& group = m_groups[i / LANES];
+        int lane = static_cast<int>(i % LANES);
+        group.b0[lane] = coefficients.b0;
+        group.b1[lane] = coefficients.b1;
+        group.b2[lane] = coefficients.b2;
+        group.a1[lane] = coefficients.a1;
+        group.a2[lane] = coefficients.a2;
+        group.count = static_cast<int>(std::min(m_bands.size() - (i - lane), static_cast<size_t>(LANES)));
+    }
+
+    m_state.assign(static_cast<size_t>(channelsCount) * groupsCount * EQUALIZER_STATE_SIZE, 0.0f);
+    return true;
+}
+
+void EqualizerStage::reset()
+{
+    for (float& value : m_state)
+        value = 0.0f;
+}
+
+size_t EqualizerStage::filtersCount() const
+{
+    return m_bands.size();
+}
+
+void EqualizerStage::process(float* const* planes, unsigned long frames)
+{
+    for (int c = 0; c < m_channelsCount; c++)
+        processChannel(c, planes[c], frames);
+}
+
+bool EqualizerStage::isChannelIndependent() const
+{
+    return true;
+}
+
+void EqualizerStage::processChannel(int channel, float* plane, unsigned long frames)
+{
+    // Each channel has its own state, the channels can be filtered concurrently.
+    for (size_t g = 0; g < m_groups.size(); g++)
+    {
+        float* state = m_state.data() + (channel * m_groups.size() + g) * EQUALIZER_STATE_SIZE;
+        processGroup(m_groups[g], state, plane, frames);
+    }
+}
+
+float EqualizerStage::tick(const BandGroup& group, float* state, int lane, float input)
+{
+    // Transposed direct form II, the operations are in the same order as the vectorized code.
+    // The file is built without contraction (-ffp-contract=off), a fused multiply-add would round differently.
+    float* s1 = state;
+    float* s2 = state + LANES;
+    float output = group.b0[lane] * input + s1[lane];
+    s1[lane] = (group.b1[lane] * input - group.a1[lane] * output) + s2[lane];
+    s2[lane] = group.b2[lane] * input - group.a2[lane] * output;
+    return output;
+}
+
+void EqualizerStage::processGroup(const BandGroup& group, float* state, float* samples, unsigned long frames) const
+{
+#if defined(MLB_SSE2) || defined(MLB_NEON)
+    if (frames >= LANES)
+    {
+        // Filling the pipeline: lane k receive band k of sample LANES - 2 - k.
+        float pipeline[LANES] = {};
+        for (int j = 0; j < LANES - 1; j++)
+        {
+            float value = samples[j];
+            for (int lane = 0; lane < LANES - 1 - j; lane++)
+                value = tick(group, state, lane, value);
+            pipeline[LANES - 2 - j] = value;
+        }
+
+        // Each step shift the outputs to the next lane and feed a new sample to the first one,
+        // the last lane output the sample LANES - 1 steps behind.
+#if defined(MLB_SSE2)
+        const __m128 b0 = _mm_loadu_ps(group.b0);
+        const __m128 b1 = _mm_loadu_ps(group.b1);
+        const __m128 b2 = _mm_loadu_ps(group.b2);
+        const __m128 a1 = _mm_loadu_ps(group.a1);
+        const __m128 a2 = _mm_loadu_ps(group.a2);
+        __m128 s1 = _mm_loadu_ps(state);
+        __m128 s2 = _mm_loadu_ps(state + LANES);
+        __m128 y = _mm_loadu_ps(pipeline);
+        for (unsigned long t = LANES - 1; t < frames; t++)
+        {
+            __m128 x = _mm_move_ss(_mm_shuffle_ps(y, y, _MM_SHUFFLE(2, 1, 0, 0)), _mm_set_ss(samples[t]));
+            y = _mm_add_ps(_mm_mul_ps(b0, x), s1);
+            s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), s2);
+            s2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+            samples[t - (LANES - 1)] = _mm_cvtss_f32(_mm_shuffle_ps(y, y, _MM_SHUFFLE(3, 3, 3, 3)));
+        }
+        _mm_storeu_ps(state, s1);
+        _mm_storeu_ps(state + LANES, s2);
+        _mm_storeu_ps(pipeline, y);
+#elif defined(MLB_NEON)
+        const float32x4_t b0 = vld1q_f32(group.b0);
+        const float32x4_t b1 = vld1q_f32(group.b1);
+        const float32x4_t b2 = vld1q_f32(group.b2);
+        const float32x4_t a1 = vld1q_f32(group.a1);
+        const float32x4_t a2 = vld1q_f32(group.a2);
+        float32x4_t s1 = vld1q_f32(state);
+        float32x4_t s2 = vld1q_f32(state + LANES);
+        float32x4_t y = vld1q_f32(pipeline);
+        for (unsigned long t = LANES - 1; t < frames; t++)
+        {
+            float32x4_t x = vextq_f32(vdupq_n_f32(samples[t]), y, 3);
+            y = vaddq_f32(vmulq_f32(b0, x), s1);
+            s1 = vaddq_f32(vsubq_f32(vmulq_f32(b1, x), vmulq_f32(a1, y)), s2);
+            s2 = vsubq_f32(vmulq_f32(b2, x), vmulq_f32(a2, y));
+            samples[t - (LANES - 1)] = vgetq_lane_f32(y, 3);
+        }
+        vst1q_f32(state, s1);
+        vst1q_f32(state + LANES, s2);
+        vst1q_f32(pipeline, y);
+#endif
+
+        // Emptying the pipeline: the last samples go through the remaining bands.
+        for (int j = 0; j < LANES - 1; j++)
+        {
+            float value = pipeline[LANES - 2 - j];
+            for (int lane = LANES - 1 - j; lane < LANES; lane++)
+                value = tick(group, state, lane, value);
+            samples[frames - (LANES - 1) + j] = value;
+        }
+        return;
+    }
+#endif
+
+    // Scalar path, the pass-through biquads are skipped.
+    for (unsigned long t = 0; t < frames; t++)
+    {
+        float value = samples[t];
+        for (int lane = 0; lane < group.count; lane++)
+            value = tick(group, state, lane, value);
+        samples[t] = value;
+    }
+}
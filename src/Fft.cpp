@@ -0,0 +1,132 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "Fft.h"
+#include <cmath>
+#include <utility>
+
+RealFft::RealFft() :
+    m_size(0)
+{}
+
+bool RealFft::init(size_t size)
+{
+    if (size < 4 || (size & (size - 1)) != 0)
+        return false;
+
+    const double pi = 3.14159265358979323846;
+    size_t half = size / 2;
+    m_size = size;
+    m_real.assign(half, 0.0f);
+    m_imaginary.assign(half, 0.0f);
+
+    // exp(-2 pi i k / half) for the butterflies.
+    m_cos.resize(half / 2);
+    m_sin.resize(half / 2);
+    for (size_t k = 0; k < half / 2; k++)
+    {
+        m_cos[k] = static_cast<float>(std::cos(2.0 * pi * k / half));
+        m_sin[k] = static_cast<float>(-std::sin(2.0 * pi * k / half));
+    }
+
+    // exp(-2 pi i k / size) to rebuild the spectrum of the real signal.
+    m_splitCos.resize(half + 1);
+    m_splitSin.resize(half + 1);
+    for (size_t k = 0; k <= half; k++)
+    {
+        m_splitCos[k] = static_cast<float>(std::cos(2.0 * pi * k / size));
+        m_splitSin[k] = static_cast<float>(-std::sin(2.0 * pi * k / size));
+    }
+
+    // Bit reversal permutation of the complex transform.
+    int bits = 0;
+    while ((static_cast<size_t>(1) << bits) < half)
+        bits++;
+    m_reversed.resize(half);
+    for (size_t i = 0; i < half; i++)
+    {
+        uint32_t reversed = 0;
+        for (int b = 0; b < bits; b++)
+        {
+            if (i & (static_cast<size_t>(1) << b))
+                reversed |= 1u << (bits - 1 - b);
+        }
+        m_reversed[i] = reversed;
+    }
+
+    return true;
+}
+
+size_t RealFft::size() const
+{
+    return m_size;
+}
+
+void RealFft::powerSpectrum(const float* input, float* power)
+{
+    size_t half = m_size / 2;
+    for (size_t i = 0; i < half; i++)
+    {
+        m_real[m_reversed[i]] = input[2 * i];
+        m_imaginary[m_reversed[i]] = input[2 * i + 1];
+    }
+
+    transform();
+
+    // X[k] = E[k] + W^k O[k], with E and O the spectrums of the even and odd samples:
+    // E[k] = (Z[k] + conj(Z[half - k])) / 2 and O[k] = (Z[k] - conj(Z[half - k])) / 2i.
+    for (size_t k = 0; k <= half; k++)
+    {
+        size_t i = k % half;
+        size_t j = (half - k) % half;
+        float evenReal = 0.5f * (m_real[i] + m_real[j]);
+        float evenImaginary = 0.5f * (m_imaginary[i] - m_imaginary[j]);
+        float oddReal = 0.5f * (m_imaginary[i] + m_imaginary[j]);
+        float oddImaginary = -0.5f * (m_real[i] - m_real[j]);
+        float real = evenReal + m_splitCos[k] * oddReal - m_splitSin[k] * oddImaginary;
+        float imaginary = evenImaginary + m_splitCos[k] * oddImaginary + m_splitSin[k] * oddReal;
+        power[k] = real * real + imaginary * imaginary;
+    }
+}
+
+void RealFft::transform()
+{
+    // Iterative radix-2 decimation in time, the input is already in bit reversed order.
+    size_t half = m_size / 2;
+    for (size_t length = 2; length <= half; length <<= 1)
+    {
+        size_t middle = length / 2;
+        size_t step = half / length;
+        for (size_t begin = 0; begin < half; begin += length)
+        {
+            for (size_t k = 0; k < middle; k++)
+            {
+                float wReal = m_cos[k * step];
+                float wImaginary = m_sin[k * step];
+                size_t a = begin + k;
+                size_t b = a + middle;
+                float real = wReal * m_real[b] - wImaginary * m_imaginary[b];
+                float imaginary = wReal * m_imaginary[b] + wImaginary * m_real[b];
+                m_real[b] = m_real[a] - real;
+                m_imaginary[b] = m_imaginary[a] - imaginary;
+                m_real[a] += real;
+                m_imaginary[a] += imaginary;
+            }
+        }
+    }
+}
@@ -0,0 +1,265 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "FileBackend.h"
+#include "LatencyCeiling.h"
+#include "Resampler.h"
+#include "Tracer.h"
+#include <chrono>
+#include <cstring>
+
+// Periods of silence in the simulated playback device before the first one.
+#define FILE_PLAYBACK_PREFILL 2
+
+FileBackend::FileBackend() :
+    m_isWriting(false),
+    m_isPlayingContinue(false),
+    m_periodsCount(0),
+    m_framesCount(0),
+    m_elapsedTime(0.0),
+    m_processingTime(0.0),
+    m_maxProcessingTime(0.0),
+    m_playbackLevel(0.0),
+    m_playbackStartLevel(0.0)
+{}
+
+FileBackend::~FileBackend()
+{
+    deinit();
+}
+
+bool FileBackend::init(const StreamConfig& config)
+{
+    deinit();
+    m_config = config;
+
+    // Opening the file used has the microphone.
+    if (m_config.inputFile.empty())
+    {
+        m_strError = "The file API need an input file.";
+        return false;
+    }
+    if (!m_reader.open(m_config.inputFile))
+    {
+        m_strError = m_reader.error();
+        return false;
+    }
+    if (m_reader.channelsCount() != m_config.channelsCount)
+    {
+        m_strError = "The input file must have " + std::to_string(m_config.channelsCount) + " channel(s).";
+        deinit();
+        return false;
+    }
+
+    if (!initResampler(m_reader.sampleFormat(), m_config.framesPerBuffer) ||
+        !initLatencyCeiling(m_reader.sampleFormat(), m_config.framesPerBuffer))
+    {
+        deinit();
+        return false;
+    }
+
+    // The output file is optional, the frames are discarded without it.
+    m_isWriting = !m_config.outputFile.empty();
+    if (m_isWriting &&
+        !m_writer.open(m_config.outputFile, m_reader.channelsCount(), outputSampleRate(), m_reader.sampleFormat()))
+    {
+        m_strError = m_writer.error();
+        deinit();
+        return false;
+    }
+
+    size_t periodSize = m_config.framesPerBuffer * m_config.channelsCount * sampleFormatSize(m_reader.sampleFormat());
+    m_inputData.assign(periodSize, 0);
+    m_outputData.assign(periodSize, 0);
+    if (m_resampler)
+        m_resampledData.assign(m_resampler->maxOutputFrames() * m_config.channelsCount * sampleFormatSize(m_reader.sampleFormat()), 0);
+    return true;
+}
+
+void FileBackend::deinit()
+{
+    stop();
+
+    m_reader.close();
+    m_writer.close();
+    m_isWriting = false;
+    m_inputData.clear();
+    m_outputData.clear();
+    m_resampledData.clear();
+    deinitResampler();
+    deinitLatencyCeiling();
+}
+
+bool FileBackend::play()
+{
+    if (m_inputData.empty())
+    {
+        m_strError = "The stream is not ready.";
+        return false;
+    }
+
+    m_periodsCount = 0;
+    m_framesCount = 0;
+    m_elapsedTime = 0.0;
+    m_processingTime = 0.0;
+    m_maxProcessingTime = 0.0;
+    m_playbackLevel = static_cast<double>(resampledFrames(m_config.framesPerBuffer)) * FILE_PLAYBACK_PREFILL;
+    m_playbackStartLevel = m_playbackLevel;
+
+    m_isPlayingContinue = true;
+    m_tStream = std::thread(&FileBackend::streamLoop, this);
+    return true;
+}
+
+void FileBackend::stop()
+{
+    m_isPlayingContinue = false;
+    if (m_tStream.joinable())
+        m_tStream.join();
+}
+
+bool FileBackend::isPlayingContinue() const
+{
+    return m_isPlayingContinue;
+}
+
+void FileBackend::streamLoop()
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const size_t frameSize = m_config.channelsCount * sampleFormatSize(m_reader.sampleFormat());
+    const std::chrono::duration<double> periodDuration(
+        static_cast<double>(m_config.framesPerBuffer) / m_reader.sampleRate());
+
+    Tracer::nameThread("file");
+
+    Clock::time_point start = Clock::now();
+    Clock::time_point nextPeriod = start;
+
+    while (m_isPlayingContinue)
+    {
+        size_t frames = m_reader.read(m_inputData.data(), m_config.framesPerBuffer);
+        if (frames == 0)
+            break;
+        // The last period is completed with silence.
+        if (frames < m_config.framesPerBuffer)
+            memset(m_inputData.data() + frames * frameSize, 0, (m_config.framesPerBuffer - frames) * frameSize);
+
+        PeriodTime processStart = periodBegin();
+        process(m_inputData.data(), m_outputData.data(), m_config.framesPerBuffer);
+        double processingTime = std::chrono::duration<double>(Clock::now() - processStart).count();
+        periodEnd(processStart, m_config.framesPerBuffer);
+
+        m_processingTime += processingTime;
+        if (processingTime > m_maxProcessingTime)
+            m_maxProcessingTime = processingTime;
+        m_periodsCount++;
+        m_framesCount += frames;
+
+        // The simulated playback device is the only queue of the file API.
+        if (m_config.simulatedDrift != 0.0)
+            frames = limitLatency(m_outputData.data(), frames, m_playbackLevel / outputSampleRate());
+
+        // The output file is at the output rate, the silence completing the last period is not written.
+        const char* output = m_outputData.data();
+        if (m_resampler)
+        {
+            frames = resample(m_outputData.data(), frames, m_resampledData.data());
+            output = m_resampledData.data();
+        }
+        if (m_isWriting && !m_writer.write(output, frames))
+        {
+            m_strError = "Failed to write the output file.";
+            break;
+        }
+        if (m_config.simulatedDrift != 0.0)
+            simulatePlayback(frames);
+
+        // Throttling to the speed of a real device.
+        if (m_config.isFileRealtime)
+        {
+            nextPeriod += std::chrono::duration_cast<Clock::duration>(periodDuration);
+            std::this_thread::sleep_until(nextPeriod);
+        }
+    }
+
+    m_elapsedTime = std::chrono::duration<double>(Clock::now() - start).count();
+    m_isPlayingContinue = false;
+}
+
+void FileBackend::simulatePlayback(unsigned long frames)
+{
+    // The clock of the simulated device is off by the drift, it play that many frames per period of the capture.
+    double periodFrames = static_cast<double>(m_config.framesPerBuffer) * outputSampleRate() / sampleRate();
+    m_playbackLevel += frames;
+    m_playbackLevel -= periodFrames * (1.0 + m_config.simulatedDrift * 1e-6);
+    if (m_playbackLevel < 0.0)
+    {
+        // The device played silence.
+        m_counters.outputUnderflows.fetch_add(1, std::memory_order_relaxed);
+        m_playbackLevel = 0.0;
+    }
+
+    double level = m_playbackLevel / outputSampleRate();
+    m_counters.outputLatency.store(static_cast<long>(level * 1e6), std::memory_order_relaxed);
+    compensateDrift(level);
+}
+
+SampleFormat FileBackend::sampleFormat() const
+{
+    return m_reader.sampleFormat();
+}
+
+int FileBackend::sampleRate() const
+{
+    return m_reader.sampleRate() > 0 ? m_reader.sampleRate() : m_config.sampleRate;
+}
+
+bool FileBackend::isResamplingSupported() const
+{
+    return true;
+}
+
+bool FileBackend::isLatencyCeilingSupported() const
+{
+    return m_config.simulatedDrift != 0.0;
+}
+
+void FileBackend::printSummary(std::ostream& stream) const
+{
+    if (m_periodsCount == 0)
+        return;
+
+    double audioDuration = static_cast<double>(m_framesCount) / sampleRate();
+    double periodDuration = static_cast<double>(m_config.framesPerBuffer) / sampleRate();
+    double averageTime = m_processingTime / m_periodsCount;
+
+    stream << "Processed " << m_framesCount << " frames (" << m_periodsCount << " periods, " 
+        << audioDuration << " s of audio) in " << m_elapsedTime << " s";
+    if (m_elapsedTime > 0.0)
+        stream << ", " << audioDuration / m_elapsedTime << "x realtime";
+    stream << "." << std::endl;
+    stream << "Processing time per period: average " << averageTime * 1e6 << " us, maximum " 
+        << m_maxProcessingTime * 1e6 << " us (" << averageTime / periodDuration * 100.0 
+        << "% of the " << periodDuration * 1e6 << " us period)." << std::endl;
+    if (m_config.simulatedDrift != 0.0)
+        stream << "Simulated playback clock: " << std::showpos << m_config.simulatedDrift << std::noshowpos << " ppm, playback buffer: " 
+            << m_playbackStartLevel * 1000.0 / outputSampleRate() << " ms at the start, " 
+            << m_playbackLevel * 1000.0 / outputSampleRate() << " ms at the end, " 
+            << m_counters.outputUnderflows.load(std::memory_order_relaxed) << " underflows." << std::endl;
+}
@@ -0,0 +1,180 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "FrameSplicer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // Peak of a silent block (-45 dBFS) and length of a block.
+    const float SILENCE_THRESHOLD = 0.0056f;
+    const double BLOCK_TIME = 0.001;
+    // Crossfades of a cut in the silence and in the signal.
+    const double SILENT_FADE_TIME = 0.0005;
+    const double AUDIBLE_FADE_TIME = 0.005;
+}
+
+FrameSplicer::FrameSplicer() :
+    m_channelsCount(0),
+    m_sampleRate(0),
+    m_maxFrames(0),
+    m_blockFrames(1),
+    m_frames(0)
+{}
+
+bool FrameSplicer::init(SampleFormat format, int channelsCount, int sampleRate, unsigned long maxFrames)
+{
+    if (sampleRate <= 0 || maxFrames == 0 || !m_converter.init(format, channelsCount))
+        return false;
+
+    m_channelsCount = channelsCount;
+    m_sampleRate = sampleRate;
+    m_maxFrames = maxFrames;
+    m_blockFrames = std::max(16UL, static_cast<unsigned long>(sampleRate * BLOCK_TIME));
+
+    m_buffer.assign(static_cast<size_t>(channelsCount) * maxFrames, 0.0f);
+    m_planes.resize(channelsCount);
+    for (int c = 0; c < channelsCount; c++)
+        m_planes[c] = m_buffer.data() + c * maxFrames;
+    m_blockPeaks.assign((maxFrames + m_blockFrames - 1) / m_blockFrames, 0.0f);
+    m_frames = 0;
+    return true;
+}
+
+void FrameSplicer::load(const void* data, unsigned long frames)
+{
+    m_frames = std::min(frames, m_maxFrames);
+    m_converter.deinterleave(data, m_planes.data(), m_frames);
+    measureBlocks();
+}
+
+unsigned long FrameSplicer::cutSilence(unsigned long drop)
+{
+    // The cut stay inside the silence, with the crossfade.
+    unsigned long start = 0;
+    unsigned long silence = findSilence(&start);
+    unsigned long fade = std::max(1UL, static_cast<unsigned long>(m_sampleRate * SILENT_FADE_TIME));
+    if (drop == 0 || silence <= 2 * fade)
+        return 0;
+
+    drop = std::min(drop, silence - fade);
+    splice(start, drop, fade);
+    return drop;
+}
+
+unsigned long FrameSplicer::cutQuietest(unsigned long drop)
+{
+    unsigned long fade = std::max(1UL, std::min(static_cast<unsigned long>(m_sampleRate * AUDIBLE_FADE_TIME), m_frames / 4));
+    drop = std::min(drop, m_frames / 2);
+    if (drop == 0)
+        return 0;
+
+    splice(findQuietest(drop + fade), drop, fade);
+    return drop;
+}
+
+unsigned long FrameSplicer::store(void* data)
+{
+    m_converter.interleave(m_planes.data(), data, m_frames);
+    return m_frames;
+}
+
+void FrameSplicer::measureBlocks()
+{
+    size_t blocksCount = (m_frames + m_blockFrames - 1) / m_blockFrames;
+    for (size_t b = 0; b < blocksCount; b++)
+    {
+        unsigned long begin = b * m_blockFrames;
+        unsigned long end = std::min(m_frames, begin + m_blockFrames);
+        float peak = 0.0f;
+        for (int c = 0; c < m_channelsCount; c++)
+        {
+            const float* plane = m_planes[c];
+            for (unsigned long i = begin; i < end; i++)
+                peak = std::max(peak, std::fabs(plane[i]));
+        }
+        m_blockPeaks[b] = peak;
+    }
+}
+
+unsigned long FrameSplicer::findSilence(unsigned long* start) const
+{
+    size_t blocksCount = (m_frames + m_blockFrames - 1) / m_blockFrames;
+    unsigned long longest = 0;
+    size_t runStart = 0;
+    for (size_t b = 0; b <= blocksCount; b++)
+    {
+        if (b < blocksCount && m_blockPeaks[b] < SILENCE_THRESHOLD)
+            continue;
+
+        // End of a run of silent blocks.
+        unsigned long begin = runStart * m_blockFrames;
+        unsigned long end = std::min(m_frames, static_cast<unsigned long>(b * m_blockFrames));
+        if (end > begin && end - begin > longest)
+        {
+            longest = end - begin;
+            *start = begin;
+        }
+        runStart = b + 1;
+    }
+    return longest;
+}
+
+unsigned long FrameSplicer::findQuietest(unsigned long length) const
+{
+    // The cut start at a block boundary, the crossfade and the removed frames must fit in the period.
+    // A cut is as loud as the loudest block it crossfade or remove.
+    unsigned long position = 0;
+    float quietest = -1.0f;
+    for (unsigned long begin = 0; begin + length <= m_frames; begin += m_blockFrames)
+    {
+        size_t lastBlock = (begin + length - 1) / m_blockFrames;
+        float peak = 0.0f;
+        for (size_t b = begin / m_blockFrames; b <= lastBlock; b++)
+            peak = std::max(peak, m_blockPeaks[b]);
+        if (quietest < 0.0f || peak < quietest)
+        {
+            quietest = peak;
+            position = begin;
+        }
+    }
+    return position;
+}
+
+void FrameSplicer::splice(unsigned long position, unsigned long drop, unsigned long fade)
+{
+    const double pi = 3.14159265358979323846;
+    for (int c = 0; c < m_channelsCount; c++)
+    {
+        float* plane = m_planes[c];
+        for (unsigned long i = 0; i < fade; i++)
+        {
+            float weight = static_cast<float>(0.5 - 0.5 * std::cos(pi * (i + 0.5) / fade));
+            plane[position + i] += weight * (plane[position + drop + i] - plane[position + i]);
+        }
+        unsigned long tail = position + fade + drop;
+        if (tail < m_frames)
+            std::memmove(plane + position + fade, plane + tail, (m_frames - tail) * sizeof(float));
+    }
+
+    // The blocks moved, a next cut measure them again.
+    m_frames -= drop;
+    measureBlocks();
+}
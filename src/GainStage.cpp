@@ -0,0 +1,53 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "GainStage.h"
+#include <cmath>
+
+GainStage::GainStage(double gain) :
+    m_gain(static_cast<float>(std::pow(10.0, gain / 20.0))),
+    m_channelsCount(0)
+{}
+
+const char* GainStage::name() const
+{
+    return "gain";
+}
+
+bool GainStage::init(int sampleRate, int channelsCount, unsigned long maxFrames)
+{
+    m_channelsCount = channelsCount;
+    return true;
+}
+
+void GainStage::process(float* const* planes, unsigned long frames)
+{
+    for (int c = 0; c < m_channelsCount; c++)
+        processChannel(c, planes[c], frames);
+}
+
+bool GainStage::isChannelIndependent() const
+{
+    return true;
+}
+
+void GainStage::processChannel(int channel, float* plane, unsigned long frames)
+{
+    for (unsigned long i = 0; i < frames; i++)
+        plane[i] *= m_gain;
+}
@@ -0,0 +1,444 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "HowlStage.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+// Duration of the analysis window, the FFT size is the next power of two.
+#define HOWL_WINDOW_DURATION 0.02
+// Analyses per window.
+#define HOWL_OVERLAP 4
+// Range of the searched frequencies in Hz.
+#define HOWL_MIN_FREQUENCY 80.0
+#define HOWL_MAX_FREQUENCY 16000.0
+// Quietest peak considered, in dBFS.
+#define HOWL_MIN_LEVEL -50.0
+// A howl stand this many dB above the mean power of the spectrum and above the bins 3 to 5 bins away.
+#define HOWL_PAPR 12.0
+#define HOWL_PNPR 15.0
+#define HOWL_NEIGHBOUR_FIRST 3
+#define HOWL_NEIGHBOUR_LAST 5
+// Peaks followed and peaks considered at each analysis.
+#define HOWL_TRACKS 8
+#define HOWL_CANDIDATES 4
+// Analyses before a growing peak is a howl (about 40 ms) and growth required in dB.
+#define HOWL_PERSISTENCE 8
+#define HOWL_GROWTH 6.0
+// A steady peak is a howl after this many seconds.
+#define HOWL_SUSTAINED 1.0
+// A notched howl that decay less than this many dB during the persistence get a deeper notch.
+#define HOWL_DECAY 3.0
+// Depth added at each detection and speed of the depth changes in dB per analysis.
+#define HOWL_STEP 6.0
+#define HOWL_ATTACK 3.0
+#define HOWL_RELEASE_RATE 0.1
+#define HOWL_NOTCH_Q 10.0
+
+HowlStage::HowlStage(int notchesCount, double depth, double release) :
+    m_notchesCount(std::max(1, std::min(notchesCount, static_cast<int>(MAX_NOTCHES)))),
+    m_maxDepth(depth),
+    m_release(release),
+    m_sampleRate(48000),
+    m_channelsCount(0),
+    m_hopSize(0),
+    m_hopFill(0),
+    m_releaseHops(0),
+    m_firstBin(0),
+    m_lastBin(0),
+    m_historyPosition(0),
+    m_powerScale(1.0f),
+    m_howlsCount(0)
+{
+    for (int i = 0; i < MAX_NOTCHES; i++)
+    {
+        m_notchFrequencies[i].store(0, std::memory_order_relaxed);
+        m_notchDepths[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+const char* HowlStage::name() const
+{
+    return "howl";
+}
+
+bool HowlStage::init(int sampleRate, int channelsCount, unsigned long maxFrames)
+{
+    m_sampleRate = sampleRate;
+    m_channelsCount = channelsCount;
+
+    size_t size = 4;
+    while (size < sampleRate * HOWL_WINDOW_DURATION)
+        size <<= 1;
+    if (!m_fft.init(size))
+        return false;
+    m_hopSize = size / HOWL_OVERLAP;
+    m_releaseHops = static_cast<int>(m_release * sampleRate / m_hopSize);
+
+    // Searched bins, the neighbours of each bin must be in the spectrum.
+    double binWidth = static_cast<double>(sampleRate) / size;
+    m_firstBin = std::max(static_cast<size_t>(std::ceil(HOWL_MIN_FREQUENCY / binWidth)), static_cast<size_t>(HOWL_NEIGHBOUR_LAST));
+    m_lastBin = std::min(static_cast<size_t>(std::min(HOWL_MAX_FREQUENCY, sampleRate * 0.45) / binWidth), size / 2 - HOWL_NEIGHBOUR_LAST);
+    if (m_firstBin >= m_lastBin)
+        return false;
+
+    // Hann window, a full scale sine is at 0 dB.
+    const double pi = 3.14159265358979323846;
+    m_window.resize(size);
+    for (size_t i = 0; i < size; i++)
+        m_window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * pi * i / size));
+    m_powerScale = 16.0f / (static_cast<float>(size) * static_cast<float>(size));
+
+    m_history.assign(size, 0.0f);
+    m_frame.assign(size, 0.0f);
+    m_power.assign(size / 2 + 1, 0.0f);
+    m_levels.assign(size / 2 + 1, 0.0f);
+    m_tracks.assign(HOWL_TRACKS, Track());
+    m_notches.assign(m_notchesCount, Notch());
+    m_notchState.assign(static_cast<size_t>(m_notchesCount) * channelsCount * 2, 0.0f);
+
+    reset();
+    return true;
+}
+
+void HowlStage::reset()
+{
+    std::fill(m_history.begin(), m_history.end(), 0.0f);
+    m_historyPosition = 0;
+    m_hopFill = 0;
+    for (Track& track : m_tracks)
+        track.isUsed = false;
+    for (Notch& notch : m_notches)
+        notch.isUsed = false;
+    std::fill(m_notchState.begin(), m_notchState.end(), 0.0f);
+    m_howlsCount.store(0, std::memory_order_relaxed);
+    publish();
+}
+
+void HowlStage::process(float* const* planes, unsigned long frames)
+{
+    // The frames are processed up to the next analysis, the notches change between two parts.
+    unsigned long offset = 0;
+    while (offset < frames)
+    {
+        unsigned long count = std::min(frames - offset, static_cast<unsigned long>(m_hopSize - m_hopFill));
+
+        // The analysis is done on the captured signal, before the notches.
+        float scale = 1.0f / m_channelsCount;
+        for (unsigned long t = offset; t < offset + count; t++)
+        {
+            float sum = 0.0f;
+            for (int c = 0; c < m_channelsCount; c++)
+                sum += planes[c][t];
+            m_history[m_historyPosition] = sum * scale;
+            if (++m_historyPosition == m_history.size())
+                m_historyPosition = 0;
+        }
+
+        for (size_t n = 0; n < m_notches.size(); n++)
+        {
+            const Notch& notch = m_notches[n];
+            if (!notch.isUsed)
+                continue;
+
+            const BiquadCoefficients& k = notch.coefficients;
+            for (int c = 0; c < m_channelsCount; c++)
+            {
+                float* state = m_notchState.data() + (n * m_channelsCount + c) * 2;
+                float s1 = state[0];
+                float s2 = state[1];
+                float* samples = planes[c];
+                for (unsigned long t = offset; t < offset + count; t++)
+                {
+                    float input = samples[t];
+                    float output = k.b0 * input + s1;
+                    s1 = (k.b1 * input - k.a1 * output) + s2;
+                    s2 = k.b2 * input - k.a2 * output;
+                    samples[t] = output;
+                }
+                state[0] = s1;
+                state[1] = s2;
+            }
+        }
+
+        m_hopFill += count;
+        if (m_hopFill == m_hopSize)
+        {
+            m_hopFill = 0;
+            analyse();
+        }
+        offset += count;
+    }
+}
+
+void HowlStage::analyse()
+{
+    // Windowed frame, oldest frame first.
+    size_t size = m_history.size();
+    size_t tail = size - m_historyPosition;
+    for (size_t i = 0; i < tail; i++)
+        m_frame[i] = m_history[m_historyPosition + i] * m_window[i];
+    for (size_t i = tail; i < size; i++)
+        m_frame[i] = m_history[i - tail] * m_window[i];
+    m_fft.powerSpectrum(m_frame.data(), m_power.data());
+
+    double meanPower = 0.0;
+    for (size_t k = m_firstBin - HOWL_NEIGHBOUR_LAST; k <= m_lastBin + HOWL_NEIGHBOUR_LAST; k++)
+    {
+        float power = m_power[k] * m_powerScale;
+        if (k >= m_firstBin && k <= m_lastBin)
+            meanPower += power;
+        m_levels[k] = 10.0f * std::log10(power + 1e-20f);
+    }
+    double meanLevel = 10.0 * std::log10(meanPower / (m_lastBin - m_firstBin + 1) + 1e-20);
+
+    // Loudest narrow peaks of the spectrum.
+    size_t candidates[HOWL_CANDIDATES];
+    int candidatesCount = 0;
+    for (size_t k = m_firstBin; k <= m_lastBin; k++)
+    {
+        float level = m_levels[k];
+        if (level < HOWL_MIN_LEVEL || level - meanLevel < HOWL_PAPR || level <= m_levels[k - 1] || level < m_levels[k + 1])
+            continue;
+
+        bool isNarrow = true;
+        for (size_t d = HOWL_NEIGHBOUR_FIRST; d <= HOWL_NEIGHBOUR_LAST && isNarrow; d++)
+            isNarrow = level - m_levels[k - d] >= HOWL_PNPR && level - m_levels[k + d] >= HOWL_PNPR;
+        if (!isNarrow)
+            continue;
+
+        // Sorted insertion, the quietest peak is dropped when full.
+        int position = candidatesCount < HOWL_CANDIDATES ? candidatesCount++ : HOWL_CANDIDATES;
+        while (position > 0 && m_levels[candidates[position - 1]] < level)
+        {
+            if (position < HOWL_CANDIDATES)
+                candidates[position] = candidates[position - 1];
+            position--;
+        }
+        if (position < HOWL_CANDIDATES)
+            candidates[position] = k;
+    }
+
+    for (Notch& notch : m_notches)
+    {
+        if (notch.isUsed)
+            notch.idleHops++;
+    }
+
+    // Matching the peaks with the tracks of the previous analyses.
+    double binWidth = static_cast<double>(m_sampleRate) / size;
+    bool isMatched[HOWL_TRACKS] = {};
+    for (int i = 0; i < candidatesCount; i++)
+    {
+        // Quadratic interpolation of the peak between the bins.
+        size_t k = candidates[i];
+        double previous = m_levels[k - 1];
+        double current = m_levels[k];
+        double next = m_levels[k + 1];
+        double delta = 0.5 * (previous - next) / (previous - 2.0 * current + next);
+        double frequency = (k + delta) * binWidth;
+        double level = current - 0.25 * (previous - next) * delta;
+
+        int match = -1;
+        int freeTrack = -1;
+        for (int t = 0; t < HOWL_TRACKS; t++)
+        {
+            const Track& track = m_tracks[t];
+            if (!track.isUsed)
+            {
+                if (freeTrack < 0)
+                    freeTrack = t;
+            }
+            else if (!isMatched[t] && std::abs(track.frequency - frequency) < 1.5 * binWidth &&
+                (match < 0 || std::abs(track.frequency - frequency) < std::abs(m_tracks[match].frequency - frequency)))
+            {
+                match = t;
+            }
+        }
+
+        if (match >= 0)
+        {
+            Track& track = m_tracks[match];
+            track.frequency = frequency;
+            track.level = level;
+            track.minLevel = std::min(track.minLevel, level);
+            track.hops++;
+            track.misses = 0;
+            isMatched[match] = true;
+            updateTrack(track);
+        }
+        else if (freeTrack >= 0)
+        {
+            Track& track = m_tracks[freeTrack];
+            track.isUsed = true;
+            track.frequency = frequency;
+            track.level = level;
+            track.startLevel = level;
+            track.minLevel = level;
+            track.hops = 0;
+            track.misses = 0;
+            isMatched[freeTrack] = true;
+        }
+    }
+
+    // A peak missing twice in a row is forgotten.
+    for (int t = 0; t < HOWL_TRACKS; t++)
+    {
+        Track& track = m_tracks[t];
+        if (track.isUsed && !isMatched[t] && ++track.misses > 2)
+            track.isUsed = false;
+    }
+
+    updateNotches();
+    publish();
+}
+
+void HowlStage::updateTrack(Track& track)
+{
+    double binWidth = static_cast<double>(m_sampleRate) / m_history.size();
+    Notch* notch = nullptr;
+    for (Notch& candidate : m_notches)
+    {
+        if (candidate.isUsed && std::abs(candidate.frequency - track.frequency) < binWidth &&
+            (!notch || std::abs(candidate.frequency - track.frequency) < std::abs(notch->frequency - track.frequency)))
+            notch = &candidate;
+    }
+
+    bool isHowl = false;
+    if (notch)
+    {
+        // The howl is still there, the notch is kept and deepened when it is not enough.
+        notch->idleHops = 0;
+        if (track.hops >= HOWL_PERSISTENCE && track.level > track.startLevel - HOWL_DECAY)
+        {
+            notch->targetDepth = std::min(notch->targetDepth + HOWL_STEP, m_maxDepth);
+            isHowl = true;
+        }
+    }
+    else if (track.hops >= HOWL_PERSISTENCE &&
+        (track.level - track.minLevel >= HOWL_GROWTH || track.hops >= HOWL_SUSTAINED * m_sampleRate / m_hopSize))
+    {
+        triggerNotch(track.frequency);
+        m_howlsCount.fetch_add(1, std::memory_order_relaxed);
+        isHowl = true;
+    }
+
+    // The peak must persist again before the next step.
+    if (isHowl)
+    {
+        track.startLevel = track.level;
+        track.minLevel = track.level;
+        track.hops = 0;
+    }
+}
+
+void HowlStage::triggerNotch(double frequency)
+{
+    // A free notch or the one idle for the longest time.
+    size_t index = 0;
+    for (size_t n = 0; n < m_notches.size(); n++)
+    {
+        if (!m_notches[n].isUsed)
+        {
+            index = n;
+            break;
+        }
+        if (m_notches[n].idleHops > m_notches[index].idleHops)
+            index = n;
+    }
+
+    Notch& notch = m_notches[index];
+    notch.isUsed = true;
+    notch.frequency = frequency;
+    notch.depth = 0.0;
+    notch.targetDepth = std::min(HOWL_STEP, m_maxDepth);
+    notch.idleHops = 0;
+    notch.coefficients = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    std::fill_n(m_notchState.begin() + index * m_channelsCount * 2, m_channelsCount * 2, 0.0f);
+}
+
+void HowlStage::updateNotches()
+{
+    for (size_t n = 0; n < m_notches.size(); n++)
+    {
+        Notch& notch = m_notches[n];
+        if (!notch.isUsed)
+            continue;
+
+        if (notch.idleHops > m_releaseHops)
+            notch.targetDepth = 0.0;
+
+        // Fast attack and slow release, the coefficients change a little at each analysis.
+        double depth = notch.depth;
+        if (depth < notch.targetDepth)
+            depth = std::min(depth + HOWL_ATTACK, notch.targetDepth);
+        else if (depth > notch.targetDepth)
+            depth = std::max(depth - HOWL_RELEASE_RATE, notch.targetDepth);
+
+        if (depth <= 0.0 && notch.targetDepth <= 0.0)
+        {
+            notch.isUsed = false;
+            continue;
+        }
+        if (depth == notch.depth)
+            continue;
+
+        BiquadBand band;
+        band.type = BiquadType::Peaking;
+        band.frequency = notch.frequency;
+        band.q = HOWL_NOTCH_Q;
+        band.gain = -depth;
+        if (designBiquad(band, m_sampleRate, &notch.coefficients))
+            notch.depth = depth;
+        else
+            notch.isUsed = false;
+    }
+}
+
+void HowlStage::publish()
+{
+    for (size_t n = 0; n < m_notches.size(); n++)
+    {
+        const Notch& notch = m_notches[n];
+        m_notchFrequencies[n].store(notch.isUsed ? static_cast<int>(notch.frequency + 0.5) : 0, std::memory_order_relaxed);
+        m_notchDepths[n].store(notch.isUsed ? static_cast<int>(notch.depth * 10.0 + 0.5) : 0, std::memory_order_relaxed);
+    }
+}
+
+std::string HowlStage::report() const
+{
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(1);
+    int activeCount = 0;
+    for (int n = 0; n < m_notchesCount; n++)
+    {
+        int frequency = m_notchFrequencies[n].load(std::memory_order_relaxed);
+        if (frequency == 0)
+            continue;
+        stream << (activeCount == 0 ? " (" : ", ") << frequency << " Hz -" << m_notchDepths[n].load(std::memory_order_relaxed) / 10.0 << " dB";
+        activeCount++;
+    }
+    if (activeCount > 0)
+        stream << ")";
+
+    std::ostringstream result;
+    result << m_howlsCount.load(std::memory_order_relaxed) << " howls detected, " << activeCount << "/" << m_notchesCount << " notches" << stream.str();
+    return result.str();
+}
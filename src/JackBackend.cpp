@@ -0,0 +1,267 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "JackBackend.h"
+#include "Tracer.h"
+#include <cstring>
+
+// Largest period of the JACK server, which can be changed while the client is active.
+#define JACK_MAX_PERIOD 8192
+
+JackBackend::JackBackend() :
+    m_client(nullptr),
+    m_isPlayingContinue(false),
+    m_xruns(0)
+{}
+
+JackBackend::~JackBackend()
+{
+    deinit();
+}
+
+bool JackBackend::init(const StreamConfig& config)
+{
+    deinit();
+    m_config = config;
+    m_xruns = 0;
+
+    // Connecting to the running JACK server, the server is not started by the client.
+    jack_status_t status;
+    m_client = jack_client_open("MicrophoneLoopback", JackNoStartServer, &status);
+    if (!m_client)
+    {
+        m_strError = "Failed to connect to the JACK server.";
+        return false;
+    }
+
+    jack_set_process_callback(m_client, JackBackend::staticProcessCallback, static_cast<void*>(this));
+    jack_set_xrun_callback(m_client, JackBackend::staticXrunCallback, static_cast<void*>(this));
+    jack_on_shutdown(m_client, JackBackend::staticShutdownCallback, static_cast<void*>(this));
+
+    // One input and one output port per channel.
+    for (int i = 0; i < m_config.channelsCount; i++)
+    {
+        std::string inputName = "capture_" + std::to_string(i + 1);
+        std::string outputName = "playback_" + std::to_string(i + 1);
+        jack_port_t* inputPort = jack_port_register(m_client, inputName.c_str(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+        jack_port_t* outputPort = jack_port_register(m_client, outputName.c_str(), JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+        if (!inputPort || !outputPort)
+        {
+            m_strError = "Failed to register the JACK ports.";
+            deinit();
+            return false;
+        }
+        m_inputPorts.push_back(inputPort);
+        m_outputPorts.push_back(outputPort);
+    }
+
+    // The interleaving buffers are allocated here, never in the process callback, 
+    // for the largest period so they still fit when the period of the server grows.
+    if (m_config.channelsCount > 1)
+    {
+        jack_nframes_t maxFrames = jack_get_buffer_size(m_client) > JACK_MAX_PERIOD ? jack_get_buffer_size(m_client) : JACK_MAX_PERIOD;
+        m_inputData.assign(maxFrames * m_config.channelsCount, 0.0f);
+        m_outputData.assign(maxFrames * m_config.channelsCount, 0.0f);
+        m_inputPlanes.assign(m_config.channelsCount, nullptr);
+        m_outputPlanes.assign(m_config.channelsCount, nullptr);
+        if (!m_converter.init(SampleFormat::Float32, m_config.channelsCount))
+        {
+            m_strError = "Unsupported number of channels.";
+            deinit();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void JackBackend::deinit()
+{
+    stop();
+
+    if (m_client)
+    {
+        jack_client_close(m_client);
+        m_client = nullptr;
+    }
+    m_inputPorts.clear();
+    m_outputPorts.clear();
+    m_inputData.clear();
+    m_outputData.clear();
+    m_inputPlanes.clear();
+    m_outputPlanes.clear();
+}
+
+bool JackBackend::play()
+{
+    if (!m_client)
+    {
+        m_strError = "The stream is not ready.";
+        return false;
+    }
+
+    m_isPlayingContinue = true;
+    if (jack_activate(m_client) != 0)
+    {
+        m_isPlayingContinue = false;
+        m_strError = "Failed to activate the JACK client.";
+        return false;
+    }
+
+    connectPhysicalPorts();
+    updateLatency();
+    return true;
+}
+
+void JackBackend::stop()
+{
+    if (m_client && m_isPlayingContinue)
+        jack_deactivate(m_client);
+    m_isPlayingContinue = false;
+}
+
+void JackBackend::connectPhysicalPorts()
+{
+    // The microphones are the outputs of the physical capture ports.
+    const char** capturePorts = jack_get_ports(m_client, nullptr, JACK_DEFAULT_AUDIO_TYPE, JackPortIsPhysical | JackPortIsOutput);
+    if (capturePorts)
+    {
+        for (size_t i = 0; i < m_inputPorts.size() && capturePorts[i]; i++)
+            jack_connect(m_client, capturePorts[i], jack_port_name(m_inputPorts[i]));
+        jack_free(capturePorts);
+    }
+
+    // The speakers are the inputs of the physical playback ports.
+    const char** playbackPorts = jack_get_ports(m_client, nullptr, JACK_DEFAULT_AUDIO_TYPE, JackPortIsPhysical | JackPortIsInput);
+    if (playbackPorts)
+    {
+        for (size_t i = 0; i < m_outputPorts.size() && playbackPorts[i]; i++)
+            jack_connect(m_client, jack_port_name(m_outputPorts[i]), playbackPorts[i]);
+        jack_free(playbackPorts);
+    }
+}
+
+void JackBackend::updateLatency()
+{
+    // Latency of the graph between the physical ports and our ports.
+    jack_nframes_t sampleRate = jack_get_sample_rate(m_client);
+    if (m_inputPorts.empty() || sampleRate == 0)
+        return;
+
+    jack_latency_range_t range;
+    jack_port_get_latency_range(m_inputPorts[0], JackCaptureLatency, &range);
+    m_counters.inputLatency.store(static_cast<long>(range.max * 1000000LL / sampleRate), std::memory_order_relaxed);
+    jack_port_get_latency_range(m_outputPorts[0], JackPlaybackLatency, &range);
+    m_counters.outputLatency.store(static_cast<long>(range.max * 1000000LL / sampleRate), std::memory_order_relaxed);
+}
+
+int JackBackend::staticProcessCallback(jack_nframes_t nframes, void* userData)
+{
+    // redirecting this function to the member function of JackBackend.
+    JackBackend* jStream = static_cast<JackBackend*>(userData);
+    PeriodTime begin = periodBegin();
+    int result = jStream->processCallback(nframes);
+    jStream->periodEnd(begin, nframes);
+    return result;
+}
+
+int JackBackend::processCallback(jack_nframes_t nframes)
+{
+    // With a single channel, the port buffers are sent directly to the processor.
+    if (m_inputPorts.size() == 1)
+    {
+        const jack_default_audio_sample_t* input = 
+            static_cast<const jack_default_audio_sample_t*>(jack_port_get_buffer(m_inputPorts[0], nframes));
+        jack_default_audio_sample_t* output = 
+            static_cast<jack_default_audio_sample_t*>(jack_port_get_buffer(m_outputPorts[0], nframes));
+        process(input, output, nframes);
+        return 0;
+    }
+
+    size_t channelsCount = m_inputPorts.size();
+    if (nframes * channelsCount > m_inputData.size())
+    {
+        // The server period grew over JACK_MAX_PERIOD after init(), play silence instead of allocating.
+        for (size_t i = 0; i < channelsCount; i++)
+            memset(jack_port_get_buffer(m_outputPorts[i], nframes), 0, nframes * sizeof(jack_default_audio_sample_t));
+        return 0;
+    }
+
+    // Interleaving the ports, processing and deinterleaving.
+    for (size_t i = 0; i < channelsCount; i++)
+    {
+        m_inputPlanes[i] = static_cast<jack_default_audio_sample_t*>(jack_port_get_buffer(m_inputPorts[i], nframes));
+        m_outputPlanes[i] = static_cast<jack_default_audio_sample_t*>(jack_port_get_buffer(m_outputPorts[i], nframes));
+    }
+    m_converter.interleave(m_inputPlanes.data(), m_inputData.data(), nframes);
+    process(m_inputData.data(), m_outputData.data(), nframes);
+    m_converter.deinterleave(m_outputData.data(), m_outputPlanes.data(), nframes);
+    return 0;
+}
+
+int JackBackend::staticXrunCallback(void* userData)
+{
+    static_cast<JackBackend*>(userData)->m_xruns.fetch_add(1, std::memory_order_relaxed);
+    Tracer::instant("xrun");
+    return 0;
+}
+
+void JackBackend::staticShutdownCallback(void* userData)
+{
+    // The server has stopped or has kicked the client out of the graph.
+    JackBackend* jStream = static_cast<JackBackend*>(userData);
+    jStream->m_strError = "The JACK server has shut down.";
+    jStream->m_isPlayingContinue = false;
+}
+
+bool JackBackend::isPlayingContinue() const
+{
+    return m_isPlayingContinue;
+}
+
+unsigned long JackBackend::xrunsCount() const
+{
+    return m_xruns.load(std::memory_order_relaxed);
+}
+
+double JackBackend::cpuLoad() const
+{
+    // The DSP load of the whole server, in percent.
+    if (!m_client)
+        return -1.0;
+    return jack_cpu_load(m_client) / 100.0;
+}
+
+SampleFormat JackBackend::sampleFormat() const
+{
+    return SampleFormat::Float32;
+}
+
+int JackBackend::sampleRate() const
+{
+    if (!m_client)
+        return m_config.sampleRate;
+    return jack_get_sample_rate(m_client);
+}
+
+unsigned long JackBackend::framesPerBuffer() const
+{
+    if (!m_client)
+        return m_config.framesPerBuffer;
+    return jack_get_buffer_size(m_client);
+}
@@ -0,0 +1,118 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "LatencyCeiling.h"
+#include "Tracer.h"
+
+namespace
+{
+    // The catch-up stop under this fraction of the ceiling.
+    const double CATCH_UP_TARGET = 0.8;
+    // Time waiting for silence before cutting into the signal, unless the latency is over the ceiling by this ratio.
+    const double SILENCE_WAIT = 0.5;
+    const double FORCE_RATIO = 1.5;
+}
+
+LatencyCeiling::LatencyCeiling() :
+    m_sampleRate(0),
+    m_maxLatency(0.0),
+    m_maxFrames(0),
+    m_isCatchingUp(false),
+    m_catchUpTime(0.0),
+    m_catchUpsCount(0),
+    m_droppedFrames(0),
+    m_audibleDroppedFrames(0)
+{}
+
+bool LatencyCeiling::init(SampleFormat format, int channelsCount, int sampleRate, double maxLatency, unsigned long maxFrames)
+{
+    if (maxLatency <= 0.0 || !m_splicer.init(format, channelsCount, sampleRate, maxFrames))
+        return false;
+
+    m_sampleRate = sampleRate;
+    m_maxLatency = maxLatency;
+    m_maxFrames = maxFrames;
+
+    m_isCatchingUp = false;
+    m_catchUpTime = 0.0;
+    m_catchUpsCount = 0;
+    m_droppedFrames = 0;
+    m_audibleDroppedFrames = 0;
+    return true;
+}
+
+unsigned long LatencyCeiling::process(void* data, unsigned long frames, double latency)
+{
+    if (frames == 0 || frames > m_maxFrames)
+        return frames;
+
+    if (!m_isCatchingUp)
+    {
+        if (latency <= m_maxLatency)
+            return frames;
+        m_isCatchingUp = true;
+        m_catchUpTime = 0.0;
+        m_catchUpsCount.fetch_add(1, std::memory_order_relaxed);
+        Tracer::instant("catch up");
+    }
+
+    // The catch-up is over once the latency is back under the target.
+    double excess = latency - m_maxLatency * CATCH_UP_TARGET;
+    unsigned long excessFrames = excess > 0.0 ? static_cast<unsigned long>(excess * m_sampleRate) : 0;
+    if (excessFrames == 0)
+    {
+        m_isCatchingUp = false;
+        return frames;
+    }
+    bool isForced = m_catchUpTime >= SILENCE_WAIT || latency > m_maxLatency * FORCE_RATIO;
+    m_catchUpTime += static_cast<double>(frames) / m_sampleRate;
+
+    // The silent parts are cut first, the signal only once the catch-up is forced.
+    m_splicer.load(data, frames);
+    unsigned long drop = m_splicer.cutSilence(excessFrames);
+    if (drop == 0 && isForced)
+    {
+        drop = m_splicer.cutQuietest(excessFrames);
+        m_audibleDroppedFrames.fetch_add(drop, std::memory_order_relaxed);
+    }
+    if (drop == 0)
+        return frames;
+
+    m_droppedFrames.fetch_add(drop, std::memory_order_relaxed);
+    return m_splicer.store(data);
+}
+
+double LatencyCeiling::maxLatency() const
+{
+    return m_maxLatency;
+}
+
+unsigned long LatencyCeiling::catchUpsCount() const
+{
+    return m_catchUpsCount.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyCeiling::droppedFrames() const
+{
+    return m_droppedFrames.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyCeiling::audibleDroppedFrames() const
+{
+    return m_audibleDroppedFrames.load(std::memory_order_relaxed);
+}
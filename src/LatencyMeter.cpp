@@ -0,0 +1,249 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "LatencyMeter.h"
+#include "SampleConversion.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace
+{
+    // Galois LFSR of the polynomial x^12 + x^11 + x^10 + x^4 + 1 (4095 samples).
+    const unsigned int MLS_TAPS = 0xE08;
+    const unsigned int MLS_LENGTH = 4095;
+    const float MLS_AMPLITUDE = 0.25f;
+
+    // Minimum normalized correlation to consider the burst as found.
+    const double DETECTION_THRESHOLD = 0.2;
+}
+
+LatencyMeter::LatencyMeter(int burstsCount) :
+    m_burstsCount(burstsCount > 0 ? burstsCount : 1),
+    m_format(SampleFormat::Int16),
+    m_channelsCount(1),
+    m_sampleSize(2),
+    m_frameSize(2),
+    m_sampleRate(48000),
+    m_maxLatency(0),
+    m_silenceFrames(0),
+    m_state(State::Silence),
+    m_position(0),
+    m_isRecordingReady(false),
+    m_burstsDone(0),
+    m_missedCount(0)
+{}
+
+LatencyMeter::~LatencyMeter()
+{}
+
+bool LatencyMeter::init(SampleFormat format, int channelsCount, int sampleRate)
+{
+    if (channelsCount <= 0 || sampleRate <= 0)
+        return false;
+
+    m_format = format;
+    m_channelsCount = channelsCount;
+    m_sampleSize = sampleFormatSize(format);
+    m_frameSize = channelsCount * m_sampleSize;
+    m_sampleRate = sampleRate;
+
+    // Search up to one second of latency and let the echo of a burst die
+    // for a quarter of second before the next one.
+    m_maxLatency = sampleRate;
+    m_silenceFrames = sampleRate / 4;
+
+    generateSequence();
+    m_recording.assign(m_sequence.size() + m_maxLatency, 0.0f);
+    m_latencies.reserve(m_burstsCount);
+
+    m_state = State::Silence;
+    m_position = 0;
+    m_isRecordingReady = false;
+    m_burstsDone = 0;
+    m_missedCount = 0;
+    return true;
+}
+
+void LatencyMeter::generateSequence()
+{
+    m_sequence.resize(MLS_LENGTH);
+    unsigned int state = 1;
+    for (unsigned int i = 0; i < MLS_LENGTH; i++)
+    {
+        unsigned int bit = state & 1;
+        state >>= 1;
+        if (bit)
+            state ^= MLS_TAPS;
+        m_sequence[i] = bit ? MLS_AMPLITUDE : -MLS_AMPLITUDE;
+    }
+}
+
+float LatencyMeter::inputSample(const void* input, unsigned long frame) const
+{
+    // Only the first channel is used for the detection.
+    return sampleToFloat(m_format, static_cast<const char*>(input) + frame * m_frameSize);
+}
+
+void LatencyMeter::writeSample(void* output, unsigned long frame, float value) const
+{
+    char* data = static_cast<char*>(output) + frame * m_frameSize;
+    for (int c = 0; c < m_channelsCount; c++)
+        floatToSample(m_format, value, data + c * m_sampleSize);
+}
+
+void LatencyMeter::process(const void* input, void* output, unsigned long frames)
+{
+    for (unsigned long i = 0; i < frames; i++)
+    {
+        // The input is read before the output is written, the buffers may be the same.
+        float value = 0.0f;
+
+        switch (m_state)
+        {
+        case State::Silence:
+            if (++m_position >= m_silenceFrames)
+            {
+                m_state = State::Recording;
+                m_position = 0;
+            }
+            break;
+
+        case State::Recording:
+            m_recording[m_position] = inputSample(input, i);
+            if (m_position < m_sequence.size())
+                value = m_sequence[m_position];
+            if (++m_position >= m_recording.size())
+            {
+                m_state = State::Waiting;
+                m_isRecordingReady.store(true, std::memory_order_release);
+            }
+            break;
+
+        case State::Waiting:
+            // Start the next burst once the main thread is done with the recording.
+            if (!m_isRecordingReady.load(std::memory_order_acquire) &&
+                m_burstsDone.load(std::memory_order_relaxed) < m_burstsCount)
+            {
+                m_state = State::Silence;
+                m_position = 0;
+            }
+            break;
+        }
+
+        writeSample(output, i, value);
+    }
+}
+
+bool LatencyMeter::analyze(std::ostream& stream)
+{
+    if (!m_isRecordingReady.load(std::memory_order_acquire))
+        return false;
+
+    const size_t length = m_sequence.size();
+
+    double sequenceEnergy = 0.0;
+    for (size_t n = 0; n < length; n++)
+        sequenceEnergy += m_sequence[n] * m_sequence[n];
+
+    // Energy of the recording under the sequence, updated while sliding.
+    double windowEnergy = 0.0;
+    for (size_t n = 0; n < length; n++)
+        windowEnergy += m_recording[n] * m_recording[n];
+
+    double bestScore = 0.0;
+    size_t bestLag = 0;
+    for (size_t lag = 0; lag <= m_maxLatency; lag++)
+    {
+        const float* window = m_recording.data() + lag;
+        double correlation = 0.0;
+        for (size_t n = 0; n < length; n++)
+            correlation += m_sequence[n] * window[n];
+
+        if (windowEnergy > 1e-9)
+        {
+            // The polarity may be inverted by the hardware.
+            double score = std::fabs(correlation) / std::sqrt(sequenceEnergy * windowEnergy);
+            if (score > bestScore)
+            {
+                bestScore = score;
+                bestLag = lag;
+            }
+        }
+
+        if (lag < m_maxLatency)
+        {
+            windowEnergy += window[length] * window[length] - window[0] * window[0];
+            if (windowEnergy < 0.0)
+                windowEnergy = 0.0;
+        }
+    }
+
+    int burst = m_burstsDone.load(std::memory_order_relaxed) + 1;
+    stream << "Burst " << burst << "/" << m_burstsCount << ": ";
+    if (bestScore >= DETECTION_THRESHOLD)
+    {
+        m_latencies.push_back(static_cast<long>(bestLag));
+        stream << bestLag << " frames (" << framesToMs(bestLag) << " ms)." << std::endl;
+    }
+    else
+    {
+        m_missedCount++;
+        stream << "not detected." << std::endl;
+    }
+
+    // Give the recording back to the audio thread.
+    m_burstsDone.store(burst, std::memory_order_relaxed);
+    m_isRecordingReady.store(false, std::memory_order_release);
+    return true;
+}
+
+bool LatencyMeter::isFinished() const
+{
+    return m_burstsDone.load(std::memory_order_relaxed) >= m_burstsCount;
+}
+
+size_t LatencyMeter::detectedCount() const
+{
+    return m_latencies.size();
+}
+
+double LatencyMeter::framesToMs(long frames) const
+{
+    return frames * 1000.0 / m_sampleRate;
+}
+
+void LatencyMeter::printReport(std::ostream& stream) const
+{
+    if (m_latencies.empty())
+    {
+        stream << "No burst was detected in the captured input, the output does not reach the input." << std::endl;
+        return;
+    }
+
+    std::vector<long> sorted(m_latencies);
+    std::sort(sorted.begin(), sorted.end());
+    long median = sorted[sorted.size() / 2];
+    if (sorted.size() % 2 == 0)
+        median = (sorted[sorted.size() / 2 - 1] + median) / 2;
+
+    stream << "Round-trip latency (" << m_latencies.size() << "/" << m_burstsCount << " bursts detected):" << std::endl;
+    stream << "    min: " << sorted.front() << " frames (" << framesToMs(sorted.front()) << " ms)" << std::endl;
+    stream << "    median: " << median << " frames (" << framesToMs(median) << " ms)" << std::endl;
+    stream << "    max: " << sorted.back() << " frames (" << framesToMs(sorted.back()) << " ms)" << std::endl;
+}
@@ -17,69 +17,162 @@
 */
 
 #include "LoopbackStream.h"
+#include "PortAudioBackend.h"
+#include "FileBackend.h"
+#ifdef __linux__
+#include "PulseSimpleBackend.h"
+#include "PulseBackend.h"
+#ifdef HAVE_ALSA
+#include "AlsaBackend.h"
+#endif
+#ifdef HAVE_JACK
+#include "JackBackend.h"
+#endif
+#ifdef HAVE_PIPEWIRE
+#include "PipeWireBackend.h"
+#endif
+#endif
+#include <algorithm>
 #include <cstring>
 
 LoopbackStream::LoopbackStream() :
-    m_channelsCount(1),
-    m_sampleRate(48000),
-    m_sizePerSample(2),
-    m_streamFramePerBuffer(256),
 #ifdef WIN32
-    m_inputLatency(0.02),
-    m_outputLatency(0.02),
-#endif
-    m_stream(nullptr),
-#ifdef __linux__
-    m_usePortAudio(false),
-    m_inputStream(nullptr),
-    m_outputStream(nullptr),
+    m_api(StreamApi::PortAudio),
+#elif __linux__
+    m_api(StreamApi::PulseSimple),
 #endif
+    m_frameSize(0),
     m_isStreamReady(false),
-    m_isPlayingContinue(false),
-    m_inputBufferSize(m_streamFramePerBuffer * m_sizePerSample * m_channelsCount)
-#ifdef __linux__
-    ,m_data(nullptr)
-#endif
+    m_backend(nullptr),
+    m_latencyMeter(nullptr),
+    m_bufferController(nullptr),
+    m_isAdaptiveBufferActive(false),
+    m_processingExecutor(nullptr),
+    m_mixBufferTime(0.01),
+    m_isPlayingContinue(false)
 {}
 
 LoopbackStream::~LoopbackStream()
 {
     deinit();
+    delete m_latencyMeter;
+    delete m_bufferController;
 }
 
 void LoopbackStream::deinit()
 {
     stop();
 
-    // Deinitialization of the streams and datas.
-    if (m_stream)
+    // Deinitialization of the backend.
+    if (m_backend)
     {
-        Pa_CloseStream(m_stream);
-        m_stream = nullptr;
+        m_backend->deinit();
+        delete m_backend;
+        m_backend = nullptr;
     }
-#ifdef __linux__
-    if (m_tStream.joinable())
-        m_tStream.join();
+    m_mixBus.clear();
+    
+    m_isStreamReady = false;
+    m_isPlayingContinue = false;
+    m_isAdaptiveBufferActive = false;
+}
 
-    if (m_inputStream)
+MixCapture* LoopbackStream::createMixCapture() const
+{
+    switch (m_api)
     {
-        pa_simple_free(m_inputStream);
-        m_inputStream = nullptr;
+    case StreamApi::PortAudio:
+        return new PortAudioCapture();
+#ifdef __linux__
+    // The Pulse Simple API is blocking, its sources are read by the asynchronous API.
+    case StreamApi::PulseSimple:
+    case StreamApi::Pulse:
+        return new PulseCapture();
+#endif
+    default:
+        return nullptr;
     }
-    if (m_outputStream)
+}
+
+bool LoopbackStream::initMixBus()
+{
+    m_mixBus.clear();
+    if (m_mixSources.empty() || m_latencyMeter)
+        return true;
+
+    std::vector<DeviceInfo> devices;
+    bool isProbed = false;
+    for (const MixSourceSettings& settings : m_mixSources)
     {
-        pa_simple_free(m_outputStream);
-        m_outputStream = nullptr;
+        MixCapture* capture = createMixCapture();
+        if (!capture)
+        {
+            m_strError = std::string("The ") + streamApiName(m_api) + " API does not support the mix sources.";
+            return false;
+        }
+
+        // The devices are selected like the one of the stream.
+        MixSourceSettings source = settings;
+        if (!source.device.empty())
+        {
+            if (!isProbed && !loadDevices(m_backend, true, &devices))
+            {
+                delete capture;
+                return false;
+            }
+            isProbed = true;
+
+            const DeviceInfo* device = findDevice(devices, source.device, true);
+            if (device)
+                source.device = device->id;
+            else if (isDeviceIndex(source.device))
+            {
+                m_strError = "There is no capture device " + source.device + " for the mix source " + source.name + ", see --list-devices.";
+                delete capture;
+                return false;
+            }
+        }
+        m_mixBus.addSource(new MixSource(source), capture);
     }
-    if (m_data)
+
+    if (!m_mixBus.init(m_config.channelsCount, m_config.sampleRate, m_config.framesPerBuffer, m_mixBufferTime))
     {
-        delete[] m_data;
-        m_data = nullptr;
+        m_strError = m_mixBus.error();
+        m_mixBus.clear();
+        return false;
     }
+    return true;
+}
+
+AudioBackend* LoopbackStream::createBackend() const
+{
+    switch (m_api)
+    {
+    case StreamApi::PortAudio:
+        return new PortAudioBackend();
+    case StreamApi::File:
+        return new FileBackend();
+#ifdef __linux__
+    case StreamApi::PulseSimple:
+        return new PulseSimpleBackend();
+    case StreamApi::Pulse:
+        return new PulseBackend();
+#ifdef HAVE_ALSA
+    case StreamApi::Alsa:
+        return new AlsaBackend();
 #endif
-    
-    m_isStreamReady = false;
-    m_isPlayingContinue = false;
+#ifdef HAVE_JACK
+    case StreamApi::Jack:
+        return new JackBackend();
+#endif
+#ifdef HAVE_PIPEWIRE
+    case StreamApi::PipeWire:
+        return new PipeWireBackend();
+#endif
+#endif
+    default:
+        return nullptr;
+    }
 }
 
 bool LoopbackStream::init()
@@ -87,200 +180,131 @@ bool LoopbackStream::init()
     // First, dinitialization of any existing stream.
     deinit();
 
-#ifdef __linux__
-    if (m_usePortAudio)
+    m_backend = createBackend();
+    if (!m_backend)
     {
-#endif
+        m_strError = std::string("The API ") + streamApiName(m_api) + " is not available.";
+        return false;
+    }
 
-    int err = paNoError;
+    // The ring of the Pulse Simple API must be able to hold the largest buffering.
+    StreamConfig config = m_config;
+    if (m_bufferController && config.ringBufferPeriods <= static_cast<int>(m_bufferController->maxPeriods()))
+        config.ringBufferPeriods = static_cast<int>(m_bufferController->maxPeriods()) + 1;
 
-    // Creating the input stream with the default input device.
-    PaStreamParameters inputStreamParams = {};
-    inputStreamParams.device = Pa_GetDefaultInputDevice();
-    inputStreamParams.channelCount = m_channelsCount;
-    inputStreamParams.sampleFormat = paInt16;
-#ifdef WIN32
-    inputStreamParams.suggestedLatency = m_inputLatency;
-#elif __linux__
-    inputStreamParams.suggestedLatency = 0.;
-#endif
-    inputStreamParams.hostApiSpecificStreamInfo = nullptr;
+    // The other APIs open the capture and the playback at the same rate.
+    if (config.outputSampleRate > 0 && config.outputSampleRate != config.sampleRate && !m_backend->isResamplingSupported())
+    {
+        m_strError = std::string("The ") + streamApiName(m_api) + " API does not support a different output sample rate.";
+        return false;
+    }
+    if (config.isDriftCompensation && !m_backend->isResamplingSupported())
+    {
+        m_strError = std::string("The ") + streamApiName(m_api) + " API use one clock, it does not support the drift compensation.";
+        return false;
+    }
 
-    PaStreamParameters outputStreamParams = {};
-    outputStreamParams.device = Pa_GetDefaultOutputDevice();
-    outputStreamParams.channelCount = m_channelsCount;
-    outputStreamParams.sampleFormat = paInt16;
-#ifdef WIN32
-    outputStreamParams.suggestedLatency = m_outputLatency;
-#elif __linux__
-    outputStreamParams.suggestedLatency = 0.;
-#endif
-    outputStreamParams.hostApiSpecificStreamInfo = nullptr;
-
-    err = Pa_OpenStream(
-        &m_stream,
-        &inputStreamParams,
-        &outputStreamParams,
-        m_sampleRate,
-        m_streamFramePerBuffer,
-        paClipOff,
-        LoopbackStream::staticInputCallback,
-        static_cast<void*>(this));
-
-    if (err != paNoError)
+    // The devices are resolved from the cache of the probe when possible.
+    if (!config.inputDevice.empty() || !config.outputDevice.empty())
     {
+        if (!m_backend->isDeviceSelectionSupported())
+        {
+            m_strError = std::string("The ") + streamApiName(m_api) + " API does not support the device selection.";
+            return false;
+        }
+        if (!resolveDevices(m_backend, &config))
+            return false;
+    }
+
+    m_backend->setProcessor(this);
+    if (!m_backend->init(config))
+    {
+        m_strError = m_backend->error();
         m_isStreamReady = false;
         m_isPlayingContinue = false;
-        m_strError = "Failed to create the input stream.";
         return false;
     }
 
-#ifdef __linux__
+    // Some backends choose their own format, sample rate or period size.
+    m_config.sampleRate = m_backend->sampleRate();
+    m_config.framesPerBuffer = m_backend->framesPerBuffer();
+    m_frameSize = m_config.channelsCount * sampleFormatSize(m_backend->sampleFormat());
+
+    // The adaptive buffer start with the lowest latency.
+    if (m_bufferController)
+    {
+        m_bufferController->reset(m_bufferController->minPeriods());
+        m_isAdaptiveBufferActive = m_backend->setBufferPeriods(m_bufferController->periods());
     }
-    else
+
+    if (!initMixBus())
     {
-        // Stream specification.
-        pa_sample_spec sampleSpec;
-        sampleSpec.channels = m_channelsCount;
-        sampleSpec.format = PA_SAMPLE_S16LE;
-        sampleSpec.rate = m_sampleRate;
-
-        // Pulseaudio buffer length.
-        pa_buffer_attr bufferAtribute;
-        bufferAtribute.maxlength = m_inputBufferSize;
-        bufferAtribute.tlength = -1;
-        bufferAtribute.prebuf = -1;
-        bufferAtribute.minreq = -1;
-        bufferAtribute.fragsize = -1;
-
-        // Opening the input stream. (from the microphone.)
-        m_inputStream = pa_simple_new(
-            nullptr,
-            "MicrophoneLoopback",
-            PA_STREAM_RECORD,
-            nullptr,
-            "Microphone record",
-            &sampleSpec,
-            nullptr,
-            &bufferAtribute,
-            nullptr
-        );
-
-        if (!m_inputStream)
-        {
-            m_strError = "Failed to start the input stream.";
-            m_isStreamReady = false;
-            m_isPlayingContinue = false;
-            return false;
-        }
+        m_isStreamReady = false;
+        return false;
+    }
 
-        // Opening the output stream. (to the speakers.)
-        m_outputStream = pa_simple_new(
-            nullptr,
-            "MicrophoneLoopback",
-            PA_STREAM_PLAYBACK,
-            nullptr,
-            "Microphone playback",
-            &sampleSpec,
-            nullptr,
-            &bufferAtribute,
-            nullptr
-        );
-
-        if (!m_outputStream)
-        {
-            m_strError = "Failed to start the output stream.";
-            m_isStreamReady = false;
-            m_isPlayingContinue = false;
-            return false;
-        }
+    // The stages are created again for the format of the new backend.
+    m_processingChain.clear();
+    m_processingChain.setExecutor(m_processingExecutor);
+    m_processingChain.setMixBus(m_mixBus.isEmpty() ? nullptr : &m_mixBus);
+    for (const std::string& name : m_processingSettings.stages)
+        m_processingChain.addStage(createProcessingStage(name, m_processingSettings));
+    if (!m_processingChain.isEmpty() &&
+        !m_processingChain.init(m_backend->sampleFormat(), m_config.channelsCount, m_config.sampleRate, m_config.framesPerBuffer))
+    {
+        m_strError = m_processingChain.error();
+        m_isStreamReady = false;
+        return false;
+    }
 
-        // Creating the two temporaring buffers.
-        m_data = new char[m_inputBufferSize];
-        memset(m_data, 0, m_inputBufferSize);
+    if (m_latencyMeter &&
+        !m_latencyMeter->init(m_backend->sampleFormat(), m_config.channelsCount, m_config.sampleRate))
+    {
+        m_strError = "Failed to initialize the latency measurement.";
+        m_isStreamReady = false;
+        return false;
     }
-#endif
 
     // Everything is fine.
     m_isStreamReady = true;
     return true;
 }
 
-int LoopbackStream::staticInputCallback(
-    const void *inputBuffer,
-    void *outputBuffer,
-    unsigned long framesPerBuffer,
-    const PaStreamCallbackTimeInfo* timeInfo,
-    PaStreamCallbackFlags statusFlags,
-    void *userData)
+void LoopbackStream::process(const void* input, void* output, unsigned long frames)
 {
-    // redirectint this function to the member function of LoopbackStream.
-    LoopbackStream* lStream = static_cast<LoopbackStream*>(userData);
-    return lStream->inputCallback(inputBuffer, outputBuffer);
-}
-
-int LoopbackStream::inputCallback(const void* inputBuffer, void* outputBuffer)
-{
-    memcpy(outputBuffer, inputBuffer, m_inputBufferSize);
-    return paContinue;
-}
-
-#ifdef __linux__
-void LoopbackStream::streamLoop()
-{
-    // Starting to play
-    int err = PA_OK;
-    while (m_isPlayingContinue)
+    if (m_latencyMeter)
     {
-        // Write the data to the playback buffer.
-        err = pa_simple_write(m_outputStream, m_data, m_inputBufferSize, nullptr);
-        if (err != 0)
-        {
-            m_strError = "Failed to play data.";
-            m_isPlayingContinue = false;
-            break;
-        }
-        err = pa_simple_read(m_inputStream, m_data, m_inputBufferSize, nullptr);
-        if (err != 0)
-        {
-            m_strError = "Failed to read data from the microphone.";
-            m_isPlayingContinue = false;
-            break;
-        }
+        m_latencyMeter->process(input, output, frames);
+        return;
     }
+
+    if (!m_processingChain.isEmpty())
+        m_processingChain.process(input, output, frames);
+    else if (input != output)
+        memcpy(output, input, frames * m_frameSize);
 }
-#endif
 
 bool LoopbackStream::play()
 {
     // Playing the stream
     if (m_isStreamReady)
     {
-#ifdef __linux__
-        if (m_usePortAudio)
+        // The sources fill their buffer before the stream read them.
+        if (!m_mixBus.play())
         {
-#endif
-
-        int err = Pa_StartStream(m_stream);
-        if (err != paNoError)
-        {
-            m_strError = "Failed to start the input stream.";
+            m_strError = m_mixBus.error();
             m_isPlayingContinue = false;
             return false;
         }
-
-        m_isPlayingContinue = true;
-
-#ifdef __linux__
-        } 
-        else 
+        if (!m_backend->play())
         {
-            // Launch the loop of the stream into another thread.
-            m_tStream = std::thread(&LoopbackStream::streamLoop, this);
-            m_isPlayingContinue = true;
+            m_mixBus.stop();
+            m_strError = m_backend->error();
+            m_isPlayingContinue = false;
+            return false;
         }
-#endif
 
+        m_isPlayingContinue = true;
         return true;
     }
     else
@@ -293,8 +317,9 @@ bool LoopbackStream::play()
 void LoopbackStream::stop()
 {
     // Stopping the stream.
-    if (m_stream)
-        Pa_StopStream(m_stream);
+    if (m_backend)
+        m_backend->stop();
+    m_mixBus.stop();
     m_isPlayingContinue = false;
 }
 
@@ -305,14 +330,47 @@ bool LoopbackStream::isStreamReady() const
 
 bool LoopbackStream::isPlayingContinue() const
 {
-    return m_isPlayingContinue;
+    // The backends can stop by themselves (failure, end of file).
+    return m_isPlayingContinue && m_backend && m_backend->isPlayingContinue();
+}
+
+const std::string& LoopbackStream::error() const
+{
+    // The error of a backend stopping by itself is kept in the backend.
+    if (m_backend && !m_backend->error().empty())
+        return m_backend->error();
+    return m_strError;
 }
 
 void LoopbackStream::setSampleRate(int sampleRate)
 {
     if (sampleRate < 16000)
         return;
-    m_sampleRate = sampleRate;
+    m_config.sampleRate = sampleRate;
+}
+
+void LoopbackStream::setOutputSampleRate(int sampleRate)
+{
+    if (sampleRate < 16000)
+        return;
+    m_config.outputSampleRate = sampleRate;
+}
+
+void LoopbackStream::setResamplerQuality(ResamplerQuality quality)
+{
+    m_config.resamplerQuality = quality;
+}
+
+void LoopbackStream::setDriftCompensation(bool value)
+{
+    m_config.isDriftCompensation = value;
+}
+
+void LoopbackStream::setMaxLatency(double maxLatency)
+{
+    if (maxLatency < 0.0)
+        return;
+    m_config.maxLatency = maxLatency;
 }
 
 void LoopbackStream::setFramesPerBuffer(int framesPerBuffer)
@@ -320,25 +378,289 @@ void LoopbackStream::setFramesPerBuffer(int framesPerBuffer)
     // Update number of frames per buffer.
     if (framesPerBuffer <= 0)
         return;
-    m_streamFramePerBuffer = framesPerBuffer;
-    m_inputBufferSize = m_streamFramePerBuffer * m_sizePerSample * m_channelsCount;
+    m_config.framesPerBuffer = framesPerBuffer;
+}
+
+void LoopbackStream::setChannelsCount(int channelsCount)
+{
+    if (channelsCount <= 0)
+        return;
+    m_config.channelsCount = channelsCount;
+}
+
+void LoopbackStream::setSampleFormat(SampleFormat format)
+{
+    m_config.sampleFormat = format;
+}
+
+void LoopbackStream::setApi(StreamApi api)
+{
+    m_api = api;
+}
+
+void LoopbackStream::setLatencyMeasurement(int burstsCount)
+{
+    // Must be set before init(), the audio thread use the meter without lock.
+    delete m_latencyMeter;
+    m_latencyMeter = burstsCount > 0 ? new LatencyMeter(burstsCount) : nullptr;
+}
+
+void LoopbackStream::setAdaptiveBuffer(int minPeriods, int maxPeriods)
+{
+    // Must be set before init().
+    delete m_bufferController;
+    m_bufferController = nullptr;
+    if (minPeriods > 0 && maxPeriods >= minPeriods)
+        m_bufferController = new BufferController(minPeriods, maxPeriods);
+}
+
+const BufferController* LoopbackStream::bufferController() const
+{
+    return m_isAdaptiveBufferActive ? m_bufferController : nullptr;
+}
+
+bool LoopbackStream::updateAdaptiveBuffer()
+{
+    if (!m_isAdaptiveBufferActive || !m_backend)
+        return false;
+
+    unsigned long underruns = m_backend->counters().outputUnderflows.load(std::memory_order_relaxed);
+    if (!m_bufferController->update(underruns))
+        return false;
+    return m_backend->setBufferPeriods(m_bufferController->periods());
+}
+
+void LoopbackStream::setProcessing(const ProcessingSettings& settings)
+{
+    // Must be set before init(), the chain is built with the backend.
+    m_processingSettings = settings;
+}
+
+void LoopbackStream::setProcessingExecutor(ProcessingExecutor* executor)
+{
+    m_processingExecutor = executor;
+}
+
+void LoopbackStream::setMixSources(const std::vector<MixSourceSettings>& sources, double bufferTime)
+{
+    m_mixSources = sources;
+    m_mixBufferTime = bufferTime;
+}
+
+const MixBus* LoopbackStream::mixBus() const
+{
+    return m_mixBus.isEmpty() ? nullptr : &m_mixBus;
+}
+
+const ProcessingChain* LoopbackStream::processingChain() const
+{
+    return m_processingChain.isEmpty() ? nullptr : &m_processingChain;
+}
+
+LatencyMeter* LoopbackStream::latencyMeter() const
+{
+    return m_latencyMeter;
+}
+
+void LoopbackStream::setInputFile(const std::string& path)
+{
+    m_config.inputFile = path;
+}
+
+void LoopbackStream::setOutputFile(const std::string& path)
+{
+    m_config.outputFile = path;
+}
+
+void LoopbackStream::setFileRealtime(bool value)
+{
+    m_config.isFileRealtime = value;
+}
+
+void LoopbackStream::setSimulatedDrift(double ppm)
+{
+    m_config.simulatedDrift = ppm;
 }
 
 #ifdef WIN32
 void LoopbackStream::setInputLatency(double inputLatency)
 {
     if (inputLatency > 0.0)
-        m_inputLatency = inputLatency;
+        m_config.inputLatency = inputLatency;
 }
 
 void LoopbackStream::setOutputLatency(double outputLatency)
 {
     if (outputLatency > 0.0)
-        m_outputLatency = outputLatency;
+        m_config.outputLatency = outputLatency;
 }
 #elif __linux__
-void LoopbackStream::usePortAudio(bool value)
+void LoopbackStream::setRingBufferPeriods(int periods)
 {
-    m_usePortAudio = value;
+    // At least two periods are needed to decouple the capture from the playback.
+    if (periods < 2)
+        return;
+    m_config.ringBufferPeriods = periods;
 }
+
 #endif
+
+void LoopbackStream::setInputDevice(const std::string& device)
+{
+    m_config.inputDevice = device;
+}
+
+void LoopbackStream::setOutputDevice(const std::string& device)
+{
+    m_config.outputDevice = device;
+}
+
+bool LoopbackStream::listDevices(std::vector<DeviceInfo>* devices)
+{
+    AudioBackend* backend = createBackend();
+    if (!backend)
+    {
+        m_strError = std::string("The API ") + streamApiName(m_api) + " is not available.";
+        return false;
+    }
+    bool isListed = loadDevices(backend, false, devices);
+    delete backend;
+    return isListed;
+}
+
+bool LoopbackStream::loadDevices(AudioBackend* backend, bool isCacheUsed, std::vector<DeviceInfo>* devices)
+{
+    // The APIs listing their devices quickly are not cached.
+    std::string hardware = backend->devicesHardware();
+    std::string fingerprint = deviceFingerprint(hardware);
+    std::string path = deviceCachePath(m_api);
+    if (!hardware.empty() && isCacheUsed && loadDeviceCache(path, fingerprint, devices))
+        return true;
+
+    if (!backend->probeDevices(devices))
+    {
+        m_strError = backend->error();
+        return false;
+    }
+    if (!hardware.empty())
+        saveDeviceCache(path, fingerprint, *devices);
+    return true;
+}
+
+bool LoopbackStream::resolveDevices(AudioBackend* backend, StreamConfig* config)
+{
+    std::vector<DeviceInfo> devices;
+    if (!loadDevices(backend, true, &devices))
+        return false;
+
+    for (int direction = 0; direction < 2; direction++)
+    {
+        bool isInput = direction == 0;
+        std::string& selector = isInput ? config->inputDevice : config->outputDevice;
+        if (selector.empty())
+            continue;
+
+        const std::string directionName = isInput ? "capture" : "playback";
+        const DeviceInfo* device = findDevice(devices, selector, isInput);
+        if (!device)
+        {
+            // The other names are given to the API as they are, ALSA open any PCM.
+            if (!isDeviceIndex(selector))
+                continue;
+            m_strError = "There is no " + directionName + " device " + selector + ", see --list-devices.";
+            return false;
+        }
+
+        // The capabilities are unknown when the probe could not open the device.
+        int sampleRate = !isInput && config->outputSampleRate > 0 ? config->outputSampleRate : config->sampleRate;
+        if (device->channelsCount > 0 && config->channelsCount > device->channelsCount)
+        {
+            m_strError = "The " + directionName + " device " + device->id + " has only " + std::to_string(device->channelsCount) + " channels.";
+            return false;
+        }
+        if (!device->sampleRates.empty() && 
+            std::find(device->sampleRates.begin(), device->sampleRates.end(), sampleRate) == device->sampleRates.end())
+        {
+            m_strError = "The " + directionName + " device " + device->id + " does not support " + std::to_string(sampleRate) + " Hz, its rates are:";
+            for (size_t i = 0; i < device->sampleRates.size(); i++)
+                m_strError += (i > 0 ? ", " : " ") + std::to_string(device->sampleRates[i]);
+            m_strError += ".";
+            return false;
+        }
+        selector = device->id;
+    }
+    return true;
+}
+
+int LoopbackStream::sampleRate() const
+{
+    return m_backend ? m_backend->sampleRate() : m_config.sampleRate;
+}
+
+int LoopbackStream::outputSampleRate() const
+{
+    if (m_backend)
+        return m_backend->outputSampleRate();
+    return m_config.outputSampleRate > 0 ? m_config.outputSampleRate : m_config.sampleRate;
+}
+
+double LoopbackStream::resamplerLatency() const
+{
+    return m_backend ? m_backend->resamplerLatency() : 0.0;
+}
+
+const DriftController* LoopbackStream::driftController() const
+{
+    return m_backend ? m_backend->driftController() : nullptr;
+}
+
+const LatencyCeiling* LoopbackStream::latencyCeiling() const
+{
+    return m_backend ? m_backend->latencyCeiling() : nullptr;
+}
+
+size_t LoopbackStream::ringBufferPeriods() const
+{
+    return m_backend ? m_backend->ringBufferPeriods() : 0;
+}
+
+double LoopbackStream::ringBufferFill() const
+{
+    return m_backend ? m_backend->ringBufferFill() : 0.0;
+}
+
+unsigned long LoopbackStream::ringBufferOverruns() const
+{
+    return m_backend ? m_backend->ringBufferOverruns() : 0;
+}
+
+unsigned long LoopbackStream::ringBufferUnderruns() const
+{
+    return m_backend ? m_backend->ringBufferUnderruns() : 0;
+}
+
+unsigned long LoopbackStream::xrunsCount() const
+{
+    return m_backend ? m_backend->xrunsCount() : 0;
+}
+
+const StreamCounters* LoopbackStream::counters() const
+{
+    return m_backend ? &m_backend->counters() : nullptr;
+}
+
+const TimingHistogram* LoopbackStream::timing() const
+{
+    return m_backend ? &m_backend->timing() : nullptr;
+}
+
+double LoopbackStream::cpuLoad() const
+{
+    return m_backend ? m_backend->cpuLoad() : -1.0;
+}
+
+void LoopbackStream::printSummary(std::ostream& stream) const
+{
+    if (m_backend)
+        m_backend->printSummary(stream);
+}
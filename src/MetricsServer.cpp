@@ -0,0 +1,305 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MetricsServer.h"
+#include "LatencyCeiling.h"
+#include "LoopbackStream.h"
+#include <cstring>
+#include <sstream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace
+{
+    // Interval at which the server check if it must stop.
+    const int POLL_TIMEOUT_MS = 200;
+    // Time given to a client to send its request.
+    const int REQUEST_TIMEOUT_MS = 100;
+
+    // Samples of a metric, its help and type are written once for all the routes.
+    struct MetricFamily
+    {
+        const char* name;
+        const char* type;
+        const char* help;
+        std::vector<std::pair<std::string, double>> samples;
+    };
+
+    void writeMetric(std::vector<MetricFamily>& families, const std::string& labels, 
+        const char* name, const char* type, const char* help, double value)
+    {
+        for (MetricFamily& family : families)
+        {
+            if (strcmp(family.name, name) == 0)
+            {
+                family.samples.push_back(std::make_pair(labels, value));
+                return;
+            }
+        }
+        MetricFamily family = { name, type, help, {} };
+        family.samples.push_back(std::make_pair(labels, value));
+        families.push_back(family);
+    }
+
+    void writeStreamMetrics(std::vector<MetricFamily>& families, const std::string& labels, const LoopbackStream* loopbackStream)
+    {
+        const StreamCounters* counters = loopbackStream->counters();
+        if (!counters)
+            return;
+
+        writeMetric(families, labels, "microphoneloopback_frames_processed_total", "counter", 
+            "Frames looped back from the microphone to the speakers.", 
+            static_cast<double>(counters->framesProcessed.load(std::memory_order_relaxed)));
+        writeMetric(families, labels, "microphoneloopback_xruns_total", "counter", 
+            "Xruns recovered by the ALSA API or reported by the JACK server.", 
+            static_cast<double>(loopbackStream->xrunsCount()));
+        writeMetric(families, labels, "microphoneloopback_input_overflows_total", "counter", 
+            "Captured periods lost because they were not read in time.", 
+            static_cast<double>(counters->inputOverflows.load(std::memory_order_relaxed)));
+        writeMetric(families, labels, "microphoneloopback_output_underflows_total", "counter", 
+            "Periods of silence played because the frames were not written in time.", 
+            static_cast<double>(counters->outputUnderflows.load(std::memory_order_relaxed)));
+
+        const LatencyCeiling* latencyCeiling = loopbackStream->latencyCeiling();
+        if (latencyCeiling)
+        {
+            writeMetric(families, labels, "microphoneloopback_catch_ups_total", "counter", 
+                "Times the latency went over the maximum and frames were dropped to catch up.", 
+                static_cast<double>(latencyCeiling->catchUpsCount()));
+            writeMetric(families, labels, "microphoneloopback_dropped_frames_total", "counter", 
+                "Frames dropped to catch up with the maximum latency.", 
+                static_cast<double>(latencyCeiling->droppedFrames()));
+        }
+
+        if (loopbackStream->ringBufferPeriods() > 0)
+            writeMetric(families, labels, "microphoneloopback_buffer_fill_periods", "gauge", 
+                "Periods waiting in the ring buffer between the capture and the playback.", 
+                loopbackStream->ringBufferFill());
+
+        long inputLatency = counters->inputLatency.load(std::memory_order_relaxed);
+        if (inputLatency >= 0)
+            writeMetric(families, labels, "microphoneloopback_input_latency_seconds", "gauge", 
+                "Latency of the capture device.", inputLatency / 1e6);
+        long outputLatency = counters->outputLatency.load(std::memory_order_relaxed);
+        if (outputLatency >= 0)
+            writeMetric(families, labels, "microphoneloopback_output_latency_seconds", "gauge", 
+                "Latency of the playback device.", outputLatency / 1e6);
+
+        const BufferController* bufferController = loopbackStream->bufferController();
+        if (bufferController)
+        {
+            writeMetric(families, labels, "microphoneloopback_adaptive_buffer_periods", "gauge", 
+                "Current buffering of the adaptive buffer.", static_cast<double>(bufferController->periods()));
+            writeMetric(families, labels, "microphoneloopback_adaptive_buffer_min_periods", "gauge", 
+                "Lower bound of the adaptive buffer.", static_cast<double>(bufferController->minPeriods()));
+            writeMetric(families, labels, "microphoneloopback_adaptive_buffer_max_periods", "gauge", 
+                "Upper bound of the adaptive buffer.", static_cast<double>(bufferController->maxPeriods()));
+        }
+
+        const ProcessingChain* processingChain = loopbackStream->processingChain();
+        if (processingChain)
+            writeMetric(families, labels, "microphoneloopback_processing_latency_seconds", "gauge", 
+                "Delay added by the processing stages.", static_cast<double>(processingChain->latency()) / processingChain->sampleRate());
+        if (loopbackStream->resamplerLatency() > 0.0)
+            writeMetric(families, labels, "microphoneloopback_resampler_latency_seconds", "gauge", 
+                "Delay added by the resampler of the playback.", loopbackStream->resamplerLatency());
+        const DriftController* driftController = loopbackStream->driftController();
+        if (driftController)
+        {
+            writeMetric(families, labels, "microphoneloopback_drift_correction_ratio", "gauge", 
+                "Correction of the resampling ratio following the drift between the devices.", driftController->correction());
+            writeMetric(families, labels, "microphoneloopback_drift_buffer_seconds", "gauge", 
+                "Filtered level of the buffer held by the drift compensation.", driftController->level());
+        }
+
+        double cpuLoad = loopbackStream->cpuLoad();
+        if (cpuLoad >= 0.0)
+            writeMetric(families, labels, "microphoneloopback_cpu_load_ratio", "gauge", 
+                "Fraction of the period spent in the audio callback.", cpuLoad);
+    }
+}
+
+MetricsServer::MetricsServer() :
+    m_socket(-1),
+    m_isRunning(false)
+{}
+
+MetricsServer::~MetricsServer()
+{
+    stop();
+}
+
+bool MetricsServer::start(const std::string& path)
+{
+    stop();
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+    {
+        m_strError = "Invalid metrics socket path.";
+        return false;
+    }
+    strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    m_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_socket < 0)
+    {
+        m_strError = "Failed to create the metrics socket.";
+        return false;
+    }
+
+    // A socket file left by a previous instance is replaced.
+    unlink(path.c_str());
+    if (bind(m_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(m_socket, 4) < 0)
+    {
+        m_strError = "Failed to listen on the metrics socket " + path + ".";
+        close(m_socket);
+        m_socket = -1;
+        return false;
+    }
+
+    m_path = path;
+    m_start = std::chrono::steady_clock::now();
+    m_isRunning = true;
+    m_tServer = std::thread(&MetricsServer::serverLoop, this);
+    return true;
+}
+
+void MetricsServer::stop()
+{
+    m_isRunning = false;
+    if (m_tServer.joinable())
+        m_tServer.join();
+
+    if (m_socket >= 0)
+    {
+        close(m_socket);
+        m_socket = -1;
+        unlink(m_path.c_str());
+    }
+}
+
+void MetricsServer::addStream(const LoopbackStream* stream, const std::string& route)
+{
+    std::lock_guard<std::mutex> lock(m_streamsMutex);
+    m_streams.push_back(std::make_pair(route, stream));
+}
+
+void MetricsServer::removeStream(const LoopbackStream* stream)
+{
+    std::lock_guard<std::mutex> lock(m_streamsMutex);
+    for (size_t i = 0; i < m_streams.size(); i++)
+    {
+        if (m_streams[i].second == stream)
+        {
+            m_streams.erase(m_streams.begin() + i);
+            return;
+        }
+    }
+}
+
+const std::string& MetricsServer::error() const
+{
+    return m_strError;
+}
+
+void MetricsServer::serverLoop()
+{
+    while (m_isRunning)
+    {
+        pollfd pollSocket = {};
+        pollSocket.fd = m_socket;
+        pollSocket.events = POLLIN;
+        if (poll(&pollSocket, 1, POLL_TIMEOUT_MS) <= 0)
+            continue;
+
+        int client = accept(m_socket, nullptr, nullptr);
+        if (client < 0)
+            continue;
+        serveClient(client);
+        close(client);
+    }
+}
+
+void MetricsServer::serveClient(int client)
+{
+    // Wait a little for an HTTP request, a client sending nothing get the raw metrics.
+    bool isHttp = false;
+    pollfd pollClient = {};
+    pollClient.fd = client;
+    pollClient.events = POLLIN;
+    if (poll(&pollClient, 1, REQUEST_TIMEOUT_MS) > 0)
+    {
+        char request[1024];
+        ssize_t size = recv(client, request, sizeof(request) - 1, 0);
+        if (size > 0)
+        {
+            request[size] = '\0';
+            isHttp = strncmp(request, "GET ", 4) == 0;
+        }
+    }
+
+    std::string body = metrics();
+    std::string response;
+    if (isHttp)
+    {
+        response = "HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: " + std::to_string(body.size()) + "\r\n"
+            "Connection: close\r\n\r\n";
+    }
+    response += body;
+
+    size_t offset = 0;
+    while (offset < response.size())
+    {
+        ssize_t written = send(client, response.data() + offset, response.size() - offset, MSG_NOSIGNAL);
+        if (written <= 0)
+            break;
+        offset += static_cast<size_t>(written);
+    }
+}
+
+std::string MetricsServer::metrics() const
+{
+    std::vector<MetricFamily> families;
+    double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    writeMetric(families, std::string(), "microphoneloopback_uptime_seconds", "gauge", 
+        "Time since the metrics server started.", uptime);
+    {
+        std::lock_guard<std::mutex> lock(m_streamsMutex);
+        for (const std::pair<std::string, const LoopbackStream*>& stream : m_streams)
+            writeStreamMetrics(families, stream.first.empty() ? std::string() : "{route=\"" + stream.first + "\"}", stream.second);
+    }
+
+    std::ostringstream stream;
+    // The counters are printed without exponent.
+    stream.precision(15);
+    for (const MetricFamily& family : families)
+    {
+        stream << "# HELP " << family.name << " " << family.help << "\n";
+        stream << "# TYPE " << family.name << " " << family.type << "\n";
+        for (const std::pair<std::string, double>& sample : family.samples)
+            stream << family.name << sample.first << " " << sample.second << "\n";
+    }
+    return stream.str();
+}
@@ -0,0 +1,334 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MixBus.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+
+static const double PI = 3.14159265358979323846;
+
+MixSourceSettings::MixSourceSettings() :
+    gain(0.0),
+    pan(0.0),
+    isMuted(false)
+{}
+
+void accumulateFrames(float* output, const float* input, float gain, unsigned long frames)
+{
+    unsigned long i = 0;
+#if defined(MLB_AVX2)
+    const __m256 gains = _mm256_set1_ps(gain);
+    for (; i + 8 <= frames; i += 8)
+    {
+        __m256 sum = _mm256_add_ps(_mm256_loadu_ps(output + i), _mm256_mul_ps(_mm256_loadu_ps(input + i), gains));
+        _mm256_storeu_ps(output + i, sum);
+    }
+#elif defined(MLB_SSE2)
+    const __m128 gains = _mm_set1_ps(gain);
+    for (; i + 4 <= frames; i += 4)
+    {
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(output + i), _mm_mul_ps(_mm_loadu_ps(input + i), gains));
+        _mm_storeu_ps(output + i, sum);
+    }
+#elif defined(MLB_NEON)
+    const float32x4_t gains = vdupq_n_f32(gain);
+    for (; i + 4 <= frames; i += 4)
+        vst1q_f32(output + i, vmlaq_f32(vld1q_f32(output + i), vld1q_f32(input + i), gains));
+#endif
+    for (; i < frames; i++)
+        output[i] += input[i] * gain;
+}
+
+MixSource::MixSource(const MixSourceSettings& settings) :
+    m_settings(settings),
+    m_sampleRate(48000),
+    m_maxFrames(0),
+    m_targetFrames(0),
+    m_isPrimed(false),
+    m_gain(static_cast<float>(std::pow(10.0, settings.gain / 20.0))),
+    m_isMuted(settings.isMuted),
+    m_underruns(0),
+    m_realignments(0),
+    m_overflows(0)
+{}
+
+MixSource::~MixSource()
+{}
+
+bool MixSource::init(int channelsCount, int sampleRate, unsigned long maxFrames, double bufferTime)
+{
+    if (channelsCount <= 0 || sampleRate <= 0 || maxFrames == 0)
+        return false;
+
+    m_sampleRate = sampleRate;
+    m_maxFrames = maxFrames;
+    m_targetFrames = std::max(static_cast<unsigned long>(bufferTime * sampleRate), maxFrames);
+
+    // Room for twice the target and a few periods of jitter of the capture.
+    size_t periodsCount = (2 * m_targetFrames + maxFrames - 1) / maxFrames + 4;
+    if (!m_ring.init(maxFrames * sizeof(float), periodsCount))
+        return false;
+    m_buffer.assign(maxFrames, 0.0f);
+
+    // Constant power pan between the first two channels, the other channels are not fed.
+    m_panGains.assign(channelsCount, 0.0f);
+    if (channelsCount == 1)
+        m_panGains[0] = 1.0f;
+    else
+    {
+        double angle = (std::min(std::max(m_settings.pan, -1.0), 1.0) + 1.0) * PI / 4.0;
+        m_panGains[0] = static_cast<float>(std::cos(angle));
+        m_panGains[1] = static_cast<float>(std::sin(angle));
+    }
+
+    reset();
+    return true;
+}
+
+void MixSource::reset()
+{
+    m_ring.reset();
+    m_isPrimed = false;
+    m_underruns = 0;
+    m_realignments = 0;
+    m_overflows = 0;
+}
+
+void MixSource::write(const float* frames, unsigned long count)
+{
+    size_t size = count * sizeof(float);
+    if (m_ring.availableWrite() < size)
+    {
+        // The stream stopped reading, the newest frames are lost.
+        m_overflows.fetch_add(1, std::memory_order_relaxed);
+        size = m_ring.availableWrite() / sizeof(float) * sizeof(float);
+    }
+
+    if (frames)
+    {
+        m_ring.write(frames, size);
+        return;
+    }
+
+    // A hole in the capture is filled with silence.
+    static const float SILENCE[256] = {};
+    while (size > 0)
+    {
+        size_t part = std::min(size, sizeof(SILENCE));
+        m_ring.write(SILENCE, part);
+        size -= part;
+    }
+}
+
+void MixSource::mix(float* const* planes, unsigned long frames)
+{
+    unsigned long available = static_cast<unsigned long>(m_ring.availableRead() / sizeof(float));
+    if (!m_isPrimed)
+    {
+        if (available < m_targetFrames)
+            return;
+        m_isPrimed = true;
+    }
+
+    // The source got ahead of the stream (a burst of the capture or a faster clock).
+    if (available > 2 * m_targetFrames + frames)
+    {
+        skip(available - m_targetFrames - frames);
+        available = m_targetFrames + frames;
+        m_realignments.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    unsigned long count = std::min(std::min(frames, available), m_maxFrames);
+    if (count < frames)
+    {
+        m_underruns.fetch_add(1, std::memory_order_relaxed);
+        m_isPrimed = false;
+    }
+    m_ring.read(m_buffer.data(), count * sizeof(float));
+
+    if (m_isMuted.load(std::memory_order_relaxed))
+        return;
+    float gain = m_gain.load(std::memory_order_relaxed);
+    for (size_t c = 0; c < m_panGains.size(); c++)
+    {
+        if (m_panGains[c] != 0.0f)
+            accumulateFrames(planes[c], m_buffer.data(), gain * m_panGains[c], count);
+    }
+}
+
+void MixSource::skip(unsigned long frames)
+{
+    while (frames > 0)
+    {
+        unsigned long count = std::min(frames, m_maxFrames);
+        m_ring.read(m_buffer.data(), count * sizeof(float));
+        frames -= count;
+    }
+}
+
+const MixSourceSettings& MixSource::settings() const
+{
+    return m_settings;
+}
+
+void MixSource::setMuted(bool isMuted)
+{
+    m_isMuted = isMuted;
+}
+
+void MixSource::setGain(double gain)
+{
+    m_gain = static_cast<float>(std::pow(10.0, gain / 20.0));
+}
+
+double MixSource::level() const
+{
+    return static_cast<double>(m_ring.availableRead() / sizeof(float)) / m_sampleRate;
+}
+
+double MixSource::targetLevel() const
+{
+    return static_cast<double>(m_targetFrames) / m_sampleRate;
+}
+
+unsigned long MixSource::underruns() const
+{
+    return m_underruns.load(std::memory_order_relaxed);
+}
+
+unsigned long MixSource::realignments() const
+{
+    return m_realignments.load(std::memory_order_relaxed);
+}
+
+unsigned long MixSource::overflows() const
+{
+    return m_overflows.load(std::memory_order_relaxed);
+}
+
+MixBus::MixBus()
+{}
+
+MixBus::~MixBus()
+{
+    clear();
+}
+
+void MixBus::addSource(MixSource* source, MixCapture* capture)
+{
+    if (!source || !capture)
+    {
+        delete source;
+        delete capture;
+        return;
+    }
+    m_sources.push_back(source);
+    m_captures.push_back(capture);
+}
+
+void MixBus::clear()
+{
+    deinit();
+    for (MixCapture* capture : m_captures)
+        delete capture;
+    for (MixSource* source : m_sources)
+        delete source;
+    m_captures.clear();
+    m_sources.clear();
+}
+
+bool MixBus::isEmpty() const
+{
+    return m_sources.empty();
+}
+
+bool MixBus::init(int channelsCount, int sampleRate, unsigned long maxFrames, double bufferTime)
+{
+    deinit();
+    for (size_t i = 0; i < m_sources.size(); i++)
+    {
+        const std::string& name = m_sources[i]->settings().name;
+        if (!m_sources[i]->init(channelsCount, sampleRate, maxFrames, bufferTime))
+        {
+            m_strError = "Failed to initialize the mix source " + name + ".";
+            return false;
+        }
+        if (!m_captures[i]->init(m_sources[i]->settings().device, sampleRate, maxFrames, m_sources[i]))
+        {
+            m_strError = "Mix source " + name + ": " + m_captures[i]->error();
+            deinit();
+            return false;
+        }
+    }
+    return true;
+}
+
+void MixBus::deinit()
+{
+    for (MixCapture* capture : m_captures)
+        capture->deinit();
+}
+
+bool MixBus::play()
+{
+    // The rings are filled before the stream start reading them.
+    for (size_t i = 0; i < m_sources.size(); i++)
+    {
+        m_sources[i]->reset();
+        if (!m_captures[i]->play())
+        {
+            m_strError = "Mix source " + m_sources[i]->settings().name + ": " + m_captures[i]->error();
+            stop();
+            return false;
+        }
+    }
+    return true;
+}
+
+void MixBus::stop()
+{
+    for (MixCapture* capture : m_captures)
+        capture->stop();
+}
+
+void MixBus::mix(float* const* planes, unsigned long frames)
+{
+    for (MixSource* source : m_sources)
+        source->mix(planes, frames);
+}
+
+size_t MixBus::sourcesCount() const
+{
+    return m_sources.size();
+}
+
+const MixSource& MixBus::source(size_t index) const
+{
+    return *m_sources[index];
+}
+
+bool MixBus::isSourcePlaying(size_t index) const
+{
+    return m_captures[index]->isPlayingContinue();
+}
+
+const std::string& MixBus::error() const
+{
+    return m_strError;
+}
@@ -0,0 +1,338 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "PipeWireBackend.h"
+#include <cstring>
+
+// Largest quantum of the PipeWire graph.
+#define PIPEWIRE_MAX_QUANTUM 8192
+
+// Port data of the filter, nothing is needed besides the PipeWire handle.
+struct PipeWirePort
+{
+    void* unused;
+};
+
+PipeWireBackend::PipeWireBackend() :
+    m_isPipeWireInit(false),
+    m_loop(nullptr),
+    m_filter(nullptr),
+    m_isPlayingContinue(false),
+    m_graphRate(0)
+{
+    memset(&m_filterEvents, 0, sizeof(m_filterEvents));
+    m_filterEvents.version = PW_VERSION_FILTER_EVENTS;
+    m_filterEvents.state_changed = PipeWireBackend::staticStateChangedCallback;
+    m_filterEvents.process = PipeWireBackend::staticProcessCallback;
+}
+
+PipeWireBackend::~PipeWireBackend()
+{
+    deinit();
+}
+
+bool PipeWireBackend::init(const StreamConfig& config)
+{
+    deinit();
+    m_config = config;
+
+    pw_init(nullptr, nullptr);
+    m_isPipeWireInit = true;
+
+    m_loop = pw_thread_loop_new("MicrophoneLoopback", nullptr);
+    if (!m_loop)
+    {
+        m_strError = "Failed to create the PipeWire loop.";
+        deinit();
+        return false;
+    }
+
+    // The node latency ask the graph to run at a quantum of frames per buffer, the node rate at the sample rate.
+    std::string latency = std::to_string(m_config.framesPerBuffer) + "/" + std::to_string(m_config.sampleRate);
+    std::string rate = "1/" + std::to_string(m_config.sampleRate);
+    struct pw_properties* properties = pw_properties_new(
+        PW_KEY_MEDIA_TYPE, "Audio",
+        PW_KEY_MEDIA_CATEGORY, "Duplex",
+        PW_KEY_MEDIA_ROLE, "DSP",
+        PW_KEY_NODE_LATENCY, latency.c_str(),
+        PW_KEY_NODE_RATE, rate.c_str(),
+        PW_KEY_NODE_AUTOCONNECT, "true",
+        nullptr);
+
+    pw_thread_loop_lock(m_loop);
+
+    m_filter = pw_filter_new_simple(
+        pw_thread_loop_get_loop(m_loop),
+        "MicrophoneLoopback",
+        properties,
+        &m_filterEvents,
+        static_cast<void*>(this));
+    if (!m_filter)
+    {
+        pw_thread_loop_unlock(m_loop);
+        m_strError = "Failed to create the PipeWire filter.";
+        deinit();
+        return false;
+    }
+
+    // One input and one output port per channel.
+    for (int i = 0; i < m_config.channelsCount; i++)
+    {
+        std::string inputName = "input_" + std::to_string(i + 1);
+        std::string outputName = "output_" + std::to_string(i + 1);
+        void* inputPort = pw_filter_add_port(
+            m_filter,
+            PW_DIRECTION_INPUT,
+            PW_FILTER_PORT_FLAG_MAP_BUFFERS,
+            sizeof(PipeWirePort),
+            pw_properties_new(
+                PW_KEY_FORMAT_DSP, "32 bit float mono audio",
+                PW_KEY_PORT_NAME, inputName.c_str(),
+                nullptr),
+            nullptr, 0);
+        void* outputPort = pw_filter_add_port(
+            m_filter,
+            PW_DIRECTION_OUTPUT,
+            PW_FILTER_PORT_FLAG_MAP_BUFFERS,
+            sizeof(PipeWirePort),
+            pw_properties_new(
+                PW_KEY_FORMAT_DSP, "32 bit float mono audio",
+                PW_KEY_PORT_NAME, outputName.c_str(),
+                nullptr),
+            nullptr, 0);
+        if (!inputPort || !outputPort)
+        {
+            pw_thread_loop_unlock(m_loop);
+            m_strError = "Failed to create the PipeWire ports.";
+            deinit();
+            return false;
+        }
+        m_inputPorts.push_back(inputPort);
+        m_outputPorts.push_back(outputPort);
+    }
+
+    // The quantum can be up to 8192 frames, the interleaving buffers are never allocated in the process callback.
+    if (m_config.channelsCount > 1)
+    {
+        if (!m_converter.init(SampleFormat::Float32, m_config.channelsCount))
+        {
+            pw_thread_loop_unlock(m_loop);
+            m_strError = "Unsupported number of channels.";
+            deinit();
+            return false;
+        }
+        m_inputData.assign(PIPEWIRE_MAX_QUANTUM * m_config.channelsCount, 0.0f);
+        m_outputData.assign(PIPEWIRE_MAX_QUANTUM * m_config.channelsCount, 0.0f);
+        m_inputPlanes.assign(m_config.channelsCount, nullptr);
+        m_outputPlanes.assign(m_config.channelsCount, nullptr);
+        m_silence.assign(PIPEWIRE_MAX_QUANTUM, 0.0f);
+        m_discard.assign(PIPEWIRE_MAX_QUANTUM, 0.0f);
+    }
+
+    // The filter is connected inactive, it is activated by play().
+    int err = pw_filter_connect(
+        m_filter,
+        static_cast<pw_filter_flags>(PW_FILTER_FLAG_RT_PROCESS | PW_FILTER_FLAG_INACTIVE),
+        nullptr, 0);
+    pw_thread_loop_unlock(m_loop);
+
+    if (err < 0)
+    {
+        m_strError = "Failed to connect the PipeWire filter.";
+        deinit();
+        return false;
+    }
+
+    if (pw_thread_loop_start(m_loop) < 0)
+    {
+        m_strError = "Failed to start the PipeWire loop.";
+        deinit();
+        return false;
+    }
+
+    return true;
+}
+
+void PipeWireBackend::deinit()
+{
+    stop();
+
+    if (m_loop)
+        pw_thread_loop_stop(m_loop);
+    if (m_filter)
+    {
+        pw_filter_destroy(m_filter);
+        m_filter = nullptr;
+    }
+    m_inputPorts.clear();
+    m_outputPorts.clear();
+    m_inputData.clear();
+    m_outputData.clear();
+    m_inputPlanes.clear();
+    m_outputPlanes.clear();
+    m_silence.clear();
+    m_discard.clear();
+    if (m_loop)
+    {
+        pw_thread_loop_destroy(m_loop);
+        m_loop = nullptr;
+    }
+    if (m_isPipeWireInit)
+    {
+        pw_deinit();
+        m_isPipeWireInit = false;
+    }
+}
+
+bool PipeWireBackend::play()
+{
+    if (!m_filter)
+    {
+        m_strError = "The stream is not ready.";
+        return false;
+    }
+
+    pw_thread_loop_lock(m_loop);
+    m_isPlayingContinue = true;
+    m_graphRate = 0;
+    int err = pw_filter_set_active(m_filter, true);
+    pw_thread_loop_unlock(m_loop);
+
+    if (err < 0)
+    {
+        m_isPlayingContinue = false;
+        m_strError = "Failed to activate the PipeWire filter.";
+        return false;
+    }
+    return true;
+}
+
+void PipeWireBackend::stop()
+{
+    // Reported here, the process callback cannot write the error.
+    uint32_t graphRate = m_graphRate.load(std::memory_order_acquire);
+    if (graphRate != 0)
+    {
+        m_strError = "The PipeWire graph runs at " + std::to_string(graphRate) + " Hz instead of " 
+            + std::to_string(m_config.sampleRate) + " Hz, set the sample rate of the graph or --sample-rate.";
+        m_graphRate = 0;
+    }
+
+    if (!m_filter || !m_isPlayingContinue)
+    {
+        m_isPlayingContinue = false;
+        return;
+    }
+
+    pw_thread_loop_lock(m_loop);
+    m_isPlayingContinue = false;
+    pw_filter_set_active(m_filter, false);
+    pw_thread_loop_unlock(m_loop);
+}
+
+void PipeWireBackend::staticProcessCallback(void* userData, struct spa_io_position* position)
+{
+    // redirecting this function to the member function of PipeWireBackend.
+    PipeWireBackend* pStream = static_cast<PipeWireBackend*>(userData);
+    PeriodTime begin = periodBegin();
+    pStream->processCallback(position);
+    pStream->periodEnd(begin, static_cast<unsigned long>(position->clock.duration));
+}
+
+void PipeWireBackend::processCallback(struct spa_io_position* position)
+{
+    // Called from the realtime thread of the graph.
+    uint32_t nframes = static_cast<uint32_t>(position->clock.duration);
+    size_t channelsCount = m_inputPorts.size();
+
+    // The node rate is only a request, the stages are built for the sample rate and would be wrong at another.
+    if (position->clock.rate.denom != static_cast<uint32_t>(m_config.sampleRate) && position->clock.rate.denom != 0)
+    {
+        playSilence(nframes);
+        if (m_isPlayingContinue)
+        {
+            m_graphRate.store(position->clock.rate.denom, std::memory_order_release);
+            m_isPlayingContinue = false;
+        }
+        return;
+    }
+
+    // With a single channel, the port buffers are sent directly to the processor.
+    if (channelsCount == 1)
+    {
+        const float* input = static_cast<const float*>(pw_filter_get_dsp_buffer(m_inputPorts[0], nframes));
+        float* output = static_cast<float*>(pw_filter_get_dsp_buffer(m_outputPorts[0], nframes));
+        if (!output)
+            return;
+        // An unlinked input port has no buffer.
+        if (input)
+            process(input, output, nframes);
+        else
+            memset(output, 0, nframes * sizeof(float));
+        return;
+    }
+
+    if (nframes > PIPEWIRE_MAX_QUANTUM)
+    {
+        // The buffers would overflow, play silence instead of the previous cycle.
+        playSilence(nframes);
+        return;
+    }
+
+    // Interleaving the ports, processing and deinterleaving.
+    for (size_t i = 0; i < channelsCount; i++)
+    {
+        float* input = static_cast<float*>(pw_filter_get_dsp_buffer(m_inputPorts[i], nframes));
+        float* output = static_cast<float*>(pw_filter_get_dsp_buffer(m_outputPorts[i], nframes));
+        m_inputPlanes[i] = input ? input : m_silence.data();
+        m_outputPlanes[i] = output ? output : m_discard.data();
+    }
+    m_converter.interleave(m_inputPlanes.data(), m_inputData.data(), nframes);
+    process(m_inputData.data(), m_outputData.data(), nframes);
+    m_converter.deinterleave(m_outputData.data(), m_outputPlanes.data(), nframes);
+}
+
+void PipeWireBackend::playSilence(uint32_t nframes)
+{
+    for (void* port : m_outputPorts)
+    {
+        float* output = static_cast<float*>(pw_filter_get_dsp_buffer(port, nframes));
+        if (output)
+            memset(output, 0, nframes * sizeof(float));
+    }
+}
+
+void PipeWireBackend::staticStateChangedCallback(void* userData, enum pw_filter_state oldState, enum pw_filter_state state, const char* error)
+{
+    PipeWireBackend* pStream = static_cast<PipeWireBackend*>(userData);
+    if (state == PW_FILTER_STATE_ERROR)
+    {
+        pStream->m_strError = std::string("PipeWire filter error: ") + (error ? error : "unknown");
+        pStream->m_isPlayingContinue = false;
+    }
+}
+
+bool PipeWireBackend::isPlayingContinue() const
+{
+    return m_isPlayingContinue;
+}
+
+SampleFormat PipeWireBackend::sampleFormat() const
+{
+    return SampleFormat::Float32;
+}
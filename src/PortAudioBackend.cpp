@@ -0,0 +1,402 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "PortAudioBackend.h"
+#include "Tracer.h"
+#include <algorithm>
+
+static PaSampleFormat paSampleFormat(SampleFormat format)
+{
+    switch (format)
+    {
+    case SampleFormat::Int24:
+        return paInt24;
+    case SampleFormat::Int32:
+        return paInt32;
+    case SampleFormat::Float32:
+        return paFloat32;
+    default:
+        return paInt16;
+    }
+}
+
+// Name of a device, unique as long as a host API does not have two devices of the same name.
+static std::string portAudioDeviceName(const PaDeviceInfo* info)
+{
+    const PaHostApiInfo* hostApi = Pa_GetHostApiInfo(info->hostApi);
+    return std::string(hostApi ? hostApi->name : "?") + ": " + info->name;
+}
+
+// Default device of the direction when the name is empty, paNoDevice when no device has this name.
+static PaDeviceIndex findPortAudioDevice(const std::string& name, bool isInput)
+{
+    if (name.empty())
+        return isInput ? Pa_GetDefaultInputDevice() : Pa_GetDefaultOutputDevice();
+
+    for (PaDeviceIndex index = 0; index < Pa_GetDeviceCount(); index++)
+    {
+        const PaDeviceInfo* info = Pa_GetDeviceInfo(index);
+        if (info && (isInput ? info->maxInputChannels : info->maxOutputChannels) > 0 && portAudioDeviceName(info) == name)
+            return index;
+    }
+    return paNoDevice;
+}
+
+PortAudioBackend::PortAudioBackend() :
+    m_stream(nullptr),
+    m_isPlayingContinue(false)
+{}
+
+PortAudioBackend::~PortAudioBackend()
+{
+    deinit();
+}
+
+bool PortAudioBackend::init(const StreamConfig& config)
+{
+    deinit();
+    m_config = config;
+
+    int err = paNoError;
+
+    PaDeviceIndex inputDevice = findPortAudioDevice(m_config.inputDevice, true);
+    PaDeviceIndex outputDevice = findPortAudioDevice(m_config.outputDevice, false);
+    if (inputDevice == paNoDevice || outputDevice == paNoDevice)
+    {
+        m_strError = std::string("There is no PortAudio ") + (inputDevice == paNoDevice ? "capture" : "playback") + " device named " + 
+            (inputDevice == paNoDevice ? m_config.inputDevice : m_config.outputDevice) + ".";
+        return false;
+    }
+
+    // Creating the input stream with the input device.
+    PaStreamParameters inputStreamParams = {};
+    inputStreamParams.device = inputDevice;
+    inputStreamParams.channelCount = m_config.channelsCount;
+    inputStreamParams.sampleFormat = paSampleFormat(m_config.sampleFormat);
+#ifdef WIN32
+    inputStreamParams.suggestedLatency = m_config.inputLatency;
+#elif __linux__
+    inputStreamParams.suggestedLatency = 0.;
+#endif
+    inputStreamParams.hostApiSpecificStreamInfo = nullptr;
+
+    PaStreamParameters outputStreamParams = {};
+    outputStreamParams.device = outputDevice;
+    outputStreamParams.channelCount = m_config.channelsCount;
+    outputStreamParams.sampleFormat = paSampleFormat(m_config.sampleFormat);
+#ifdef WIN32
+    outputStreamParams.suggestedLatency = m_config.outputLatency;
+#elif __linux__
+    outputStreamParams.suggestedLatency = 0.;
+#endif
+    outputStreamParams.hostApiSpecificStreamInfo = nullptr;
+
+    err = Pa_OpenStream(
+        &m_stream,
+        &inputStreamParams,
+        &outputStreamParams,
+        m_config.sampleRate,
+        m_config.framesPerBuffer,
+        paClipOff,
+        PortAudioBackend::staticInputCallback,
+        static_cast<void*>(this));
+
+    if (err != paNoError)
+    {
+        m_stream = nullptr;
+        m_strError = "Failed to create the input stream.";
+        return false;
+    }
+
+    return true;
+}
+
+void PortAudioBackend::deinit()
+{
+    stop();
+
+    if (m_stream)
+    {
+        Pa_CloseStream(m_stream);
+        m_stream = nullptr;
+    }
+}
+
+bool PortAudioBackend::play()
+{
+    if (!m_stream)
+    {
+        m_strError = "The stream is not ready.";
+        return false;
+    }
+
+    int err = Pa_StartStream(m_stream);
+    if (err != paNoError)
+    {
+        m_strError = "Failed to start the input stream.";
+        m_isPlayingContinue = false;
+        return false;
+    }
+
+    m_isPlayingContinue = true;
+    return true;
+}
+
+void PortAudioBackend::stop()
+{
+    // Stopping the stream.
+    if (m_stream && m_isPlayingContinue)
+        Pa_StopStream(m_stream);
+    m_isPlayingContinue = false;
+}
+
+bool PortAudioBackend::isPlayingContinue() const
+{
+    return m_isPlayingContinue;
+}
+
+double PortAudioBackend::cpuLoad() const
+{
+    if (!m_stream)
+        return -1.0;
+    return Pa_GetStreamCpuLoad(m_stream);
+}
+
+bool PortAudioBackend::isDeviceSelectionSupported() const
+{
+    return true;
+}
+
+bool PortAudioBackend::probeDevices(std::vector<DeviceInfo>* devices)
+{
+    devices->clear();
+    for (int direction = 0; direction < 2; direction++)
+    {
+        bool isInput = direction == 0;
+        for (PaDeviceIndex index = 0; index < Pa_GetDeviceCount(); index++)
+        {
+            const PaDeviceInfo* info = Pa_GetDeviceInfo(index);
+            int channelsCount = info ? (isInput ? info->maxInputChannels : info->maxOutputChannels) : 0;
+            if (channelsCount <= 0)
+                continue;
+
+            DeviceInfo device;
+            device.id = portAudioDeviceName(info);
+            device.description = info->name;
+            device.isInput = isInput;
+            device.channelsCount = channelsCount;
+            device.defaultSampleRate = static_cast<int>(info->defaultSampleRate);
+            device.lowLatency = isInput ? info->defaultLowInputLatency : info->defaultLowOutputLatency;
+
+            // Stereo is tested when possible, some devices refuse to open a single channel.
+            PaStreamParameters params = {};
+            params.device = index;
+            params.channelCount = std::min(channelsCount, 2);
+            params.sampleFormat = paInt16;
+            params.suggestedLatency = device.lowLatency;
+            for (int rate : standardSampleRates())
+            {
+                if (Pa_IsFormatSupported(isInput ? &params : nullptr, isInput ? nullptr : &params, rate) == paFormatIsSupported)
+                    device.sampleRates.push_back(rate);
+            }
+            devices->push_back(device);
+        }
+    }
+    return true;
+}
+
+std::string PortAudioBackend::devicesHardware() const
+{
+    // The devices found by Pa_Initialize(), only the test of their rates is cached.
+    std::string hardware = Pa_GetVersionText();
+    for (PaDeviceIndex index = 0; index < Pa_GetDeviceCount(); index++)
+    {
+        const PaDeviceInfo* info = Pa_GetDeviceInfo(index);
+        if (info)
+            hardware += "\n" + portAudioDeviceName(info) + " " + std::to_string(info->maxInputChannels) + " " + std::to_string(info->maxOutputChannels);
+    }
+    return hardware;
+}
+
+int PortAudioBackend::staticInputCallback(
+    const void *inputBuffer,
+    void *outputBuffer,
+    unsigned long framesPerBuffer,
+    const PaStreamCallbackTimeInfo* timeInfo,
+    PaStreamCallbackFlags statusFlags,
+    void *userData)
+{
+    // redirectint this function to the member function of PortAudioBackend.
+    PortAudioBackend* lStream = static_cast<PortAudioBackend*>(userData);
+    return lStream->inputCallback(inputBuffer, outputBuffer, framesPerBuffer, timeInfo, statusFlags);
+}
+
+int PortAudioBackend::inputCallback(
+    const void* inputBuffer, 
+    void* outputBuffer, 
+    unsigned long framesPerBuffer,
+    const PaStreamCallbackTimeInfo* timeInfo,
+    PaStreamCallbackFlags statusFlags)
+{
+    PeriodTime begin = periodBegin();
+
+    // Glitches reported by PortAudio since the last callback.
+    if (statusFlags & paInputOverflow)
+    {
+        m_counters.inputOverflows.fetch_add(1, std::memory_order_relaxed);
+        Tracer::instant("input overflow");
+    }
+    if (statusFlags & paOutputUnderflow)
+    {
+        m_counters.outputUnderflows.fetch_add(1, std::memory_order_relaxed);
+        Tracer::instant("output underflow");
+    }
+    // The missing input replaced by zeros and the output discarded are only traced, the counters do not describe them.
+    if (statusFlags & paInputUnderflow)
+        Tracer::instant("input underflow");
+    if (statusFlags & paOutputOverflow)
+        Tracer::instant("output overflow");
+    if (statusFlags & paPrimingOutput)
+        m_counters.primingOutputs.fetch_add(1, std::memory_order_relaxed);
+
+    // Latency of the devices, some host APIs do not provide the timestamps.
+    if (timeInfo && timeInfo->currentTime > 0.0)
+    {
+        if (timeInfo->inputBufferAdcTime > 0.0)
+            m_counters.inputLatency.store(
+                static_cast<long>((timeInfo->currentTime - timeInfo->inputBufferAdcTime) * 1000000.0), 
+                std::memory_order_relaxed);
+        if (timeInfo->outputBufferDacTime > 0.0)
+            m_counters.outputLatency.store(
+                static_cast<long>((timeInfo->outputBufferDacTime - timeInfo->currentTime) * 1000000.0), 
+                std::memory_order_relaxed);
+    }
+
+    process(inputBuffer, outputBuffer, framesPerBuffer);
+
+    // The period must be ready before the DAC start to play it.
+    double deadline = 0.0;
+    if (timeInfo && timeInfo->outputBufferDacTime > timeInfo->currentTime && timeInfo->currentTime > 0.0)
+        deadline = timeInfo->outputBufferDacTime - timeInfo->currentTime;
+    periodEnd(begin, framesPerBuffer, deadline);
+    return paContinue;
+}
+
+PortAudioCapture::PortAudioCapture() :
+    m_stream(nullptr),
+    m_source(nullptr),
+    m_isPlayingContinue(false)
+{}
+
+PortAudioCapture::~PortAudioCapture()
+{
+    deinit();
+}
+
+bool PortAudioCapture::init(const std::string& device, int sampleRate, unsigned long framesPerBuffer, MixSource* source)
+{
+    deinit();
+    m_source = source;
+
+    PaDeviceIndex inputDevice = findPortAudioDevice(device, true);
+    if (inputDevice == paNoDevice)
+    {
+        m_strError = "There is no PortAudio capture device named " + device + ".";
+        return false;
+    }
+
+    // The sources are mixed in mono float, PortAudio convert the format and the channels.
+    PaStreamParameters inputStreamParams = {};
+    inputStreamParams.device = inputDevice;
+    inputStreamParams.channelCount = 1;
+    inputStreamParams.sampleFormat = paFloat32;
+    inputStreamParams.suggestedLatency = Pa_GetDeviceInfo(inputDevice)->defaultLowInputLatency;
+    inputStreamParams.hostApiSpecificStreamInfo = nullptr;
+
+    int err = Pa_OpenStream(
+        &m_stream,
+        &inputStreamParams,
+        nullptr,
+        sampleRate,
+        framesPerBuffer,
+        paClipOff,
+        PortAudioCapture::staticInputCallback,
+        static_cast<void*>(this));
+
+    if (err != paNoError)
+    {
+        m_stream = nullptr;
+        m_strError = std::string("Failed to create the input stream (") + Pa_GetErrorText(err) + ").";
+        return false;
+    }
+    return true;
+}
+
+void PortAudioCapture::deinit()
+{
+    stop();
+
+    if (m_stream)
+    {
+        Pa_CloseStream(m_stream);
+        m_stream = nullptr;
+    }
+}
+
+bool PortAudioCapture::play()
+{
+    if (!m_stream)
+    {
+        m_strError = "The stream is not ready.";
+        return false;
+    }
+
+    if (Pa_StartStream(m_stream) != paNoError)
+    {
+        m_strError = "Failed to start the input stream.";
+        return false;
+    }
+    m_isPlayingContinue = true;
+    return true;
+}
+
+void PortAudioCapture::stop()
+{
+    if (m_stream && m_isPlayingContinue)
+        Pa_StopStream(m_stream);
+    m_isPlayingContinue = false;
+}
+
+bool PortAudioCapture::isPlayingContinue() const
+{
+    return m_isPlayingContinue && m_stream && Pa_IsStreamActive(m_stream) == 1;
+}
+
+int PortAudioCapture::staticInputCallback(
+    const void *inputBuffer,
+    void *outputBuffer,
+    unsigned long framesPerBuffer,
+    const PaStreamCallbackTimeInfo* timeInfo,
+    PaStreamCallbackFlags statusFlags,
+    void *userData)
+{
+    // A null input buffer is written as silence.
+    PortAudioCapture* capture = static_cast<PortAudioCapture*>(userData);
+    capture->m_source->write(static_cast<const float*>(inputBuffer), framesPerBuffer);
+    return paContinue;
+}
@@ -0,0 +1,450 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ProcessingChain.h"
+#include "DynamicsStage.h"
+#include "EqualizerStage.h"
+#include "GainStage.h"
+#include "HowlStage.h"
+#include "Simd.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+// Names of the stages, the order is the one of the help.
+static const char* PROCESSING_STAGES[] = {"gain", "eq", "howl", "dynamics"};
+
+ProcessingSettings::ProcessingSettings() :
+    gain(0.0),
+    howlNotches(6),
+    howlDepth(18.0),
+    howlRelease(10.0),
+    gateThreshold(-60.0),
+    compressorThreshold(-18.0),
+    compressorRatio(3.0),
+    limiterCeiling(-1.0),
+    lookahead(2.0)
+{}
+
+bool processingStagesFromString(const std::string& list, std::vector<std::string>* stages)
+{
+    if (!stages)
+        return false;
+
+    std::vector<std::string> names;
+    size_t begin = 0;
+    while (begin <= list.size())
+    {
+        size_t end = list.find(',', begin);
+        if (end == std::string::npos)
+            end = list.size();
+
+        // Trimming the spaces around the name.
+        size_t first = list.find_first_not_of(" \t", begin);
+        size_t last = list.find_last_not_of(" \t", end - 1);
+        if (first != std::string::npos && first < end && last >= first)
+        {
+            std::string name = list.substr(first, last - first + 1);
+            if (std::find(std::begin(PROCESSING_STAGES), std::end(PROCESSING_STAGES), name) == std::end(PROCESSING_STAGES))
+                return false;
+            names.push_back(name);
+        }
+        else if (end < list.size())
+        {
+            // Empty name between two commas.
+            return false;
+        }
+        begin = end + 1;
+    }
+
+    *stages = names;
+    return true;
+}
+
+std::string availableProcessingStages()
+{
+    std::string stages;
+    for (const char* name : PROCESSING_STAGES)
+    {
+        if (!stages.empty())
+            stages += ", ";
+        stages += name;
+    }
+    return stages;
+}
+
+ProcessingStage* createProcessingStage(const std::string& name, const ProcessingSettings& settings)
+{
+    if (name == "gain")
+        return new GainStage(settings.gain);
+    if (name == "eq")
+        return new EqualizerStage(settings.eqBands);
+    if (name == "howl")
+        return new HowlStage(settings.howlNotches, settings.howlDepth, settings.howlRelease);
+    if (name == "dynamics")
+        return new DynamicsStage(settings.gateThreshold, settings.compressorThreshold, settings.compressorRatio, 
+            settings.limiterCeiling, settings.lookahead);
+    return nullptr;
+}
+
+ProcessingChain::ProcessingChain() :
+    m_frameSize(0),
+    m_maxFrames(0),
+    m_executor(nullptr),
+    m_partFrames(0),
+    m_serialPeriods(0),
+    m_mixBus(nullptr),
+    m_sampleRate(48000),
+    m_periodDuration(0)
+{}
+
+ProcessingChain::~ProcessingChain()
+{
+    clear();
+}
+
+void ProcessingChain::addStage(ProcessingStage* stage)
+{
+    if (!stage)
+        return;
+    m_stages.push_back(stage);
+    m_timings.push_back(new TimingHistogram());
+    m_durations.push_back(0);
+}
+
+void ProcessingChain::setExecutor(ProcessingExecutor* executor)
+{
+    m_executor = executor;
+}
+
+void ProcessingChain::setMixBus(MixBus* mixBus)
+{
+    m_mixBus = mixBus;
+}
+
+void ProcessingChain::clear()
+{
+    for (ProcessingStage* stage : m_stages)
+        delete stage;
+    for (TimingHistogram* timing : m_timings)
+        delete timing;
+    for (TimingHistogram* timing : m_nodeTimings)
+        delete timing;
+    m_stages.clear();
+    m_timings.clear();
+    m_durations.clear();
+    m_data.clear();
+    m_planes.clear();
+    m_nodes.clear();
+    m_nodeTimings.clear();
+    m_nodeDurations.clear();
+    clearNodes();
+}
+
+bool ProcessingChain::isEmpty() const
+{
+    return m_stages.empty() && !m_mixBus;
+}
+
+bool ProcessingChain::init(SampleFormat format, int channelsCount, int sampleRate, unsigned long maxFrames)
+{
+    if (sampleRate <= 0 || maxFrames == 0 || !m_converter.init(format, channelsCount))
+    {
+        m_strError = "Unsupported stream format for the processing chain.";
+        return false;
+    }
+
+    m_frameSize = channelsCount * sampleFormatSize(format);
+    m_maxFrames = maxFrames;
+    m_sampleRate = sampleRate;
+    m_periodDuration = static_cast<uint64_t>(maxFrames * 1000000000.0 / sampleRate);
+
+    // One plane per channel in a single allocation, on their own cache lines
+    // since they may be processed by different threads.
+    size_t stride = (static_cast<size_t>(maxFrames) + 15) & ~static_cast<size_t>(15);
+    m_data.assign(static_cast<size_t>(channelsCount) * stride, 0.0f);
+    m_planes.resize(channelsCount);
+    for (int c = 0; c < channelsCount; c++)
+        m_planes[c] = m_data.data() + static_cast<size_t>(c) * stride;
+
+    for (ProcessingStage* stage : m_stages)
+    {
+        if (!stage->init(sampleRate, channelsCount, maxFrames))
+        {
+            m_strError = std::string("Failed to initialize the processing stage ") + stage->name() + ".";
+            return false;
+        }
+    }
+
+    buildGraph(channelsCount);
+    reset();
+    return true;
+}
+
+void ProcessingChain::buildGraph(int channelsCount)
+{
+    for (TimingHistogram* timing : m_nodeTimings)
+        delete timing;
+    m_nodes.clear();
+    m_nodeTimings.clear();
+    m_nodeDurations.clear();
+    clearNodes();
+
+    // Without a stage split by channel, the graph would be the serial chain.
+    bool isParallel = false;
+    for (ProcessingStage* stage : m_stages)
+        isParallel = isParallel || stage->isChannelIndependent();
+    if (!m_executor || m_executor->threadsCount() == 0 || channelsCount < 2 || !isParallel)
+        return;
+
+    // Nodes of the previous stage which wrote each channel.
+    std::vector<std::vector<size_t>> writers(channelsCount);
+    for (size_t i = 0; i < m_stages.size(); i++)
+    {
+        Node node;
+        node.stage = i;
+        if (m_stages[i]->isChannelIndependent())
+        {
+            for (int c = 0; c < channelsCount; c++)
+            {
+                node.channel = c;
+                m_nodes.push_back(node);
+                size_t index = addNode(writers[c]);
+                writers[c].assign(1, index);
+            }
+        }
+        else
+        {
+            // The stage read all the channels.
+            std::vector<size_t> dependencies;
+            for (const std::vector<size_t>& channelWriters : writers)
+                dependencies.insert(dependencies.end(), channelWriters.begin(), channelWriters.end());
+            std::sort(dependencies.begin(), dependencies.end());
+            dependencies.erase(std::unique(dependencies.begin(), dependencies.end()), dependencies.end());
+
+            node.channel = -1;
+            m_nodes.push_back(node);
+            size_t index = addNode(dependencies);
+            for (std::vector<size_t>& channelWriters : writers)
+                channelWriters.assign(1, index);
+        }
+    }
+
+    for (size_t i = 0; i < m_nodes.size(); i++)
+        m_nodeTimings.push_back(new TimingHistogram());
+    m_nodeDurations.assign(m_nodes.size(), 0);
+}
+
+void ProcessingChain::reset()
+{
+    for (ProcessingStage* stage : m_stages)
+        stage->reset();
+    for (TimingHistogram* timing : m_timings)
+        timing->reset();
+    for (TimingHistogram* timing : m_nodeTimings)
+        timing->reset();
+    m_mixTiming.reset();
+    m_serialPeriods = 0;
+}
+
+void ProcessingChain::process(const void* input, void* output, unsigned long frames)
+{
+    typedef std::chrono::steady_clock Clock;
+
+#ifdef MLB_SSE2
+    // The recursive filters decay into denormals on silence, they are flushed to zero.
+    unsigned int csr = _mm_getcsr();
+    _mm_setcsr(csr | 0x8040);
+#endif
+
+    for (uint64_t& duration : m_durations)
+        duration = 0;
+    for (uint64_t& duration : m_nodeDurations)
+        duration = 0;
+    bool isSerial = false;
+    uint64_t mixDuration = 0;
+
+    // Periods longer than the buffers are processed in several parts.
+    const char* inputData = static_cast<const char*>(input);
+    char* outputData = static_cast<char*>(output);
+    for (unsigned long offset = 0; offset < frames; offset += m_maxFrames)
+    {
+        unsigned long count = frames - offset < m_maxFrames ? frames - offset : m_maxFrames;
+        m_converter.deinterleave(inputData + offset * m_frameSize, m_planes.data(), count);
+
+        if (!m_nodes.empty())
+        {
+            // The nodes are run in index order when the workers are busy with another stream.
+            m_partFrames = count;
+            if (!m_executor->run(*this))
+            {
+                isSerial = true;
+                for (size_t i = 0; i < m_nodes.size(); i++)
+                    runNode(i);
+            }
+        }
+        else
+        {
+            Clock::time_point begin = Clock::now();
+            for (size_t i = 0; i < m_stages.size(); i++)
+            {
+                Tracer::begin(m_stages[i]->name());
+                m_stages[i]->process(m_planes.data(), count);
+                Tracer::end(m_stages[i]->name());
+                Clock::time_point end = Clock::now();
+                m_durations[i] += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+                begin = end;
+            }
+        }
+
+        // The sources are summed in float, the frames are converted once.
+        if (m_mixBus)
+        {
+            Clock::time_point begin = Clock::now();
+            Tracer::begin("mix");
+            m_mixBus->mix(m_planes.data(), count);
+            Tracer::end("mix");
+            mixDuration += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count());
+        }
+
+        m_converter.interleave(m_planes.data(), outputData + offset * m_frameSize, count);
+    }
+
+    // The time of a stage split in nodes is the sum of its nodes, its cost in cpu time.
+    uint64_t deadline = static_cast<uint64_t>(frames * 1000000000.0 / m_sampleRate);
+    for (size_t i = 0; i < m_nodes.size(); i++)
+    {
+        m_nodeTimings[i]->record(m_nodeDurations[i], deadline);
+        m_durations[m_nodes[i].stage] += m_nodeDurations[i];
+    }
+    for (size_t i = 0; i < m_stages.size(); i++)
+        m_timings[i]->record(m_durations[i], deadline);
+    if (m_mixBus)
+        m_mixTiming.record(mixDuration, deadline);
+    if (isSerial)
+        m_serialPeriods.fetch_add(1, std::memory_order_relaxed);
+
+#ifdef MLB_SSE2
+    _mm_setcsr(csr);
+#endif
+}
+
+void ProcessingChain::runNode(size_t index)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const Node& node = m_nodes[index];
+    ProcessingStage* stage = m_stages[node.stage];
+    Clock::time_point begin = Clock::now();
+    Tracer::begin(stage->name());
+    if (node.channel < 0)
+        stage->process(m_planes.data(), m_partFrames);
+    else
+        stage->processChannel(node.channel, m_planes[node.channel], m_partFrames);
+    Tracer::end(stage->name());
+    m_nodeDurations[index] += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count());
+}
+
+size_t ProcessingChain::stagesCount() const
+{
+    return m_stages.size();
+}
+
+const char* ProcessingChain::stageName(size_t index) const
+{
+    return m_stages[index]->name();
+}
+
+const TimingHistogram& ProcessingChain::stageTiming(size_t index) const
+{
+    return *m_timings[index];
+}
+
+size_t ProcessingChain::stageFiltersCount(size_t index) const
+{
+    return m_stages[index]->filtersCount();
+}
+
+std::string ProcessingChain::stageReport(size_t index) const
+{
+    return m_stages[index]->report();
+}
+
+unsigned long ProcessingChain::latency() const
+{
+    unsigned long frames = 0;
+    for (ProcessingStage* stage : m_stages)
+        frames += stage->latency();
+    return frames;
+}
+
+int ProcessingChain::sampleRate() const
+{
+    return m_sampleRate;
+}
+
+uint64_t ProcessingChain::periodDuration() const
+{
+    return m_periodDuration;
+}
+
+size_t ProcessingChain::nodesCount() const
+{
+    return m_nodes.size();
+}
+
+size_t ProcessingChain::nodeStage(size_t index) const
+{
+    return m_nodes[index].stage;
+}
+
+int ProcessingChain::nodeChannel(size_t index) const
+{
+    return m_nodes[index].channel;
+}
+
+const TimingHistogram& ProcessingChain::nodeTiming(size_t index) const
+{
+    return *m_nodeTimings[index];
+}
+
+const ProcessingExecutor* ProcessingChain::executor() const
+{
+    return m_nodes.empty() ? nullptr : m_executor;
+}
+
+unsigned long ProcessingChain::serialPeriods() const
+{
+    return m_serialPeriods.load(std::memory_order_relaxed);
+}
+
+const MixBus* ProcessingChain::mixBus() const
+{
+    return m_mixBus;
+}
+
+const TimingHistogram& ProcessingChain::mixTiming() const
+{
+    return m_mixTiming;
+}
+
+const std::string& ProcessingChain::error() const
+{
+    return m_strError;
+}
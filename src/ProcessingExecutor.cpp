@@ -0,0 +1,426 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ProcessingExecutor.h"
+#include "Simd.h"
+#include "Tracer.h"
+
+#ifdef WIN32
+#include <windows.h>
+#elif __linux__
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Polls of a waiting thread before it sleeps.
+static const int SPIN_COUNT = 2000;
+// Priority of the workers, under the one of the audio threads of the sound servers.
+static const int WORKER_PRIORITY = 60;
+
+static inline void cpuRelax()
+{
+#if defined(MLB_SSE2)
+    _mm_pause();
+#elif defined(MLB_NEON)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Sleep while address holds value, or until it is woken.
+static void waitOnAddress(std::atomic<int32_t>* address, int32_t value)
+{
+#ifdef WIN32
+    WaitOnAddress(address, &value, sizeof(value), INFINITE);
+#elif __linux__
+    syscall(SYS_futex, reinterpret_cast<int32_t*>(address), FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+#else
+    if (address->load() == value)
+        std::this_thread::yield();
+#endif
+}
+
+static void wakeAddress(std::atomic<int32_t>* address)
+{
+#ifdef WIN32
+    WakeByAddressAll(address);
+#elif __linux__
+    syscall(SYS_futex, reinterpret_cast<int32_t*>(address), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#else
+    (void)address;
+#endif
+}
+
+// Pin the thread to a core and raise it to the realtime priority, false when the system refuse.
+static bool setWorkerPriority(std::thread& thread, int core)
+{
+#ifdef WIN32
+    HANDLE handle = static_cast<HANDLE>(thread.native_handle());
+    SetThreadAffinityMask(handle, static_cast<DWORD_PTR>(1) << (core % (sizeof(DWORD_PTR) * 8)));
+    return SetThreadPriority(handle, THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#elif __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+    sched_param param = {};
+    param.sched_priority = WORKER_PRIORITY;
+    return pthread_setschedparam(thread.native_handle(), SCHED_FIFO, &param) == 0;
+#else
+    (void)thread;
+    (void)core;
+    return false;
+#endif
+}
+
+ProcessingGraph::ProcessingGraph()
+{}
+
+ProcessingGraph::~ProcessingGraph()
+{}
+
+size_t ProcessingGraph::addNode(const std::vector<size_t>& dependencies)
+{
+    size_t index = m_successors.size();
+    m_successors.push_back(std::vector<size_t>());
+    m_dependenciesCounts.push_back(static_cast<int>(dependencies.size()));
+    for (size_t dependency : dependencies)
+        m_successors[dependency].push_back(index);
+    if (dependencies.empty())
+        m_roots.push_back(index);
+
+    m_pendings.reset(new std::atomic<int>[m_successors.size()]);
+    return index;
+}
+
+void ProcessingGraph::clearNodes()
+{
+    m_successors.clear();
+    m_dependenciesCounts.clear();
+    m_pendings.reset();
+    m_roots.clear();
+}
+
+size_t ProcessingGraph::nodesCount() const
+{
+    return m_successors.size();
+}
+
+ProcessingExecutor::Deque::Deque() :
+    m_top(0),
+    m_bottom(0),
+    m_nodes(new std::atomic<int32_t>[MAX_NODES])
+{}
+
+void ProcessingExecutor::Deque::push(int32_t node)
+{
+    // A node is pushed once per run and the deques are empty between the runs.
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    m_nodes[bottom & (MAX_NODES - 1)].store(node, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+}
+
+int32_t ProcessingExecutor::Deque::pop()
+{
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom)
+    {
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return NO_NODE;
+    }
+
+    int32_t node = m_nodes[bottom & (MAX_NODES - 1)].load(std::memory_order_relaxed);
+    if (top == bottom)
+    {
+        // Last node, racing with the thieves.
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            node = NO_NODE;
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return node;
+}
+
+int32_t ProcessingExecutor::Deque::steal()
+{
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = m_bottom.load(std::memory_order_acquire);
+    if (top >= bottom)
+        return NO_NODE;
+
+    int32_t node = m_nodes[top & (MAX_NODES - 1)].load(std::memory_order_relaxed);
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return NO_NODE;
+    return node;
+}
+
+ProcessingExecutor::ProcessingExecutor() :
+    m_isRealtime(false),
+    m_isRunning(false),
+    m_isBusy(false),
+    m_graph(nullptr),
+    m_runState(0),
+    m_remaining(0),
+    m_wakeSequence(0),
+    m_sleepingWorkers(0),
+    m_isCallerSleeping(false)
+{}
+
+ProcessingExecutor::~ProcessingExecutor()
+{
+    stop();
+}
+
+bool ProcessingExecutor::start(int threadsCount)
+{
+    stop();
+
+    if (threadsCount < 1 || threadsCount > MAX_THREADS)
+    {
+        m_strError = "The processing threads count must be between 1 and " + std::to_string(MAX_THREADS) + ".";
+        return false;
+    }
+
+    // A core is left to the audio threads, the workers would else take it while spinning.
+    unsigned int coresCount = std::thread::hardware_concurrency();
+    if (coresCount > 0 && threadsCount > static_cast<int>(coresCount) - 1)
+        threadsCount = static_cast<int>(coresCount) - 1;
+    if (threadsCount < 1)
+    {
+        m_strError = "The processing threads need at least two cores.";
+        return false;
+    }
+
+    m_deques.clear();
+    for (int i = 0; i <= threadsCount; i++)
+        m_deques.push_back(std::unique_ptr<Deque>(new Deque()));
+    m_runState = 0;
+    m_isRunning = true;
+
+    // The first core is left to the audio threads.
+    m_isRealtime = true;
+    for (int i = 1; i <= threadsCount; i++)
+    {
+        try
+        {
+            m_threads.push_back(std::thread(&ProcessingExecutor::workerLoop, this, i));
+        }
+        catch (...)
+        {
+            m_strError = "Failed to start the processing threads.";
+            stop();
+            return false;
+        }
+        int core = coresCount > 1 ? static_cast<int>(i % coresCount) : 0;
+        if (!setWorkerPriority(m_threads.back(), core))
+            m_isRealtime = false;
+    }
+    return true;
+}
+
+void ProcessingExecutor::stop()
+{
+    m_isRunning = false;
+    m_wakeSequence.fetch_add(1);
+    wakeAddress(&m_wakeSequence);
+    for (std::thread& thread : m_threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+    m_threads.clear();
+}
+
+int ProcessingExecutor::threadsCount() const
+{
+    return static_cast<int>(m_threads.size());
+}
+
+bool ProcessingExecutor::isRealtime() const
+{
+    return !m_threads.empty() && m_isRealtime;
+}
+
+bool ProcessingExecutor::run(ProcessingGraph& graph)
+{
+    size_t nodesCount = graph.nodesCount();
+    if (m_threads.empty() || nodesCount == 0 || nodesCount > MAX_NODES)
+        return false;
+    // Another stream is using the workers.
+    if (m_isBusy.exchange(true, std::memory_order_acquire))
+        return false;
+
+    for (size_t i = 0; i < nodesCount; i++)
+        graph.m_pendings[i].store(graph.m_dependenciesCounts[i], std::memory_order_relaxed);
+    m_graph = &graph;
+    m_remaining.store(static_cast<int32_t>(nodesCount), std::memory_order_relaxed);
+    for (size_t root : graph.m_roots)
+        m_deques[0]->push(static_cast<int32_t>(root));
+
+    // Opening the run, with a new sequence so the workers of the previous one cannot join it.
+    uint64_t sequence = (m_runState.load(std::memory_order_relaxed) >> SEQUENCE_SHIFT) + 1;
+    m_runState.store((sequence << SEQUENCE_SHIFT) | OPEN_FLAG, std::memory_order_seq_cst);
+    m_wakeSequence.fetch_add(1, std::memory_order_seq_cst);
+    if (m_sleepingWorkers.load(std::memory_order_seq_cst) > 0)
+        wakeAddress(&m_wakeSequence);
+
+    // Barrier: the caller run nodes until the graph is done, spinning then sleeping 
+    // when the nodes left are already running on the workers.
+    int spins = 0;
+    int32_t remaining;
+    while ((remaining = m_remaining.load(std::memory_order_acquire)) > 0)
+    {
+        int32_t node = findNode(0);
+        if (node != NO_NODE)
+        {
+            runNode(0, node);
+            spins = 0;
+        }
+        else if (++spins < SPIN_COUNT)
+            cpuRelax();
+        else
+        {
+            m_isCallerSleeping.store(true, std::memory_order_seq_cst);
+            waitOnAddress(&m_remaining, remaining);
+            m_isCallerSleeping.store(false, std::memory_order_relaxed);
+            spins = 0;
+        }
+    }
+
+    // Closing the run once no worker is in it.
+    uint64_t open = (sequence << SEQUENCE_SHIFT) | OPEN_FLAG;
+    uint64_t expected = open;
+    while (!m_runState.compare_exchange_weak(expected, sequence << SEQUENCE_SHIFT, std::memory_order_acq_rel))
+    {
+        expected = open;
+        cpuRelax();
+    }
+
+    m_graph = nullptr;
+    m_isBusy.store(false, std::memory_order_release);
+    return true;
+}
+
+const std::string& ProcessingExecutor::error() const
+{
+    return m_strError;
+}
+
+void ProcessingExecutor::workerLoop(int slot)
+{
+    Tracer::nameThread("processing worker");
+#ifdef MLB_SSE2
+    // Flushing the denormals to zero, like the audio thread running the chain.
+    _mm_setcsr(_mm_getcsr() | 0x8040);
+#endif
+
+    int32_t wakeSequence = m_wakeSequence.load(std::memory_order_acquire);
+    uint64_t lastSequence = 0;
+    while (m_isRunning.load(std::memory_order_acquire))
+    {
+        // Joining the open run, once.
+        uint64_t state = m_runState.load(std::memory_order_acquire);
+        uint64_t sequence = state >> SEQUENCE_SHIFT;
+        if ((state & OPEN_FLAG) && sequence != lastSequence &&
+            m_runState.compare_exchange_strong(state, state + 1, std::memory_order_acq_rel))
+        {
+            lastSequence = sequence;
+            work(slot);
+            m_runState.fetch_sub(1, std::memory_order_acq_rel);
+            continue;
+        }
+
+        // Waiting for the next run, spinning first.
+        bool isWoken = false;
+        for (int i = 0; i < SPIN_COUNT && !isWoken; i++)
+        {
+            cpuRelax();
+            isWoken = m_wakeSequence.load(std::memory_order_acquire) != wakeSequence;
+        }
+        if (!isWoken)
+        {
+            m_sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+            if (m_wakeSequence.load(std::memory_order_seq_cst) == wakeSequence)
+                waitOnAddress(&m_wakeSequence, wakeSequence);
+            m_sleepingWorkers.fetch_sub(1, std::memory_order_seq_cst);
+        }
+        wakeSequence = m_wakeSequence.load(std::memory_order_acquire);
+    }
+}
+
+void ProcessingExecutor::work(int slot)
+{
+    int spins = 0;
+    while (m_remaining.load(std::memory_order_acquire) > 0)
+    {
+        int32_t node = findNode(slot);
+        if (node != NO_NODE)
+        {
+            runNode(slot, node);
+            spins = 0;
+        }
+        else if (++spins < SPIN_COUNT)
+            cpuRelax();
+        else
+        {
+            // The nodes left are run by the other threads or wait for a long dependency,
+            // the caller always stays in the run to finish them.
+            return;
+        }
+    }
+}
+
+int32_t ProcessingExecutor::findNode(int slot)
+{
+    int32_t node = m_deques[slot]->pop();
+    if (node != NO_NODE)
+        return node;
+
+    // Stealing from the next threads first, so the thieves spread over the deques.
+    size_t count = m_deques.size();
+    for (size_t i = 1; i < count; i++)
+    {
+        node = m_deques[(slot + i) % count]->steal();
+        if (node != NO_NODE)
+            return node;
+    }
+    return NO_NODE;
+}
+
+void ProcessingExecutor::runNode(int slot, int32_t node)
+{
+    ProcessingGraph& graph = *m_graph;
+    graph.runNode(static_cast<size_t>(node));
+
+    // The successors whose last dependency was this node are ready.
+    for (size_t successor : graph.m_successors[node])
+    {
+        if (graph.m_pendings[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            m_deques[slot]->push(static_cast<int32_t>(successor));
+    }
+
+    if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1 && m_isCallerSleeping.load(std::memory_order_seq_cst))
+        wakeAddress(&m_remaining);
+}
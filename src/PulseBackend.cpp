@@ -0,0 +1,837 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "PulseBackend.h"
+#include "Resampler.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <cstring>
+
+static pa_sample_format_t pulseSampleFormat(SampleFormat format)
+{
+    switch (format)
+    {
+    case SampleFormat::Int24:
+        return PA_SAMPLE_S24LE;
+    case SampleFormat::Int32:
+        return PA_SAMPLE_S32LE;
+    case SampleFormat::Float32:
+        return PA_SAMPLE_FLOAT32LE;
+    default:
+        return PA_SAMPLE_S16LE;
+    }
+}
+
+namespace
+{
+    // Introspection of the server by probePulseDevices(), the two lists are pending until their end.
+    struct PulseProbe
+    {
+        std::vector<DeviceInfo>* devices;
+        int pendingLists;
+    };
+
+    void addPulseDevice(PulseProbe* probe, bool isInput, const char* name, const char* description, const pa_sample_spec& sampleSpec)
+    {
+        // The server convert any rate, the device rate is its default one.
+        DeviceInfo device;
+        device.id = name;
+        device.description = description ? description : name;
+        device.isInput = isInput;
+        device.channelsCount = sampleSpec.channels;
+        device.defaultSampleRate = static_cast<int>(sampleSpec.rate);
+        probe->devices->push_back(device);
+    }
+
+    void sourceInfoCallback(pa_context* context, const pa_source_info* info, int eol, void* userData)
+    {
+        PulseProbe* probe = static_cast<PulseProbe*>(userData);
+        if (eol)
+            probe->pendingLists--;
+        else if (info)
+            addPulseDevice(probe, true, info->name, info->description, info->sample_spec);
+    }
+
+    void sinkInfoCallback(pa_context* context, const pa_sink_info* info, int eol, void* userData)
+    {
+        PulseProbe* probe = static_cast<PulseProbe*>(userData);
+        if (eol)
+            probe->pendingLists--;
+        else if (info)
+            addPulseDevice(probe, false, info->name, info->description, info->sample_spec);
+    }
+}
+
+bool probePulseDevices(std::vector<DeviceInfo>* devices, std::string* error)
+{
+    // A blocking mainloop, the probe run in the main thread before the streams are created.
+    pa_mainloop* mainloop = pa_mainloop_new();
+    pa_context* context = mainloop ? pa_context_new(pa_mainloop_get_api(mainloop), "MicrophoneLoopback") : nullptr;
+    bool isOk = context && pa_context_connect(context, nullptr, PA_CONTEXT_NOFLAGS, nullptr) >= 0;
+    while (isOk)
+    {
+        pa_context_state_t state = pa_context_get_state(context);
+        if (state == PA_CONTEXT_READY)
+            break;
+        if (!PA_CONTEXT_IS_GOOD(state) || pa_mainloop_iterate(mainloop, 1, nullptr) < 0)
+            isOk = false;
+    }
+
+    if (isOk)
+    {
+        devices->clear();
+        PulseProbe probe = { devices, 0 };
+        pa_operation* operations[2] = {
+            pa_context_get_source_info_list(context, sourceInfoCallback, &probe),
+            pa_context_get_sink_info_list(context, sinkInfoCallback, &probe)
+        };
+        for (pa_operation* operation : operations)
+        {
+            if (operation)
+                probe.pendingLists++;
+            else
+                isOk = false;
+        }
+        while (probe.pendingLists > 0 && pa_mainloop_iterate(mainloop, 1, nullptr) >= 0)
+            ;
+        isOk = isOk && probe.pendingLists == 0;
+        for (pa_operation* operation : operations)
+        {
+            if (operation)
+                pa_operation_unref(operation);
+        }
+    }
+
+    if (!isOk)
+        *error = "Failed to list the devices of the PulseAudio server.";
+    if (context)
+    {
+        pa_context_disconnect(context);
+        pa_context_unref(context);
+    }
+    if (mainloop)
+        pa_mainloop_free(mainloop);
+    return isOk;
+}
+
+std::mutex PulseContext::s_mutex;
+PulseContext* PulseContext::s_instance = nullptr;
+
+PulseContext::PulseContext() :
+    m_mainloop(nullptr),
+    m_context(nullptr),
+    m_references(0)
+{}
+
+PulseContext::~PulseContext()
+{
+    // The mainloop thread must be stopped before releasing the context it use.
+    if (m_mainloop)
+        pa_threaded_mainloop_stop(m_mainloop);
+    if (m_context)
+    {
+        pa_context_disconnect(m_context);
+        pa_context_unref(m_context);
+    }
+    if (m_mainloop)
+        pa_threaded_mainloop_free(m_mainloop);
+}
+
+PulseContext* PulseContext::acquire(std::string* error)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+
+    // A lost connection is replaced, the routes still using it release it when they are restarted.
+    if (s_instance && !s_instance->isReady())
+        s_instance = nullptr;
+    if (!s_instance)
+    {
+        PulseContext* pulseContext = new PulseContext();
+        if (!pulseContext->connect(error))
+        {
+            delete pulseContext;
+            return nullptr;
+        }
+        s_instance = pulseContext;
+    }
+    s_instance->m_references++;
+    return s_instance;
+}
+
+void PulseContext::release(PulseContext* pulseContext)
+{
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (--pulseContext->m_references > 0)
+        return;
+    if (s_instance == pulseContext)
+        s_instance = nullptr;
+    delete pulseContext;
+}
+
+pa_threaded_mainloop* PulseContext::mainloop() const
+{
+    return m_mainloop;
+}
+
+pa_context* PulseContext::context() const
+{
+    return m_context;
+}
+
+bool PulseContext::isReady() const
+{
+    pa_threaded_mainloop_lock(m_mainloop);
+    bool isReady = pa_context_get_state(m_context) == PA_CONTEXT_READY;
+    pa_threaded_mainloop_unlock(m_mainloop);
+    return isReady;
+}
+
+bool PulseContext::connect(std::string* error)
+{
+    // Creating the mainloop and connecting to the server.
+    m_mainloop = pa_threaded_mainloop_new();
+    if (!m_mainloop)
+    {
+        *error = "Failed to create the PulseAudio mainloop.";
+        return false;
+    }
+
+    m_context = pa_context_new(pa_threaded_mainloop_get_api(m_mainloop), "MicrophoneLoopback");
+    if (!m_context)
+    {
+        *error = "Failed to create the PulseAudio context.";
+        return false;
+    }
+    pa_context_set_state_callback(m_context, PulseContext::staticStateCallback, static_cast<void*>(this));
+
+    if (pa_context_connect(m_context, nullptr, PA_CONTEXT_NOFLAGS, nullptr) < 0)
+    {
+        *error = "Failed to connect to the PulseAudio server.";
+        return false;
+    }
+
+    pa_threaded_mainloop_lock(m_mainloop);
+    if (pa_threaded_mainloop_start(m_mainloop) < 0)
+    {
+        pa_threaded_mainloop_unlock(m_mainloop);
+        *error = "Failed to start the PulseAudio mainloop.";
+        return false;
+    }
+
+    // Waiting for the context to be ready.
+    bool isReady = false;
+    for (;;)
+    {
+        pa_context_state_t state = pa_context_get_state(m_context);
+        if (state == PA_CONTEXT_READY)
+        {
+            isReady = true;
+            break;
+        }
+        if (state == PA_CONTEXT_FAILED || state == PA_CONTEXT_TERMINATED)
+            break;
+        pa_threaded_mainloop_wait(m_mainloop);
+    }
+    pa_threaded_mainloop_unlock(m_mainloop);
+
+    if (!isReady)
+        *error = "Failed to connect to the PulseAudio server.";
+    return isReady;
+}
+
+void PulseContext::staticStateCallback(pa_context* context, void* userData)
+{
+    // Wake up the thread waiting in connect(), the streams report the lost connection themselves.
+    pa_threaded_mainloop_signal(static_cast<PulseContext*>(userData)->m_mainloop, 0);
+}
+
+PulseBackend::PulseBackend() :
+    m_pulseContext(nullptr),
+    m_mainloop(nullptr),
+    m_context(nullptr),
+    m_inputStream(nullptr),
+    m_outputStream(nullptr),
+    m_periodSize(0),
+    m_outputPeriodSize(0),
+    m_frameSize(0),
+    m_isPlayingContinue(false)
+{}
+
+PulseBackend::~PulseBackend()
+{
+    deinit();
+}
+
+bool PulseBackend::init(const StreamConfig& config)
+{
+    deinit();
+    m_config = config;
+
+    // Stream specification.
+    pa_sample_spec sampleSpec;
+    sampleSpec.channels = m_config.channelsCount;
+    sampleSpec.format = pulseSampleFormat(m_config.sampleFormat);
+    sampleSpec.rate = m_config.sampleRate;
+    m_frameSize = pa_frame_size(&sampleSpec);
+    m_periodSize = m_config.framesPerBuffer * m_frameSize;
+
+    // The playback stream run at the output rate, the captured fragments are resampled after the processing.
+    if (!initResampler(m_config.sampleFormat, m_config.framesPerBuffer))
+        return false;
+    pa_sample_spec outputSampleSpec = sampleSpec;
+    outputSampleSpec.rate = outputSampleRate();
+    m_outputPeriodSize = resampledFrames(m_config.framesPerBuffer) * m_frameSize;
+    if (m_resampler)
+    {
+        m_processedData.assign(m_periodSize, 0);
+        m_resampledData.assign(m_resampler->maxOutputFrames() * m_frameSize, 0);
+    }
+
+    // The connection to the server is shared with the other routes of the process.
+    m_pulseContext = PulseContext::acquire(&m_strError);
+    if (!m_pulseContext)
+        return false;
+    m_mainloop = m_pulseContext->mainloop();
+    m_context = m_pulseContext->context();
+
+    pa_threaded_mainloop_lock(m_mainloop);
+    bool isConnected = connectStreams(sampleSpec, m_periodSize, outputSampleSpec, m_outputPeriodSize);
+    pa_threaded_mainloop_unlock(m_mainloop);
+
+    if (!isConnected)
+    {
+        deinit();
+        return false;
+    }
+
+    return true;
+}
+
+bool PulseBackend::connectStreams(const pa_sample_spec& inputSpec, size_t inputPeriodSize, const pa_sample_spec& outputSpec, size_t outputPeriodSize)
+{
+    // The server must honour the buffer attributes instead of picking its own latency.
+    pa_stream_flags_t flags = static_cast<pa_stream_flags_t>(
+        PA_STREAM_START_CORKED | 
+        PA_STREAM_ADJUST_LATENCY | 
+        PA_STREAM_INTERPOLATE_TIMING | 
+        PA_STREAM_AUTO_TIMING_UPDATE);
+
+    // Record buffer: the server send one fragment per period.
+    pa_buffer_attr inputAttribute;
+    inputAttribute.maxlength = static_cast<uint32_t>(-1);
+    inputAttribute.tlength = static_cast<uint32_t>(-1);
+    inputAttribute.prebuf = static_cast<uint32_t>(-1);
+    inputAttribute.minreq = static_cast<uint32_t>(-1);
+    inputAttribute.fragsize = inputPeriodSize;
+
+    // Playback buffer: two periods in the server, the playback start after the first one.
+    pa_buffer_attr outputAttribute;
+    outputAttribute.maxlength = static_cast<uint32_t>(-1);
+    outputAttribute.tlength = outputPeriodSize * 2;
+    outputAttribute.prebuf = outputPeriodSize;
+    outputAttribute.minreq = outputPeriodSize;
+    outputAttribute.fragsize = static_cast<uint32_t>(-1);
+
+    // Opening the input stream. (from the microphone.)
+    m_inputStream = pa_stream_new(m_context, "Microphone record", &inputSpec, nullptr);
+    if (!m_inputStream)
+    {
+        m_strError = "Failed to create the input stream.";
+        return false;
+    }
+    pa_stream_set_state_callback(m_inputStream, PulseBackend::staticStreamStateCallback, static_cast<void*>(this));
+    const char* inputDevice = m_config.inputDevice.empty() ? nullptr : m_config.inputDevice.c_str();
+    if (pa_stream_connect_record(m_inputStream, inputDevice, &inputAttribute, flags) < 0 ||
+        !waitStreamReady(m_inputStream))
+    {
+        m_strError = "Failed to start the input stream.";
+        return false;
+    }
+
+    // Opening the output stream. (to the speakers.)
+    m_outputStream = pa_stream_new(m_context, "Microphone playback", &outputSpec, nullptr);
+    if (!m_outputStream)
+    {
+        m_strError = "Failed to create the output stream.";
+        return false;
+    }
+    pa_stream_set_state_callback(m_outputStream, PulseBackend::staticStreamStateCallback, static_cast<void*>(this));
+    const char* outputDevice = m_config.outputDevice.empty() ? nullptr : m_config.outputDevice.c_str();
+    if (pa_stream_connect_playback(m_outputStream, outputDevice, &outputAttribute, flags, nullptr, nullptr) < 0 ||
+        !waitStreamReady(m_outputStream))
+    {
+        m_strError = "Failed to start the output stream.";
+        return false;
+    }
+
+    pa_stream_set_read_callback(m_inputStream, PulseBackend::staticReadCallback, static_cast<void*>(this));
+    pa_stream_set_overflow_callback(m_inputStream, PulseBackend::staticOverflowCallback, static_cast<void*>(this));
+    pa_stream_set_underflow_callback(m_outputStream, PulseBackend::staticUnderflowCallback, static_cast<void*>(this));
+    return true;
+}
+
+bool PulseBackend::waitStreamReady(pa_stream* stream)
+{
+    // The mainloop must be locked.
+    for (;;)
+    {
+        pa_stream_state_t state = pa_stream_get_state(stream);
+        if (state == PA_STREAM_READY)
+            return true;
+        if (state == PA_STREAM_FAILED || state == PA_STREAM_TERMINATED)
+            return false;
+        pa_threaded_mainloop_wait(m_mainloop);
+    }
+}
+
+void PulseBackend::deinit()
+{
+    stop();
+
+    // The mainloop thread is shared, the streams are released with the mainloop locked
+    // so none of their callbacks run after.
+    if (m_mainloop)
+        pa_threaded_mainloop_lock(m_mainloop);
+    if (m_inputStream)
+    {
+        pa_stream_set_state_callback(m_inputStream, nullptr, nullptr);
+        pa_stream_set_read_callback(m_inputStream, nullptr, nullptr);
+        pa_stream_set_overflow_callback(m_inputStream, nullptr, nullptr);
+        pa_stream_disconnect(m_inputStream);
+        pa_stream_unref(m_inputStream);
+        m_inputStream = nullptr;
+    }
+    if (m_outputStream)
+    {
+        pa_stream_set_state_callback(m_outputStream, nullptr, nullptr);
+        pa_stream_set_underflow_callback(m_outputStream, nullptr, nullptr);
+        pa_stream_disconnect(m_outputStream);
+        pa_stream_unref(m_outputStream);
+        m_outputStream = nullptr;
+    }
+    if (m_mainloop)
+        pa_threaded_mainloop_unlock(m_mainloop);
+    if (m_pulseContext)
+    {
+        PulseContext::release(m_pulseContext);
+        m_pulseContext = nullptr;
+    }
+    m_mainloop = nullptr;
+    m_context = nullptr;
+    m_processedData.clear();
+    m_resampledData.clear();
+    deinitResampler();
+}
+
+bool PulseBackend::play()
+{
+    if (!m_inputStream || !m_outputStream)
+    {
+        m_strError = "The stream is not ready.";
+        return false;
+    }
+
+    pa_threaded_mainloop_lock(m_mainloop);
+    // One period of silence so the playback start as soon as it is uncorked.
+    bool isPrimed = writeToPlayback(nullptr, m_outputPeriodSize);
+    if (isPrimed)
+    {
+        m_counters.primingOutputs.fetch_add(1, std::memory_order_relaxed);
+        m_isPlayingContinue = true;
+        corkStreams(false);
+    }
+    pa_threaded_mainloop_unlock(m_mainloop);
+
+    if (!isPrimed)
+    {
+        m_strError = "Failed to play data.";
+        return false;
+    }
+    return true;
+}
+
+void PulseBackend::stop()
+{
+    if (!m_mainloop || !m_isPlayingContinue)
+    {
+        m_isPlayingContinue = false;
+        return;
+    }
+
+    pa_threaded_mainloop_lock(m_mainloop);
+    m_isPlayingContinue = false;
+    corkStreams(true);
+    pa_threaded_mainloop_unlock(m_mainloop);
+}
+
+void PulseBackend::corkStreams(bool cork)
+{
+    // The mainloop must be locked.
+    pa_operation* operation = nullptr;
+    if (m_outputStream)
+    {
+        operation = pa_stream_cork(m_outputStream, cork ? 1 : 0, nullptr, nullptr);
+        if (operation)
+            pa_operation_unref(operation);
+    }
+    if (m_inputStream)
+    {
+        operation = pa_stream_cork(m_inputStream, cork ? 1 : 0, nullptr, nullptr);
+        if (operation)
+            pa_operation_unref(operation);
+    }
+}
+
+bool PulseBackend::setBufferPeriods(size_t periods)
+{
+    if (!m_mainloop || !m_outputStream || periods == 0)
+        return false;
+
+    // Only the target length of the playback buffer change, the server start playing after one period.
+    pa_buffer_attr outputAttribute;
+    outputAttribute.maxlength = static_cast<uint32_t>(-1);
+    outputAttribute.tlength = static_cast<uint32_t>(m_outputPeriodSize * periods);
+    outputAttribute.prebuf = static_cast<uint32_t>(m_outputPeriodSize);
+    outputAttribute.minreq = static_cast<uint32_t>(m_outputPeriodSize);
+    outputAttribute.fragsize = static_cast<uint32_t>(-1);
+
+    pa_threaded_mainloop_lock(m_mainloop);
+    pa_operation* operation = pa_stream_set_buffer_attr(m_outputStream, &outputAttribute, nullptr, nullptr);
+    if (operation)
+        pa_operation_unref(operation);
+    pa_threaded_mainloop_unlock(m_mainloop);
+    return operation != nullptr;
+}
+
+bool PulseBackend::isPlayingContinue() const
+{
+    return m_isPlayingContinue;
+}
+
+bool PulseBackend::isResamplingSupported() const
+{
+    return true;
+}
+
+bool PulseBackend::isDeviceSelectionSupported() const
+{
+    return true;
+}
+
+bool PulseBackend::probeDevices(std::vector<DeviceInfo>* devices)
+{
+    return probePulseDevices(devices, &m_strError);
+}
+
+void PulseBackend::staticStreamStateCallback(pa_stream* stream, void* userData)
+{
+    PulseBackend* pStream = static_cast<PulseBackend*>(userData);
+    pa_stream_state_t state = pa_stream_get_state(stream);
+    if (state == PA_STREAM_FAILED || state == PA_STREAM_TERMINATED)
+    {
+        // The streams of all the routes fail when the shared connection is lost.
+        if (pStream->m_isPlayingContinue)
+            pStream->m_strError = pa_context_get_state(pa_stream_get_context(stream)) == PA_CONTEXT_READY ? 
+                "A PulseAudio stream has failed." : "The connection to the PulseAudio server was lost.";
+        pStream->m_isPlayingContinue = false;
+    }
+    pa_threaded_mainloop_signal(pStream->m_mainloop, 0);
+}
+
+void PulseBackend::staticReadCallback(pa_stream* stream, size_t nbytes, void* userData)
+{
+    // redirecting this function to the member function of PulseBackend.
+    static_cast<PulseBackend*>(userData)->readCallback();
+}
+
+void PulseBackend::staticOverflowCallback(pa_stream* stream, void* userData)
+{
+    // The server dropped captured data because the record buffer was full.
+    // Called with the lock held, which stop() takes to clear the flag: a stopped stream is no longer traced.
+    PulseBackend* pStream = static_cast<PulseBackend*>(userData);
+    if (!pStream->m_isPlayingContinue)
+        return;
+    pStream->m_counters.inputOverflows.fetch_add(1, std::memory_order_relaxed);
+    Tracer::instant("input overflow");
+}
+
+void PulseBackend::staticUnderflowCallback(pa_stream* stream, void* userData)
+{
+    // The server played silence because the playback buffer was empty.
+    PulseBackend* pStream = static_cast<PulseBackend*>(userData);
+    if (!pStream->m_isPlayingContinue)
+        return;
+    pStream->m_counters.outputUnderflows.fetch_add(1, std::memory_order_relaxed);
+    Tracer::instant("output underflow");
+}
+
+void PulseBackend::updateLatency()
+{
+    // The timing information is interpolated by the library, it is not a server round trip.
+    pa_usec_t latency = 0;
+    int negative = 0;
+    if (pa_stream_get_latency(m_inputStream, &latency, &negative) == 0)
+        m_counters.inputLatency.store(negative ? 0 : static_cast<long>(latency), std::memory_order_relaxed);
+    if (pa_stream_get_latency(m_outputStream, &latency, &negative) == 0)
+        m_counters.outputLatency.store(negative ? 0 : static_cast<long>(latency), std::memory_order_relaxed);
+}
+
+void PulseBackend::readCallback()
+{
+    // Called from the mainloop thread, the lock is already held.
+    while (m_isPlayingContinue && pa_stream_readable_size(m_inputStream) > 0)
+    {
+        const void* data = nullptr;
+        size_t size = 0;
+        if (pa_stream_peek(m_inputStream, &data, &size) < 0)
+        {
+            m_strError = "Failed to read data from the microphone.";
+            m_isPlayingContinue = false;
+            return;
+        }
+        if (size == 0)
+            return;
+
+        // A null pointer with a size is a hole in the record buffer, it is replaced by silence.
+        PeriodTime begin = periodBegin();
+        bool isWritten = writeToPlayback(data, size);
+        periodEnd(begin, size / m_frameSize);
+        pa_stream_drop(m_inputStream);
+
+        if (!isWritten)
+        {
+            m_strError = "Failed to play data.";
+            m_isPlayingContinue = false;
+            return;
+        }
+    }
+
+    updateLatency();
+}
+
+bool PulseBackend::writeToPlayback(const void* data, size_t size)
+{
+    if (m_resampler && data)
+        return writeResampled(data, size);
+
+    // The fragment is written directly into the memory of the playback stream.
+    size_t offset = 0;
+    while (offset < size)
+    {
+        void* outputBuffer = nullptr;
+        size_t outputSize = size - offset;
+        if (pa_stream_begin_write(m_outputStream, &outputBuffer, &outputSize) < 0 || !outputBuffer)
+            return false;
+        if (outputSize > size - offset)
+            outputSize = size - offset;
+        // Only whole frames are sent to the processor.
+        if (outputSize >= m_frameSize)
+            outputSize -= outputSize % m_frameSize;
+
+        if (data)
+            process(static_cast<const char*>(data) + offset, outputBuffer, outputSize / m_frameSize);
+        else
+            memset(outputBuffer, 0, outputSize);
+
+        if (pa_stream_write(m_outputStream, outputBuffer, outputSize, nullptr, 0, PA_SEEK_RELATIVE) < 0)
+            return false;
+        offset += outputSize;
+    }
+    return true;
+}
+
+bool PulseBackend::writeResampled(const void* data, size_t size)
+{
+    // The resampled frames do not fit the memory returned by pa_stream_begin_write(), they are copied by the server.
+    size_t offset = 0;
+    while (offset + m_frameSize <= size)
+    {
+        size_t inputSize = std::min(size - offset, m_periodSize);
+        inputSize -= inputSize % m_frameSize;
+        unsigned long frames = static_cast<unsigned long>(inputSize / m_frameSize);
+
+        process(static_cast<const char*>(data) + offset, m_processedData.data(), frames);
+        unsigned long outputFrames = resample(m_processedData.data(), frames, m_resampledData.data());
+        if (outputFrames > 0 &&
+            pa_stream_write(m_outputStream, m_resampledData.data(), outputFrames * m_frameSize, nullptr, 0, PA_SEEK_RELATIVE) < 0)
+            return false;
+        offset += inputSize;
+
+        // The drift between the sink and the source accumulate in the playback buffer.
+        pa_usec_t latency = 0;
+        int negative = 0;
+        if (pa_stream_get_latency(m_outputStream, &latency, &negative) == 0)
+            compensateDrift(negative ? 0.0 : latency * 1e-6);
+    }
+    return true;
+}
+
+PulseCapture::PulseCapture() :
+    m_pulseContext(nullptr),
+    m_stream(nullptr),
+    m_source(nullptr),
+    m_isPlayingContinue(false)
+{}
+
+PulseCapture::~PulseCapture()
+{
+    deinit();
+}
+
+bool PulseCapture::init(const std::string& device, int sampleRate, unsigned long framesPerBuffer, MixSource* source)
+{
+    deinit();
+    m_source = source;
+
+    // The sources are mixed in mono float, the server convert the format and the channels.
+    pa_sample_spec sampleSpec;
+    sampleSpec.channels = 1;
+    sampleSpec.format = PA_SAMPLE_FLOAT32NE;
+    sampleSpec.rate = sampleRate;
+
+    pa_buffer_attr attribute;
+    attribute.maxlength = static_cast<uint32_t>(-1);
+    attribute.tlength = static_cast<uint32_t>(-1);
+    attribute.prebuf = static_cast<uint32_t>(-1);
+    attribute.minreq = static_cast<uint32_t>(-1);
+    attribute.fragsize = static_cast<uint32_t>(framesPerBuffer * sizeof(float));
+
+    m_pulseContext = PulseContext::acquire(&m_strError);
+    if (!m_pulseContext)
+        return false;
+    pa_threaded_mainloop* mainloop = m_pulseContext->mainloop();
+
+    pa_threaded_mainloop_lock(mainloop);
+    bool isConnected = false;
+    m_stream = pa_stream_new(m_pulseContext->context(), "Mix source record", &sampleSpec, nullptr);
+    if (m_stream)
+    {
+        pa_stream_set_state_callback(m_stream, PulseCapture::staticStreamStateCallback, static_cast<void*>(this));
+        pa_stream_flags_t flags = static_cast<pa_stream_flags_t>(PA_STREAM_START_CORKED | PA_STREAM_ADJUST_LATENCY);
+        if (pa_stream_connect_record(m_stream, device.empty() ? nullptr : device.c_str(), &attribute, flags) == 0)
+        {
+            for (;;)
+            {
+                pa_stream_state_t state = pa_stream_get_state(m_stream);
+                if (state == PA_STREAM_READY)
+                    isConnected = true;
+                if (state == PA_STREAM_READY || state == PA_STREAM_FAILED || state == PA_STREAM_TERMINATED)
+                    break;
+                pa_threaded_mainloop_wait(mainloop);
+            }
+        }
+        if (isConnected)
+            pa_stream_set_read_callback(m_stream, PulseCapture::staticReadCallback, static_cast<void*>(this));
+    }
+    pa_threaded_mainloop_unlock(mainloop);
+
+    if (!isConnected)
+    {
+        m_strError = "Failed to start the input stream.";
+        deinit();
+        return false;
+    }
+    return true;
+}
+
+void PulseCapture::deinit()
+{
+    stop();
+
+    if (!m_pulseContext)
+        return;
+
+    pa_threaded_mainloop* mainloop = m_pulseContext->mainloop();
+    pa_threaded_mainloop_lock(mainloop);
+    if (m_stream)
+    {
+        pa_stream_set_state_callback(m_stream, nullptr, nullptr);
+        pa_stream_set_read_callback(m_stream, nullptr, nullptr);
+        pa_stream_disconnect(m_stream);
+        pa_stream_unref(m_stream);
+        m_stream = nullptr;
+    }
+    pa_threaded_mainloop_unlock(mainloop);
+
+    PulseContext::release(m_pulseContext);
+    m_pulseContext = nullptr;
+}
+
+bool PulseCapture::play()
+{
+    if (!m_stream)
+    {
+        m_strError = "The stream is not ready.";
+        return false;
+    }
+
+    pa_threaded_mainloop_lock(m_pulseContext->mainloop());
+    m_isPlayingContinue = true;
+    pa_operation* operation = pa_stream_cork(m_stream, 0, nullptr, nullptr);
+    if (operation)
+        pa_operation_unref(operation);
+    pa_threaded_mainloop_unlock(m_pulseContext->mainloop());
+    return true;
+}
+
+void PulseCapture::stop()
+{
+    if (!m_stream || !m_isPlayingContinue)
+    {
+        m_isPlayingContinue = false;
+        return;
+    }
+
+    pa_threaded_mainloop_lock(m_pulseContext->mainloop());
+    m_isPlayingContinue = false;
+    pa_operation* operation = pa_stream_cork(m_stream, 1, nullptr, nullptr);
+    if (operation)
+        pa_operation_unref(operation);
+    pa_threaded_mainloop_unlock(m_pulseContext->mainloop());
+}
+
+bool PulseCapture::isPlayingContinue() const
+{
+    return m_isPlayingContinue;
+}
+
+void PulseCapture::staticStreamStateCallback(pa_stream* stream, void* userData)
+{
+    PulseCapture* capture = static_cast<PulseCapture*>(userData);
+    pa_stream_state_t state = pa_stream_get_state(stream);
+    if (state == PA_STREAM_FAILED || state == PA_STREAM_TERMINATED)
+        capture->m_isPlayingContinue = false;
+    pa_threaded_mainloop_signal(capture->m_pulseContext->mainloop(), 0);
+}
+
+void PulseCapture::staticReadCallback(pa_stream* stream, size_t nbytes, void* userData)
+{
+    // Called from the mainloop thread, the lock is already held.
+    PulseCapture* capture = static_cast<PulseCapture*>(userData);
+    while (capture->m_isPlayingContinue && pa_stream_readable_size(stream) > 0)
+    {
+        const void* data = nullptr;
+        size_t size = 0;
+        if (pa_stream_peek(stream, &data, &size) < 0 || size == 0)
+            return;
+
+        // A null pointer with a size is a hole in the record buffer, it is written as silence.
+        capture->m_source->write(static_cast<const float*>(data), static_cast<unsigned long>(size / sizeof(float)));
+        pa_stream_drop(stream);
+    }
+}
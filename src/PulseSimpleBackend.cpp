@@ -0,0 +1,451 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "PulseSimpleBackend.h"
+#include "LatencyCeiling.h"
+#include "PulseBackend.h"
+#include "Resampler.h"
+#include "Tracer.h"
+#include <cstring>
+
+// Time waiting for silence before cutting into the signal to give the latency back after a shrink of the buffering.
+static const double SHRINK_SILENCE_WAIT = 0.5;
+
+static pa_sample_format_t pulseSampleFormat(SampleFormat format)
+{
+    switch (format)
+    {
+    case SampleFormat::Int24:
+        return PA_SAMPLE_S24LE;
+    case SampleFormat::Int32:
+        return PA_SAMPLE_S32LE;
+    case SampleFormat::Float32:
+        return PA_SAMPLE_FLOAT32LE;
+    default:
+        return PA_SAMPLE_S16LE;
+    }
+}
+
+PulseSimpleBackend::PulseSimpleBackend() :
+    m_inputStream(nullptr),
+    m_outputStream(nullptr),
+    m_isPlayingContinue(false),
+    m_threadError(nullptr),
+    m_inputBufferSize(0),
+    m_data(nullptr),
+    m_playbackData(nullptr),
+    m_resampledData(nullptr),
+    m_ringOverruns(0),
+    m_ringUnderruns(0),
+    m_targetPeriods(0)
+{}
+
+PulseSimpleBackend::~PulseSimpleBackend()
+{
+    deinit();
+}
+
+bool PulseSimpleBackend::init(const StreamConfig& config)
+{
+    deinit();
+    m_config = config;
+    m_inputBufferSize = m_config.framesPerBuffer * m_config.channelsCount * sampleFormatSize(m_config.sampleFormat);
+
+    // Stream specification.
+    pa_sample_spec sampleSpec;
+    sampleSpec.channels = m_config.channelsCount;
+    sampleSpec.format = pulseSampleFormat(m_config.sampleFormat);
+    sampleSpec.rate = m_config.sampleRate;
+
+    // Pulseaudio buffer length.
+    pa_buffer_attr bufferAtribute;
+    bufferAtribute.maxlength = m_inputBufferSize;
+    bufferAtribute.tlength = -1;
+    bufferAtribute.prebuf = -1;
+    bufferAtribute.minreq = -1;
+    bufferAtribute.fragsize = -1;
+
+    // Opening the input stream. (from the microphone.)
+    m_inputStream = pa_simple_new(
+        nullptr,
+        "MicrophoneLoopback",
+        PA_STREAM_RECORD,
+        m_config.inputDevice.empty() ? nullptr : m_config.inputDevice.c_str(),
+        "Microphone record",
+        &sampleSpec,
+        nullptr,
+        &bufferAtribute,
+        nullptr
+    );
+
+    if (!m_inputStream)
+    {
+        m_strError = "Failed to start the input stream.";
+        return false;
+    }
+
+    // The playback is resampled by the playback thread when its rate differs.
+    if (!initResampler(m_config.sampleFormat, m_config.framesPerBuffer) ||
+        !initLatencyCeiling(m_config.sampleFormat, m_config.framesPerBuffer))
+    {
+        deinit();
+        return false;
+    }
+    pa_sample_spec outputSampleSpec = sampleSpec;
+    outputSampleSpec.rate = outputSampleRate();
+    pa_buffer_attr outputBufferAtribute = bufferAtribute;
+    outputBufferAtribute.maxlength = resampledFrames(m_config.framesPerBuffer) * m_config.channelsCount * sampleFormatSize(m_config.sampleFormat);
+
+    // Opening the output stream. (to the speakers.)
+    m_outputStream = pa_simple_new(
+        nullptr,
+        "MicrophoneLoopback",
+        PA_STREAM_PLAYBACK,
+        m_config.outputDevice.empty() ? nullptr : m_config.outputDevice.c_str(),
+        "Microphone playback",
+        &outputSampleSpec,
+        nullptr,
+        &outputBufferAtribute,
+        nullptr
+    );
+
+    if (!m_outputStream)
+    {
+        m_strError = "Failed to start the output stream.";
+        deinit();
+        return false;
+    }
+
+    // Creating the two temporaring buffers.
+    m_data = new char[m_inputBufferSize];
+    memset(m_data, 0, m_inputBufferSize);
+    m_playbackData = new char[m_inputBufferSize];
+    memset(m_playbackData, 0, m_inputBufferSize);
+    if (m_resampler)
+    {
+        size_t resampledSize = m_resampler->maxOutputFrames() * m_config.channelsCount * sampleFormatSize(m_config.sampleFormat);
+        m_resampledData = new char[resampledSize];
+        memset(m_resampledData, 0, resampledSize);
+    }
+
+    // The periods given back when the buffering shrink are cut without a click.
+    if (!m_shrinkSplicer.init(m_config.sampleFormat, m_config.channelsCount, m_config.sampleRate, m_config.framesPerBuffer))
+    {
+        m_strError = "Unsupported number of channels.";
+        deinit();
+        return false;
+    }
+
+    // Creating the buffer between the capture and the playback threads.
+    if (!m_ringBuffer.init(m_inputBufferSize, m_config.ringBufferPeriods))
+    {
+        m_strError = "Failed to create the ring buffer.";
+        deinit();
+        return false;
+    }
+    m_ringOverruns = 0;
+    m_ringUnderruns = 0;
+
+    return true;
+}
+
+void PulseSimpleBackend::deinit()
+{
+    stop();
+
+    if (m_inputStream)
+    {
+        pa_simple_free(m_inputStream);
+        m_inputStream = nullptr;
+    }
+    if (m_outputStream)
+    {
+        pa_simple_free(m_outputStream);
+        m_outputStream = nullptr;
+    }
+    if (m_data)
+    {
+        delete[] m_data;
+        m_data = nullptr;
+    }
+    if (m_playbackData)
+    {
+        delete[] m_playbackData;
+        m_playbackData = nullptr;
+    }
+    if (m_resampledData)
+    {
+        delete[] m_resampledData;
+        m_resampledData = nullptr;
+    }
+    m_ringBuffer.deinit();
+    deinitResampler();
+    deinitLatencyCeiling();
+}
+
+bool PulseSimpleBackend::play()
+{
+    if (!m_inputStream || !m_outputStream)
+    {
+        m_strError = "The stream is not ready.";
+        return false;
+    }
+
+    // Launch the capture and the playback loops into their own threads.
+    m_ringBuffer.reset();
+    m_threadError = nullptr;
+    m_isPlayingContinue = true;
+    m_tCapture = std::thread(&PulseSimpleBackend::captureLoop, this);
+    m_tPlayback = std::thread(&PulseSimpleBackend::playbackLoop, this);
+    return true;
+}
+
+void PulseSimpleBackend::stop()
+{
+    m_isPlayingContinue = false;
+    if (m_tCapture.joinable())
+        m_tCapture.join();
+    if (m_tPlayback.joinable())
+        m_tPlayback.join();
+
+    // The threads are joined, the error can be read by the control thread.
+    const char* error = m_threadError.exchange(nullptr);
+    if (error)
+        m_strError = error;
+}
+
+bool PulseSimpleBackend::isPlayingContinue() const
+{
+    return m_isPlayingContinue;
+}
+
+void PulseSimpleBackend::captureLoop()
+{
+    Tracer::nameThread("pulse-simple capture");
+
+    int err = PA_OK;
+    while (m_isPlayingContinue)
+    {
+        // Read a period from the microphone.
+        Tracer::begin("pa_simple_read");
+        err = pa_simple_read(m_inputStream, m_data, m_inputBufferSize, nullptr);
+        Tracer::end("pa_simple_read");
+        if (err != 0)
+        {
+            fail("Failed to read data from the microphone.");
+            break;
+        }
+
+        // Latency of the record stream.
+        pa_usec_t latency = pa_simple_get_latency(m_inputStream, &err);
+        if (latency != static_cast<pa_usec_t>(-1))
+            m_counters.inputLatency.store(static_cast<long>(latency), std::memory_order_relaxed);
+
+        // Push it to the playback thread, if the playback thread is late,
+        // the period is dropped instead of blocking the capture.
+        if (m_ringBuffer.availableWrite() < m_inputBufferSize)
+        {
+            m_ringOverruns.fetch_add(1, std::memory_order_relaxed);
+            m_counters.inputOverflows.fetch_add(1, std::memory_order_relaxed);
+            Tracer::instant("ring overrun");
+            continue;
+        }
+        PeriodTime begin = periodBegin();
+        process(m_data, m_data, m_config.framesPerBuffer);
+        m_ringBuffer.write(m_data, m_inputBufferSize);
+        periodEnd(begin, m_config.framesPerBuffer);
+        Tracer::counter("ring fill", m_ringBuffer.fillLevel());
+    }
+}
+
+void PulseSimpleBackend::playbackLoop()
+{
+    Tracer::nameThread("pulse-simple playback");
+
+    int err = PA_OK;
+    bool isPriming = true;
+    // Nothing can be missing before the capture delivered its first period.
+    bool isFirstPeriodRead = false;
+    size_t lastTargetPeriods = 0;
+    // Frames to remove since the target has shrunk, and time spent waiting for silence to cut them.
+    unsigned long shrinkFrames = 0;
+    double shrinkTime = 0.0;
+    while (m_isPlayingContinue)
+    {
+        unsigned long frames = m_config.framesPerBuffer;
+        // Periods the ring should hold, 0 when the buffering is not adaptive.
+        size_t targetPeriods = m_targetPeriods.load(std::memory_order_relaxed);
+        size_t availablePeriods = m_ringBuffer.availableRead() / m_inputBufferSize;
+        if (targetPeriods > lastTargetPeriods)
+        {
+            isPriming = true;
+            shrinkFrames = 0;
+        }
+        else if (targetPeriods > 0 && targetPeriods < lastTargetPeriods)
+        {
+            shrinkFrames += static_cast<unsigned long>(lastTargetPeriods - targetPeriods) * m_config.framesPerBuffer;
+            shrinkTime = 0.0;
+        }
+        // The drift compensation hold the new buffering.
+        if (targetPeriods != lastTargetPeriods)
+            m_driftController.settle();
+        lastTargetPeriods = targetPeriods;
+
+        if (targetPeriods > 0 && isPriming && availablePeriods < targetPeriods)
+        {
+            // Silence is played while the ring fill up to the target.
+            memset(m_playbackData, 0, m_inputBufferSize);
+        }
+        else if (availablePeriods > 0)
+        {
+            // Get a period from the capture thread.
+            isPriming = false;
+            m_ringBuffer.read(m_playbackData, m_inputBufferSize);
+            isFirstPeriodRead = true;
+
+            // The target has shrunk, the frames over it are cut in the silences, in the signal after a while.
+            if (availablePeriods <= targetPeriods)
+                shrinkFrames = 0;
+            if (shrinkFrames > 0)
+            {
+                m_shrinkSplicer.load(m_playbackData, frames);
+                unsigned long drop = m_shrinkSplicer.cutSilence(shrinkFrames);
+                if (drop == 0 && shrinkTime >= SHRINK_SILENCE_WAIT)
+                    drop = m_shrinkSplicer.cutQuietest(shrinkFrames);
+                shrinkTime += static_cast<double>(frames) / m_config.sampleRate;
+                if (drop > 0)
+                {
+                    frames = m_shrinkSplicer.store(m_playbackData);
+                    shrinkFrames -= drop;
+                    Tracer::instant("buffer shrink");
+                }
+            }
+        }
+        else if (!isFirstPeriodRead)
+        {
+            // Silence until the capture start.
+            memset(m_playbackData, 0, m_inputBufferSize);
+        }
+        else
+        {
+            // Play silence if no period is available.
+            m_ringUnderruns.fetch_add(1, std::memory_order_relaxed);
+            m_counters.outputUnderflows.fetch_add(1, std::memory_order_relaxed);
+            Tracer::instant("ring underrun");
+            memset(m_playbackData, 0, m_inputBufferSize);
+            isPriming = true;
+        }
+
+        // The ring absorb the drift between the clocks of the two streams, its level is held by the resampler.
+        double ringLevel = static_cast<double>(m_ringBuffer.availableRead()) / m_inputBufferSize * m_config.framesPerBuffer / m_config.sampleRate;
+        compensateDrift(ringLevel);
+
+        // Over the maximum latency (the ring and the playback stream), frames are dropped to catch up.
+        if (m_latencyCeiling)
+        {
+            long outputLatency = m_counters.outputLatency.load(std::memory_order_relaxed);
+            double latency = ringLevel + (outputLatency > 0 ? outputLatency * 1e-6 : 0.0);
+            unsigned long catchUps = m_latencyCeiling->catchUpsCount();
+            frames = limitLatency(m_playbackData, frames, latency);
+            if (m_latencyCeiling->catchUpsCount() != catchUps)
+                m_driftController.settle();
+        }
+
+        // The silence is resampled too, so the output rate stay steady.
+        const char* playbackData = m_playbackData;
+        size_t playbackSize = frames * m_config.channelsCount * sampleFormatSize(m_config.sampleFormat);
+        if (m_resampler)
+        {
+            frames = resample(m_playbackData, frames, m_resampledData);
+            playbackData = m_resampledData;
+            playbackSize = frames * m_config.channelsCount * sampleFormatSize(m_config.sampleFormat);
+        }
+
+        // Write the data to the playback buffer.
+        Tracer::begin("pa_simple_write");
+        err = pa_simple_write(m_outputStream, playbackData, playbackSize, nullptr);
+        Tracer::end("pa_simple_write");
+        if (err != 0)
+        {
+            fail("Failed to play data.");
+            break;
+        }
+
+        // Latency of the playback stream.
+        pa_usec_t latency = pa_simple_get_latency(m_outputStream, &err);
+        if (latency != static_cast<pa_usec_t>(-1))
+            m_counters.outputLatency.store(static_cast<long>(latency), std::memory_order_relaxed);
+    }
+}
+
+void PulseSimpleBackend::fail(const char* error)
+{
+    // Only the first error is kept, the other thread fail because the stream stop.
+    const char* expected = nullptr;
+    m_threadError.compare_exchange_strong(expected, error);
+    m_isPlayingContinue = false;
+}
+
+bool PulseSimpleBackend::isResamplingSupported() const
+{
+    return true;
+}
+
+bool PulseSimpleBackend::isDeviceSelectionSupported() const
+{
+    return true;
+}
+
+bool PulseSimpleBackend::probeDevices(std::vector<DeviceInfo>* devices)
+{
+    return probePulseDevices(devices, &m_strError);
+}
+
+bool PulseSimpleBackend::isLatencyCeilingSupported() const
+{
+    return true;
+}
+
+bool PulseSimpleBackend::setBufferPeriods(size_t periods)
+{
+    // The ring is never resized, the target must leave a free period for the capture.
+    if (periods == 0 || periods >= m_ringBuffer.periodsCount())
+        return false;
+    m_targetPeriods.store(periods, std::memory_order_relaxed);
+    return true;
+}
+
+size_t PulseSimpleBackend::ringBufferPeriods() const
+{
+    return m_ringBuffer.periodsCount();
+}
+
+double PulseSimpleBackend::ringBufferFill() const
+{
+    return m_ringBuffer.fillLevel();
+}
+
+unsigned long PulseSimpleBackend::ringBufferOverruns() const
+{
+    return m_ringOverruns.load(std::memory_order_relaxed);
+}
+
+unsigned long PulseSimpleBackend::ringBufferUnderruns() const
+{
+    return m_ringUnderruns.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,346 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "Resampler.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Filters with more phases are not supported (the ratio is too complex).
+#define RESAMPLER_MAX_PHASES 1024
+// Phases of a variable resampler, the interpolation between them is below the stopband.
+#define RESAMPLER_VARIABLE_PHASES 256
+// Largest ratio correction of a variable resampler.
+#define RESAMPLER_MAX_CORRECTION 0.01
+
+struct ResamplerPreset
+{
+    // Zero crossings on each side of the sinc and attenuation of the stopband in dB.
+    int zeroCrossings;
+    double attenuation;
+};
+
+static ResamplerPreset resamplerPreset(ResamplerQuality quality)
+{
+    switch (quality)
+    {
+    case ResamplerQuality::Low:
+        return {8, 60.0};
+    case ResamplerQuality::Medium:
+        return {16, 90.0};
+    case ResamplerQuality::High:
+        return {32, 120.0};
+    }
+    return {16, 90.0};
+}
+
+// Modified Bessel function of the first kind, for the Kaiser window.
+static double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+static unsigned long greatestCommonDivisor(unsigned long a, unsigned long b)
+{
+    while (b != 0)
+    {
+        unsigned long r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+// The count is a multiple of 8.
+static float dotProduct(const float* a, const float* b, size_t count)
+{
+#if defined(MLB_AVX2)
+    __m256 sum = _mm256_setzero_ps();
+    for (size_t i = 0; i < count; i += 8)
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    return _mm_cvtss_f32(half);
+#elif defined(MLB_SSE2)
+    __m128 sum0 = _mm_setzero_ps();
+    __m128 sum1 = _mm_setzero_ps();
+    for (size_t i = 0; i < count; i += 8)
+    {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 sum = _mm_add_ps(sum0, sum1);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+#elif defined(MLB_NEON)
+    float32x4_t sum0 = vdupq_n_f32(0.0f);
+    float32x4_t sum1 = vdupq_n_f32(0.0f);
+    for (size_t i = 0; i < count; i += 8)
+    {
+        sum0 = vmlaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+        sum1 = vmlaq_f32(sum1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    return vaddvq_f32(vaddq_f32(sum0, sum1));
+#else
+    float sum[4] = {};
+    for (size_t i = 0; i < count; i += 4)
+    {
+        sum[0] += a[i] * b[i];
+        sum[1] += a[i + 1] * b[i + 1];
+        sum[2] += a[i + 2] * b[i + 2];
+        sum[3] += a[i + 3] * b[i + 3];
+    }
+    return (sum[0] + sum[2]) + (sum[1] + sum[3]);
+#endif
+}
+
+// Linear interpolation of the taps of two phases, the count is a multiple of 8.
+static void interpolateTaps(const float* a, const float* b, float t, float* output, size_t count)
+{
+#if defined(MLB_AVX2)
+    __m256 factor = _mm256_set1_ps(t);
+    for (size_t i = 0; i < count; i += 8)
+    {
+        __m256 first = _mm256_loadu_ps(a + i);
+        _mm256_storeu_ps(output + i, _mm256_add_ps(first, _mm256_mul_ps(factor, _mm256_sub_ps(_mm256_loadu_ps(b + i), first))));
+    }
+#elif defined(MLB_SSE2)
+    __m128 factor = _mm_set1_ps(t);
+    for (size_t i = 0; i < count; i += 4)
+    {
+        __m128 first = _mm_loadu_ps(a + i);
+        _mm_storeu_ps(output + i, _mm_add_ps(first, _mm_mul_ps(factor, _mm_sub_ps(_mm_loadu_ps(b + i), first))));
+    }
+#elif defined(MLB_NEON)
+    for (size_t i = 0; i < count; i += 4)
+    {
+        float32x4_t first = vld1q_f32(a + i);
+        vst1q_f32(output + i, vmlaq_n_f32(first, vsubq_f32(vld1q_f32(b + i), first), t));
+    }
+#else
+    for (size_t i = 0; i < count; i++)
+        output[i] = a[i] + t * (b[i] - a[i]);
+#endif
+}
+
+Resampler::Resampler() :
+    m_channelsCount(0),
+    m_inputRate(0),
+    m_maxInputFrames(0),
+    m_maxOutputFrames(0),
+    m_upFactor(1),
+    m_downFactor(1),
+    m_tapsCount(0),
+    m_isVariable(false),
+    m_step(1.0),
+    m_position(0.0),
+    m_index(0),
+    m_phase(0)
+{}
+
+bool Resampler::init(SampleFormat format, int channelsCount, int inputRate, int outputRate, ResamplerQuality quality, 
+    unsigned long maxInputFrames, bool isVariable)
+{
+    if (inputRate <= 0 || outputRate <= 0 || maxInputFrames == 0 || !m_converter.init(format, channelsCount))
+    {
+        m_strError = "Unsupported stream format for the resampler.";
+        return false;
+    }
+
+    unsigned long divisor = greatestCommonDivisor(static_cast<unsigned long>(inputRate), static_cast<unsigned long>(outputRate));
+    m_upFactor = outputRate / divisor;
+    m_downFactor = inputRate / divisor;
+    if (m_upFactor > RESAMPLER_MAX_PHASES)
+    {
+        m_strError = "The resampler does not support the ratio between " + std::to_string(inputRate) + 
+            " and " + std::to_string(outputRate) + " Hz.";
+        return false;
+    }
+
+    m_channelsCount = channelsCount;
+    m_inputRate = inputRate;
+    m_maxInputFrames = maxInputFrames;
+    m_maxOutputFrames = static_cast<unsigned long>(
+        (static_cast<unsigned long long>(maxInputFrames) * m_upFactor + m_downFactor - 1) / m_downFactor) + 1;
+
+    // The same ratio with more phases, so the step between the phases is fine enough.
+    m_isVariable = isVariable;
+    if (m_isVariable)
+    {
+        unsigned long factor = (RESAMPLER_VARIABLE_PHASES + m_upFactor - 1) / m_upFactor;
+        m_upFactor *= factor;
+        m_downFactor *= factor;
+        m_maxOutputFrames += static_cast<unsigned long>(std::ceil(m_maxOutputFrames * RESAMPLER_MAX_CORRECTION)) + 1;
+    }
+
+    // When decimating, the cutoff is lowered to the output Nyquist frequency and the filter is longer by the same ratio.
+    ResamplerPreset preset = resamplerPreset(quality);
+    double ratio = std::min(1.0, static_cast<double>(m_upFactor) / m_downFactor);
+    size_t taps = static_cast<size_t>(std::ceil(2.0 * preset.zeroCrossings / ratio));
+    m_tapsCount = (taps + 7) / 8 * 8;
+
+    // Kaiser window: transition width for the attenuation and the length, the stopband start at the output Nyquist frequency.
+    // The frequencies are in cycles per input frame.
+    const double pi = 3.14159265358979323846;
+    double transition = (preset.attenuation - 7.95) / (14.36 * m_tapsCount);
+    double cutoff = 0.5 * ratio - transition / 2.0;
+    double beta = 0.1102 * (preset.attenuation - 8.7);
+    double window = besselI0(beta);
+
+    // Prototype filter of tapsCount * L + 1 taps at the rate inputRate * L, each phase take one tap out of L.
+    // The phase L is computed too, it is the phase 0 moved by one input frame.
+    double center = m_tapsCount * m_upFactor / 2.0;
+    m_coefficients.assign(m_tapsCount * (m_upFactor + 1), 0.0f);
+    std::vector<double> phase(m_tapsCount);
+    for (unsigned long p = 0; p <= m_upFactor; p++)
+    {
+        double sum = 0.0;
+        for (size_t k = 0; k < m_tapsCount; k++)
+        {
+            // Tap n = p + k * L is applied to the frame k frames before the last one of the window.
+            size_t n = p + k * m_upFactor;
+            double t = (n - center) / m_upFactor;
+            double x = 2.0 * cutoff * t;
+            double sinc = std::fabs(x) < 1e-12 ? 1.0 : std::sin(pi * x) / (pi * x);
+            double r = (n - center) / center;
+            double kaiser = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / window;
+            phase[k] = 2.0 * cutoff * sinc * kaiser;
+            sum += phase[k];
+        }
+
+        // Each phase is normalized so the gain is flat at DC, the taps are stored oldest frame first.
+        for (size_t k = 0; k < m_tapsCount; k++)
+            m_coefficients[p * m_tapsCount + (m_tapsCount - 1 - k)] = static_cast<float>(phase[k] / sum);
+    }
+
+    size_t planeSize = m_tapsCount - 1 + maxInputFrames;
+    m_history.assign(static_cast<size_t>(channelsCount) * planeSize, 0.0f);
+    m_inputPlanes.resize(channelsCount);
+    m_output.assign(static_cast<size_t>(channelsCount) * m_maxOutputFrames, 0.0f);
+    m_outputPlanes.resize(channelsCount);
+    m_interpolated.assign(m_tapsCount, 0.0f);
+    for (int c = 0; c < channelsCount; c++)
+    {
+        m_inputPlanes[c] = m_history.data() + c * planeSize + m_tapsCount - 1;
+        m_outputPlanes[c] = m_output.data() + c * m_maxOutputFrames;
+    }
+
+    reset();
+    return true;
+}
+
+void Resampler::reset()
+{
+    std::fill(m_history.begin(), m_history.end(), 0.0f);
+    m_index = m_tapsCount - 1;
+    m_phase = 0;
+    m_position = 0.0;
+    m_step = static_cast<double>(m_downFactor);
+}
+
+void Resampler::setRatioCorrection(double correction)
+{
+    if (!m_isVariable)
+        return;
+    correction = std::max(-RESAMPLER_MAX_CORRECTION, std::min(RESAMPLER_MAX_CORRECTION, correction));
+    m_step = m_downFactor * (1.0 + correction);
+}
+
+unsigned long Resampler::process(const void* input, unsigned long frames, void* output)
+{
+    if (frames > m_maxInputFrames)
+        frames = m_maxInputFrames;
+    m_converter.deinterleave(input, m_inputPlanes.data(), frames);
+
+    size_t planeSize = m_tapsCount - 1 + m_maxInputFrames;
+    unsigned long end = m_tapsCount - 1 + frames;
+    unsigned long count = 0;
+    while (m_isVariable && m_index < end)
+    {
+        // Taps between the two phases around the position.
+        unsigned long phase = static_cast<unsigned long>(m_position);
+        const float* coefficients = m_coefficients.data() + phase * m_tapsCount;
+        interpolateTaps(coefficients, coefficients + m_tapsCount, static_cast<float>(m_position - phase), m_interpolated.data(), m_tapsCount);
+
+        size_t first = m_index - (m_tapsCount - 1);
+        for (int c = 0; c < m_channelsCount; c++)
+            m_outputPlanes[c][count] = dotProduct(m_interpolated.data(), m_history.data() + c * planeSize + first, m_tapsCount);
+        count++;
+
+        m_position += m_step;
+        unsigned long advance = static_cast<unsigned long>(m_position / m_upFactor);
+        m_index += advance;
+        m_position -= static_cast<double>(advance * m_upFactor);
+    }
+    while (!m_isVariable && m_index < end)
+    {
+        const float* coefficients = m_coefficients.data() + m_phase * m_tapsCount;
+        size_t first = m_index - (m_tapsCount - 1);
+        for (int c = 0; c < m_channelsCount; c++)
+            m_outputPlanes[c][count] = dotProduct(coefficients, m_history.data() + c * planeSize + first, m_tapsCount);
+        count++;
+
+        m_phase += m_downFactor;
+        m_index += m_phase / m_upFactor;
+        m_phase %= m_upFactor;
+    }
+
+    m_converter.interleave(m_outputPlanes.data(), output, count);
+
+    // The last frames are kept for the next call.
+    for (int c = 0; c < m_channelsCount; c++)
+    {
+        float* plane = m_history.data() + c * planeSize;
+        std::memmove(plane, plane + frames, (m_tapsCount - 1) * sizeof(float));
+    }
+    m_index -= frames;
+    return count;
+}
+
+unsigned long Resampler::maxOutputFrames() const
+{
+    return m_maxOutputFrames;
+}
+
+double Resampler::latency() const
+{
+    // Group delay of the symmetric prototype filter, half the taps of a phase.
+    return m_tapsCount / 2.0 / m_inputRate;
+}
+
+size_t Resampler::tapsCount() const
+{
+    return m_tapsCount;
+}
+
+const std::string& Resampler::error() const
+{
+    return m_strError;
+}
@@ -0,0 +1,157 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "RingBuffer.h"
+#include <cstring>
+
+RingBuffer::RingBuffer() :
+    m_buffer(nullptr),
+    m_capacity(0),
+    m_periodSize(0),
+    m_periodsCount(0),
+    m_writePos(0),
+    m_readPos(0)
+{}
+
+RingBuffer::~RingBuffer()
+{
+    deinit();
+}
+
+bool RingBuffer::init(size_t periodSize, size_t periodsCount)
+{
+    deinit();
+
+    if (periodSize == 0 || periodsCount == 0)
+        return false;
+
+    m_periodSize = periodSize;
+    m_periodsCount = periodsCount;
+    m_capacity = periodSize * periodsCount;
+    m_buffer = new char[m_capacity];
+    memset(m_buffer, 0, m_capacity);
+    reset();
+    return true;
+}
+
+void RingBuffer::deinit()
+{
+    if (m_buffer)
+    {
+        delete[] m_buffer;
+        m_buffer = nullptr;
+    }
+    m_capacity = 0;
+    m_periodSize = 0;
+    m_periodsCount = 0;
+    reset();
+}
+
+void RingBuffer::reset()
+{
+    m_writePos.store(0, std::memory_order_relaxed);
+    m_readPos.store(0, std::memory_order_relaxed);
+}
+
+size_t RingBuffer::write(const void* data, size_t size)
+{
+    if (!m_buffer)
+        return 0;
+
+    // Only the producer update the write position.
+    size_t writePos = m_writePos.load(std::memory_order_relaxed);
+    size_t readPos = m_readPos.load(std::memory_order_acquire);
+    size_t freeSpace = m_capacity - (writePos - readPos);
+    if (size > freeSpace)
+        size = freeSpace;
+    if (size == 0)
+        return 0;
+
+    // Copy the data in at most two parts when wrapping around the end.
+    size_t offset = writePos % m_capacity;
+    size_t firstPart = m_capacity - offset;
+    if (firstPart > size)
+        firstPart = size;
+    memcpy(m_buffer + offset, data, firstPart);
+    if (size > firstPart)
+        memcpy(m_buffer, static_cast<const char*>(data) + firstPart, size - firstPart);
+
+    m_writePos.store(writePos + size, std::memory_order_release);
+    return size;
+}
+
+size_t RingBuffer::availableWrite() const
+{
+    return m_capacity - availableRead();
+}
+
+size_t RingBuffer::read(void* data, size_t size)
+{
+    if (!m_buffer)
+        return 0;
+
+    // Only the consumer update the read position.
+    size_t readPos = m_readPos.load(std::memory_order_relaxed);
+    size_t writePos = m_writePos.load(std::memory_order_acquire);
+    size_t available = writePos - readPos;
+    if (size > available)
+        size = available;
+    if (size == 0)
+        return 0;
+
+    size_t offset = readPos % m_capacity;
+    size_t firstPart = m_capacity - offset;
+    if (firstPart > size)
+        firstPart = size;
+    memcpy(data, m_buffer + offset, firstPart);
+    if (size > firstPart)
+        memcpy(static_cast<char*>(data) + firstPart, m_buffer, size - firstPart);
+
+    m_readPos.store(readPos + size, std::memory_order_release);
+    return size;
+}
+
+size_t RingBuffer::availableRead() const
+{
+    // The read position is loaded first, it can never be ahead of a later write position.
+    size_t readPos = m_readPos.load(std::memory_order_acquire);
+    size_t writePos = m_writePos.load(std::memory_order_acquire);
+    return writePos - readPos;
+}
+
+size_t RingBuffer::capacity() const
+{
+    return m_capacity;
+}
+
+size_t RingBuffer::periodSize() const
+{
+    return m_periodSize;
+}
+
+size_t RingBuffer::periodsCount() const
+{
+    return m_periodsCount;
+}
+
+double RingBuffer::fillLevel() const
+{
+    if (m_periodSize == 0)
+        return 0.0;
+    return static_cast<double>(availableRead()) / static_cast<double>(m_periodSize);
+}
@@ -0,0 +1,574 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "SampleConversion.h"
+#include "Simd.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+    // Samples converted at once by the multichannel kernels, the block is on the stack of the audio thread.
+    const unsigned long BLOCK_SAMPLES = 1024;
+    // The generic kernel must fit at least one frame in a block.
+    const int MAX_CHANNELS = 64;
+
+    const float INT16_SCALE = 32768.0f;
+    const float INT24_SCALE = 8388608.0f;
+    const float INT32_SCALE = 2147483648.0f;
+    // Largest float below 2^31, 2^31 itself does not fit in an int32.
+    const float INT32_MAX_FLOAT = 2147483520.0f;
+
+    float clip(float value, float min, float max)
+    {
+        return value < min ? min : (value > max ? max : value);
+    }
+
+    // Scalar load and store of one sample of each format.
+    template<SampleFormat F> struct SampleTraits;
+
+    template<> struct SampleTraits<SampleFormat::Int16>
+    {
+        static const size_t SIZE = 2;
+        static float load(const unsigned char* data)
+        {
+            int16_t value;
+            memcpy(&value, data, sizeof(value));
+            return value / INT16_SCALE;
+        }
+        static void store(float value, unsigned char* data)
+        {
+            int16_t sample = static_cast<int16_t>(lrintf(clip(value * INT16_SCALE, -INT16_SCALE, INT16_SCALE - 1.0f)));
+            memcpy(data, &sample, sizeof(sample));
+        }
+    };
+
+    // Packed 24 bits little endian, the format of paInt24, PA_SAMPLE_S24LE and SND_PCM_FORMAT_S24_3LE.
+    template<> struct SampleTraits<SampleFormat::Int24>
+    {
+        static const size_t SIZE = 3;
+        static float load(const unsigned char* data)
+        {
+            int32_t value = data[0] | (data[1] << 8) | (data[2] << 16);
+            if (value & 0x800000)
+                value -= 0x1000000;
+            return value / INT24_SCALE;
+        }
+        static void store(float value, unsigned char* data)
+        {
+            int32_t sample = static_cast<int32_t>(lrintf(clip(value * INT24_SCALE, -INT24_SCALE, INT24_SCALE - 1.0f)));
+            data[0] = static_cast<unsigned char>(sample & 0xFF);
+            data[1] = static_cast<unsigned char>((sample >> 8) & 0xFF);
+            data[2] = static_cast<unsigned char>((sample >> 16) & 0xFF);
+        }
+    };
+
+    template<> struct SampleTraits<SampleFormat::Int32>
+    {
+        static const size_t SIZE = 4;
+        static float load(const unsigned char* data)
+        {
+            int32_t value;
+            memcpy(&value, data, sizeof(value));
+            return value / INT32_SCALE;
+        }
+        static void store(float value, unsigned char* data)
+        {
+            int32_t sample = static_cast<int32_t>(lrintf(clip(value * INT32_SCALE, -INT32_SCALE, INT32_MAX_FLOAT)));
+            memcpy(data, &sample, sizeof(sample));
+        }
+    };
+
+    template<> struct SampleTraits<SampleFormat::Float32>
+    {
+        static const size_t SIZE = 4;
+        static float load(const unsigned char* data)
+        {
+            float value;
+            memcpy(&value, data, sizeof(value));
+            return value;
+        }
+        static void store(float value, unsigned char* data)
+        {
+            memcpy(data, &value, sizeof(value));
+        }
+    };
+
+    template<SampleFormat F>
+    void toFloatScalar(const unsigned char* input, float* output, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+            output[i] = SampleTraits<F>::load(input + i * SampleTraits<F>::SIZE);
+    }
+
+    template<SampleFormat F>
+    void fromFloatScalar(const float* input, unsigned char* output, size_t count)
+    {
+        for (size_t i = 0; i < count; i++)
+            SampleTraits<F>::store(input[i], output + i * SampleTraits<F>::SIZE);
+    }
+
+    // Conversion of contiguous samples, specialized with vector instructions below.
+    template<SampleFormat F>
+    void toFloat(const unsigned char* input, float* output, size_t count)
+    {
+        toFloatScalar<F>(input, output, count);
+    }
+
+    template<SampleFormat F>
+    void fromFloat(const float* input, unsigned char* output, size_t count)
+    {
+        fromFloatScalar<F>(input, output, count);
+    }
+
+    template<>
+    void toFloat<SampleFormat::Float32>(const unsigned char* input, float* output, size_t count)
+    {
+        memcpy(output, input, count * sizeof(float));
+    }
+
+    template<>
+    void fromFloat<SampleFormat::Float32>(const float* input, unsigned char* output, size_t count)
+    {
+        memcpy(output, input, count * sizeof(float));
+    }
+
+#if defined(MLB_SSE2) || defined(MLB_NEON)
+    template<>
+    void toFloat<SampleFormat::Int16>(const unsigned char* input, float* output, size_t count)
+    {
+        size_t i = 0;
+#if defined(MLB_AVX2)
+        const __m256 scale = _mm256_set1_ps(1.0f / INT16_SCALE);
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i samples = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i * 2)));
+            _mm256_storeu_ps(output + i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+        }
+#elif defined(MLB_SSE2)
+        const __m128 scale = _mm_set1_ps(1.0f / INT16_SCALE);
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i * 2));
+            // Sign extension of the 16 bits samples into 32 bits.
+            __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+            __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+            _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(low), scale));
+            _mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(high), scale));
+        }
+#elif defined(MLB_NEON)
+        const float32x4_t scale = vdupq_n_f32(1.0f / INT16_SCALE);
+        for (; i + 8 <= count; i += 8)
+        {
+            int16x8_t samples = vld1q_s16(reinterpret_cast<const int16_t*>(input + i * 2));
+            vst1q_f32(output + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples))), scale));
+            vst1q_f32(output + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(samples))), scale));
+        }
+#endif
+        toFloatScalar<SampleFormat::Int16>(input + i * 2, output + i, count - i);
+    }
+
+    template<>
+    void fromFloat<SampleFormat::Int16>(const float* input, unsigned char* output, size_t count)
+    {
+        size_t i = 0;
+#if defined(MLB_AVX2)
+        const __m256 scale = _mm256_set1_ps(INT16_SCALE);
+        const __m256 min = _mm256_set1_ps(-INT16_SCALE);
+        const __m256 max = _mm256_set1_ps(INT16_SCALE - 1.0f);
+        for (; i + 16 <= count; i += 16)
+        {
+            __m256 first = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(input + i), scale), min), max);
+            __m256 second = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(input + i + 8), scale), min), max);
+            // The pack works on each 128 bits lane, the permutation restores the order.
+            __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(first), _mm256_cvtps_epi32(second));
+            packed = _mm256_permute4x64_epi64(packed, 0xD8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i * 2), packed);
+        }
+#elif defined(MLB_SSE2)
+        const __m128 scale = _mm_set1_ps(INT16_SCALE);
+        const __m128 min = _mm_set1_ps(-INT16_SCALE);
+        const __m128 max = _mm_set1_ps(INT16_SCALE - 1.0f);
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128 first = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(input + i), scale), min), max);
+            __m128 second = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(input + i + 4), scale), min), max);
+            __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(first), _mm_cvtps_epi32(second));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i * 2), packed);
+        }
+#elif defined(MLB_NEON)
+        const float32x4_t scale = vdupq_n_f32(INT16_SCALE);
+        const float32x4_t min = vdupq_n_f32(-INT16_SCALE);
+        const float32x4_t max = vdupq_n_f32(INT16_SCALE - 1.0f);
+        for (; i + 8 <= count; i += 8)
+        {
+            float32x4_t first = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(input + i), scale), min), max);
+            float32x4_t second = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(input + i + 4), scale), min), max);
+            int16x8_t packed = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(first)), vqmovn_s32(vcvtnq_s32_f32(second)));
+            vst1q_s16(reinterpret_cast<int16_t*>(output + i * 2), packed);
+        }
+#endif
+        fromFloatScalar<SampleFormat::Int16>(input + i, output + i * 2, count - i);
+    }
+
+    template<>
+    void toFloat<SampleFormat::Int32>(const unsigned char* input, float* output, size_t count)
+    {
+        size_t i = 0;
+#if defined(MLB_AVX2)
+        const __m256 scale = _mm256_set1_ps(1.0f / INT32_SCALE);
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i samples = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i * 4));
+            _mm256_storeu_ps(output + i, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), scale));
+        }
+#elif defined(MLB_SSE2)
+        const __m128 scale = _mm_set1_ps(1.0f / INT32_SCALE);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i * 4));
+            _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(samples), scale));
+        }
+#elif defined(MLB_NEON)
+        const float32x4_t scale = vdupq_n_f32(1.0f / INT32_SCALE);
+        for (; i + 4 <= count; i += 4)
+            vst1q_f32(output + i, vmulq_f32(vcvtq_f32_s32(vld1q_s32(reinterpret_cast<const int32_t*>(input + i * 4))), scale));
+#endif
+        toFloatScalar<SampleFormat::Int32>(input + i * 4, output + i, count - i);
+    }
+
+    template<>
+    void fromFloat<SampleFormat::Int32>(const float* input, unsigned char* output, size_t count)
+    {
+        size_t i = 0;
+#if defined(MLB_AVX2)
+        const __m256 scale = _mm256_set1_ps(INT32_SCALE);
+        const __m256 min = _mm256_set1_ps(-INT32_SCALE);
+        const __m256 max = _mm256_set1_ps(INT32_MAX_FLOAT);
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 samples = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(input + i), scale), min), max);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i * 4), _mm256_cvtps_epi32(samples));
+        }
+#elif defined(MLB_SSE2)
+        const __m128 scale = _mm_set1_ps(INT32_SCALE);
+        const __m128 min = _mm_set1_ps(-INT32_SCALE);
+        const __m128 max = _mm_set1_ps(INT32_MAX_FLOAT);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 samples = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(input + i), scale), min), max);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i * 4), _mm_cvtps_epi32(samples));
+        }
+#elif defined(MLB_NEON)
+        const float32x4_t scale = vdupq_n_f32(INT32_SCALE);
+        const float32x4_t min = vdupq_n_f32(-INT32_SCALE);
+        const float32x4_t max = vdupq_n_f32(INT32_MAX_FLOAT);
+        for (; i + 4 <= count; i += 4)
+        {
+            float32x4_t samples = vminq_f32(vmaxq_f32(vmulq_f32(vld1q_f32(input + i), scale), min), max);
+            vst1q_s32(reinterpret_cast<int32_t*>(output + i * 4), vcvtnq_s32_f32(samples));
+        }
+#endif
+        fromFloatScalar<SampleFormat::Int32>(input + i, output + i * 4, count - i);
+    }
+#endif
+
+    // Split interleaved float frames into the planes, starting at offset in the planes.
+    // C is the channels count, 0 when only known at run time.
+    template<int C>
+    void splitChannels(const float* frames, float* const* planes, int channelsCount, unsigned long offset, unsigned long count)
+    {
+        const int channels = C > 0 ? C : channelsCount;
+        for (int c = 0; c < channels; c++)
+        {
+            float* plane = planes[c] + offset;
+            for (unsigned long i = 0; i < count; i++)
+                plane[i] = frames[i * channels + c];
+        }
+    }
+
+    template<>
+    void splitChannels<2>(const float* frames, float* const* planes, int, unsigned long offset, unsigned long count)
+    {
+        float* left = planes[0] + offset;
+        float* right = planes[1] + offset;
+        unsigned long i = 0;
+#if defined(MLB_SSE2)
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 first = _mm_loadu_ps(frames + i * 2);
+            __m128 second = _mm_loadu_ps(frames + i * 2 + 4);
+            _mm_storeu_ps(left + i, _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(right + i, _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+#elif defined(MLB_NEON)
+        for (; i + 4 <= count; i += 4)
+        {
+            float32x4x2_t samples = vld2q_f32(frames + i * 2);
+            vst1q_f32(left + i, samples.val[0]);
+            vst1q_f32(right + i, samples.val[1]);
+        }
+#endif
+        for (; i < count; i++)
+        {
+            left[i] = frames[i * 2];
+            right[i] = frames[i * 2 + 1];
+        }
+    }
+
+    // Merge the planes, starting at offset in the planes, into interleaved float frames.
+    template<int C>
+    void mergeChannels(const float* const* planes, float* frames, int channelsCount, unsigned long offset, unsigned long count)
+    {
+        const int channels = C > 0 ? C : channelsCount;
+        for (int c = 0; c < channels; c++)
+        {
+            const float* plane = planes[c] + offset;
+            for (unsigned long i = 0; i < count; i++)
+                frames[i * channels + c] = plane[i];
+        }
+    }
+
+    template<>
+    void mergeChannels<2>(const float* const* planes, float* frames, int, unsigned long offset, unsigned long count)
+    {
+        const float* left = planes[0] + offset;
+        const float* right = planes[1] + offset;
+        unsigned long i = 0;
+#if defined(MLB_SSE2)
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 l = _mm_loadu_ps(left + i);
+            __m128 r = _mm_loadu_ps(right + i);
+            _mm_storeu_ps(frames + i * 2, _mm_unpacklo_ps(l, r));
+            _mm_storeu_ps(frames + i * 2 + 4, _mm_unpackhi_ps(l, r));
+        }
+#elif defined(MLB_NEON)
+        for (; i + 4 <= count; i += 4)
+        {
+            float32x4x2_t samples;
+            samples.val[0] = vld1q_f32(left + i);
+            samples.val[1] = vld1q_f32(right + i);
+            vst2q_f32(frames + i * 2, samples);
+        }
+#endif
+        for (; i < count; i++)
+        {
+            frames[i * 2] = left[i];
+            frames[i * 2 + 1] = right[i];
+        }
+    }
+
+    template<SampleFormat F, int C>
+    void deinterleaveFrames(const void* input, float* const* planes, int channelsCount, unsigned long frames)
+    {
+        const int channels = C > 0 ? C : channelsCount;
+        const unsigned char* data = static_cast<const unsigned char*>(input);
+
+        if (channels == 1)
+        {
+            toFloat<F>(data, planes[0], frames);
+            return;
+        }
+        // Float frames are split directly.
+        if (F == SampleFormat::Float32)
+        {
+            splitChannels<C>(static_cast<const float*>(input), planes, channels, 0, frames);
+            return;
+        }
+
+        // The samples are converted by blocks, then split.
+        float block[BLOCK_SAMPLES];
+        const unsigned long blockFrames = BLOCK_SAMPLES / channels;
+        for (unsigned long offset = 0; offset < frames; offset += blockFrames)
+        {
+            unsigned long count = frames - offset < blockFrames ? frames - offset : blockFrames;
+            toFloat<F>(data + offset * channels * SampleTraits<F>::SIZE, block, count * channels);
+            splitChannels<C>(block, planes, channels, offset, count);
+        }
+    }
+
+    template<SampleFormat F, int C>
+    void interleaveFrames(const float* const* planes, void* output, int channelsCount, unsigned long frames)
+    {
+        const int channels = C > 0 ? C : channelsCount;
+        unsigned char* data = static_cast<unsigned char*>(output);
+
+        if (channels == 1)
+        {
+            fromFloat<F>(planes[0], data, frames);
+            return;
+        }
+        // Float frames are merged directly.
+        if (F == SampleFormat::Float32)
+        {
+            mergeChannels<C>(planes, static_cast<float*>(output), channels, 0, frames);
+            return;
+        }
+
+        // The planes are merged by blocks, then converted.
+        float block[BLOCK_SAMPLES];
+        const unsigned long blockFrames = BLOCK_SAMPLES / channels;
+        for (unsigned long offset = 0; offset < frames; offset += blockFrames)
+        {
+            unsigned long count = frames - offset < blockFrames ? frames - offset : blockFrames;
+            mergeChannels<C>(planes, block, channels, offset, count);
+            fromFloat<F>(block, data + offset * channels * SampleTraits<F>::SIZE, count * channels);
+        }
+    }
+
+    template<SampleFormat F>
+    void selectKernels(int channelsCount, SampleConverter::DeinterleaveKernel* deinterleave, SampleConverter::InterleaveKernel* interleave)
+    {
+        switch (channelsCount)
+        {
+        case 1:
+            *deinterleave = &deinterleaveFrames<F, 1>;
+            *interleave = &interleaveFrames<F, 1>;
+            break;
+        case 2:
+            *deinterleave = &deinterleaveFrames<F, 2>;
+            *interleave = &interleaveFrames<F, 2>;
+            break;
+        case 4:
+            *deinterleave = &deinterleaveFrames<F, 4>;
+            *interleave = &interleaveFrames<F, 4>;
+            break;
+        case 6:
+            *deinterleave = &deinterleaveFrames<F, 6>;
+            *interleave = &interleaveFrames<F, 6>;
+            break;
+        case 8:
+            *deinterleave = &deinterleaveFrames<F, 8>;
+            *interleave = &interleaveFrames<F, 8>;
+            break;
+        default:
+            *deinterleave = &deinterleaveFrames<F, 0>;
+            *interleave = &interleaveFrames<F, 0>;
+            break;
+        }
+    }
+}
+
+float sampleToFloat(SampleFormat format, const void* sample)
+{
+    const unsigned char* data = static_cast<const unsigned char*>(sample);
+    switch (format)
+    {
+    case SampleFormat::Int16:
+        return SampleTraits<SampleFormat::Int16>::load(data);
+    case SampleFormat::Int24:
+        return SampleTraits<SampleFormat::Int24>::load(data);
+    case SampleFormat::Int32:
+        return SampleTraits<SampleFormat::Int32>::load(data);
+    case SampleFormat::Float32:
+        return SampleTraits<SampleFormat::Float32>::load(data);
+    }
+    return 0.0f;
+}
+
+void floatToSample(SampleFormat format, float value, void* sample)
+{
+    unsigned char* data = static_cast<unsigned char*>(sample);
+    switch (format)
+    {
+    case SampleFormat::Int16:
+        SampleTraits<SampleFormat::Int16>::store(value, data);
+        break;
+    case SampleFormat::Int24:
+        SampleTraits<SampleFormat::Int24>::store(value, data);
+        break;
+    case SampleFormat::Int32:
+        SampleTraits<SampleFormat::Int32>::store(value, data);
+        break;
+    case SampleFormat::Float32:
+        SampleTraits<SampleFormat::Float32>::store(value, data);
+        break;
+    }
+}
+
+SampleConverter::SampleConverter() :
+    m_format(SampleFormat::Int16),
+    m_channelsCount(0),
+    m_deinterleave(nullptr),
+    m_interleave(nullptr)
+{}
+
+bool SampleConverter::init(SampleFormat format, int channelsCount)
+{
+    m_deinterleave = nullptr;
+    m_interleave = nullptr;
+    if (channelsCount <= 0 || channelsCount > MAX_CHANNELS)
+        return false;
+
+    switch (format)
+    {
+    case SampleFormat::Int16:
+        selectKernels<SampleFormat::Int16>(channelsCount, &m_deinterleave, &m_interleave);
+        break;
+    case SampleFormat::Int24:
+        selectKernels<SampleFormat::Int24>(channelsCount, &m_deinterleave, &m_interleave);
+        break;
+    case SampleFormat::Int32:
+        selectKernels<SampleFormat::Int32>(channelsCount, &m_deinterleave, &m_interleave);
+        break;
+    case SampleFormat::Float32:
+        selectKernels<SampleFormat::Float32>(channelsCount, &m_deinterleave, &m_interleave);
+        break;
+    default:
+        return false;
+    }
+
+    m_format = format;
+    m_channelsCount = channelsCount;
+    return true;
+}
+
+void SampleConverter::deinterleave(const void* input, float* const* planes, unsigned long frames) const
+{
+    m_deinterleave(input, planes, m_channelsCount, frames);
+}
+
+void SampleConverter::interleave(const float* const* planes, void* output, unsigned long frames) const
+{
+    m_interleave(planes, output, m_channelsCount, frames);
+}
+
+SampleFormat SampleConverter::format() const
+{
+    return m_format;
+}
+
+int SampleConverter::channelsCount() const
+{
+    return m_channelsCount;
+}
+
+const char* SampleConverter::instructionSet()
+{
+#if defined(MLB_AVX2)
+    return "AVX2";
+#elif defined(MLB_SSE2)
+    return "SSE2";
+#elif defined(MLB_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
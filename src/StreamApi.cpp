@@ -0,0 +1,94 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "StreamApi.h"
+
+bool streamApiFromString(const std::string& name, StreamApi* api)
+{
+    if (!api)
+        return false;
+
+    if (name == "portaudio")
+        *api = StreamApi::PortAudio;
+    else if (name == "file")
+        *api = StreamApi::File;
+#ifdef __linux__
+    else if (name == "pulse-simple")
+        *api = StreamApi::PulseSimple;
+    else if (name == "pulse")
+        *api = StreamApi::Pulse;
+#ifdef HAVE_ALSA
+    else if (name == "alsa")
+        *api = StreamApi::Alsa;
+#endif
+#ifdef HAVE_JACK
+    else if (name == "jack")
+        *api = StreamApi::Jack;
+#endif
+#ifdef HAVE_PIPEWIRE
+    else if (name == "pipewire")
+        *api = StreamApi::PipeWire;
+#endif
+#endif
+    else
+        return false;
+    return true;
+}
+
+const char* streamApiName(StreamApi api)
+{
+    switch (api)
+    {
+    case StreamApi::PortAudio:
+        return "portaudio";
+    case StreamApi::PulseSimple:
+        return "pulse-simple";
+    case StreamApi::Pulse:
+        return "pulse";
+    case StreamApi::Alsa:
+        return "alsa";
+    case StreamApi::Jack:
+        return "jack";
+    case StreamApi::PipeWire:
+        return "pipewire";
+    case StreamApi::File:
+        return "file";
+    }
+    return "unknown";
+}
+
+std::string availableStreamApis()
+{
+    std::string apis;
+#ifdef __linux__
+    apis += "pulse-simple (default), pulse, ";
+#ifdef HAVE_ALSA
+    apis += "alsa, ";
+#endif
+#ifdef HAVE_JACK
+    apis += "jack, ";
+#endif
+#ifdef HAVE_PIPEWIRE
+    apis += "pipewire, ";
+#endif
+    apis += "portaudio, file";
+#else
+    apis += "portaudio (default), file";
+#endif
+    return apis;
+}
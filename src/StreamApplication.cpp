@@ -17,10 +17,16 @@
 */
 
 #include "StreamApplication.h"
-#include "CMDParser.h"
+#include "LatencyCeiling.h"
+#include "Resampler.h"
+#include "Tracer.h"
+#include "ConfigWriter.h"
 #include <portaudio.h>
 #include <thread>
 #include <chrono>
+#include <iostream>
+#include <iterator>
+#include <vector>
 #ifdef __linux__
 #include <csignal>
 #endif
@@ -28,17 +34,41 @@
 // Static pointer to the app initialized.
 static StreamApplication* app = nullptr;
 
+// Delay before a failed route is opened again.
+static const int ROUTE_RESTART_SECONDS = 5;
+
 StreamApplication::StreamApplication(int& argc, char**& argv) :
     m_stream(nullptr),
     m_isAppContinue(false),
+    m_isStatsRequested(false),
     m_isAppReady(false),
     m_sampleRate(-1),
+    m_outputSampleRate(0),
+    m_resamplerQuality(ResamplerQuality::Medium),
+    m_isDriftCompensation(false),
+    m_maxLatency(0.0),
     m_framesPerBuffer(-1),
+    m_channelsCount(0),
+    m_isSampleFormatSet(false),
+    m_sampleFormat(SampleFormat::Int16),
+    m_api(StreamApi::PortAudio),
+    m_measureLatencyBursts(0),
+    m_isCalibrate(false),
+    m_isBenchmark(false),
+    m_isListDevices(false),
+    m_calibrateTime(5),
+    m_statsInterval(0),
+    m_isFileRealtime(false),
+    m_simulatedDrift(0.0),
+    m_processingThreads(0),
+    m_mixBufferTime(0.0),
 #ifdef WIN32
     m_inputLatency(-1.0),
     m_outputLatency(-1.0)
 #elif __linux
-    m_usePortAudio(false)
+    m_ringBufferPeriods(-1),
+    m_adaptiveBufferMin(0),
+    m_adaptiveBufferMax(0)
 #endif
 {
     // Set the app static member to this instance.
@@ -48,33 +78,75 @@ StreamApplication::StreamApplication(int& argc, char**& argv) :
     CMDParser cmdParse(argc, argv);
     if (cmdParse.isSampleRateSet())
         m_sampleRate = cmdParse.sampleRate();
+    m_outputSampleRate = cmdParse.outputSampleRate();
+    m_resamplerQuality = cmdParse.resamplerQuality();
+    m_isDriftCompensation = cmdParse.isDriftCompensation();
+    m_maxLatency = cmdParse.maxLatency();
     if (cmdParse.isFramesPerBufferSet())
         m_framesPerBuffer = cmdParse.framesPerBuffer();
+    m_channelsCount = cmdParse.channelsCount();
+    m_isSampleFormatSet = cmdParse.isSampleFormatSet();
+    m_sampleFormat = cmdParse.sampleFormat();
+    m_api = cmdParse.api();
+    m_measureLatencyBursts = cmdParse.measureLatencyBursts();
+    m_isCalibrate = cmdParse.isCalibrate();
+    m_isBenchmark = cmdParse.isBenchmark();
+    m_isListDevices = cmdParse.isListDevices();
+    m_calibrateTime = cmdParse.calibrateTime();
+    m_statsInterval = cmdParse.statsInterval();
+    m_traceFile = cmdParse.traceFile();
+    m_inputFile = cmdParse.inputFile();
+    m_outputFile = cmdParse.outputFile();
+    m_isFileRealtime = cmdParse.isFileRealtime();
+    m_simulatedDrift = cmdParse.simulatedDrift();
+    m_processing = cmdParse.processing();
+    m_processingThreads = cmdParse.processingThreads();
+    m_inputDevice = cmdParse.inputDevice();
+    m_outputDevice = cmdParse.outputDevice();
+    for (const RouteSettings& settings : cmdParse.routes())
+    {
+        Route route;
+        route.settings = settings;
+        route.stream = nullptr;
+        route.isPlaying = false;
+        route.lastXruns = 0;
+        route.lastCatchUps = 0;
+        m_routes.push_back(route);
+    }
+    m_mixSources = cmdParse.mixSources();
+    m_mixBufferTime = cmdParse.mixBufferTime();
 #ifdef WIN32
     if (cmdParse.isInputLatencySet())
         m_inputLatency = cmdParse.inputLatency();
     if (cmdParse.isOutputLatencySet())
         m_outputLatency = cmdParse.outputLatency();
 #elif __linux__
-    m_usePortAudio = cmdParse.usePortAudio();
+    if (cmdParse.isRingBufferPeriodsSet())
+        m_ringBufferPeriods = cmdParse.ringBufferPeriods();
+    m_adaptiveBufferMin = cmdParse.adaptiveBufferMin();
+    m_adaptiveBufferMax = cmdParse.adaptiveBufferMax();
+    m_metricsSocket = cmdParse.metricsSocket();
 #endif
 
     // Initialize PortAudio.
-#ifdef __linux__
-    if (m_usePortAudio)
+    if (m_api == StreamApi::PortAudio)
     {
-#endif
-    int err = Pa_Initialize();
-    if (err == paNoError)
-        m_isAppReady = true;
-    else
-        m_isAppReady = false;
-#ifdef __linux__
+        int err = Pa_Initialize();
+        if (err == paNoError)
+            m_isAppReady = true;
+        else
+            m_isAppReady = false;
     }
-#endif
 
     m_isAppReady = true;
 
+    // The stages run on the audio thread when the workers cannot be started.
+    if (m_processingThreads > 0 && !m_processingExecutor.start(m_processingThreads))
+        std::cout << m_processingExecutor.error() << " The processing stages run on the audio thread." << std::endl;
+    else if (m_processingExecutor.threadsCount() < m_processingThreads)
+        std::cout << m_processingThreads << " processing threads requested, " << m_processingExecutor.threadsCount() 
+            << " started: one worker per core at most, a core being left to the audio thread." << std::endl;
+
     // Connect the signal handler to catch ctrl-c and terminate signals.
 #ifdef WIN32
     createWindowsSignalsCatch();
@@ -91,19 +163,60 @@ StreamApplication::~StreamApplication()
 void StreamApplication::setStream(LoopbackStream* stream)
 {
     m_stream = stream;
+    configureStream(m_stream);
+
+    // The benchmark does not open any device and the list only probe them.
+    // The routes open their own streams.
+    if (m_isBenchmark || m_isListDevices || !m_routes.empty())
+        return;
+
+    m_stream->setMixSources(m_mixSources, m_mixBufferTime);
+    if (!m_stream->init())
+        std::cout << m_stream->error() << std::endl;
+    else if (m_maxLatency > 0.0 && !m_stream->latencyCeiling())
+        std::cout << "The maximum latency is not supported by the " << streamApiName(m_api) << " API." << std::endl;
+#ifdef __linux__
+    else if (m_adaptiveBufferMin > 0 && !m_stream->bufferController())
+        std::cout << "The adaptive buffer is not supported by the " << streamApiName(m_api) << " API." << std::endl;
+#endif
+}
+
+void StreamApplication::configureStream(LoopbackStream* stream)
+{
     if (m_sampleRate > -1)
-        m_stream->setSampleRate(m_sampleRate);
+        stream->setSampleRate(m_sampleRate);
+    if (m_outputSampleRate > 0)
+        stream->setOutputSampleRate(m_outputSampleRate);
+    stream->setResamplerQuality(m_resamplerQuality);
+    stream->setDriftCompensation(m_isDriftCompensation);
+    stream->setMaxLatency(m_maxLatency / 1000.0);
     if (m_framesPerBuffer > -1)
-        m_stream->setFramesPerBuffer(m_framesPerBuffer);
+        stream->setFramesPerBuffer(m_framesPerBuffer);
+    if (m_channelsCount > 0)
+        stream->setChannelsCount(m_channelsCount);
+    if (m_isSampleFormatSet)
+        stream->setSampleFormat(m_sampleFormat);
+    stream->setApi(m_api);
+    stream->setInputFile(m_inputFile);
+    stream->setOutputFile(m_outputFile);
+    stream->setFileRealtime(m_isFileRealtime);
+    stream->setSimulatedDrift(m_simulatedDrift);
+    stream->setProcessing(m_processing);
+    stream->setProcessingExecutor(m_processingExecutor.threadsCount() > 0 ? &m_processingExecutor : nullptr);
+    stream->setLatencyMeasurement(m_measureLatencyBursts);
+    stream->setInputDevice(m_inputDevice);
+    stream->setOutputDevice(m_outputDevice);
 #ifdef WIN32
     if (m_inputLatency > -1.0)
-        m_stream->setInputLatency(m_inputLatency);
+        stream->setInputLatency(m_inputLatency);
     if (m_outputLatency > -1.0)
-        m_stream->setOutputLatency(m_outputLatency);
+        stream->setOutputLatency(m_outputLatency);
 #elif __linux__
-    m_stream->usePortAudio(m_usePortAudio);
+    if (m_ringBufferPeriods > -1)
+        stream->setRingBufferPeriods(m_ringBufferPeriods);
+    stream->setAdaptiveBuffer(m_adaptiveBufferMin, m_adaptiveBufferMax);
 #endif
-    m_stream->init();
+
 }
 
 bool StreamApplication::isAppReady() const
@@ -121,8 +234,16 @@ int StreamApplication::run()
 {
     if (!m_stream) return EXIT_FAILURE;
 
+    // The calibration open the stream itself with each setting.
+    if (m_isCalibrate) return calibrate();
+    if (m_isBenchmark) return benchmark();
+    if (m_isListDevices) return listDevices();
+    if (!m_routes.empty()) return runRoutes();
+
     if (!isAppReady()) return EXIT_FAILURE;
 
+    startTracer();
+
     // Check if the stream is initialized before lauching the main loop.
     if (!m_stream->isStreamReady())
         m_stream->init();
@@ -131,15 +252,549 @@ int StreamApplication::run()
     else
         m_isAppContinue = false;
 
-    if (!m_isAppContinue) return EXIT_FAILURE;
+    if (!m_isAppContinue)
+    {
+        if (!m_stream->error().empty())
+            std::cout << m_stream->error() << std::endl;
+        m_stream->stop();
+        Tracer::stop();
+        return EXIT_FAILURE;
+    }
+
+    // The lookahead of the stages delay the whole stream.
+    const ProcessingChain* processingChain = m_stream->processingChain();
+    if (processingChain && processingChain->executor())
+        std::cout << "The processing stages run on " << processingChain->executor()->threadsCount() << " worker threads"
+            << (processingChain->executor()->isRealtime() ? "" : " without realtime priority") << " (" 
+            << processingChain->nodesCount() << " nodes)." << std::endl;
+    if (m_stream->mixBus())
+        std::cout << "Mixing " << m_stream->mixBus()->sourcesCount() << " capture sources into the playback, buffered " 
+            << m_mixBufferTime * 1000.0 << " ms each." << std::endl;
+    if (processingChain && processingChain->latency() > 0)
+        std::cout << "The processing stages add " << processingChain->latency() * 1000.0 / processingChain->sampleRate() << " ms of latency (" 
+            << processingChain->latency() << " frames)." << std::endl;
+    if (m_stream->resamplerLatency() > 0.0)
+        std::cout << "The playback is resampled from " << m_stream->sampleRate() << " to " << m_stream->outputSampleRate() 
+            << " Hz (" << resamplerQualityName(m_resamplerQuality) << " quality), adding " 
+            << m_stream->resamplerLatency() * 1000.0 << " ms of latency." << std::endl;
+
+#ifdef __linux__
+    // The metrics are served from their own thread while the stream is playing.
+    if (!m_metricsSocket.empty())
+    {
+        m_metricsServer.addStream(m_stream);
+        if (m_metricsServer.start(m_metricsSocket))
+            std::cout << "Serving the metrics on " << m_metricsSocket << "." << std::endl;
+        else
+            std::cout << m_metricsServer.error() << std::endl;
+    }
+#endif
 
     // Main loop of the program.
+    auto lastStats = std::chrono::steady_clock::now();
+    unsigned long lastXruns = 0;
+    unsigned long lastCatchUps = 0;
     while (m_isAppContinue && m_stream->isPlayingContinue())
     {
         std::this_thread::sleep_for(std::chrono::milliseconds(50));
 
-        if (m_isAppContinue)
-            m_isAppContinue = m_stream->isPlayingContinue();
+        reportStreamEvents(m_stream, "", lastXruns, lastCatchUps);
+
+        // Periodically or on request (SIGUSR1) show the statistics of the stream.
+        if (m_isStatsRequested.exchange(false) ||
+            (m_statsInterval > 0 &&
+            std::chrono::steady_clock::now() - lastStats >= std::chrono::seconds(m_statsInterval)))
+        {
+            lastStats = std::chrono::steady_clock::now();
+            printStats(m_stream);
+        }
+
+        // The correlation of the latency measurement is done outside of the audio thread.
+        LatencyMeter* latencyMeter = m_stream->latencyMeter();
+        if (latencyMeter)
+        {
+            latencyMeter->analyze(std::cout);
+            if (latencyMeter->isFinished())
+                m_isAppContinue = false;
+        }
+
+        if (!m_stream->isPlayingContinue())
+            m_isAppContinue = false;
+    }
+
+#ifdef __linux__
+    m_metricsServer.stop();
+#endif
+
+    // The backend is stopped but kept alive to report its statistics.
+    m_stream->stop();
+    Tracer::stop();
+    if (!m_stream->error().empty())
+        std::cout << m_stream->error() << std::endl;
+    m_stream->printSummary(std::cout);
+    printStats(m_stream);
+
+    LatencyMeter* latencyMeter = m_stream->latencyMeter();
+    if (latencyMeter)
+    {
+        latencyMeter->printReport(std::cout);
+        if (latencyMeter->detectedCount() == 0)
+            return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void StreamApplication::startTracer()
+{
+    // The tracer must be ready before the audio threads start.
+    if (m_traceFile.empty())
+        return;
+
+    if (Tracer::start(m_traceFile))
+        std::cout << "Tracing into " << m_traceFile << "." << std::endl;
+    else
+        std::cout << "Failed to open the trace file " << m_traceFile << "." << std::endl;
+}
+
+void StreamApplication::reportStreamEvents(LoopbackStream* stream, const std::string& prefix, unsigned long& lastXruns, unsigned long& lastCatchUps)
+{
+    // Report the xruns as soon as they happen.
+    unsigned long xruns = stream->xrunsCount();
+    if (xruns != lastXruns)
+    {
+        std::cout << prefix << "Xrun detected (total: " << xruns << ")." << std::endl;
+        lastXruns = xruns;
+    }
+
+    // Report the catch-ups of the maximum latency as soon as they happen.
+    const LatencyCeiling* latencyCeiling = stream->latencyCeiling();
+    if (latencyCeiling && latencyCeiling->catchUpsCount() != lastCatchUps)
+    {
+        lastCatchUps = latencyCeiling->catchUpsCount();
+        std::cout << prefix << "Latency over " << m_maxLatency << " ms, catching up by dropping frames (total: " << lastCatchUps << ")." << std::endl;
+    }
+
+#ifdef __linux__
+    // Follow the load of the machine with the buffering.
+    if (stream->updateAdaptiveBuffer())
+        std::cout << prefix << "Adaptive buffer: " << stream->bufferController()->periods() << " periods." << std::endl;
+#endif
+}
+
+int StreamApplication::runRoutes()
+{
+    // The routes are played from devices, and their latency measurements would hear each other.
+    if (m_api == StreamApi::File || m_measureLatencyBursts > 0)
+    {
+        std::cout << "The routes cannot play files nor measure the latency." << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!m_isAppReady)
+        return EXIT_FAILURE;
+
+    startTracer();
+
+#ifdef __linux__
+    // The routes are added to the metrics while they play, labelled by their name.
+    if (!m_metricsSocket.empty())
+    {
+        if (m_metricsServer.start(m_metricsSocket))
+            std::cout << "Serving the metrics on " << m_metricsSocket << "." << std::endl;
+        else
+            std::cout << m_metricsServer.error() << std::endl;
+    }
+#endif
+
+    // Each route has its own stream, the backends share the context of their API.
+    m_isAppContinue = true;
+    bool isRoutePlayed = false;
+    for (Route& route : m_routes)
+    {
+        route.stream = new LoopbackStream();
+        configureStream(route.stream);
+        route.stream->setInputDevice(route.settings.inputDevice);
+        route.stream->setOutputDevice(route.settings.outputDevice);
+        if (route.settings.framesPerBuffer > 0)
+            route.stream->setFramesPerBuffer(route.settings.framesPerBuffer);
+        route.stream->setProcessing(route.settings.processing);
+        if (startRoute(route))
+            isRoutePlayed = true;
+    }
+
+    // Main loop, the failures are handled route by route.
+    // A route which could not start is retried like a route which stopped.
+    auto lastStats = std::chrono::steady_clock::now();
+    while (m_isAppContinue)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        bool isStatsTime = m_isStatsRequested.exchange(false) ||
+            (m_statsInterval > 0 && now - lastStats >= std::chrono::seconds(m_statsInterval));
+        if (isStatsTime)
+            lastStats = now;
+
+        for (Route& route : m_routes)
+        {
+            if (route.isPlaying && !route.stream->isPlayingContinue())
+            {
+                // The backend is kept until the restart to report its statistics.
+                // Its error is complete once its threads are stopped.
+                route.stream->stop();
+                std::cout << "Route " << route.settings.name << " stopped";
+                if (!route.stream->error().empty())
+                    std::cout << ": " << route.stream->error();
+                std::cout << ", restarting in " << ROUTE_RESTART_SECONDS << " s." << std::endl;
+                route.isPlaying = false;
+                route.restartTime = now + std::chrono::seconds(ROUTE_RESTART_SECONDS);
+            }
+            else if (route.isPlaying)
+                reportStreamEvents(route.stream, "Route " + route.settings.name + ": ", route.lastXruns, route.lastCatchUps);
+            else if (now >= route.restartTime && startRoute(route))
+                isRoutePlayed = true;
+
+            if (isStatsTime)
+            {
+                std::cout << "Route " << route.settings.name << (route.isPlaying ? ":" : " (stopped):") << std::endl;
+                printStats(route.stream);
+            }
+        }
+    }
+
+#ifdef __linux__
+    m_metricsServer.stop();
+#endif
+
+    // The backends are stopped but kept alive to report their statistics.
+    for (Route& route : m_routes)
+        route.stream->stop();
+    Tracer::stop();
+    for (Route& route : m_routes)
+    {
+        std::cout << "Route " << route.settings.name << ":" << std::endl;
+        route.stream->printSummary(std::cout);
+        printStats(route.stream);
+    }
+
+    for (Route& route : m_routes)
+    {
+#ifdef __linux__
+        m_metricsServer.removeStream(route.stream);
+#endif
+        route.stream->deinit();
+        delete route.stream;
+        route.stream = nullptr;
+    }
+
+    if (!isRoutePlayed)
+    {
+        std::cout << "No route could be played." << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+bool StreamApplication::startRoute(Route& route)
+{
+    // The metrics must not read the backend while it is replaced.
+#ifdef __linux__
+    m_metricsServer.removeStream(route.stream);
+#endif
+    route.stream->deinit();
+
+    route.lastXruns = 0;
+    route.lastCatchUps = 0;
+    route.isPlaying = route.stream->init() && route.stream->play();
+    if (!route.isPlaying)
+    {
+        route.stream->stop();
+        std::cout << "Route " << route.settings.name << ": " << route.stream->error() 
+            << " Retrying in " << ROUTE_RESTART_SECONDS << " s." << std::endl;
+        route.restartTime = std::chrono::steady_clock::now() + std::chrono::seconds(ROUTE_RESTART_SECONDS);
+        return false;
+    }
+
+    std::cout << "Route " << route.settings.name << ": playing " 
+        << (route.settings.inputDevice.empty() ? "the default input" : route.settings.inputDevice) << " into "
+        << (route.settings.outputDevice.empty() ? "the default output" : route.settings.outputDevice) << "." << std::endl;
+#ifdef __linux__
+    m_metricsServer.addStream(route.stream, route.settings.name);
+#endif
+    return true;
+}
+
+int StreamApplication::calibrate()
+{
+    // Tested settings, from the highest to the lowest latency.
+    static const int FRAMES_PER_BUFFER[] = {1024, 512, 256, 128, 64, 32, 16};
+    static const int SAMPLE_RATES[] = {96000, 48000, 44100};
+
+    if (!m_isAppReady)
+        return EXIT_FAILURE;
+    if (m_api == StreamApi::Jack || m_api == StreamApi::PipeWire || m_api == StreamApi::File)
+    {
+        std::cout << "The " << streamApiName(m_api) << " API cannot be calibrated, its period is not chosen by MicrophoneLoopback." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // A sample rate given by the user is the only one tested.
+    std::vector<int> sampleRates;
+    if (m_sampleRate > -1)
+        sampleRates.push_back(m_sampleRate);
+    else
+        sampleRates.assign(std::begin(SAMPLE_RATES), std::end(SAMPLE_RATES));
+
+    int bestSampleRate = 0;
+    int bestFramesPerBuffer = 0;
+    m_isAppContinue = true;
+    for (int sampleRate : sampleRates)
+    {
+        for (int framesPerBuffer : FRAMES_PER_BUFFER)
+        {
+            if (!m_isAppContinue)
+                break;
+
+            std::cout << "Testing " << framesPerBuffer << " frames per buffer at " << sampleRate << " Hz: " << std::flush;
+            unsigned long glitches = 0;
+            if (!calibrationStep(sampleRate, framesPerBuffer, glitches))
+            {
+                std::cout << "failed to play (" << m_stream->error() << ")." << std::endl;
+                break;
+            }
+            if (glitches > 0)
+            {
+                // A smaller period would only be worse.
+                std::cout << glitches << " glitches." << std::endl;
+                break;
+            }
+            std::cout << "stable." << std::endl;
+
+            // The best setting is the one with the shortest period.
+            if (bestFramesPerBuffer == 0 ||
+                static_cast<double>(framesPerBuffer) / sampleRate < static_cast<double>(bestFramesPerBuffer) / bestSampleRate)
+            {
+                bestSampleRate = sampleRate;
+                bestFramesPerBuffer = framesPerBuffer;
+            }
+        }
+    }
+
+    if (!m_isAppContinue)
+    {
+        std::cout << "Calibration interrupted." << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (bestFramesPerBuffer == 0)
+    {
+        std::cout << "No setting played without glitch." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Best setting: " << bestFramesPerBuffer << " frames per buffer at " << bestSampleRate << " Hz ("
+        << bestFramesPerBuffer * 1000.0 / bestSampleRate << " ms per period)." << std::endl;
+
+    std::string path = CMDParser::userConfigPath();
+    std::string error;
+    std::vector<std::pair<std::string, std::string>> values;
+    values.push_back(std::make_pair("sample-rate", std::to_string(bestSampleRate)));
+    values.push_back(std::make_pair("frames-per-buffer", std::to_string(bestFramesPerBuffer)));
+    if (!writeIniValues(path, "stream", values, error))
+    {
+        std::cout << error << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Written to " << path << "." << std::endl;
+    return EXIT_SUCCESS;
+}
+
+bool StreamApplication::calibrationStep(int sampleRate, int framesPerBuffer, unsigned long& glitches)
+{
+    m_stream->setSampleRate(sampleRate);
+    m_stream->setFramesPerBuffer(framesPerBuffer);
+    if (!m_stream->init() || !m_stream->play())
+    {
+        m_stream->deinit();
+        return false;
+    }
+
+    // The glitches of the start of the stream are not counted.
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    unsigned long startGlitches = glitchesCount();
+
+    auto end = std::chrono::steady_clock::now() + std::chrono::seconds(m_calibrateTime);
+    while (m_isAppContinue && m_stream->isPlayingContinue() && std::chrono::steady_clock::now() < end)
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    glitches = glitchesCount() - startGlitches;
+    // A stream stopping by itself has failed.
+    if (m_isAppContinue && !m_stream->isPlayingContinue())
+        glitches++;
+
+    m_stream->stop();
+    m_stream->deinit();
+    return true;
+}
+
+unsigned long StreamApplication::glitchesCount() const
+{
+    const StreamCounters* counters = m_stream->counters();
+    if (!counters)
+        return 0;
+
+    m_stream->timing()->snapshot(m_timingSnapshot);
+    return m_stream->xrunsCount() +
+        counters->inputOverflows.load(std::memory_order_relaxed) +
+        counters->outputUnderflows.load(std::memory_order_relaxed) +
+        static_cast<unsigned long>(m_timingSnapshot.deadlineMisses);
+}
+
+int StreamApplication::listDevices()
+{
+    std::vector<DeviceInfo> devices;
+    if (!m_stream->listDevices(&devices))
+    {
+        std::cout << m_stream->error() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // The devices are numbered by direction, as selected by --input-device and --output-device.
+    for (int direction = 0; direction < 2; direction++)
+    {
+        bool isInput = direction == 0;
+        std::cout << (isInput ? "Capture" : "Playback") << " devices of the " << streamApiName(m_api) << " API:" << std::endl;
+        int index = 0;
+        for (const DeviceInfo& device : devices)
+        {
+            if (device.isInput != isInput)
+                continue;
+
+            std::cout << "  " << index++ << ": " << device.id;
+            if (device.description != device.id)
+                std::cout << " (" << device.description << ")";
+            if (device.channelsCount <= 0)
+            {
+                std::cout << ", unavailable." << std::endl;
+                continue;
+            }
+            std::cout << ", " << device.channelsCount << " channels, ";
+            if (device.sampleRates.empty())
+                std::cout << "any rate";
+            for (size_t i = 0; i < device.sampleRates.size(); i++)
+                std::cout << (i > 0 ? ", " : "") << device.sampleRates[i];
+            std::cout << " Hz";
+            if (device.defaultSampleRate > 0)
+                std::cout << " (default: " << device.defaultSampleRate << " Hz)";
+            if (device.lowLatency > 0.0)
+                std::cout << ", lowest latency: " << device.lowLatency * 1000.0 << " ms";
+            std::cout << "." << std::endl;
+        }
+        if (index == 0)
+            std::cout << "  None." << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
+
+int StreamApplication::benchmark()
+{
+    // Seconds of audio processed.
+    static const int BENCHMARK_SECONDS = 60;
+
+    if (m_processing.stages.empty())
+    {
+        std::cout << "There is no processing stage to benchmark, set them with --processing-chain." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    int sampleRate = m_sampleRate > -1 ? m_sampleRate : 48000;
+    unsigned long framesPerBuffer = m_framesPerBuffer > -1 ? m_framesPerBuffer : 256;
+    int channelsCount = m_channelsCount > 0 ? m_channelsCount : 1;
+    SampleFormat format = m_isSampleFormatSet ? m_sampleFormat : SampleFormat::Int16;
+
+    ProcessingChain chain;
+    chain.setExecutor(m_processingExecutor.threadsCount() > 0 ? &m_processingExecutor : nullptr);
+    for (const std::string& name : m_processing.stages)
+        chain.addStage(createProcessingStage(name, m_processing));
+    if (!chain.init(format, channelsCount, sampleRate, framesPerBuffer))
+    {
+        std::cout << chain.error() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // White noise at -12 dBFS, the output is written in another buffer to keep the input.
+    size_t frameSize = channelsCount * sampleFormatSize(format);
+    std::vector<char> input(framesPerBuffer * frameSize);
+    std::vector<char> output(input.size());
+    unsigned int seed = 1;
+    for (size_t i = 0; i < framesPerBuffer * channelsCount; i++)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        float value = (static_cast<float>(seed >> 8) / 16777216.0f - 0.5f) * 0.5f;
+        floatToSample(format, value, input.data() + i * sampleFormatSize(format));
+    }
+
+    // The whole chain, with the conversions, is timed for each period.
+    m_isAppContinue = true;
+    TimingHistogram chainTiming;
+    unsigned long periodsCount = static_cast<unsigned long>(BENCHMARK_SECONDS) * sampleRate / framesPerBuffer;
+    uint64_t deadline = chain.periodDuration();
+    for (unsigned long i = 0; i < periodsCount && m_isAppContinue; i++)
+    {
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        chain.process(input.data(), output.data(), framesPerBuffer);
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        chainTiming.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()), deadline);
+    }
+
+    std::cout << "Benchmark of " << periodsCount << " periods of " << framesPerBuffer << " frames, " 
+        << channelsCount << " channel(s) " << sampleFormatName(format) << " at " << sampleRate << " Hz"
+        << " (" << SampleConverter::instructionSet();
+    if (chain.executor())
+        std::cout << ", " << chain.executor()->threadsCount() << " processing threads, " << chain.nodesCount() << " nodes";
+    std::cout << "), median cost:" << std::endl;
+    for (size_t i = 0; i < chain.stagesCount(); i++)
+    {
+        chain.stageTiming(i).snapshot(m_timingSnapshot);
+        double period = static_cast<double>(m_timingSnapshot.percentile(0.5));
+        double frame = period / framesPerBuffer;
+        std::cout << "Stage " << chain.stageName(i) << ": " << period / 1000.0 << " us per period, " 
+            << frame << " ns per frame";
+        if (chain.stageFiltersCount(i) > 1)
+            std::cout << ", " << frame / chain.stageFiltersCount(i) << " ns per frame per filter ("
+                << chain.stageFiltersCount(i) << " filters)";
+        std::cout << std::endl;
+    }
+    chainTiming.snapshot(m_timingSnapshot);
+    double period = static_cast<double>(m_timingSnapshot.percentile(0.5));
+    std::cout << "Chain with the conversions: " << period / 1000.0 << " us per period, " 
+        << period / framesPerBuffer << " ns per frame, " << period * 100.0 / deadline << "% of the period." << std::endl;
+    if (chain.latency() > 0)
+        std::cout << "Latency of the chain: " << chain.latency() * 1000.0 / sampleRate << " ms (" << chain.latency() << " frames)." << std::endl;
+
+    // The resampler run after the chain when the output rate differs.
+    if (m_outputSampleRate > 0 && m_outputSampleRate != sampleRate)
+    {
+        Resampler resampler;
+        if (!resampler.init(format, channelsCount, sampleRate, m_outputSampleRate, m_resamplerQuality, framesPerBuffer))
+        {
+            std::cout << resampler.error() << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::vector<char> resampled(resampler.maxOutputFrames() * frameSize);
+        TimingHistogram resamplerTiming;
+        for (unsigned long i = 0; i < periodsCount && m_isAppContinue; i++)
+        {
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            resampler.process(output.data(), framesPerBuffer, resampled.data());
+            std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+            resamplerTiming.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()), deadline);
+        }
+        resamplerTiming.snapshot(m_timingSnapshot);
+        period = static_cast<double>(m_timingSnapshot.percentile(0.5));
+        std::cout << "Resampler to " << m_outputSampleRate << " Hz (" << resamplerQualityName(m_resamplerQuality) << " quality, " 
+            << resampler.tapsCount() << " taps): " << period / 1000.0 << " us per period, " << period / framesPerBuffer 
+            << " ns per frame, latency " << resampler.latency() * 1000.0 << " ms." << std::endl;
     }
 
     return EXIT_SUCCESS;
@@ -147,17 +802,15 @@ int StreamApplication::run()
 
 void StreamApplication::stopApplication()
 {
+    // Called from the signal handler, the main loop of run() stop the stream.
     m_isAppContinue = false;
-    deinit();
 }
 
 void StreamApplication::deinit()
 {
     m_stream->deinit();
-#ifdef __linux__
-    if (m_usePortAudio)
-#endif
-    Pa_Terminate();
+    if (m_api == StreamApi::PortAudio)
+        Pa_Terminate();
 }
 
 #ifdef WIN32
@@ -188,6 +841,8 @@ void StreamApplication::createSigAction()
     sigHandler.sa_flags = 0;
     sigaction(SIGINT, &sigHandler, NULL);
     sigaction(SIGTERM, &sigHandler, NULL);
+    // SIGUSR1 print the statistics without stopping the stream.
+    sigaction(SIGUSR1, &sigHandler, NULL);
 }
 
 void StreamApplication::sigActionHandler(int signal)
@@ -200,5 +855,130 @@ void StreamApplication::sigActionHandler(int signal)
             app->stopApplication();
         }
     }
+    else if (signal == SIGUSR1)
+    {
+        if (app)
+            app->m_isStatsRequested = true;
+    }
 }
-#endif
\ No newline at end of file
+
+#endif
+
+void StreamApplication::printStats(const LoopbackStream* stream) const
+{
+    if (!stream || !stream->counters())
+        return;
+
+    // Glitches and latency reported by the backend.
+    const StreamCounters* counters = stream->counters();
+    std::cout << "Input overflows: " << counters->inputOverflows.load(std::memory_order_relaxed)
+        << ", output underflows: " << counters->outputUnderflows.load(std::memory_order_relaxed)
+        << ", priming: " << counters->primingOutputs.load(std::memory_order_relaxed);
+    long inputLatency = counters->inputLatency.load(std::memory_order_relaxed);
+    if (inputLatency >= 0)
+        std::cout << ", input latency: " << inputLatency / 1000.0 << " ms";
+    long outputLatency = counters->outputLatency.load(std::memory_order_relaxed);
+    if (outputLatency >= 0)
+        std::cout << ", output latency: " << outputLatency / 1000.0 << " ms";
+    double cpuLoad = stream->cpuLoad();
+    if (cpuLoad >= 0.0)
+        std::cout << ", cpu load: " << cpuLoad * 100.0 << "%";
+    std::cout << std::endl;
+
+    // Tail of the time spent by the audio thread on each period.
+    if (stream->timing())
+    {
+        stream->timing()->snapshot(m_timingSnapshot);
+        m_timingSnapshot.print(std::cout);
+    }
+
+    // Cost of each processing stage within the period.
+    const ProcessingChain* processingChain = stream->processingChain();
+    if (processingChain)
+    {
+        double periodDuration = static_cast<double>(processingChain->periodDuration());
+        for (size_t i = 0; i < processingChain->stagesCount(); i++)
+        {
+            processingChain->stageTiming(i).snapshot(m_timingSnapshot);
+            uint64_t p99 = m_timingSnapshot.percentile(0.99);
+            std::cout << "Stage " << processingChain->stageName(i) 
+                << ": p50: " << m_timingSnapshot.percentile(0.5) / 1000.0 << " us"
+                << ", p99: " << p99 / 1000.0 << " us"
+                << ", max: " << m_timingSnapshot.max / 1000.0 << " us"
+                << ", p99 of the period: " << (periodDuration > 0.0 ? p99 * 100.0 / periodDuration : 0.0) << "%" << std::endl;
+            std::string report = processingChain->stageReport(i);
+            if (!report.empty())
+                std::cout << "Stage " << processingChain->stageName(i) << ": " << report << std::endl;
+        }
+        // With the workers, the time of each channel of the stages split in nodes.
+        for (size_t i = 0; i < processingChain->nodesCount(); i++)
+        {
+            if (processingChain->nodeChannel(i) < 0)
+                continue;
+            processingChain->nodeTiming(i).snapshot(m_timingSnapshot);
+            std::cout << "Stage " << processingChain->stageName(processingChain->nodeStage(i)) 
+                << ", channel " << processingChain->nodeChannel(i) + 1
+                << ": p50: " << m_timingSnapshot.percentile(0.5) / 1000.0 << " us"
+                << ", p99: " << m_timingSnapshot.percentile(0.99) / 1000.0 << " us"
+                << ", max: " << m_timingSnapshot.max / 1000.0 << " us" << std::endl;
+        }
+        if (processingChain->executor())
+            std::cout << "Periods processed serially (workers busy with another route): " << processingChain->serialPeriods() << std::endl;
+        // Alignment of each mix source and the cost of the accumulation.
+        const MixBus* mixBus = processingChain->mixBus();
+        if (mixBus)
+        {
+            for (size_t i = 0; i < mixBus->sourcesCount(); i++)
+            {
+                const MixSource& source = mixBus->source(i);
+                std::cout << "Mix source " << source.settings().name << (mixBus->isSourcePlaying(i) ? "" : " (stopped)")
+                    << ": level " << source.level() * 1000.0 << " ms (target " << source.targetLevel() * 1000.0 << " ms)"
+                    << ", underruns " << source.underruns()
+                    << ", realignments " << source.realignments()
+                    << ", overflows " << source.overflows() << std::endl;
+            }
+            processingChain->mixTiming().snapshot(m_timingSnapshot);
+            std::cout << "Mix: p50: " << m_timingSnapshot.percentile(0.5) / 1000.0 << " us"
+                << ", p99: " << m_timingSnapshot.percentile(0.99) / 1000.0 << " us"
+                << ", max: " << m_timingSnapshot.max / 1000.0 << " us" << std::endl;
+        }
+        if (processingChain->latency() > 0)
+            std::cout << "Processing latency: " << processingChain->latency() * 1000.0 / processingChain->sampleRate() << " ms (" 
+                << processingChain->latency() << " frames)." << std::endl;
+    }
+    if (stream->resamplerLatency() > 0.0)
+        std::cout << "Resampler latency: " << stream->resamplerLatency() * 1000.0 << " ms." << std::endl;
+    const LatencyCeiling* latencyCeiling = stream->latencyCeiling();
+    if (latencyCeiling)
+    {
+        std::cout << "Catch-ups over " << latencyCeiling->maxLatency() * 1000.0 << " ms: " << latencyCeiling->catchUpsCount() 
+            << ", dropped: " << latencyCeiling->droppedFrames() * 1000.0 / stream->sampleRate() << " ms ("
+            << latencyCeiling->audibleDroppedFrames() * 1000.0 / stream->sampleRate() << " ms outside silence)." << std::endl;
+    }
+
+    const DriftController* driftController = stream->driftController();
+    if (driftController)
+    {
+        std::cout << "Drift correction: " << driftController->correction() * 1e6 << " ppm, buffer level: " 
+            << driftController->level() * 1000.0 << " ms";
+        if (driftController->targetLevel() >= 0.0)
+            std::cout << " (target: " << driftController->targetLevel() * 1000.0 << " ms)";
+        std::cout << "." << std::endl;
+    }
+
+    const BufferController* bufferController = stream->bufferController();
+    if (bufferController)
+        std::cout << "Adaptive buffer: " << bufferController->periods() << " periods (min: " 
+            << bufferController->minPeriods() << ", max: " << bufferController->maxPeriods() << ")." << std::endl;
+
+    if (m_api == StreamApi::Alsa || m_api == StreamApi::Jack)
+        std::cout << "Xruns: " << stream->xrunsCount() << std::endl;
+
+    // The ring buffer is only used by the Pulse Simple API.
+    if (m_api == StreamApi::PulseSimple)
+    {
+        std::cout << "Ring buffer: " << stream->ringBufferFill() << "/" << stream->ringBufferPeriods() << " periods"
+            << ", overruns: " << stream->ringBufferOverruns()
+            << ", underruns: " << stream->ringBufferUnderruns() << std::endl;
+    }
+}
\ No newline at end of file
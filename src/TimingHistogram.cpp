@@ -0,0 +1,131 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "TimingHistogram.h"
+#include <cstring>
+
+TimingHistogram::Snapshot::Snapshot() :
+    count(0),
+    deadlineMisses(0),
+    max(0)
+{
+    memset(buckets, 0, sizeof(buckets));
+}
+
+uint64_t TimingHistogram::Snapshot::percentile(double fraction) const
+{
+    if (count == 0)
+        return 0;
+
+    uint64_t rank = static_cast<uint64_t>(fraction * count);
+    if (rank >= count)
+        rank = count - 1;
+
+    uint64_t total = 0;
+    for (int i = 0; i < BUCKETS_COUNT; i++)
+    {
+        total += buckets[i];
+        if (total > rank)
+        {
+            // The bucket upper bound may be above the highest duration recorded.
+            uint64_t value = bucketValue(i);
+            return value < max ? value : max;
+        }
+    }
+    return max;
+}
+
+void TimingHistogram::Snapshot::print(std::ostream& stream) const
+{
+    stream << "Period timing: " << count << " periods"
+        << ", p50: " << percentile(0.5) / 1000.0 << " us"
+        << ", p99: " << percentile(0.99) / 1000.0 << " us"
+        << ", p999: " << percentile(0.999) / 1000.0 << " us"
+        << ", max: " << max / 1000.0 << " us"
+        << ", deadline misses: " << deadlineMisses << std::endl;
+}
+
+TimingHistogram::TimingHistogram() :
+    m_deadlineMisses(0),
+    m_max(0)
+{
+    for (int i = 0; i < BUCKETS_COUNT; i++)
+        m_buckets[i].store(0, std::memory_order_relaxed);
+}
+
+TimingHistogram::~TimingHistogram()
+{}
+
+int TimingHistogram::bucketIndex(uint64_t value)
+{
+    // The first buckets are linear, then each power of two is split in SUB_BUCKETS.
+    if (value < 2 * SUB_BUCKETS)
+        return static_cast<int>(value);
+
+    int exponent = 0;
+    for (uint64_t v = value; v > 1; v >>= 1)
+        exponent++;
+    if (exponent > MAX_BITS)
+        return BUCKETS_COUNT - 1;
+
+    int subBucket = static_cast<int>(value >> (exponent - SUB_BUCKETS_BITS)) - SUB_BUCKETS;
+    return (exponent - SUB_BUCKETS_BITS + 1) * SUB_BUCKETS + subBucket;
+}
+
+uint64_t TimingHistogram::bucketValue(int index)
+{
+    if (index < 2 * SUB_BUCKETS)
+        return static_cast<uint64_t>(index);
+
+    int exponent = index / SUB_BUCKETS + SUB_BUCKETS_BITS - 1;
+    uint64_t subBucket = static_cast<uint64_t>(index % SUB_BUCKETS);
+    int shift = exponent - SUB_BUCKETS_BITS;
+    return ((SUB_BUCKETS + subBucket + 1) << shift) - 1;
+}
+
+void TimingHistogram::record(uint64_t duration, uint64_t deadline)
+{
+    // Single writer: a load and a store are enough, no locked instruction is needed.
+    std::atomic<uint32_t>& bucket = m_buckets[bucketIndex(duration)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    if (deadline > 0 && duration > deadline)
+        m_deadlineMisses.store(m_deadlineMisses.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (duration > m_max.load(std::memory_order_relaxed))
+        m_max.store(duration, std::memory_order_relaxed);
+}
+
+void TimingHistogram::snapshot(Snapshot& snapshot) const
+{
+    snapshot.count = 0;
+    for (int i = 0; i < BUCKETS_COUNT; i++)
+    {
+        snapshot.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.buckets[i];
+    }
+    snapshot.deadlineMisses = m_deadlineMisses.load(std::memory_order_relaxed);
+    snapshot.max = m_max.load(std::memory_order_relaxed);
+}
+
+void TimingHistogram::reset()
+{
+    for (int i = 0; i < BUCKETS_COUNT; i++)
+        m_buckets[i].store(0, std::memory_order_relaxed);
+    m_deadlineMisses.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,304 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "Tracer.h"
+#include <iomanip>
+#include <iostream>
+
+std::atomic<Tracer*> Tracer::s_instance(nullptr);
+std::atomic<unsigned int> Tracer::s_generation(0);
+std::atomic<int> Tracer::s_writers(0);
+
+Tracer::ThreadBuffer::ThreadBuffer() :
+    events(nullptr),
+    name(nullptr),
+    state(FREE_BUFFER),
+    tid(0),
+    isNameWritten(false),
+    writePos(0),
+    readPos(0),
+    droppedEvents(0)
+{}
+
+Tracer::ThreadSlot::ThreadSlot() :
+    generation(0),
+    buffer(nullptr),
+    name(nullptr)
+{}
+
+Tracer::ThreadSlot::~ThreadSlot()
+{
+    // The buffer of a previous trace is already gone.
+    Tracer* tracer = acquireInstance();
+    if (!tracer)
+        return;
+    if (buffer && generation == tracer->m_generation)
+        buffer->state.store(RELEASED_BUFFER, std::memory_order_release);
+    releaseInstance();
+}
+
+Tracer::Tracer(unsigned int generation) :
+    m_generation(generation),
+    m_isFirstEvent(true),
+    m_start(std::chrono::steady_clock::now()),
+    m_nextTid(1),
+    m_missedThreads(0),
+    m_isFlushing(false)
+{
+    // All the events are allocated here, never by the threads writing them.
+    for (int i = 0; i < MAX_THREADS; i++)
+        m_buffers[i].events = new Event[BUFFER_EVENTS];
+}
+
+Tracer::~Tracer()
+{
+    for (int i = 0; i < MAX_THREADS; i++)
+        delete[] m_buffers[i].events;
+}
+
+bool Tracer::start(const std::string& path)
+{
+    stop();
+
+    Tracer* tracer = new Tracer(s_generation.fetch_add(1) + 1);
+    tracer->m_file.open(path, std::ios::out | std::ios::trunc);
+    if (!tracer->m_file.is_open())
+    {
+        delete tracer;
+        return false;
+    }
+    tracer->m_file << "{\"traceEvents\":[" << std::endl;
+
+    tracer->m_isFlushing = true;
+    tracer->m_tFlush = std::thread(&Tracer::flushLoop, tracer);
+    s_instance.store(tracer, std::memory_order_release);
+    return true;
+}
+
+void Tracer::stop()
+{
+    Tracer* tracer = s_instance.exchange(nullptr);
+    if (!tracer)
+        return;
+
+    // The threads which loaded the tracer before it was cleared may still be writing an event.
+    while (s_writers.load(std::memory_order_acquire) != 0)
+        std::this_thread::yield();
+
+    tracer->m_isFlushing = false;
+    if (tracer->m_tFlush.joinable())
+        tracer->m_tFlush.join();
+    tracer->flush();
+
+    // Events lost because the flush thread was late.
+    unsigned long droppedEvents = 0;
+    for (int i = 0; i < MAX_THREADS; i++)
+        droppedEvents += tracer->m_buffers[i].droppedEvents.load();
+    unsigned long missedThreads = tracer->m_missedThreads.load();
+    tracer->m_file << std::endl << "],\"otherData\":{\"droppedEvents\":" << droppedEvents 
+        << ",\"missedThreads\":" << missedThreads << "}}" << std::endl;
+    tracer->m_file.close();
+    if (missedThreads > 0)
+        std::cout << "The trace is missing " << missedThreads << " threads, more than " << MAX_THREADS 
+            << " threads were traced at the same time." << std::endl;
+    delete tracer;
+}
+
+bool Tracer::isEnabled()
+{
+    return s_instance.load(std::memory_order_relaxed) != nullptr;
+}
+
+Tracer* Tracer::acquireInstance()
+{
+    // Only a pointer is checked when the tracer is not started.
+    if (!s_instance.load(std::memory_order_relaxed))
+        return nullptr;
+
+    // Counted before loading the tracer again, so stop() either see the writer or the writer see nullptr.
+    s_writers.fetch_add(1, std::memory_order_seq_cst);
+    Tracer* tracer = s_instance.load(std::memory_order_seq_cst);
+    if (!tracer)
+        s_writers.fetch_sub(1, std::memory_order_release);
+    return tracer;
+}
+
+void Tracer::releaseInstance()
+{
+    s_writers.fetch_sub(1, std::memory_order_release);
+}
+
+Tracer::ThreadSlot& Tracer::threadSlot()
+{
+    thread_local ThreadSlot t_slot;
+    return t_slot;
+}
+
+Tracer::ThreadBuffer* Tracer::threadBuffer(Tracer* tracer)
+{
+    // Each thread take a free buffer the first time it write an event.
+    ThreadSlot& t_slot = threadSlot();
+    if (t_slot.generation == tracer->m_generation)
+        return t_slot.buffer;
+
+    t_slot.generation = tracer->m_generation;
+    t_slot.buffer = nullptr;
+    for (int i = 0; i < MAX_THREADS; i++)
+    {
+        ThreadBuffer& buffer = tracer->m_buffers[i];
+        int state = FREE_BUFFER;
+        if (!buffer.state.compare_exchange_strong(state, TAKEN_BUFFER))
+            continue;
+
+        // The flush thread only read the buffer once it is used.
+        buffer.tid = tracer->m_nextTid.fetch_add(1);
+        buffer.name.store(t_slot.name, std::memory_order_relaxed);
+        buffer.isNameWritten = false;
+        buffer.state.store(USED_BUFFER, std::memory_order_release);
+        t_slot.buffer = &buffer;
+        return t_slot.buffer;
+    }
+
+    tracer->m_missedThreads.fetch_add(1, std::memory_order_relaxed);
+    return nullptr;
+}
+
+void Tracer::record(char phase, const char* name, double value)
+{
+    Tracer* tracer = acquireInstance();
+    if (!tracer)
+        return;
+    ThreadBuffer* buffer = threadBuffer(tracer);
+    if (!buffer)
+    {
+        releaseInstance();
+        return;
+    }
+
+    // The event is dropped when the flush thread is late.
+    size_t writePos = buffer->writePos.load(std::memory_order_relaxed);
+    if (writePos - buffer->readPos.load(std::memory_order_acquire) >= BUFFER_EVENTS)
+    {
+        buffer->droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        releaseInstance();
+        return;
+    }
+
+    Event& event = buffer->events[writePos & (BUFFER_EVENTS - 1)];
+    event.timestamp = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - tracer->m_start).count());
+    event.name = name;
+    event.phase = phase;
+    event.value = value;
+    buffer->writePos.store(writePos + 1, std::memory_order_release);
+    releaseInstance();
+}
+
+void Tracer::nameThread(const char* name)
+{
+    // The threads started before the tracer are named with their first event.
+    threadSlot().name = name;
+    Tracer* tracer = acquireInstance();
+    if (!tracer)
+        return;
+    ThreadBuffer* buffer = threadBuffer(tracer);
+    if (buffer)
+        buffer->name.store(name, std::memory_order_release);
+    releaseInstance();
+}
+
+void Tracer::begin(const char* name)
+{
+    record('B', name, 0.0);
+}
+
+void Tracer::end(const char* name)
+{
+    record('E', name, 0.0);
+}
+
+void Tracer::counter(const char* name, double value)
+{
+    record('C', name, value);
+}
+
+void Tracer::instant(const char* name)
+{
+    record('i', name, 0.0);
+}
+
+void Tracer::flushLoop()
+{
+    while (m_isFlushing)
+    {
+        flush();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+void Tracer::flush()
+{
+    for (int i = 0; i < MAX_THREADS; i++)
+    {
+        ThreadBuffer& buffer = m_buffers[i];
+        // The thread of a released buffer does not write anymore.
+        int state = buffer.state.load(std::memory_order_acquire);
+        if (state != USED_BUFFER && state != RELEASED_BUFFER)
+            continue;
+
+        // Thread name metadata.
+        const char* name = buffer.name.load(std::memory_order_acquire);
+        if (name && !buffer.isNameWritten)
+        {
+            if (!m_isFirstEvent)
+                m_file << "," << std::endl;
+            m_isFirstEvent = false;
+            m_file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer.tid 
+                << ",\"args\":{\"name\":\"" << name << "\"}}";
+            buffer.isNameWritten = true;
+        }
+
+        size_t readPos = buffer.readPos.load(std::memory_order_relaxed);
+        size_t writePos = buffer.writePos.load(std::memory_order_acquire);
+        for (; readPos != writePos; readPos++)
+            writeEvent(buffer.tid, buffer.events[readPos & (BUFFER_EVENTS - 1)]);
+        buffer.readPos.store(readPos, std::memory_order_release);
+
+        // Emptied, the buffer can be taken by the next thread.
+        if (state == RELEASED_BUFFER)
+            buffer.state.store(FREE_BUFFER, std::memory_order_release);
+    }
+    m_file.flush();
+}
+
+void Tracer::writeEvent(int tid, const Event& event)
+{
+    if (!m_isFirstEvent)
+        m_file << "," << std::endl;
+    m_isFirstEvent = false;
+
+    // The timestamps of the Chrome trace format are in microseconds.
+    m_file << "{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase 
+        << "\",\"ts\":" << std::fixed << std::setprecision(3) << event.timestamp / 1000.0
+        << ",\"pid\":1,\"tid\":" << tid;
+    if (event.phase == 'C')
+        m_file << ",\"args\":{\"value\":" << std::setprecision(6) << event.value << "}";
+    else if (event.phase == 'i')
+        m_file << ",\"s\":\"t\"";
+    m_file << "}";
+}
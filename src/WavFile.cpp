@@ -0,0 +1,301 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "WavFile.h"
+#include <cstring>
+
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_FLOAT 3
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+// The WAV headers are little endian whatever the host is.
+static unsigned int readLE(const unsigned char* data, int size)
+{
+    unsigned int value = 0;
+    for (int i = size - 1; i >= 0; i--)
+        value = (value << 8) | data[i];
+    return value;
+}
+
+static void writeLE(unsigned char* data, unsigned int value, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        data[i] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+WavReader::WavReader() :
+    m_file(nullptr),
+    m_channelsCount(0),
+    m_sampleRate(0),
+    m_sampleFormat(SampleFormat::Int16),
+    m_frameSize(0),
+    m_framesCount(0),
+    m_framesRead(0)
+{}
+
+WavReader::~WavReader()
+{
+    close();
+}
+
+bool WavReader::open(const std::string& path)
+{
+    close();
+
+    m_file = fopen(path.c_str(), "rb");
+    if (!m_file)
+    {
+        m_strError = "Failed to open the file " + path + ".";
+        return false;
+    }
+
+    unsigned char header[12];
+    if (fread(header, 1, 12, m_file) != 12 ||
+        memcmp(header, "RIFF", 4) != 0 ||
+        memcmp(header + 8, "WAVE", 4) != 0)
+    {
+        m_strError = path + " is not a WAV file.";
+        close();
+        return false;
+    }
+
+    // Looking for the fmt and data chunks.
+    bool isFormatFound = false;
+    unsigned char chunk[8];
+    while (fread(chunk, 1, 8, m_file) == 8)
+    {
+        unsigned int chunkSize = readLE(chunk + 4, 4);
+
+        if (memcmp(chunk, "fmt ", 4) == 0)
+        {
+            unsigned char format[40] = {};
+            size_t formatSize = chunkSize < sizeof(format) ? chunkSize : sizeof(format);
+            if (formatSize < 16 || fread(format, 1, formatSize, m_file) != formatSize)
+                break;
+            if (chunkSize + (chunkSize & 1) > formatSize)
+                fseek(m_file, chunkSize + (chunkSize & 1) - formatSize, SEEK_CUR);
+
+            unsigned int formatTag = readLE(format, 2);
+            m_channelsCount = readLE(format + 2, 2);
+            m_sampleRate = readLE(format + 4, 4);
+            unsigned int bitsPerSample = readLE(format + 14, 2);
+            // The real format of an extensible file is the beginning of the sub format GUID.
+            if (formatTag == WAV_FORMAT_EXTENSIBLE && formatSize >= 26)
+                formatTag = readLE(format + 24, 2);
+
+            if (formatTag == WAV_FORMAT_PCM && bitsPerSample == 16)
+                m_sampleFormat = SampleFormat::Int16;
+            else if (formatTag == WAV_FORMAT_PCM && bitsPerSample == 24)
+                m_sampleFormat = SampleFormat::Int24;
+            else if (formatTag == WAV_FORMAT_PCM && bitsPerSample == 32)
+                m_sampleFormat = SampleFormat::Int32;
+            else if (formatTag == WAV_FORMAT_FLOAT && bitsPerSample == 32)
+                m_sampleFormat = SampleFormat::Float32;
+            else
+            {
+                m_strError = path + ": only PCM 16, 24 and 32 bits and float 32 bits WAV files are supported.";
+                close();
+                return false;
+            }
+            m_frameSize = m_channelsCount * sampleFormatSize(m_sampleFormat);
+            isFormatFound = m_channelsCount > 0 && m_sampleRate > 0;
+        }
+        else if (memcmp(chunk, "data", 4) == 0)
+        {
+            if (!isFormatFound)
+                break;
+            // The file is now at the beginning of the frames.
+            m_framesCount = chunkSize / m_frameSize;
+            m_framesRead = 0;
+            return true;
+        }
+        else
+        {
+            // Chunks are aligned on two bytes.
+            fseek(m_file, chunkSize + (chunkSize & 1), SEEK_CUR);
+        }
+    }
+
+    m_strError = path + " is not a valid WAV file.";
+    close();
+    return false;
+}
+
+void WavReader::close()
+{
+    if (m_file)
+    {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+size_t WavReader::read(void* data, size_t frames)
+{
+    if (!m_file)
+        return 0;
+
+    if (frames > m_framesCount - m_framesRead)
+        frames = m_framesCount - m_framesRead;
+    size_t framesRead = fread(data, m_frameSize, frames, m_file);
+    m_framesRead += framesRead;
+    return framesRead;
+}
+
+int WavReader::channelsCount() const
+{
+    return m_channelsCount;
+}
+
+int WavReader::sampleRate() const
+{
+    return m_sampleRate;
+}
+
+SampleFormat WavReader::sampleFormat() const
+{
+    return m_sampleFormat;
+}
+
+size_t WavReader::framesCount() const
+{
+    return m_framesCount;
+}
+
+const std::string& WavReader::error() const
+{
+    return m_strError;
+}
+
+WavWriter::WavWriter() :
+    m_file(nullptr),
+    m_channelsCount(0),
+    m_sampleRate(0),
+    m_sampleFormat(SampleFormat::Int16),
+    m_frameSize(0),
+    m_framesWritten(0)
+{}
+
+WavWriter::~WavWriter()
+{
+    close();
+}
+
+bool WavWriter::open(const std::string& path, int channelsCount, int sampleRate, SampleFormat format)
+{
+    close();
+
+    m_channelsCount = channelsCount;
+    m_sampleRate = sampleRate;
+    m_sampleFormat = format;
+    m_frameSize = channelsCount * sampleFormatSize(format);
+    m_framesWritten = 0;
+
+    m_file = fopen(path.c_str(), "wb");
+    if (!m_file)
+    {
+        m_strError = "Failed to create the file " + path + ".";
+        return false;
+    }
+
+    // The sizes are written when the file is closed.
+    if (!writeHeader())
+    {
+        m_strError = "Failed to write the file " + path + ".";
+        close();
+        return false;
+    }
+    return true;
+}
+
+void WavWriter::close()
+{
+    if (!m_file)
+        return;
+
+    // Chunks are aligned on two bytes.
+    if ((m_framesWritten * m_frameSize) & 1)
+        fputc(0, m_file);
+    fseek(m_file, 0, SEEK_SET);
+    writeHeader();
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+bool WavWriter::writeHeader()
+{
+    unsigned int dataSize = static_cast<unsigned int>(m_framesWritten * m_frameSize);
+    unsigned int bitsPerSample = static_cast<unsigned int>(sampleFormatSize(m_sampleFormat) * 8);
+    unsigned int formatTag = m_sampleFormat == SampleFormat::Float32 ? WAV_FORMAT_FLOAT : WAV_FORMAT_PCM;
+    // Integer samples over 16 bits and more than two channels need the extensible format.
+    bool isExtensible = (formatTag == WAV_FORMAT_PCM && bitsPerSample > 16) || m_channelsCount > 2;
+    unsigned int formatSize = isExtensible ? 40 : 16;
+
+    unsigned char header[68] = {};
+    memcpy(header, "RIFF", 4);
+    writeLE(header + 4, 4 + 8 + formatSize + 8 + dataSize + (dataSize & 1), 4);
+    memcpy(header + 8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);
+    writeLE(header + 16, formatSize, 4);
+    writeLE(header + 20, isExtensible ? WAV_FORMAT_EXTENSIBLE : formatTag, 2);
+    writeLE(header + 22, m_channelsCount, 2);
+    writeLE(header + 24, m_sampleRate, 4);
+    writeLE(header + 28, static_cast<unsigned int>(m_sampleRate * m_frameSize), 4);
+    writeLE(header + 32, static_cast<unsigned int>(m_frameSize), 2);
+    writeLE(header + 34, bitsPerSample, 2);
+    unsigned char* data = header + 36;
+    if (isExtensible)
+    {
+        // Size of the extension, valid bits, speakers of the channels and sub format GUID.
+        static const unsigned char guidTail[14] = { 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+        unsigned int channelMask = 0;
+        if (m_channelsCount == 1)
+            channelMask = 0x4;
+        else if (m_channelsCount <= 18)
+            channelMask = (1u << m_channelsCount) - 1;
+        writeLE(header + 36, 22, 2);
+        writeLE(header + 38, bitsPerSample, 2);
+        writeLE(header + 40, channelMask, 4);
+        writeLE(header + 44, formatTag, 2);
+        memcpy(header + 46, guidTail, sizeof(guidTail));
+        data = header + 60;
+    }
+    memcpy(data, "data", 4);
+    writeLE(data + 4, dataSize, 4);
+
+    size_t headerSize = static_cast<size_t>(data + 8 - header);
+    return fwrite(header, 1, headerSize, m_file) == headerSize;
+}
+
+bool WavWriter::write(const void* data, size_t frames)
+{
+    if (!m_file)
+        return false;
+
+    size_t framesWritten = fwrite(data, m_frameSize, frames, m_file);
+    m_framesWritten += framesWritten;
+    return framesWritten == frames;
+}
+
+const std::string& WavWriter::error() const
+{
+    return m_strError;
+}
@@ -0,0 +1,134 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "FileBackend.h"
+#include "WavFile.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+The drift compensation must hold the buffer of a playback device drifting by N ppm (the first argument).
+Noise is played by the file API into its simulated playback device, as fast as possible,
+the test fail on an underflow or when the buffer is not back at its target at the end.
+*/
+
+static const int SAMPLE_RATE = 16000;
+static const unsigned long FRAMES_PER_BUFFER = 128;
+// The correction settle in about two minutes.
+static const int DURATION = 180;
+// Tolerances at the end of the file.
+static const double MAX_LEVEL_ERROR = 0.0005;
+static const double MAX_CORRECTION_ERROR = 20e-6;
+
+static bool writeNoise(const std::string& path)
+{
+    WavWriter writer;
+    if (!writer.open(path, 1, SAMPLE_RATE, SampleFormat::Int16))
+    {
+        std::cout << writer.error() << std::endl;
+        return false;
+    }
+
+    std::vector<int16_t> period(SAMPLE_RATE / 10);
+    srand(1);
+    for (int i = 0; i < DURATION * 10; i++)
+    {
+        for (int16_t& sample : period)
+            sample = static_cast<int16_t>(rand() % 2001 - 1000);
+        if (!writer.write(period.data(), period.size()))
+        {
+            std::cout << "Failed to write " << path << "." << std::endl;
+            return false;
+        }
+    }
+    writer.close();
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        std::cout << "Usage: DriftTest <drift in ppm>" << std::endl;
+        return EXIT_FAILURE;
+    }
+    double drift = std::atof(argv[1]);
+
+    std::string path = std::string("drift_test_") + argv[1] + ".wav";
+    if (!writeNoise(path))
+        return EXIT_FAILURE;
+
+    StreamConfig config;
+    config.sampleRate = SAMPLE_RATE;
+    config.channelsCount = 1;
+    config.framesPerBuffer = FRAMES_PER_BUFFER;
+    config.isDriftCompensation = true;
+    config.inputFile = path;
+    config.simulatedDrift = drift;
+
+    FileBackend backend;
+    if (!backend.init(config) || !backend.play())
+    {
+        std::cout << backend.error() << std::endl;
+        std::remove(path.c_str());
+        return EXIT_FAILURE;
+    }
+    while (backend.isPlayingContinue())
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    backend.stop();
+    backend.printSummary(std::cout);
+    std::remove(path.c_str());
+
+    // A positive correction consume the captured frames faster, it compensate a slower playback.
+    const DriftController* driftController = backend.driftController();
+    if (!driftController)
+    {
+        std::cout << "The drift is not compensated." << std::endl;
+        return EXIT_FAILURE;
+    }
+    unsigned long underflows = backend.counters().outputUnderflows.load();
+    double levelError = driftController->level() - driftController->targetLevel();
+    double correctionError = driftController->correction() + drift * 1e-6;
+    std::cout << "Drift correction: " << driftController->correction() * 1e6 << " ppm, buffer level: " 
+        << driftController->level() * 1000.0 << " ms (target: " << driftController->targetLevel() * 1000.0 << " ms), "
+        << underflows << " underflows." << std::endl;
+
+    bool isSuccess = true;
+    if (underflows > 0)
+    {
+        std::cout << "The simulated playback device underflowed." << std::endl;
+        isSuccess = false;
+    }
+    if (driftController->targetLevel() < 0.0 || std::fabs(levelError) > MAX_LEVEL_ERROR)
+    {
+        std::cout << "The buffer is more than " << MAX_LEVEL_ERROR * 1000.0 << " ms away from its target." << std::endl;
+        isSuccess = false;
+    }
+    if (std::fabs(correctionError) > MAX_CORRECTION_ERROR)
+    {
+        std::cout << "The correction is more than " << MAX_CORRECTION_ERROR * 1e6 << " ppm away from the drift." << std::endl;
+        isSuccess = false;
+    }
+    return isSuccess ? EXIT_SUCCESS : EXIT_FAILURE;
+}
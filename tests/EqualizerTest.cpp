@@ -0,0 +1,100 @@
+/*
+ * MIT Licence
+ * 
+ * MicrophoneLoopback
+ * 
+ * Copyright © 2022 Erwan Saclier de la Bâtie (BlueDragon28)
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), 
+ * to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "EqualizerStage.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+The vectorized equalizer must give the same samples as its scalar path.
+The scalar path is used for the periods shorter than the lanes, so the same noise
+is filtered in one long period and frame by frame.
+*/
+
+static const int CHANNELS_COUNT = 2;
+static const unsigned long FRAMES_COUNT = 4000;
+
+static bool compare(const std::string& bandsList)
+{
+    std::vector<BiquadBand> bands;
+    if (!biquadBandsFromString(bandsList, &bands))
+    {
+        std::cout << "Invalid bands " << bandsList << "." << std::endl;
+        return false;
+    }
+
+    EqualizerStage vectorized(bands);
+    EqualizerStage scalar(bands);
+    if (!vectorized.init(48000, CHANNELS_COUNT, FRAMES_COUNT) || !scalar.init(48000, CHANNELS_COUNT, FRAMES_COUNT))
+    {
+        std::cout << "Failed to design the bands " << bandsList << "." << std::endl;
+        return false;
+    }
+
+    std::vector<std::vector<float>> vectorizedPlanes(CHANNELS_COUNT, std::vector<float>(FRAMES_COUNT));
+    for (std::vector<float>& plane : vectorizedPlanes)
+    {
+        for (float& sample : plane)
+            sample = static_cast<float>(rand()) / RAND_MAX - 0.5f;
+    }
+    std::vector<std::vector<float>> scalarPlanes = vectorizedPlanes;
+
+    float* planes[CHANNELS_COUNT];
+    for (int c = 0; c < CHANNELS_COUNT; c++)
+        planes[c] = vectorizedPlanes[c].data();
+    vectorized.process(planes, FRAMES_COUNT);
+
+    for (unsigned long t = 0; t < FRAMES_COUNT; t++)
+    {
+        for (int c = 0; c < CHANNELS_COUNT; c++)
+            planes[c] = scalarPlanes[c].data() + t;
+        scalar.process(planes, 1);
+    }
+
+    unsigned long differences = 0;
+    for (int c = 0; c < CHANNELS_COUNT; c++)
+    {
+        for (unsigned long t = 0; t < FRAMES_COUNT; t++)
+        {
+            if (vectorizedPlanes[c][t] != scalarPlanes[c][t])
+                differences++;
+        }
+    }
+    if (differences > 0)
+    {
+        std::cout << bands.size() << " bands: " << differences << " of " << CHANNELS_COUNT * FRAMES_COUNT 
+            << " samples differ between the vectorized and the scalar paths." << std::endl;
+        return false;
+    }
+    std::cout << bands.size() << " bands: identical." << std::endl;
+    return true;
+}
+
+int main()
+{
+    srand(1);
+
+    // A partial group of bands and several groups.
+    bool isSuccess = compare("peaking:1000:1.5:4");
+    isSuccess = compare("highpass:80,lowshelf:200:0.7:-3,peaking:1000:1.5:4,highshelf:8000:0.7:2") && isSuccess;
+    isSuccess = compare("highpass:80,lowshelf:200:0.7:-3,peaking:1000:1.5:4,peaking:3000:2:-5,highshelf:8000:0.7:2,lowpass:16000") 
+        && isSuccess;
+    return isSuccess ? EXIT_SUCCESS : EXIT_FAILURE;
+}